@@ -0,0 +1,187 @@
+#include "LevelMeter.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LEVELMETER_SSE2
+#include <emmintrin.h>
+#endif
+
+
+LevelMeter::LevelMeter(DWORD stream, int priority)
+{
+    this->stream = stream;
+    this->priority = priority;
+}
+
+LevelMeter::~LevelMeter()
+{
+    if (_on)
+        off();
+}
+
+void LevelMeter::on()
+{
+    if (_on)
+        return;
+
+    _on = true;
+
+    if (stream == 0)
+        return;
+
+    BASS_CHANNELINFO info;
+    if (!BASS_ChannelGetInfo(stream, &info))
+        return;
+
+    if (info.flags & BASS_SAMPLE_FLOAT)
+        sampleBytes = 4;
+    else if (info.flags & BASS_SAMPLE_8BITS)
+        sampleBytes = 1;
+    else
+        sampleBytes = 2;
+
+    dsp = BASS_ChannelSetDSP(stream, &LevelMeter::meterProc, this, priority);
+}
+
+void LevelMeter::off()
+{
+    if (!_on)
+        return;
+
+    _on = false;
+
+    if (dsp != 0)
+        BASS_ChannelRemoveDSP(stream, dsp);
+    dsp = 0;
+
+    for (int i=0; i<METER_READERS; i++) {
+        _peak[i].storeRelease(0);
+        _rms[i].storeRelease(0);
+    }
+}
+
+void LevelMeter::setStreamHandle(DWORD stream)
+{
+    if (_on)
+    {
+        off();
+        this->stream = stream;
+        on();
+    }
+    else
+    {
+        this->stream = stream;
+    }
+}
+
+MeterLevel LevelMeter::take(MeterReader reader)
+{
+    int i = static_cast<int>(reader);
+    quint32 p = _peak[i].fetchAndStoreAcquire(0);
+    quint32 r = _rms[i].fetchAndStoreAcquire(0);
+
+    MeterLevel level;
+    std::memcpy(&level.peak, &p, sizeof(float));
+    std::memcpy(&level.rms, &r, sizeof(float));
+
+    return level;
+}
+
+int LevelMeter::dbSteps(float level, int steps)
+{
+    if (level <= 0.001f)
+        return 0;
+
+    float db = 20.0f * std::log10(level);
+    return qBound(0, qRound((db + 60.0f) * steps / 60.0f), steps);
+}
+
+void LevelMeter::measure(const float *samples, int count, float *peak, float *sumSquares)
+{
+    int i = 0;
+    float pk = 0.0f;
+    float sum = 0.0f;
+
+    #ifdef LEVELMETER_SSE2
+    // 4 samples a step, the sign bit masked off for the peak
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 vPeak = _mm_setzero_ps();
+    __m128 vSum = _mm_setzero_ps();
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_loadu_ps(samples + i);
+        vPeak = _mm_max_ps(vPeak, _mm_and_ps(v, absMask));
+        vSum = _mm_add_ps(vSum, _mm_mul_ps(v, v));
+    }
+
+    float p[4], s[4];
+    _mm_storeu_ps(p, vPeak);
+    _mm_storeu_ps(s, vSum);
+    pk = std::fmax(std::fmax(p[0], p[1]), std::fmax(p[2], p[3]));
+    sum = (s[0] + s[1]) + (s[2] + s[3]);
+    #endif
+
+    for (; i < count; i++) {
+        pk = std::fmax(pk, std::fabs(samples[i]));
+        sum += samples[i] * samples[i];
+    }
+
+    *peak = pk;
+    *sumSquares = sum;
+}
+
+void CALLBACK LevelMeter::meterProc(HDSP handle, DWORD channel, void *buffer, DWORD length, void *user)
+{
+    Q_UNUSED(handle);
+    Q_UNUSED(channel);
+
+    LevelMeter *m = static_cast<LevelMeter*>(user);
+
+    int count = length / m->sampleBytes;
+    if (count == 0)
+        return;
+
+    float peak = 0.0f;
+    float sum = 0.0f;
+
+    switch (m->sampleBytes) {
+    case 4:
+        measure(static_cast<const float*>(buffer), count, &peak, &sum);
+        break;
+    case 2: {
+        const short *s = static_cast<const short*>(buffer);
+        int pk = 0;
+        for (int i=0; i<count; i++) {
+            pk = qMax(pk, qAbs((int)s[i]));
+            sum += (float)s[i] * s[i];
+        }
+        peak = pk / 32768.0f;
+        sum /= 32768.0f * 32768.0f;
+        break;
+    }
+    default:
+        return;
+    }
+
+    float rms = std::sqrt(sum / count);
+    for (int i=0; i<METER_READERS; i++) {
+        storeMax(m->_peak[i], peak);
+        storeMax(m->_rms[i], rms);
+    }
+}
+
+void LevelMeter::storeMax(QAtomicInteger<quint32> &level, float v)
+{
+    // false for NaN too
+    if (!(v > 0.0f))
+        return;
+
+    quint32 bits;
+    std::memcpy(&bits, &v, sizeof(float));
+
+    quint32 old = level.loadAcquire();
+    while (bits > old && !level.testAndSetRelease(old, bits))
+        old = level.loadAcquire();
+}
@@ -0,0 +1,64 @@
+#ifndef LEVELMETER_H
+#define LEVELMETER_H
+
+#include <bass.h>
+
+#include <QAtomicInteger>
+
+// linear, 1.0 is full scale
+typedef struct
+{
+    float peak;
+    float rms;
+} MeterLevel;
+
+// The views that take levels, each one has its own highest levels
+enum class MeterReader
+{
+    SynthMixer,
+    ChannelMixer
+};
+
+#define METER_READERS   2
+
+// Peak and RMS of a stream, measured by a DSP after the FX of the
+// stream on the thread that mixes it. The GUI takes the levels
+// without a lock. Nothing is hooked while off.
+class LevelMeter
+{
+public:
+    LevelMeter(DWORD stream = 0, int priority = -1000);
+    ~LevelMeter();
+
+    void on();
+    void off();
+    bool isOn() { return _on; }
+
+    void setStreamHandle(DWORD stream);
+
+    // highest levels since the last call of reader
+    MeterLevel take(MeterReader reader = MeterReader::SynthMixer);
+
+    // -60 dB to full scale on steps, 0 below
+    static int dbSteps(float level, int steps);
+
+    // the kernel, float samples of any channel count
+    static void measure(const float *samples, int count, float *peak, float *sumSquares);
+
+private:
+    static void CALLBACK meterProc(HDSP handle, DWORD channel, void *buffer, DWORD length, void *user);
+
+    static void storeMax(QAtomicInteger<quint32> &level, float v);
+
+    DWORD stream;
+    HDSP dsp = 0;
+    int priority;
+    bool _on = false;
+    int sampleBytes = 4;    // 4 float, 2 16 bit, 1 8 bit
+
+    // float bits, positive floats sort as their bits
+    QAtomicInteger<quint32> _peak[METER_READERS];
+    QAtomicInteger<quint32> _rms[METER_READERS];
+};
+
+#endif // LEVELMETER_H
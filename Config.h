@@ -12,7 +12,6 @@
 
 
 #define TEMP_DIR_PATH           QDir::tempPath() + "/HandyKaraoke"
-#define TEMP_MIDI_DIR_PATH      TEMP_DIR_PATH + "/temp.mid"
 
 #define ALL_DATA_DIR_PATH       QDir::homePath() + "/.HandyKaraoke"
 
@@ -9,6 +9,9 @@ SecondMonitorDialog::SecondMonitorDialog(QWidget *parent, LyricsWidget *lyr) :
 
     ui->setupUi(this);
 
+    // lines are laid out and drawn once for both monitors
+    ui->lyr->shareLayouts(lyr);
+
     ui->lyr->setTextFont(lyr->textFont());
     ui->lyr->setTextColor(lyr->textColor());
     ui->lyr->setTextBorderColor(lyr->textBorderColor());
@@ -27,6 +30,8 @@ SecondMonitorDialog::SecondMonitorDialog(QWidget *parent, LyricsWidget *lyr) :
     ui->lyr->setLine1Y(lyr->line1Y());
     ui->lyr->setLine2Y(lyr->line2Y());
     ui->lyr->setAnimationTime(lyr->animationTime());
+    ui->lyr->setFrameWipe(lyr->isFrameWipe());
+    ui->lyr->setPlayer(lyr->player());
     ui->lyr->setAutoFontSize(lyr->isAutoFontSize());
 
     ui->lyr->setLyrics(lyr->lyrData(), lyr->curData());
@@ -46,6 +46,10 @@ SynthMixerDialog::SynthMixerDialog(QWidget *parent, MainWindow *mainWin) : //, M
     settingTimer.start();
     connect(&settingTimer, SIGNAL(timeout()), this, SLOT(settingValues()));
 
+    // poll the stream level meters of the synth at VU rate
+    peakTimer.setInterval(30);
+    connect(&peakTimer, SIGNAL(timeout()), this, SLOT(readLevels()));
+
     this->mainWin = mainWin;
     this->player = mainWin->midiPlayer();
     this->synth = player->midiSynthesizer();
@@ -53,6 +57,16 @@ SynthMixerDialog::SynthMixerDialog(QWidget *parent, MainWindow *mainWin) : //, M
     mapChInstUI();
     setChInstDetails();
 
+    // a meter per device mixer, what goes out after the master volume
+    for (int i=0; i<synth->mixerCount(); i++) {
+        LEDVu *vu = new LEDVu(this);
+        vu->setMaximumLevel(127);
+        vu->setFixedSize(8, 30);
+        vu->setToolTip(tr("Output %1").arg(i + 1));
+        ui->horizontalLayout_2->insertWidget(ui->horizontalLayout_2->indexOf(ui->btnMenu), vu);
+        outVus.append(vu);
+    }
+
     ui->scrollArea->setWidgetResizable(false);
     this->adjustSize();
     this->setMinimumSize(970, height());
@@ -199,6 +213,18 @@ SynthMixerDialog::SynthMixerDialog(QWidget *parent, MainWindow *mainWin) : //, M
             #endif
         }
         st.endArray();
+
+        for (LEDVu *vBar : outVus) {
+            vBar->setBackGroundColor(QColor(bg));
+            vBar->setLedColorOn1(QColor(o1));
+            vBar->setLedColorOn2(QColor(o2));
+            vBar->setLedColorOn3(QColor(o3));
+            vBar->setLedColorOff1(QColor(f1));
+            vBar->setLedColorOff2(QColor(f2));
+            vBar->setLedColorOff3(QColor(f3));
+            vBar->setShowPeakHold(sph);
+            vBar->setPeakHoldMs(phm);
+        }
     }
 
     connect(&btnPresets, SIGNAL(buttonClicked(int)), this, SLOT(changeSoundfontPresets(int)));
@@ -487,25 +513,35 @@ void SynthMixerDialog::resetMixLevel(InstrumentType t)
     synth->setVolume(t, 50);
 }
 
-void SynthMixerDialog::showPeakVU(InstrumentType t, int bus,  int ch, int note, int velocity)
+void SynthMixerDialog::readLevels()
 {
-    chInstMap[t]->peak(velocity);
-    if(bus > -1) {
-        InstrumentType bType = static_cast<InstrumentType>(bus + synth->HANDLE_MIDI_COUNT);
-        chInstMap[bType]->peak(velocity);
+    // -60 dB to full scale on the 127 leds
+    for (InstrumentType t : chInstMap.keys())
+    {
+        int leds = LevelMeter::dbSteps(synth->takeLevel(t).peak, 127);
+        if (leds > 0)
+            chInstMap[t]->peak(leds);
+    }
+
+    for (int i=0; i<outVus.count(); i++)
+    {
+        int leds = LevelMeter::dbSteps(synth->takeMixerLevel(i).peak, 127);
+        if (leds > outVus[i]->level())
+            outVus[i]->peak(leds);
     }
 }
 
 void SynthMixerDialog::showEvent(QShowEvent *)
 {
-    connect(synth, SIGNAL(noteOnSended(InstrumentType,int,int,int,int)),
-            this, SLOT(showPeakVU(InstrumentType,int,int,int,int)));
+    // the streams are measured only while the meters are seen
+    synth->setMetering(true);
+    peakTimer.start();
 }
 
 void SynthMixerDialog::hideEvent(QHideEvent *event)
 {
-    disconnect(synth, SIGNAL(noteOnSended(InstrumentType,int,int,int,int)),
-            this, SLOT(showPeakVU(InstrumentType,int,int,int,int)));
+    peakTimer.stop();
+    synth->setMetering(false);
 }
 
 void SynthMixerDialog::mapChInstUI()
@@ -999,6 +1035,7 @@ void SynthMixerDialog::showVuDlg()
     {
         vus.append(ch->vuBar());
     }
+    vus.append(outVus);
 
     SettingVuDialog vdlg(this, vus);
     vdlg.setModal(true);
@@ -47,7 +47,7 @@ private slots:
     void setSolo(InstrumentType t, bool s);
     void setMixLevel(InstrumentType t, int level);
     void resetMixLevel(InstrumentType t);
-    void showPeakVU(InstrumentType t, int bus, int ch, int note, int velocity);
+    void readLevels();
 
     void showChannelMenu(InstrumentType type, const QPoint &pos);
     void setBusGroup(int group);
@@ -77,12 +77,14 @@ private:
     Ui::SynthMixerDialog *ui;
 
     QTimer settingTimer;
+    QTimer peakTimer;
     MainWindow *mainWin;
     MidiPlayer *player;
     MidiSynthesizer *synth;
     InstrumentType currentType;
 
     QMap<InstrumentType, InstCh*> chInstMap;
+    QList<LEDVu*> outVus;   // per device mixer
 
     QList<QMenu*> vstVendorMenus;
     QSignalMapper signalVstActionMapper;
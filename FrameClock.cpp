@@ -0,0 +1,13 @@
+#include "FrameClock.h"
+
+
+FrameClock::FrameClock(QObject *parent) : QAbstractAnimation(parent)
+{
+}
+
+void FrameClock::updateCurrentTime(int currentTime)
+{
+    Q_UNUSED(currentTime);
+
+    emit frame();
+}
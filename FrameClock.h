@@ -0,0 +1,24 @@
+#ifndef FRAMECLOCK_H
+#define FRAMECLOCK_H
+
+#include <QAbstractAnimation>
+
+// Emits frame() once per tick of Qt's animation timer, the one clock
+// that also steps every QVariantAnimation of the window. Runs until
+// stopped.
+class FrameClock : public QAbstractAnimation
+{
+    Q_OBJECT
+public:
+    explicit FrameClock(QObject *parent = nullptr);
+
+    int duration() const { return -1; }
+
+signals:
+    void frame();
+
+protected:
+    void updateCurrentTime(int currentTime);
+};
+
+#endif // FRAMECLOCK_H
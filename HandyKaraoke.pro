@@ -20,14 +20,23 @@ SOURCES += main.cpp\
     MedleyLoader.cpp \
     SettingsDialog.cpp \
     SongDatabase.cpp \
+    SongScanner.cpp \
+    SearchSession.cpp \
+    SongCache.cpp \
+    FrameClock.cpp \
+    SongCatalog.cpp \
     Song.cpp \
+    Midi/MidiEventStore.cpp \
     Midi/MidiFile.cpp \
     Midi/MidiEvent.cpp \
     Midi/MidiOut.cpp \
     Midi/Channel.cpp \
     Midi/MidiSynthesizer.cpp \
     Widgets/Background.cpp \
+    Widgets/SlideshowLoader.cpp \
     Widgets/ChMx.cpp \
+    Widgets/LyricsLayout.cpp \
+    Widgets/LyricsTimeline.cpp \
     Widgets/LyricsWidget.cpp \
     Widgets/RhythmWidget.cpp \
     Widgets/ChannelMixer.cpp \
@@ -60,7 +69,9 @@ SOURCES += main.cpp\
     Dialogs/SynthMixerDialog.cpp \
     Dialogs/SecondMonitorDialog.cpp \
     Midi/MidiSequencer.cpp \
+    Midi/MidiDispatcher.cpp \
     Midi/MidiPlayer.cpp \
+    Midi/MidiRenderer.cpp \
     Dialogs/MapChannelDialog.cpp \
     Widgets/ChMxComboBox.cpp \
     BASSFX/AutoWahFX.cpp \
@@ -81,6 +92,7 @@ SOURCES += main.cpp\
     Dialogs/Chorus2Dialog.cpp \
     BASSFX/Chorus2FX.cpp \
     BASSFX/Reverb2FX.cpp \
+    BASSFX/LevelMeter.cpp \
     Dialogs/Reverb2Dialog.cpp \
     Dialogs/DeleteSongDialog.cpp
 
@@ -89,14 +101,23 @@ HEADERS  += MainWindow.h \
     MedleyLoader.h \
     SettingsDialog.h \
     SongDatabase.h \
+    SongScanner.h \
+    SearchSession.h \
+    SongCache.h \
+    FrameClock.h \
+    SongCatalog.h \
     Song.h \
+    Midi/MidiEventStore.h \
     Midi/MidiFile.h \
     Midi/MidiEvent.h \
     Midi/MidiOut.h \
     Midi/Channel.h \
     Midi/MidiSynthesizer.h \
     Widgets/Background.h \
+    Widgets/SlideshowLoader.h \
     Widgets/ChMx.h \
+    Widgets/LyricsLayout.h \
+    Widgets/LyricsTimeline.h \
     Widgets/LyricsWidget.h \
     Widgets/RhythmWidget.h \
     Widgets/ChannelMixer.h \
@@ -130,7 +151,10 @@ HEADERS  += MainWindow.h \
     Dialogs/BusDialog.h \
     Dialogs/SecondMonitorDialog.h \
     Midi/MidiSequencer.h \
+    Midi/EventRing.h \
+    Midi/MidiDispatcher.h \
     Midi/MidiPlayer.h \
+    Midi/MidiRenderer.h \
     DrumPadsKey.h \
     version.h \
     Dialogs/MapChannelDialog.h \
@@ -154,6 +178,7 @@ HEADERS  += MainWindow.h \
     Dialogs/Chorus2Dialog.h \
     BASSFX/Chorus2FX.h \
     BASSFX/Reverb2FX.h \
+    BASSFX/LevelMeter.h \
     Dialogs/Reverb2Dialog.h \
     Midi/HNKFileComp.h \
     Dialogs/DeleteSongDialog.h
@@ -13,10 +13,11 @@
 #include "Config.h"
 #include "Utils.h"
 #include "MedleyLoader.h"
+#include "SongCache.h"
 #include "DrumPadsKey.h"
 #include "SettingsDialog.h"
 #include "Midi/MidiFile.h"
-#include "Midi/HNKFile.h"
+#include "Midi/MidiRenderer.h"
 #include "Dialogs/AboutDialog.h"
 #include "Dialogs/MapSoundfontDialog.h"
 #include "Dialogs/MapChannelDialog.h"
@@ -99,6 +100,11 @@ MainWindow::MainWindow(QWidget *parent) :
     db->setNcnPath(ncn);
     db->setHNKPath(hnk);
     db->setKarPath(kar);
+    db->setUseCatalog(settings->value("SongCatalogInMemory", false).toBool());
+
+    songCache = new SongCache(db, settings->value("SongCacheSizeMB", 256).toLongLong() * 1024 * 1024);
+    songCache->setAheadCount(settings->value("SongCacheAhead", 3).toInt());
+    songCache->start(QThread::LowPriority);
 
 
     timer1 = new QTimer();
@@ -108,13 +114,13 @@ MainWindow::MainWindow(QWidget *parent) :
     positionTimer = new QTimer(this);
     positionTimer->setInterval(30);
 
-    lyricsTimer = new QTimer(0);
-    lyricsTimer->setInterval(30);
+    lyricsClock = new FrameClock();
 
     detailTimer = new QTimer();
     detailTimer->setSingleShot(true);
 
     player = new MidiPlayer();
+    lyrWidget->setPlayer(player);
 
     locale = QLocale(QLocale::English, QLocale::UnitedStates);
 
@@ -154,6 +160,12 @@ MainWindow::MainWindow(QWidget *parent) :
         int bg = settings->value("BackgroundType", 0).toInt();
         QString bgColor = settings->value("BackgroundColor", "#515151").toString();
         QString bgImg = settings->value("BackgroundImage", "").toString();
+        QString bgSlides = settings->value("BackgroundSlideshowDir", "").toString();
+        int slideTime = settings->value("BackgroundSlideshowInterval", 10).toInt();
+        int fadeTime = settings->value("BackgroundSlideshowFadeTime", 1000).toInt();
+        bgWidget->setSlideshowInterval(slideTime * 1000);
+        bgWidget->setSlideshowFadeTime(fadeTime);
+        bgWidget->setSlideshowDir(bgSlides);
         bgWidget->setBackgroundType((Background::BackgroundType)bg);
         bgWidget->setBackgroundColor(bgColor);
         bgWidget->setBackgroundImage(bgImg);
@@ -201,6 +213,13 @@ MainWindow::MainWindow(QWidget *parent) :
             player->setLockBass(true, lbNum);
         }
 
+        // Medley transition
+        player->setMedleyCrossfadeBars(settings->value("MedleyCrossfadeBars", 0).toInt());
+        player->setMedleyTempoRampBars(settings->value("MedleyTempoRampBars", 0).toInt());
+
+        // Internal synth event clock
+        player->setUseEventClock(settings->value("SynthEventClock", false).toBool());
+
         // Midi Channel Mapper
         QList<int> ports = settings->value("MidiChannelMapper").value<QList<int>>();
         if (ports.count() == 16) {
@@ -212,11 +231,11 @@ MainWindow::MainWindow(QWidget *parent) :
         connect(player, SIGNAL(finished()), this, SLOT(onPlayerThreadFinished()));
         connect(player, SIGNAL(bpmChanged(int)), ui->rhmWidget, SLOT(setBpm(int)));
 
-        connect(player, SIGNAL(nextMedleyStarted()), lyricsTimer, SLOT(stop()));
+        connect(player, SIGNAL(nextMedleyStarted()), lyricsClock, SLOT(stop()));
         connect(player, SIGNAL(nextMedleyStarted()), this, SLOT(onNextMedleyStarted()));
         connect(player, SIGNAL(nextMedleyStarted()), this, SLOT(switchMedleyLyrics()));
         connect(player, SIGNAL(nextMedleyStarted()), this, SLOT(switchMedleyLyrics2()));
-        connect(player, SIGNAL(nextMedleyAfterStarted()), lyricsTimer, SLOT(start()));
+        connect(player, SIGNAL(nextMedleyAfterStarted()), lyricsClock, SLOT(start()));
         connect(player, SIGNAL(nextMedleyAfterStarted()), this, SLOT(onNextMedleyAfterStarted()));
     }
 
@@ -271,6 +290,7 @@ MainWindow::MainWindow(QWidget *parent) :
         int     line1Y  = settings->value("LyricsLine1Y", 320).toInt();
         int     line2Y  = settings->value("LyricsLine2Y", 170).toInt();
         int     aTime   = settings->value("LyricsAnimationTime", 250).toInt();
+        bool  frameWipe = settings->value("LyricsFrameWipe", true).toBool();
         bool   autosize = settings->value("LyricsAutoFontSize", true).toBool();
 
         QFont f;
@@ -299,6 +319,7 @@ MainWindow::MainWindow(QWidget *parent) :
         lyrWidget->setLine1Y(line1Y);
         lyrWidget->setLine2Y(line2Y);
         lyrWidget->setAnimationTime(aTime);
+        lyrWidget->setFrameWipe(frameWipe);
         lyrWidget->setAutoFontSize(autosize);
     }
 
@@ -362,7 +383,7 @@ MainWindow::MainWindow(QWidget *parent) :
         connect(timer2, SIGNAL(timeout()), this, SLOT(hideUIFrame()));
 
         connect(positionTimer, SIGNAL(timeout()), this, SLOT(onPositiomTimerTimeOut()));
-        connect(lyricsTimer, SIGNAL(timeout()), this, SLOT(onLyricsTimerTimeOut()));
+        connect(lyricsClock, SIGNAL(frame()), this, SLOT(onLyricsFrame()));
 
         connect(detailTimer, SIGNAL(timeout()), this, SLOT(onDetailTimerTimeout()));
 
@@ -431,19 +452,22 @@ MainWindow::~MainWindow()
         settings->setValue("WindowHeight", this->height());
     }
 
-    foreach (Song *s, playlist) {
-        delete s;
-    }
-
     if (medleyLoader != nullptr) {
         medleyLoader->wait();
     }
 
+    if (renderer != nullptr) {
+        renderer->clearJobs();
+        renderer->waitForJobs();
+    }
+
+    delete songCache;
+
     delete player;
 
     delete detailTimer;
 
-    delete lyricsTimer;
+    delete lyricsClock;
     delete positionTimer;
     delete timer2;
     delete timer1;
@@ -466,6 +490,9 @@ MainWindow::~MainWindow()
 
 void MainWindow::play(int index, int position)
 {
+    if (renderer != nullptr && renderer->isRunning())
+        return;
+
     if (player->isUseMedley() && player->isPlayerPlaying()) {
         loadNextMedley(playlist[index]);
         connect(medleyLoader, &MedleyLoader::finished, [this, index](){
@@ -504,25 +531,37 @@ void MainWindow::play(int index, int position)
 
         player->play();
         positionTimer->start();
-        lyricsTimer->start();
+        lyricsClock->start();
         return;
     }
 
-    Song *s = playlist[index];
-    playingSong = *s;
+    playingSong = playlist[index];
     playingIndex = index;
 
     if (remove_playlist) {
-        delete s; // delete playlist in "index"
         playlist.removeAt(index);
         ui->playlistWidget->removeRow(index);
         playingIndex = -1;
     }
 
 
-    // NCN File
-    if (playingSong.songType() == "NCN")
+    CachedSong cached;
+    bool isCached = songCache->find(playingSong, &cached);
+
+    if (isCached)
+    {
+        // read ahead by the song cache
+        if (!player->load(cached.midi)) {
+            QMessageBox::warning(this, tr("ไม่สามารถเล่นเพลงได้"),
+                                 tr("ไฟล์อาจเสียหายไม่สามารถอ่านได้"), QMessageBox::Ok);
+            return;
+        }
+
+        lyrWidget->setLyrics(cached.lyrics, cached.cursor);
+    }
+    else if (playingSong.songType() == "NCN")
     {
+        // NCN File
         QString p = db->ncnPath() + playingSong.path();
         if (!player->load(p, true)) {
             QMessageBox::warning(this, tr("ไม่สามารถเล่นเพลงได้"),
@@ -561,25 +600,16 @@ void MainWindow::play(int index, int position)
             return;
         }
 
-        QFile mid(TEMP_MIDI_DIR_PATH);
-        if (mid.exists())
-            mid.remove();
-
-        mid.open(QFile::ReadWrite);
-        mid.write(HNKFile::midData(p));
-        mid.close();
-
-        if (!player->load(TEMP_MIDI_DIR_PATH, true)) {
+        // decoded in memory, no temp file
+        HNKSong hnk;
+        if (!Utils::readHNK(p, &hnk) || !player->load(hnk.midData, true)) {
             QMessageBox::warning(this, tr("ไม่สามารถเล่นเพลงได้"),
                                  tr("ไฟล์อาจเสียหายไม่สามารถอ่านได้"), QMessageBox::Ok);
-            mid.remove();
             return;
         }
 
-        mid.remove();
-
-        lyrWidget->setLyrics(Utils::readLyrics(HNKFile::lyrData(p)),
-            Utils::readCurFile(HNKFile::curData(p), player->midiFile()->resorution()));
+        lyrWidget->setLyrics(Utils::readLyrics(hnk.lyrData),
+            Utils::readCurFile(hnk.curData, player->midiFile()->resorution()));
 
     }
     else if (playingSong.songType() == "KAR")
@@ -619,7 +649,8 @@ void MainWindow::play(int index, int position)
     #endif
 
     // RHM
-    ui->rhmWidget->setBeat(MidiHelper::calculateBeats(player->midiFile()), player->beatCount());
+    ui->rhmWidget->setBeat(isCached ? cached.beats : MidiHelper::calculateBeats(player->midiFile()),
+                           player->beatCount());
 
     ui->frameSearch->hide();
     ui->playlistWidget->hide();
@@ -652,17 +683,19 @@ void MainWindow::play(int index, int position)
         secondLyr->show();
 
     positionTimer->start();
-    lyricsTimer->start();
+    lyricsClock->start();
 
     if (player->isUseMedley() && (playlist.size() > (playingIndex + 1))) {
         loadNextMedley(playlist[playingIndex + 1]);
     }
+
+    preloadNext();
 }
 
 void MainWindow::pause()
 {
     positionTimer->stop();
-    lyricsTimer->stop();
+    lyricsClock->stop();
     lyrWidget->stopAnimation();
     if (secondLyr != nullptr)
         secondLyr->stopAnimation();
@@ -677,7 +710,7 @@ void MainWindow::resume()
 {
     player->play();
     positionTimer->start();
-    lyricsTimer->start();
+    lyricsClock->start();
 
     #ifdef _WIN32
     taskbarButton->progress()->resume();
@@ -687,7 +720,7 @@ void MainWindow::resume()
 void MainWindow::stop()
 {
     positionTimer->stop();
-    lyricsTimer->stop();
+    lyricsClock->stop();
     player->stop(true);
 
     ui->sliderPosition->setValue(0);
@@ -791,17 +824,18 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
         }
         case Qt::Key_Enter:
         case Qt::Key_Return: {
-            Song *s = playlist[ui->playlistWidget->currentRow()];
-            s->setCutStartBar(ui->songMedley->cutStartBar());
-            s->setCutEndBar(ui->songMedley->cutEndBar());
+            Song &s = playlist[ui->playlistWidget->currentRow()];
+            s.setCutStartBar(ui->songMedley->cutStartBar());
+            s.setCutEndBar(ui->songMedley->cutEndBar());
             this->setFocus();
             ui->songMedley->hide();
             timer2->start(playlist_timeout);
 
             if (ui->playlistWidget->currentRow() == playingIndex + 1) {
                 MidiSequencer *seq = player->midiSequencerTemp();
-                seq->setCutStartBar(s->cutStartBar());
-                seq->setCutEndBar(s->cutEndBar());
+                seq->setCutStartBar(s.cutStartBar());
+                seq->setCutEndBar(s.cutEndBar());
+                player->updateMedleyTransitions();
             }
             break;
         }
@@ -823,8 +857,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
                     int i = ui->playlistWidget->currentRow();
                     if (i < 0)
                         break;
-                    Song *s = playlist[i];
-                    s->setTranspose(s->transpose() + 1);
+                    Song &s = playlist[i];
+                    s.setTranspose(s.transpose() + 1);
                     ui->playlistWidget->updateDetail(i, s);
                     timer2->start(playlist_timeout);
                 }
@@ -843,8 +877,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
                     int i = ui->playlistWidget->currentRow();
                     if (i < 0)
                         break;
-                    Song *s = playlist[i];
-                    s->setTranspose(s->transpose() - 1);
+                    Song &s = playlist[i];
+                    s.setTranspose(s.transpose() - 1);
                     ui->playlistWidget->updateDetail(i, s);
                     timer2->start(playlist_timeout);
                 }
@@ -863,8 +897,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
                     int i = ui->playlistWidget->currentRow();
                     if (i < 0)
                         break;
-                    Song *s = playlist[i];
-                    s->setBpmSpeed(s->bpmSpeed() + 1);
+                    Song &s = playlist[i];
+                    s.setBpmSpeed(s.bpmSpeed() + 1);
                     ui->playlistWidget->updateDetail(i, s);
                     timer2->start(playlist_timeout);
                 }
@@ -879,8 +913,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
                     int i = ui->playlistWidget->currentRow();
                     if (i < 0)
                         break;
-                    Song *s = playlist[i];
-                    s->setBpmSpeed(s->bpmSpeed() - 1);
+                    Song &s = playlist[i];
+                    s.setBpmSpeed(s.bpmSpeed() - 1);
                     ui->playlistWidget->updateDetail(i, s);
                     timer2->start(playlist_timeout);
                 }
@@ -1088,8 +1122,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
             int i = ui->playlistWidget->currentRow();
             if (i < 0)
                 break;
-            Song *s = playlist[i];
-            s->setBpmSpeed(s->bpmSpeed() + 1);
+            Song &s = playlist[i];
+            s.setBpmSpeed(s.bpmSpeed() + 1);
             ui->playlistWidget->updateDetail(i, s);
             timer2->start(playlist_timeout);
         } else {
@@ -1103,8 +1137,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
             int i = ui->playlistWidget->currentRow();
             if (i < 0)
                 break;
-            Song *s = playlist[i];
-            s->setBpmSpeed(s->bpmSpeed() - 1);
+            Song &s = playlist[i];
+            s.setBpmSpeed(s.bpmSpeed() - 1);
             ui->playlistWidget->updateDetail(i, s);
             timer2->start(playlist_timeout);
         } else {
@@ -1222,7 +1256,7 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
     case Qt::Key_Return:
         if (ui->frameSearch->isVisible()) {
             Song *s = db->currentSong();
-            addToPlaylist(s);
+            addToPlaylist(*s);
 
             if (auto_playnext && playlist.count() == 1 && player->isPlayerStopped()) {
                 play(0);
@@ -1238,8 +1272,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
     case Qt::Key_Space:
         if (player->isUseMedley() && ui->playlistWidget->isVisible()) {
             timer2->stop();
-            Song *s = playlist[ui->playlistWidget->currentRow()];
-            ui->songMedley->setup(s->cutStartBar(), s->cutEndBar());
+            const Song &s = playlist[ui->playlistWidget->currentRow()];
+            ui->songMedley->setup(s.cutStartBar(), s.cutEndBar());
             ui->songMedley->show();
             break;
         }
@@ -1300,12 +1334,12 @@ void MainWindow::keyReleaseEvent(QKeyEvent *event)
     }
 }
 
-void MainWindow::loadNextMedley(Song *song)
+void MainWindow::loadNextMedley(const Song &song)
 {
     if ((medleyLoader != nullptr) && medleyLoader->isRunning())
         medleyLoader->wait();
 
-    medleyLoader = new MedleyLoader(this, song, db, player, lyrWidget, secondLyr);
+    medleyLoader = new MedleyLoader(this, song, db, player, lyrWidget, secondLyr, songCache);
     connect(medleyLoader, &MedleyLoader::finished, [this](){
         medleyLoader->deleteLater();
         medleyLoader = nullptr;
@@ -1313,14 +1347,13 @@ void MainWindow::loadNextMedley(Song *song)
     medleyLoader->start();
 }
 
-void MainWindow::addToPlaylist(Song *song)
+void MainWindow::addToPlaylist(const Song &song)
 {
-    Song *songToAdd = new Song();
-    *songToAdd = *song;
+    Song songToAdd = song;
 
     if (player->isUseMedley()) {
-        int medleySpeed = player->medleyBPM() - songToAdd->tempo();
-        songToAdd->setBpmSpeed(songToAdd->bpmSpeed() + medleySpeed);
+        int medleySpeed = player->medleyBPM() - songToAdd.tempo();
+        songToAdd.setBpmSpeed(songToAdd.bpmSpeed() + medleySpeed);
     }
 
     playlist.append(songToAdd);
@@ -1329,11 +1362,13 @@ void MainWindow::addToPlaylist(Song *song)
     if (player->isUseMedley() && !player->isPlayerStopped() && ((playlist.size() - 1 - playingIndex) == 1)) {
         loadNextMedley(songToAdd);
     }
+
+    preloadNext();
 }
 
 void MainWindow::removeFromPlaylist(int index)
 {
-    delete playlist.takeAt(index);
+    playlist.removeAt(index);
     ui->playlistWidget->removeRow(index);
 
     if (playlist.size() == 0)
@@ -1341,6 +1376,8 @@ void MainWindow::removeFromPlaylist(int index)
 
     if (player->isUseMedley() && (index == playingIndex + 1) && (playlist.size() > playingIndex + 1))
         loadNextMedley(playlist[playingIndex + 1]);
+
+    preloadNext();
 }
 
 void MainWindow::swapInPlaylist(int index, int toIndex)
@@ -1354,6 +1391,13 @@ void MainWindow::swapInPlaylist(int index, int toIndex)
     if (player->isUseMedley() && isNextSong && (playlist.size() > playingIndex + 1)) {
         loadNextMedley(playlist[playingIndex + 1]);
     }
+
+    preloadNext();
+}
+
+void MainWindow::preloadNext()
+{
+    songCache->preload(playlist.mid(playingIndex + 1, songCache->aheadCount()));
 }
 
 void MainWindow::updateShutdownRequest()
@@ -1521,6 +1565,10 @@ void MainWindow::showContextMenu(const QPoint &pos)
         act = m->addAction(tr("แยกอุปกรณ์เสียง/ลำโพง..."));
         connect(act, SIGNAL(triggered()), this, SLOT(showSpeakerDialog()));
 
+        act = m->addAction(tr("บันทึกเป็นไฟล์ WAV..."));
+        act->setEnabled(renderer == nullptr || !renderer->isRunning());
+        connect(act, SIGNAL(triggered()), this, SLOT(renderToWav()));
+
         #ifndef __linux__
         act = m->addAction(tr("จัดการ VST && VSTi..."));
         connect(act, SIGNAL(triggered()), this, SLOT(showVSTDirDialog()));
@@ -1563,6 +1611,61 @@ void MainWindow::showContextMenu(const QPoint &pos)
     menu.exec(mapToGlobal(pos));
 }
 
+void MainWindow::renderToWav()
+{
+    QStringList files = QFileDialog::getOpenFileNames(this, tr("เลือกไฟล์ MIDI"),
+                                                      Utils::LAST_OPEN_DIR,
+                                                      "MIDI (*.mid *.MID *.kar *.KAR *.hnk *.HNK)");
+    if (files.isEmpty())
+        return;
+
+    Utils::LAST_OPEN_DIR = QFileInfo(files.first()).dir().absolutePath();
+
+    QString dir = QFileDialog::getExistingDirectory(this, tr("เลือกที่เก็บไฟล์ WAV"), Utils::LAST_OPEN_DIR,
+                                                    QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
+    if (dir == "")
+        return;
+
+    // the synthesizer renders offline, it can't play at the same time
+    if (!player->isPlayerStopped())
+        stop();
+
+    if (renderer == nullptr) {
+        renderer = new MidiRenderer(player, this);
+        connect(renderer, SIGNAL(finished()), this, SLOT(onRendererFinished()));
+    }
+
+    renderer->clearJobs();
+    renderer->resetStats();
+    renderer->setTranspose(player->transpose());
+    for (const QString &f : files) {
+        QString wav = dir + "/" + QFileInfo(f).completeBaseName() + ".wav";
+        if (QFileInfo(f).suffix().toLower() == "hnk") {
+            // decoded in memory, an unreadable file fails in the renderer
+            HNKSong hnk;
+            Utils::readHNK(f, &hnk, HNKMidi);
+            renderer->addJob(hnk.midData, wav);
+        } else {
+            renderer->addJob(f, wav);
+        }
+    }
+
+    if (!renderer->startJobs()) {
+        QMessageBox::critical(this, tr("บันทึกเป็นไฟล์ WAV"),
+                              tr("ไม่สามารถบันทึกได้ขณะกำลังเล่นเพลง"));
+    }
+}
+
+void MainWindow::onRendererFinished()
+{
+    RenderStats st = renderer->stats();
+
+    QMessageBox::information(this, tr("บันทึกเป็นไฟล์ WAV"),
+                             tr("สำเร็จ %1 เพลง  ไม่สำเร็จ %2 เพลง\nเร็วกว่าเวลาจริง %3 เท่า")
+                             .arg(st.songs).arg(st.failed)
+                             .arg(renderer->realtimeFactor(), 0, 'f', 1));
+}
+
 void MainWindow::showSettingsDialog()
 {
     SettingsDialog d(this, this);
@@ -1676,6 +1779,9 @@ void MainWindow::showSecondMonitor()
         bg->setBackgroundType(bgWidget->backgroundType());
         bg->setBackgroundColor(bgWidget->backgroundColor());
         bg->setBackgroundImage(bgWidget->backgroundImage());
+        bg->setSlideshowInterval(bgWidget->slideshowInterval());
+        bg->setSlideshowFadeTime(bgWidget->slideshowFadeTime());
+        bg->setSlideshowDir(bgWidget->slideshowDir());
 
         secondLyr = secondMonitor->lyrWidget();
         secondMonitor->show();
@@ -1760,11 +1866,13 @@ void MainWindow::onPositiomTimerTimeOut()
     ui->rhmWidget->setCurrentBeat( player->currentBeat() );
 }
 
-void MainWindow::onLyricsTimerTimeOut()
+void MainWindow::onLyricsFrame()
 {
-    lyrWidget->setPositionCursor(player->positionTick() + 25);
+    // one position for both monitors, so they wipe the same frame
+    int tick = player->positionTick() + 25;
+    lyrWidget->setPositionCursor(tick);
     if (secondLyr != nullptr)
-        secondLyr->setPositionCursor(player->positionTick() + 25);
+        secondLyr->setPositionCursor(tick);
 }
 
 void MainWindow::onPlayerDurationMSChanged(qint64 d)
@@ -1871,10 +1979,10 @@ void MainWindow::onNextMedleyStarted()
 {
     int index = playingIndex + 1;
 
-    playingSong = *playlist[index];
+    playingSong = playlist[index];
 
     if (remove_playlist && playlist.size() > 0) {
-        delete playlist.takeAt(index);
+        playlist.removeAt(index);
         ui->playlistWidget->removeRow(index);
         playingIndex = -1;
     }
@@ -1911,6 +2019,8 @@ void MainWindow::onNextMedleyAfterStarted()
 {
     if (playlist.size() > 0)
         loadNextMedley(playlist[playingIndex + 1]);
+
+    preloadNext();
 }
 
 void MainWindow::onPlayerThreadFinished()
@@ -2079,12 +2189,9 @@ void MainWindow::loadPlaylist()
 
     Utils::LAST_OPEN_DIR = QFileInfo(fileName).dir().absolutePath();
 
-    QList<Song*> songs;
+    QList<Song> songs;
     if (Utils::loadPlaylist(fileName, songs))
     {
-        for (Song *s : playlist)
-            delete s;
-        playlist.clear();
         playlist = songs;
         ui->playlistWidget->setPlaylist(playlist);
         playingIndex = -1;
@@ -20,6 +20,7 @@
 #include <ChannelMixer.h>
 
 #include "SongDatabase.h"
+#include "FrameClock.h"
 
 #include "Midi/MidiPlayer.h"
 
@@ -28,6 +29,8 @@
 
 
 class MedleyLoader;
+class SongCache;
+class MidiRenderer;
 
 
 namespace Ui {
@@ -81,10 +84,11 @@ protected:
     void keyReleaseEvent(QKeyEvent *event);
 
 private:
-    void loadNextMedley(Song *song);
-    void addToPlaylist(Song *song);
+    void loadNextMedley(const Song &song);
+    void addToPlaylist(const Song &song);
     void removeFromPlaylist(int index);
     void swapInPlaylist(int index, int toIndex);
+    void preloadNext();
     static void updateShutdownRequest();
 
 private slots:
@@ -118,9 +122,11 @@ private slots:
     void showBusGroupDialog();
     void showSpeakerDialog();
     void showVSTDirDialog();
+    void renderToWav();
+    void onRendererFinished();
 
     void onPositiomTimerTimeOut();
-    void onLyricsTimerTimeOut();
+    void onLyricsFrame();
     void onPlayerDurationMSChanged(qint64 d);
     void onPlayerPositionMSChanged(qint64 p);
     void onPlayerDurationTickChanged(int d);
@@ -154,10 +160,11 @@ private:
     Ui::MainWindow *ui;
     QSettings *settings;
     SongDatabase *db;
-    QTimer *timer1, *timer2, *positionTimer, *lyricsTimer;
+    QTimer *timer1, *timer2, *positionTimer;
+    FrameClock *lyricsClock;
     QTimer *detailTimer;
 
-    QList<Song*> playlist;
+    QList<Song> playlist;
     MidiPlayer *player;
     Song playingSong;
     int playingIndex = -1;
@@ -167,6 +174,8 @@ private:
     bool nextMedleyRequested = false;
 
     MedleyLoader *medleyLoader = nullptr;
+    MidiRenderer *renderer = nullptr;
+    SongCache *songCache;
 
     Background *bgWidget = nullptr;
     LyricsWidget *lyrWidget, *secondLyr = nullptr;
@@ -1,21 +1,20 @@
 #include "MedleyLoader.h"
 
-#include "Config.h"
-
 #include "Utils.h"
 #include "Song.h"
 #include "SongDatabase.h"
+#include "SongCache.h"
 #include "Midi/MidiPlayer.h"
-#include "Midi/HNKFile.h"
 #include "Widgets/LyricsWidget.h"
 
 
 MedleyLoader::MedleyLoader(QObject *parent,
-                           Song *song,
+                           const Song &song,
                            SongDatabase *songDB,
                            MidiPlayer *player,
                            LyricsWidget *lyrWidget,
-                           LyricsWidget *lyrWidget2)
+                           LyricsWidget *lyrWidget2,
+                           SongCache *cache)
     : QThread(parent)
 {
     _song = song;
@@ -23,14 +22,22 @@ MedleyLoader::MedleyLoader(QObject *parent,
     _player = player;
     _lyrWidget = lyrWidget;
     _lyrWidget2 = lyrWidget2;
+    _cache = cache;
 }
 
 void MedleyLoader::run()
 {
-    if (_song->songType() == "NCN")
+    CachedSong cached;
+    if (_cache != nullptr && _cache->find(_song, &cached))
+    {
+        _player->loadNextMedley(cached.midi, _song.cutStartBar(), _song.cutEndBar(), _song.bpmSpeed(), _song.transpose());
+
+        _lyrWidget->setLyricsTemp(cached.lyrics, cached.cursor);
+    }
+    else if (_song.songType() == "NCN")
     {
-        QString midPath = _songDb->ncnPath() + _song->path();
-        _player->loadNextMedley(midPath, _song->cutStartBar(), _song->cutEndBar(), _song->bpmSpeed(), _song->transpose());
+        QString midPath = _songDb->ncnPath() + _song.path();
+        _player->loadNextMedley(midPath, _song.cutStartBar(), _song.cutEndBar(), _song.bpmSpeed(), _song.transpose());
 
         QString curPath = _songDb->getCurFilePath(midPath);
         if (curPath == "" || !QFile::exists(curPath)) {
@@ -45,30 +52,24 @@ void MedleyLoader::run()
         _lyrWidget->setLyricsTemp(Utils::readLyrics(lyrPath),
             Utils::readCurFile(curPath, _player->midiFileTemp()->resorution()));
     }
-    else if (_song->songType() == "HNK")
+    else if (_song.songType() == "HNK")
     {
-        QString hnkPath = _songDb->hnkPath() + _song->path();
+        QString hnkPath = _songDb->hnkPath() + _song.path();
 
-        QFile mid(TEMP_MIDI_DIR_PATH);
-        if (mid.exists())
-            mid.remove();
-
-        mid.open(QFile::ReadWrite);
-        mid.write(HNKFile::midData(hnkPath));
-        mid.close();
-
-        _player->loadNextMedley(TEMP_MIDI_DIR_PATH, _song->cutStartBar(), _song->cutEndBar(), _song->bpmSpeed(), _song->transpose());
+        HNKSong hnk;
+        if (!Utils::readHNK(hnkPath, &hnk))
+            return;
 
-        mid.remove();
+        _player->loadNextMedley(hnk.midData, _song.cutStartBar(), _song.cutEndBar(), _song.bpmSpeed(), _song.transpose());
 
-        _lyrWidget->setLyricsTemp(Utils::readLyrics(HNKFile::lyrData(hnkPath)),
-            Utils::readCurFile(HNKFile::curData(hnkPath), _player->midiFileTemp()->resorution()));
+        _lyrWidget->setLyricsTemp(Utils::readLyrics(hnk.lyrData),
+            Utils::readCurFile(hnk.curData, _player->midiFileTemp()->resorution()));
     }
-    else if (_song->songType() == "KAR")
+    else if (_song.songType() == "KAR")
     {
-        QString karPath = _songDb->karPath() + _song->path();
+        QString karPath = _songDb->karPath() + _song.path();
 
-        _player->loadNextMedley(karPath, _song->cutStartBar(), _song->cutEndBar(), _song->bpmSpeed(), _song->transpose());
+        _player->loadNextMedley(karPath, _song.cutStartBar(), _song.cutEndBar(), _song.bpmSpeed(), _song.transpose());
 
         _lyrWidget->setLyricsTemp(_player->midiFileTemp()->lyrics(), _player->midiFileTemp()->lyricsCursor());
     }  else {
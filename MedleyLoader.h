@@ -3,8 +3,10 @@
 
 #include <QThread>
 
-class Song;
+#include "Song.h"
+
 class SongDatabase;
+class SongCache;
 class MidiPlayer;
 class LyricsWidget;
 
@@ -13,20 +15,22 @@ class MedleyLoader : public QThread
     Q_OBJECT
 public:
     explicit MedleyLoader(QObject *parent = nullptr,
-                          Song *song = nullptr,
+                          const Song &song = Song(),
                           SongDatabase *songDB = nullptr,
                           MidiPlayer *player = nullptr,
                           LyricsWidget *lyrWidget = nullptr,
-                          LyricsWidget *lyrWidget2 = nullptr);
+                          LyricsWidget *lyrWidget2 = nullptr,
+                          SongCache *cache = nullptr);
 
 protected:
     void run();
 
 private:
-    Song *_song;
+    Song _song;
     SongDatabase *_songDb;
     MidiPlayer *_player;
     LyricsWidget *_lyrWidget, *_lyrWidget2;
+    SongCache *_cache;
 };
 
 #endif // MEDLEYLOADER_H
@@ -0,0 +1,55 @@
+#ifndef EVENTRING_H
+#define EVENTRING_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+
+// Fixed size ring for one producer thread and one consumer thread,
+// no lock and no allocation. T is copied in and out, keep it small
+// and without pointers to shared data. N must be a power of two.
+template <typename T, int N>
+class EventRing
+{
+    static_assert(N > 1 && (N & (N - 1)) == 0, "N must be a power of two");
+
+public:
+    // producer, false when full
+    bool push(const T &value)
+    {
+        uint head = _head.load();
+        if (head - _tail.loadAcquire() == (uint)N)
+            return false;
+        _values[head & (N - 1)] = value;
+        _head.storeRelease(head + 1);
+        return true;
+    }
+
+    // consumer, false when empty
+    bool pop(T *value)
+    {
+        uint tail = _tail.load();
+        if (tail == _head.loadAcquire())
+            return false;
+        *value = _values[tail & (N - 1)];
+        _tail.storeRelease(tail + 1);
+        return true;
+    }
+
+    // consumer, drop everything pushed so far
+    void clear()
+    {
+        _tail.storeRelease(_head.loadAcquire());
+    }
+
+    bool isEmpty() { return _tail.loadAcquire() == _head.loadAcquire(); }
+    int count() { return (int)(_head.loadAcquire() - _tail.loadAcquire()); }
+    int capacity() { return N; }
+
+private:
+    T _values[N];
+    QAtomicInteger<uint> _head;    // written by the producer, wraps around
+    QAtomicInteger<uint> _tail;    // written by the consumer
+};
+
+#endif // EVENTRING_H
@@ -0,0 +1,173 @@
+#include "MidiDispatcher.h"
+#include "MidiPlayer.h"
+
+
+MidiDispatcher::MidiDispatcher(MidiPlayer *player, QObject *parent) : QThread(parent)
+{
+    _player = player;
+}
+
+MidiDispatcher::~MidiDispatcher()
+{
+    stop();
+}
+
+void MidiDispatcher::push(int ring, const QueuedEvent &e)
+{
+    _pending.ref();
+
+    // full only when the output is stalled, nothing in the GUI can do that
+    while (!_rings[ring].push(e))
+        QThread::yieldCurrentThread();
+
+    wake();
+}
+
+void MidiDispatcher::push(int ring, const QueuedEvent *events, int count)
+{
+    _pending.fetchAndAddOrdered(count);
+
+    for (int i = 0; i < count; i++) {
+        // the batch may not fit, run() must be awake to make room
+        while (!_rings[ring].push(events[i])) {
+            wake();
+            QThread::yieldCurrentThread();
+        }
+    }
+
+    wake();
+}
+
+void MidiDispatcher::send(const QueuedEvent &e)
+{
+    _pending.ref();
+
+    _sendMutex.lock();
+    while (!_sendRing.push(e))
+        QThread::yieldCurrentThread();
+    _sendMutex.unlock();
+
+    wake();
+}
+
+void MidiDispatcher::wake()
+{
+    // only the producer that takes the flag releases, run() sleeps on
+    // one release per sleep
+    if (_sleeping.fetchAndStoreOrdered(0) == 1)
+        _wakeSem.release();
+}
+
+bool MidiDispatcher::isEmpty()
+{
+    for (auto &ring : _rings) {
+        if (!ring.isEmpty())
+            return false;
+    }
+
+    return _sendRing.isEmpty();
+}
+
+void MidiDispatcher::waitForEmpty()
+{
+    while (_pending.loadAcquire() > 0 && isRunning())
+        QThread::usleep(100);
+}
+
+void MidiDispatcher::stop()
+{
+    _quit.storeRelease(1);
+    wake();
+
+    wait();
+}
+
+QueuedEvent MidiDispatcher::pack(const MidiEvent &e, qint64 timeUs, float gain)
+{
+    QueuedEvent q;
+    q.timeUs = timeUs;
+    q.gain = gain;
+    q.data1 = e.data1();
+    q.data2 = e.data2();
+    q.type = static_cast<quint8>(e.eventType());
+    q.channel = e.channel();
+    q.command = DispatchCommand::Event;
+
+    return q;
+}
+
+QueuedEvent MidiDispatcher::pack(const MidiEventRecord &r, qint64 timeUs, float gain)
+{
+    QueuedEvent q;
+    q.timeUs = timeUs;
+    q.gain = gain;
+    q.type = r.status & 0xF0;
+    q.channel = r.status & 0x0F;
+    if (q.type == static_cast<quint8>(MidiEventType::PitchBend)) {
+        q.data1 = (r.data2 << 7) | r.data1;
+        q.data2 = 0;
+    } else {
+        q.data1 = r.data1;
+        q.data2 = r.data2;
+    }
+    q.command = DispatchCommand::Event;
+
+    return q;
+}
+
+QueuedEvent MidiDispatcher::command(DispatchCommand c, int ch, int data1)
+{
+    QueuedEvent q;
+    q.timeUs = -1;
+    q.gain = 1.0f;
+    q.data1 = data1;
+    q.data2 = 0;
+    q.type = 0;
+    q.channel = ch;
+    q.command = c;
+
+    return q;
+}
+
+MidiEvent MidiDispatcher::unpack(const QueuedEvent &e)
+{
+    MidiEvent ev;
+    ev.setEventType(static_cast<MidiEventType>(e.type));
+    ev.setChannel(e.channel);
+    ev.setData1(e.data1);
+    ev.setData2(e.data2);
+
+    return ev;
+}
+
+void MidiDispatcher::run()
+{
+    QueuedEvent e;
+
+    for (;;) {
+        // sent from the GUI before the sequencer events queued after it
+        while (_sendRing.pop(&e)) {
+            _player->dispatchSent(e);
+            _pending.deref();
+        }
+
+        for (int r = 0; r < DISPATCH_RINGS; r++) {
+            while (_rings[r].pop(&e)) {
+                _player->dispatchQueued(e, r);
+                _pending.deref();
+            }
+        }
+
+        if (_quit.loadAcquire())
+            break;
+
+        // The flag goes up before the rings are checked and a producer
+        // takes it down after its push, both with a full barrier. Either
+        // the push is seen here or the producer sees the flag and wakes.
+        _sleeping.fetchAndStoreOrdered(1);
+        if (isEmpty() && !_quit.loadAcquire())
+            _wakeSem.acquire();
+        else if (_sleeping.fetchAndStoreOrdered(0) == 0)
+            _wakeSem.acquire();     // a producer took the flag, take its release too
+    }
+}
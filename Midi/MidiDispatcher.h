@@ -0,0 +1,90 @@
+#ifndef MIDIDISPATCHER_H
+#define MIDIDISPATCHER_H
+
+#include "MidiEvent.h"
+#include "MidiEventStore.h"
+#include "EventRing.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QSemaphore>
+
+// What a QueuedEvent sent from the GUI does on the dispatcher thread
+enum class DispatchCommand : quint8
+{
+    Event,                  // the MIDI event, through mute, solo and the locks
+    AllNotesOff,            // on the output of channel
+    ResetAllControllers,    // on the output of channel
+    Instrument,             // program change data1 on the synth and every MIDI out
+    ChannelOutput,          // move channel to port data1 - 1, 0 is the synth
+    OutputVolume,           // volume of the MIDI outs, data1 in percent
+    ResetGain               // new song, the channel volumes have no medley gain
+};
+
+// A channel event on its way to the output, copied by value through
+// the rings
+typedef struct
+{
+    qint64  timeUs;     // event clock time, -1 send now
+    float   gain;       // medley fade
+    quint16 data1;      // PitchBend : 14 bit value
+    quint8  data2;
+    quint8  type;       // MidiEventType
+    quint8  channel;
+    DispatchCommand command;
+} QueuedEvent;
+
+#define DISPATCH_RINGS  2
+
+class MidiPlayer;
+
+// Sends the events of the sequencer thread to the synthesizer and the
+// MIDI outs. The sequencer only pushes into a lock free ring, routing,
+// the devices and the observers of what was sent run on this thread.
+// There is a ring per sequencer, two songs of a medley play together
+// during a crossfade.
+class MidiDispatcher : public QThread
+{
+    Q_OBJECT
+public:
+    explicit MidiDispatcher(MidiPlayer *player, QObject *parent = nullptr);
+    ~MidiDispatcher();
+
+    // producer thread of ring, waits only when the ring is full
+    void push(int ring, const QueuedEvent &e);
+    // a window of events, one wake up for all of them
+    void push(int ring, const QueuedEvent *events, int count);
+
+    // GUI and MIDI in threads, an event or a command to run now. While
+    // the dispatcher runs, the devices, the MIDI out map and the channel
+    // state are only changed on its thread.
+    void send(const QueuedEvent &e);
+
+    // returns when every pushed event is sent
+    void waitForEmpty();
+    void stop();
+
+    static QueuedEvent pack(const MidiEvent &e, qint64 timeUs = -1, float gain = 1.0f);
+    // channel events only
+    static QueuedEvent pack(const MidiEventRecord &r, qint64 timeUs = -1, float gain = 1.0f);
+    static QueuedEvent command(DispatchCommand c, int ch = 0, int data1 = 0);
+    static MidiEvent unpack(const QueuedEvent &e);
+
+protected:
+    void run();
+
+private:
+    void wake();
+    bool isEmpty();
+
+    MidiPlayer *_player;
+    EventRing<QueuedEvent, 4096> _rings[DISPATCH_RINGS];
+    EventRing<QueuedEvent, 256> _sendRing;
+    QMutex _sendMutex;      // send() has more than one producer thread
+    QAtomicInt _pending;    // pushed and not sent yet
+    QAtomicInt _sleeping;   // 1 while run() may wait on _wakeSem
+    QAtomicInt _quit;
+    QSemaphore _wakeSem;
+};
+
+#endif // MIDIDISPATCHER_H
@@ -0,0 +1,179 @@
+#include "MidiEventStore.h"
+
+#include <algorithm>
+
+MidiEventStore::MidiEventStore()
+{
+}
+
+void MidiEventStore::clear()
+{
+    fRecords.clear();
+    fPayloads.clear();
+}
+
+void MidiEventStore::reserve(int count)
+{
+    fRecords.reserve(count);
+}
+
+MidiMetaType MidiEventStore::metaType(int index) const
+{
+    const MidiEventRecord &r = fRecords.at(index);
+    if (r.status != 0xFF)
+        return MidiMetaType::Invalid;
+
+    MidiEvent e;
+    e.setMetaType(r.data1);
+    return e.metaEventType();
+}
+
+QByteArray MidiEventStore::payload(int index) const
+{
+    const MidiEventRecord &r = fRecords.at(index);
+    if (r.status != 0xFF && r.status != 0xF7)
+        return QByteArray();
+
+    return fPayloads.mid(r.payload, r.length);
+}
+
+float MidiEventStore::bpm(int index) const
+{
+    int midi_tempo = usPerQuarter(index);
+    if (midi_tempo == 0)
+        return 0;
+
+    return (float)(60000000.0 / midi_tempo);
+}
+
+int MidiEventStore::usPerQuarter(int index) const
+{
+    const MidiEventRecord &r = fRecords.at(index);
+    if (r.status != 0xFF || r.data1 != 0x51)
+        return 0;
+
+    if (r.length < 3)
+        return 0;
+
+    const unsigned char *buffer = (const unsigned char*)fPayloads.constData() + r.payload;
+    return (buffer[0] << 16) | (buffer[1] << 8) | buffer[2];
+}
+
+MidiEvent MidiEventStore::event(int index) const
+{
+    const MidiEventRecord &r = fRecords.at(index);
+
+    MidiEvent e;
+    e.setTick(r.tick);
+    e.setTrack(r.track);
+
+    switch (r.status) {
+    case 0:
+        break;
+    case 0xFF:
+        e.setEventType(MidiEventType::Meta);
+        e.setMetaType(r.data1);
+        e.setData(fPayloads.mid(r.payload, r.length));
+        break;
+    case 0xF7:
+        e.setEventType(MidiEventType::SysEx);
+        e.setData(fPayloads.mid(r.payload, r.length));
+        break;
+    default: {
+        MidiEventType evType = static_cast<MidiEventType>(r.status & 0xF0);
+        e.setEventType(evType);
+        e.setChannel(r.status & 0x0F);
+        if (evType == MidiEventType::PitchBend) {
+            e.setData1((r.data2 << 7) | r.data1);
+        } else {
+            e.setData1(r.data1);
+            e.setData2(r.data2);
+        }
+        break;
+    }
+    }
+
+    return e;
+}
+
+int MidiEventStore::lowerBound(uint32_t tick) const
+{
+    auto it = std::lower_bound(fRecords.constBegin(), fRecords.constEnd(), tick,
+                               [](const MidiEventRecord &r, uint32_t t) { return r.tick < t; });
+
+    return it - fRecords.constBegin();
+}
+
+int MidiEventStore::appendChannelEvent(int track, uint32_t tick, MidiEventType evType, int ch, int data1, int data2)
+{
+    int status = static_cast<int>(evType) | (ch & 0x0F);
+
+    if (evType == MidiEventType::PitchBend) {
+        data2 = (data1 >> 7) & 0x7F;
+        data1 = data1 & 0x7F;
+    }
+
+    fRecords.append(makeRecord(track, tick, status, data1, data2));
+
+    return fRecords.count() - 1;
+}
+
+int MidiEventStore::appendMetaEvent(int track, uint32_t tick, int number, const QByteArray &data)
+{
+    MidiEventRecord r = makeRecord(track, tick, 0xFF, number, 0);
+    r.payload = fPayloads.size();
+    r.length = data.size();
+
+    fPayloads.append(data);
+    fRecords.append(r);
+
+    return fRecords.count() - 1;
+}
+
+int MidiEventStore::appendSysExEvent(int track, uint32_t tick, const QByteArray &data)
+{
+    MidiEventRecord r = makeRecord(track, tick, 0xF7, 0, 0);
+    r.payload = fPayloads.size();
+    r.length = data.size();
+
+    fPayloads.append(data);
+    fRecords.append(r);
+
+    return fRecords.count() - 1;
+}
+
+MidiEventRecord MidiEventStore::makeRecord(int track, uint32_t tick, int status, int data1, int data2)
+{
+    MidiEventRecord r;
+    r.tick = tick;
+    r.payload = 0;
+    r.length = 0;
+    r.status = status;
+    r.data1 = data1;
+    r.data2 = data2;
+    r.track = track;
+    return r;
+}
+
+// ========================================================
+
+MidiEventList::MidiEventList(const MidiEventStore *store)
+{
+    fStore = store;
+    fAll = true;
+}
+
+MidiEventList::MidiEventList(const MidiEventStore *store, const QVector<int> &indexes)
+{
+    fStore = store;
+    fIndexes = indexes;
+    fAll = false;
+}
+
+int MidiEventList::count() const
+{
+    if (fStore == nullptr)
+        return 0;
+
+    return fAll ? fStore->count() : fIndexes.count();
+}
@@ -0,0 +1,108 @@
+#ifndef MIDIEVENTSTORE_H
+#define MIDIEVENTSTORE_H
+
+#include "MidiEvent.h"
+
+#include <QVector>
+
+// 16 bytes per event
+typedef struct
+{
+    uint32_t tick;
+    uint32_t payload;   // Meta, SysEx : offset in payload arena
+    uint32_t length;    // Meta, SysEx : bytes in payload arena
+    uint8_t  status;    // MidiEventType | channel, Meta = 0xFF, SysEx = 0xF7, Invalid = 0
+    uint8_t  data1;     // Meta : meta number, PitchBend : LSB
+    uint8_t  data2;     // PitchBend : MSB
+    uint8_t  track;     // MidiFile::read rejects more than MIDI_MAX_TRACKS
+} MidiEventRecord;
+
+#define MIDI_MAX_TRACKS 256
+
+class MidiEventStore
+{
+public:
+    MidiEventStore();
+
+    void clear();
+    void reserve(int count);
+
+    int count() const { return fRecords.count(); }
+    bool isEmpty() const { return fRecords.isEmpty(); }
+
+    const MidiEventRecord &record(int index) const { return fRecords.at(index); }
+    const MidiEventRecord *records() const { return fRecords.constData(); }
+    QVector<MidiEventRecord> &recordVector() { return fRecords; }
+
+    uint32_t tick(int index) const { return fRecords.at(index).tick; }
+    bool isMeta(int index) const { return fRecords.at(index).status == 0xFF; }
+    bool isTempo(int index) const { return isMeta(index) && fRecords.at(index).data1 == 0x51; }
+    MidiMetaType metaType(int index) const;
+    QByteArray payload(int index) const;
+    int payloadBytes() const { return fPayloads.size(); }
+    float bpm(int index) const;
+    int usPerQuarter(int index) const;  // the 24 bit value of a tempo event, 0 if none
+
+    MidiEvent event(int index) const;
+
+    // index of the first event at or after tick, count() if none
+    int lowerBound(uint32_t tick) const;
+
+    int appendChannelEvent(int track, uint32_t tick, MidiEventType evType, int ch, int data1, int data2);
+    int appendMetaEvent(int track, uint32_t tick, int number, const QByteArray &data);
+    int appendSysExEvent(int track, uint32_t tick, const QByteArray &data);
+
+    static MidiEventRecord makeRecord(int track, uint32_t tick, int status, int data1, int data2);
+
+private:
+    QVector<MidiEventRecord> fRecords;
+    QByteArray fPayloads; // Meta, SysEx data of all events back to back
+};
+
+
+// Lightweight view over all events or an index list of a MidiEventStore.
+// Valid until the owning MidiFile is cleared or re-read.
+class MidiEventList
+{
+public:
+    class const_iterator
+    {
+    public:
+        const_iterator(const MidiEventList *list, int i) : l(list), pos(i) {}
+        MidiEvent operator*() const { return l->at(pos); }
+        const_iterator &operator++() { ++pos; return *this; }
+        bool operator!=(const const_iterator &o) const { return pos != o.pos; }
+        bool operator==(const const_iterator &o) const { return pos == o.pos; }
+    private:
+        const MidiEventList *l;
+        int pos;
+    };
+
+    MidiEventList() {}
+    explicit MidiEventList(const MidiEventStore *store);
+    MidiEventList(const MidiEventStore *store, const QVector<int> &indexes);
+
+    int count() const;
+    int size() const { return count(); }
+    bool isEmpty() const { return count() == 0; }
+
+    // index in the store
+    int index(int i) const { return fAll ? i : fIndexes.at(i); }
+    uint32_t tick(int i) const { return fStore->tick(index(i)); }
+
+    MidiEvent at(int i) const { return fStore->event(index(i)); }
+    MidiEvent operator[](int i) const { return at(i); }
+    MidiEvent first() const { return at(0); }
+    MidiEvent last() const { return at(count() - 1); }
+    MidiEvent back() const { return last(); }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count()); }
+
+private:
+    const MidiEventStore *fStore = nullptr;
+    QVector<int> fIndexes;
+    bool fAll = false;
+};
+
+#endif // MIDIEVENTSTORE_H
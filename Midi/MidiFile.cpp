@@ -3,12 +3,26 @@
 #include "MidiHelper.h"
 
 #include <cstdlib>
+#include <algorithm>
+#include <iterator>
 
 // ========================================================
-bool isGreaterThan(MidiEvent* e1, MidiEvent* e2)
+typedef struct
 {
-    return (e1->tick() < e2->tick());
+    uint32_t tick;  // tick of the record at pos
+    int track;
+    int pos;
+    int end;
+} TrackCursor;
+
+// min-heap order, equal ticks keep the track order
+static bool isLaterCursor(const TrackCursor &c1, const TrackCursor &c2)
+{
+    if (c1.tick != c2.tick)
+        return c1.tick > c2.tick;
+    return c1.track > c2.track;
 }
+
 quint16 readUInt16(QFile *in) {
     unsigned char buffer[2];
     in->read((char*)&buffer, 2);
@@ -32,6 +46,39 @@ quint32 readVariableLengthQuantity(QFile *in) {
 
     return value;
 }
+
+inline quint16 readUInt16(const uchar *p) {
+    return ((uint16_t)(p[0]) << 8) | (uint16_t)(p[1]);
+}
+
+inline quint32 readUInt32(const uchar *p) {
+    return ((uint32_t)(p[0]) << 24) | ((uint32_t)(p[1]) << 16) |
+           ((uint32_t)(p[2]) << 8) | (uint32_t)(p[3]);
+}
+
+inline quint32 readVariableLengthQuantity(const uchar *&p, const uchar *end) {
+    unsigned char b;
+    uint32_t value = 0;
+    do {
+        if (p >= end)
+            break;
+        b = *p++;
+        value = (value << 7) | (b & 0x7F);
+    } while ((b & 0x80) == 0x80);
+
+    return value;
+}
+// ========================================================
+
+static qint64 usPerBeatAtSpeed(int usPerQuarter, int bpmSpeed)
+{
+    // exact from the file at speed 0
+    if (bpmSpeed == 0 && usPerQuarter > 0)
+        return usPerQuarter;
+
+    double bpm = (usPerQuarter > 0) ? 60000000.0 / usPerQuarter : 0;
+    return qRound64(60000000.0 / qMax(1.0, bpm + bpmSpeed));
+}
 // ========================================================
 
 MidiFile::MidiFile()
@@ -44,14 +91,20 @@ MidiFile::~MidiFile()
     clear();
 }
 
-QVector<MidiEvent *> MidiFile::controllerAndProgramEvents()
+MidiEventList MidiFile::controllerAndProgramEvents() const
 {
-    QVector<MidiEvent*> evnts = fControllerEvents;
-    for (MidiEvent *e : fProgramChangeEvents)
-        evnts.append(e);
-
-    qStableSort(evnts.begin(), evnts.end(), isGreaterThan);
-    return evnts;
+    // both lists are in tick order, on equal ticks controllers come
+    // before program changes like the old stable sort of both lists
+    QVector<int> indexes;
+    indexes.reserve(fControllerIndexes.count() + fProgramChangeIndexes.count());
+
+    const MidiEventStore *store = &fStore;
+    std::merge(fControllerIndexes.constBegin(), fControllerIndexes.constEnd(),
+               fProgramChangeIndexes.constBegin(), fProgramChangeIndexes.constEnd(),
+               std::back_inserter(indexes),
+               [store](int i1, int i2) { return store->tick(i1) < store->tick(i2); });
+
+    return MidiEventList(&fStore, indexes);
 }
 
 void MidiFile::clear()
@@ -64,15 +117,14 @@ void MidiFile::clear()
     fLyrics = "";
     fLyricscursor.clear();
 
-    for (MidiEvent *e : fEvents)
-        delete e;
+    fStore.clear();
+    fTempoIndexes.clear();
+    fLyricsIndexes.clear();
+    fControllerIndexes.clear();
+    fProgramChangeIndexes.clear();
+    fTimeSignatureIndexes.clear();
 
-    fEvents.clear();
-    fTempoEvents.clear();
-    fLyricsEvents.clear();
-    fControllerEvents.clear();
-    fProgramChangeEvents.clear();
-    fTimeSignatureEvents.clear();
+    clearTempoMaps();
 }
 
 bool MidiFile::read(const QString &file, bool seekFileChunkID)
@@ -90,33 +142,53 @@ bool MidiFile::read(QFile *in, bool seekFileChunkID)
     if (!in->exists() || !in->open(QFile::ReadOnly))
         return false;
 
+    // one bulk read, the file is not kept open after loading
+    QByteArray data = in->readAll();
+    in->close();
+
+    return read(data, seekFileChunkID);
+}
+
+bool MidiFile::read(const QByteArray &data, bool seekFileChunkID)
+{
+    // Meta payloads are copied to the store, the buffer is not kept
+    QByteArray buffer = data;
+
     clear();
 
-    char chunkID[4];
-    qint64 chunkSize = 0, chunkStart = 0;
+    const uchar *p = (const uchar*)buffer.constData();
+    const uchar *end = p + buffer.size();
 
-    in->read((char*)chunkID, 4);
+    if (end - p < 14)
+        return false;
 
     if (seekFileChunkID == false) {
-        if (memcmp(chunkID, "MThd", 4) != 0){
-            in->close();
+        if (memcmp(p, "MThd", 4) != 0) {
+            clear();
             return false;
         }
     }
+    p += 4;
 
-    chunkSize = readUInt32(in);
-    chunkStart = in->pos();
+    quint32 chunkSize = readUInt32(p);
+    p += 4;
 
     if (chunkSize != 6) {
-        in->close();
+        clear();
         return false;
     }
 
-    fFormatType = readUInt16(in);
-    fNumOfTracks = readUInt16(in);
+    fFormatType = readUInt16(p);
+    fNumOfTracks = readUInt16(p + 2);
 
-    unsigned char divResolution[2];
-    in->read((char*)divResolution, 2);
+    // the track number is one byte in the store
+    if (fNumOfTracks > MIDI_MAX_TRACKS) {
+        clear();
+        return false;
+    }
+
+    const uchar *divResolution = p + 4;
+    p += 6;
 
     switch ((signed char)(divResolution[0])) {
     case SMPTE24:
@@ -141,199 +213,165 @@ bool MidiFile::read(QFile *in, bool seekFileChunkID)
         break;
     }
 
+    // first record of every track in fStore
+    QVector<int> trackStarts;
+    trackStarts.reserve(fNumOfTracks);
+
     for (int t=0; t<fNumOfTracks; t++) {
 
-        in->read((char*)chunkID, 4);
-        chunkSize = readUInt32(in);
-        chunkStart = in->pos();
+        trackStarts.append(fStore.count());
 
-        if (memcmp(chunkID, "MTrk", 4) != 0) {
+        if (end - p < 8 || memcmp(p, "MTrk", 4) != 0) {
             clear();
-            in->close();
             return false;
         }
 
+        chunkSize = readUInt32(p + 4);
+        p += 8;
+
+        const uchar *trackEnd = (chunkSize > (quint32)(end - p)) ? end : p + chunkSize;
+
         uint32_t tick = 0, delta = 0;
         unsigned char status, runningStatus = 0;
         bool endOfTrack = false;
 
-        while (in->pos() < (chunkStart + chunkSize) && !endOfTrack && !in->atEnd()) {
+        while (p < trackEnd && !endOfTrack) {
 
-            delta = readVariableLengthQuantity(in);
+            delta = readVariableLengthQuantity(p, trackEnd);
             tick += delta;
-            in->getChar((char*)&status);
+
+            if (p >= trackEnd)
+                break;
+
+            status = *p;
 
             if ((status & 0x80) == 0) {
                 status = runningStatus;
-                in->seek(in->pos() - 1);
             } else {
                 runningStatus = status;
+                p++;
             }
 
+            int ch = status & 0x0F;
+
             switch (status & 0xF0) {
             case 0x80: {
-                int ch = status & 0x0F;
-                char d1, d2;
-                in->getChar(&d1);
-                in->getChar(&d2);
-                createMidiEvent(t, tick, delta, MidiEventType::NoteOff, ch, d1, d2);
+                if (trackEnd - p < 2) { p = trackEnd; break; }
+                createMidiEvent(t, tick, MidiEventType::NoteOff, ch, p[0], p[1]);
+                p += 2;
                 break;
             }
             case 0x90: {
-                int ch = status & 0x0F;
-                char d1, d2;
-                in->getChar(&d1);
-                in->getChar(&d2);
-                if (d2 != 0) {
-                    createMidiEvent(t, tick, delta, MidiEventType::NoteOn, ch, d1, d2);
+                if (trackEnd - p < 2) { p = trackEnd; break; }
+                if (p[1] != 0) {
+                    createMidiEvent(t, tick, MidiEventType::NoteOn, ch, p[0], p[1]);
                 } else {
-                    createMidiEvent(t, tick, delta, MidiEventType::NoteOff, ch, d1, 0);
+                    createMidiEvent(t, tick, MidiEventType::NoteOff, ch, p[0], 0);
                 }
+                p += 2;
                 break;
             }
             case 0xA0: {
-                int ch = status & 0x0F;
-                char d1, d2;
-                in->getChar(&d1);
-                in->getChar(&d2);
-                createMidiEvent(t, tick, delta, MidiEventType::NoteAftertouch, ch, d1, d2);
+                if (trackEnd - p < 2) { p = trackEnd; break; }
+                createMidiEvent(t, tick, MidiEventType::NoteAftertouch, ch, p[0], p[1]);
+                p += 2;
                 break;
             }
             case 0xB0: {
-                int ch = status & 0x0F;
-                char d1, d2;
-                in->getChar(&d1);
-                in->getChar(&d2);
-                MidiEvent *e = createMidiEvent(t, tick, delta, MidiEventType::Controller, ch, d1, d2);
-                fControllerEvents.append(e);
+                if (trackEnd - p < 2) { p = trackEnd; break; }
+                createMidiEvent(t, tick, MidiEventType::Controller, ch, p[0], p[1]);
+                p += 2;
                 break;
             }
             case 0xC0: {
-                int ch = status & 0x0F;
-                char d1;
-                in->getChar(&d1);
-                MidiEvent *e = createMidiEvent(t, tick, delta, MidiEventType::ProgramChange, ch, d1, 0);
-                fProgramChangeEvents.append(e);
+                if (trackEnd - p < 1) { p = trackEnd; break; }
+                createMidiEvent(t, tick, MidiEventType::ProgramChange, ch, p[0], 0);
+                p += 1;
                 break;
             }
             case 0xD0: {
-                int ch = status & 0x0F;
-                char d1;
-                in->getChar(&d1);
-                createMidiEvent(t, tick, delta, MidiEventType::ChannelAftertouch, ch, d1, 0);
+                if (trackEnd - p < 1) { p = trackEnd; break; }
+                createMidiEvent(t, tick, MidiEventType::ChannelAftertouch, ch, p[0], 0);
+                p += 1;
                 break;
             }
             case 0xE0: {
-                int ch = status & 0x0F;
-                char d1, d2;
-                in->getChar(&d1);
-                in->getChar(&d2);
-                int pitch = ((d2 & 0x7F) << 7) | (d1 & 0x7F);
-                createMidiEvent(t, tick, delta, MidiEventType::PitchBend, ch, pitch, 0);
+                if (trackEnd - p < 2) { p = trackEnd; break; }
+                int pitch = ((p[1] & 0x7F) << 7) | (p[0] & 0x7F);
+                createMidiEvent(t, tick, MidiEventType::PitchBend, ch, pitch, 0);
+                p += 2;
                 break;
             }
-            case 0xF0:
-                QByteArray data;
-                int lenght = 0;
+            case 0xF0: {
+                quint32 lenght = 0;
                 switch (status) {
                     case 0xF0:
-                    case 0xF7:
-                        lenght = readVariableLengthQuantity(in);
-                        data[0] = status;
-                        data += in->read(lenght);
-                        createSysExEvent(t, tick, delta, data);
+                    case 0xF7: {
+                        lenght = readVariableLengthQuantity(p, trackEnd);
+                        lenght = qMin(lenght, (quint32)(trackEnd - p));
+                        // SysEx keeps the status byte in front
+                        QByteArray data;
+                        data.reserve(lenght + 1);
+                        data.append((char)status);
+                        data.append((const char*)p, lenght);
+                        createSysExEvent(t, tick, data);
+                        p += lenght;
                         break;
-                    case 0xFF:
-                        char number;
-                        in->getChar(&number);
-                        lenght = readVariableLengthQuantity(in);
-                        data = in->read(lenght);
-                        createMetaEvent(t, tick, delta, number, data);
+                    }
+                    case 0xFF: {
+                        if (p >= trackEnd) break;
+                        int number = *p++;
+                        lenght = readVariableLengthQuantity(p, trackEnd);
+                        lenght = qMin(lenght, (quint32)(trackEnd - p));
+                        createMetaEvent(t, tick, number,
+                                        QByteArray::fromRawData((const char*)p, lenght));
+                        p += lenght;
                         if (number == 0x2F) {
                             endOfTrack = true;
                         }
                         break;
+                    }
                 }
                 break;
+            }
             } // End Switch
 
         } // End while
 
         /* forwards compatibility: skip over any unrecognized chunks, or extra
         * data at the end of tracks. */
-        in->seek(chunkStart + chunkSize);
+        p = trackEnd;
 
     } // For loop read tracks
 
-    qStableSort(fEvents.begin(), fEvents.end(), isGreaterThan);
-    qStableSort(fTempoEvents.begin(), fTempoEvents.end(), isGreaterThan);
-    qStableSort(fLyricsEvents.begin(), fLyricsEvents.end(), isGreaterThan);
-    qStableSort(fControllerEvents.begin(), fControllerEvents.end(), isGreaterThan);
-    qStableSort(fProgramChangeEvents.begin(), fProgramChangeEvents.end(), isGreaterThan);
-    qStableSort(fTimeSignatureEvents.begin(), fTimeSignatureEvents.end(), isGreaterThan);
+    mergeTracks(trackStarts);
 
-    in->close();
-
-    for (auto e : fLyricsEvents) {
-        QString lyr = e->data();
+    for (int i : fLyricsIndexes) {
+        QString lyr = fStore.payload(i);
+        uint32_t tick = fStore.tick(i);
         for (auto chr : lyr)
-            fLyricscursor.append(e->tick());
+            fLyricscursor.append(tick);
         fLyrics += lyr;
     }
 
+    tempoMap(0);
+
     return true;
 }
 
-MidiEvent *MidiFile::createMidiEvent(int track, uint32_t tick, uint32_t delta, MidiEventType evType, int ch, int data1, int data2)
+int MidiFile::createMidiEvent(int track, uint32_t tick, MidiEventType evType, int ch, int data1, int data2)
 {
-    MidiEvent *e = new MidiEvent();
-    e->setTrack(track);
-    e->setTick(tick);
-    e->setDelta(delta);
-    e->setEventType(evType);
-    e->setChannel(ch);
-    e->setData1(data1);
-    e->setData2(data2);
-
-    fEvents.append(e);
-
-    return e;
+    return fStore.appendChannelEvent(track, tick, evType, ch, data1, data2);
 }
 
-MidiEvent *MidiFile::createMetaEvent(int track, uint32_t tick, uint32_t delta, int number, QByteArray data)
+int MidiFile::createMetaEvent(int track, uint32_t tick, int number, const QByteArray &data)
 {
-    MidiEvent *me = new MidiEvent();
-    me->setTrack(track);
-    me->setTick(tick);
-    me->setDelta(delta);
-    me->setEventType(MidiEventType::Meta);
-    me->setMetaType(number);
-    me->setData(data);
-
-    fEvents.append(me);
-
-    if (me->metaEventType() == MidiMetaType::SetTempo)
-        fTempoEvents.append(me);
-    if (me->metaEventType() == MidiMetaType::Lyrics)
-        fLyricsEvents.append(me);
-    if (me->metaEventType() == MidiMetaType::TimeSignature)
-        fTimeSignatureEvents.append(me);
-
-    return me;
+    return fStore.appendMetaEvent(track, tick, number, data);
 }
 
-MidiEvent *MidiFile::createSysExEvent(int track, uint32_t tick, uint32_t delta, QByteArray data)
+int MidiFile::createSysExEvent(int track, uint32_t tick, const QByteArray &data)
 {
-    MidiEvent *e = new MidiEvent();
-    e->setTrack(track);
-    e->setTick(tick);
-    e->setDelta(delta);
-    e->setEventType(MidiEventType::SysEx);
-    e->setData(data);
-
-    fEvents.append(e);
-
-    return e;
+    return fStore.appendSysExEvent(track, tick, data);
 }
 
 float MidiFile::beatFromTick(uint32_t tick)
@@ -354,31 +392,11 @@ float MidiFile::beatFromTick(uint32_t tick)
     }
 }
 
-float MidiFile::timeFromTick(uint32_t tick, int bpmSpeed)
+float MidiFile::timeFromTick(uint32_t tick, int bpmSpeed, bool singleTempo)
 {
     switch (fDivision) {
-    case PPQ: {
-        float tempo_event_time = 0.0;
-        uint32_t tempo_event_tick = 0;
-        float tempo = 120.0 + bpmSpeed;
-
-        for (MidiEvent* e : fTempoEvents) {
-            if (e->tick() >= tick) {
-                break;
-            }
-            tempo_event_time +=
-                (((float)(e->tick() - tempo_event_tick)) / fResolution / (tempo / 60));
-            tempo_event_tick = e->tick();
-            tempo = e->bpm() + bpmSpeed;
-
-            if (_singleTempo)
-                break;
-        }
-
-        float time =
-            tempo_event_time + (((float)(tick - tempo_event_tick)) / fResolution / (tempo / 60));
-        return time;
-    }
+    case PPQ:
+        return timeUsFromTick(tick, bpmSpeed, singleTempo) / 1000000.0;
     case SMPTE24:
         return (float)(tick) / (fResolution * 24.0);
     case SMPTE25:
@@ -392,29 +410,30 @@ float MidiFile::timeFromTick(uint32_t tick, int bpmSpeed)
     }
 }
 
-uint32_t MidiFile::tickFromTime(float time, int bpmSpeed)
+qint64 MidiFile::timeUsFromTick(uint32_t tick, int bpmSpeed, bool singleTempo)
 {
-    switch (fDivision) {
-    case PPQ: {
-        float tempo_event_time = 0.0;
-        uint32_t tempo_event_tick = 0;
-        float tempo = 120.0 + bpmSpeed;
-
-        for (MidiEvent* e : fTempoEvents) {
-            float next_tempo_event_time =
-                tempo_event_time +
-                (((float)(e->tick() - tempo_event_tick)) / fResolution / (tempo / 60));
-            if (next_tempo_event_time >= time) break;
-            tempo_event_time = next_tempo_event_time;
-            tempo_event_tick = e->tick();
-            tempo = e->bpm() + bpmSpeed;
-
-            if (_singleTempo)
-                break;
-        }
+    if (fDivision != PPQ)
+        return (qint64)(timeFromTick(tick, bpmSpeed, singleTempo) * 1000000.0);
 
-        return tempo_event_tick + (uint32_t)((time - tempo_event_time) * (tempo / 60) * fResolution);
-    }
+    if (fResolution <= 0)
+        return 0;
+
+    const TempoMap &map = tempoMap(bpmSpeed, singleTempo);
+
+    // last segment that starts before tick
+    auto it = std::lower_bound(map.constBegin(), map.constEnd(), tick,
+                               [](const TempoSegment &seg, uint32_t t) { return seg.tick < t; });
+    if (it != map.constBegin())
+        --it;
+
+    return it->timeUs + (qint64)(tick - it->tick) * it->usPerBeat / fResolution;
+}
+
+uint32_t MidiFile::tickFromTime(float time, int bpmSpeed, bool singleTempo)
+{
+    switch (fDivision) {
+    case PPQ:
+        return tickFromTimeUs((qint64)(time * 1000000.0), bpmSpeed, singleTempo);
     case SMPTE24:
         return (uint32_t)(time * fResolution * 24.0);
     case SMPTE25:
@@ -428,29 +447,11 @@ uint32_t MidiFile::tickFromTime(float time, int bpmSpeed)
     }
 }
 
-uint32_t MidiFile::tickFromTimeMs(long msTime, int bpmSpeed)
+uint32_t MidiFile::tickFromTimeMs(long msTime, int bpmSpeed, bool singleTempo)
 {
     switch (fDivision) {
-    case PPQ: {
-        float tempo_event_time = 0.0;
-        uint32_t tempo_event_tick = 0;
-        float tempo = 120.0 + bpmSpeed;
-
-        for (MidiEvent* e : fTempoEvents) {
-            float next_tempo_event_time =
-                tempo_event_time +
-                (((float)(e->tick() - tempo_event_tick)) / fResolution / (tempo / 60000));
-            if (next_tempo_event_time >= msTime) break;
-            tempo_event_time = next_tempo_event_time;
-            tempo_event_tick = e->tick();
-            tempo = e->bpm() + bpmSpeed;
-
-            if (_singleTempo)
-                break;
-        }
-
-        return tempo_event_tick + (uint32_t)((msTime - tempo_event_time) * (tempo / 60000) * fResolution);
-    }
+    case PPQ:
+        return tickFromTimeUs((qint64)(msTime) * 1000, bpmSpeed, singleTempo);
     case SMPTE24:
         return (uint32_t)(msTime * fResolution * 24.0) * 1000;
     case SMPTE25:
@@ -464,6 +465,25 @@ uint32_t MidiFile::tickFromTimeMs(long msTime, int bpmSpeed)
     }
 }
 
+uint32_t MidiFile::tickFromTimeUs(qint64 usTime, int bpmSpeed, bool singleTempo)
+{
+    if (fDivision != PPQ)
+        return tickFromTime(usTime / 1000000.0, bpmSpeed, singleTempo);
+
+    if (fResolution <= 0 || usTime <= 0)
+        return 0;
+
+    const TempoMap &map = tempoMap(bpmSpeed, singleTempo);
+
+    // last segment that starts before usTime
+    auto it = std::lower_bound(map.constBegin(), map.constEnd(), usTime,
+                               [](const TempoSegment &seg, qint64 us) { return seg.timeUs < us; });
+    if (it != map.constBegin())
+        --it;
+
+    return it->tick + (uint32_t)((usTime - it->timeUs) * fResolution / it->usPerBeat);
+}
+
 uint32_t MidiFile::tickFromBeat(float beat)
 {
     switch (fDivision) {
@@ -541,36 +561,33 @@ int MidiFile::barCount()
         lastBeatInBar = sigBeat.nBeatInBar;
     }
 
-    int beatCount = beatFromTick(fEvents.last()->tick());
+    int beatCount = beatFromTick(fStore.tick(fStore.count() - 1));
     bCount += (beatCount - lastBeat) / lastBeatInBar;
 
     return bCount;
 }
 
-bool MidiFile::isSingleTempo()
+const TempoMap &MidiFile::tempoMap(int bpmSpeed, bool singleTempo)
 {
-    return _singleTempo;
-}
+    int slot = bpmSpeed + TEMPO_MAP_SPEEDS / 2;
+    if (slot < 0 || slot >= TEMPO_MAP_SPEEDS) {
+        fSpeedTempoMap = buildTempoMap(bpmSpeed, singleTempo);
+        return fSpeedTempoMap;
+    }
 
-void MidiFile::setSingleTempo(bool single)
-{
-    _singleTempo = single;
-}
+    QAtomicPointer<TempoMap> &p = fTempoMaps[singleTempo ? 1 : 0][slot];
 
-void MidiFile::insertEvent(int index, MidiEvent *event)
-{
-    fEvents.insert(index, event);
-}
+    TempoMap *map = p.loadAcquire();
+    if (map)
+        return *map;
 
-MidiEvent *MidiFile::takeEvent(int index)
-{
-    return fEvents.takeAt(index);
-}
+    // two threads may build the same map, the second one drops its copy
+    TempoMap *built = new TempoMap(buildTempoMap(bpmSpeed, singleTempo));
+    if (p.testAndSetOrdered(nullptr, built))
+        return *built;
 
-MidiEvent *MidiFile::takeEvent(MidiEvent *event)
-{
-    int i = fEvents.indexOf(event, fEvents.count() - 1);
-    return takeEvent(i);
+    delete built;
+    return *p.loadAcquire();
 }
 
 int MidiFile::firstBpm(const QString &file)
@@ -624,36 +641,168 @@ int MidiFile::firstBpm(QFile *in)
 
     // End check file
 
-    in->seek(0);
+    // walk the events in file order, up to the first tempo
+    in->seek(14);
 
-    QByteArray buffer = in->readAll();
-    int index = buffer.indexOf(0xFF51, 0);
+    for (int i=0; i<nTracks; i++) {
 
-    if (index == -1) {
-        in->close();
-        return 120;
-    }
-    else {
-        in->seek(index);
-        char metaNumber;//, lenght;
-        in->getChar(&metaNumber);
-        //in->getChar(&lenght);
-        int lenght = readVariableLengthQuantity(in);
-
-        // wrong
-        if (metaNumber != 0x51 || lenght != 3) {
-            in->close();
-            return 120;
+        in->read((char*)cId, 4);
+        qint64 trackEnd = readUInt32(in);
+        trackEnd += in->pos();
+
+        unsigned char status, runningStatus = 0;
+
+        while (in->pos() < trackEnd && !in->atEnd()) {
+
+            readVariableLengthQuantity(in);
+            in->getChar((char*)&status);
+
+            if ((status & 0x80) == 0) {
+                status = runningStatus;
+                in->seek(in->pos() - 1);
+            } else {
+                runningStatus = status;
+            }
+
+            if (status == 0xFF) {
+                char metaNumber;
+                in->getChar(&metaNumber);
+                int lenght = readVariableLengthQuantity(in);
+
+                if (metaNumber == 0x51 && lenght == 3) {
+                    unsigned char data[3];
+                    in->read((char*)data, 3);
+                    int32_t midi_tempo = (data[0] << 16) | (data[1] << 8) | data[2];
+
+                    in->close();
+
+                    return (midi_tempo > 0) ? 60000000 / midi_tempo : 120;
+                }
+
+                if (metaNumber == 0x2F)
+                    break;
+
+                in->seek(in->pos() + lenght);
+            }
+            else if (status == 0xF0 || status == 0xF7) {
+                int lenght = readVariableLengthQuantity(in);
+                in->seek(in->pos() + lenght);
+            }
+            else {
+                // program change and channel aftertouch have one data byte
+                int evType = status & 0xF0;
+                in->seek(in->pos() + ((evType == 0xC0 || evType == 0xD0) ? 1 : 2));
+            }
         }
 
-        unsigned char data[3];
-        in->read((char*)data, 3);
-        int32_t midi_tempo = (data[0] << 16) | (data[1] << 8) | data[2];
+        in->seek(trackEnd);
+    }
+
+    in->close();
 
-        in->close();
+    return 120;
+}
 
-        return 60000000 / midi_tempo;
+void MidiFile::mergeTracks(const QVector<int> &trackStarts)
+{
+    // Every track is already in tick order, merge them instead of sorting
+    // the whole list and fill the typed indexes on the way.
+    QVector<MidiEventRecord> &records = fStore.recordVector();
+    const int count = records.count();
+
+    QVector<TrackCursor> heap;
+    heap.reserve(trackStarts.count());
+
+    for (int t=0; t<trackStarts.count(); t++) {
+        TrackCursor c;
+        c.track = t;
+        c.pos = trackStarts[t];
+        c.end = (t + 1 < trackStarts.count()) ? trackStarts[t + 1] : count;
+        if (c.pos >= c.end)
+            continue;
+        c.tick = records[c.pos].tick;
+        heap.append(c);
     }
+
+    std::make_heap(heap.begin(), heap.end(), isLaterCursor);
+
+    QVector<MidiEventRecord> merged;
+    merged.reserve(count);
+
+    while (!heap.isEmpty()) {
+        std::pop_heap(heap.begin(), heap.end(), isLaterCursor);
+        TrackCursor &c = heap.last();
+
+        const MidiEventRecord &r = records[c.pos];
+        appendToIndexes(r, merged.count());
+        merged.append(r);
+
+        if (++c.pos < c.end) {
+            c.tick = records[c.pos].tick;
+            std::push_heap(heap.begin(), heap.end(), isLaterCursor);
+        } else {
+            heap.removeLast();
+        }
+    }
+
+    records.swap(merged);
 }
 
+void MidiFile::appendToIndexes(const MidiEventRecord &r, int index)
+{
+    switch (r.status) {
+    case 0xFF:
+        if (r.data1 == 0x51)
+            fTempoIndexes.append(index);
+        else if (r.data1 == 0x05)
+            fLyricsIndexes.append(index);
+        else if (r.data1 == 0x58)
+            fTimeSignatureIndexes.append(index);
+        break;
+    default:
+        if ((r.status & 0xF0) == 0xB0)
+            fControllerIndexes.append(index);
+        else if ((r.status & 0xF0) == 0xC0)
+            fProgramChangeIndexes.append(index);
+        break;
+    }
+}
 
+TempoMap MidiFile::buildTempoMap(int bpmSpeed, bool singleTempo)
+{
+    TempoMap map;
+    map.reserve(fTempoIndexes.count() + 1);
+
+    TempoSegment seg;
+    seg.tick = 0;
+    seg.timeUs = 0;
+    seg.usPerBeat = usPerBeatAtSpeed(500000, bpmSpeed); // 120 bpm
+    map.append(seg);
+
+    if (fResolution <= 0)
+        return map;
+
+    for (int i : fTempoIndexes) {
+        TempoSegment next;
+        next.tick = fStore.tick(i);
+        next.timeUs = seg.timeUs + (qint64)(next.tick - seg.tick) * seg.usPerBeat / fResolution;
+        next.usPerBeat = usPerBeatAtSpeed(fStore.usPerQuarter(i), bpmSpeed);
+        map.append(next);
+        seg = next;
+
+        if (singleTempo)
+            break;
+    }
+
+    return map;
+}
+
+void MidiFile::clearTempoMaps()
+{
+    // not while another thread converts times of this file
+    for (auto &maps : fTempoMaps) {
+        for (QAtomicPointer<TempoMap> &p : maps)
+            delete p.fetchAndStoreOrdered(nullptr);
+    }
+    fSpeedTempoMap.clear();
+}
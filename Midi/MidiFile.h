@@ -2,10 +2,24 @@
 #define MIDIFILE_H
 
 #include "MidiEvent.h"
+#include "MidiEventStore.h"
 
 #include <QString>
 #include <QVector>
 #include <QFile>
+#include <QAtomicPointer>
+
+typedef struct
+{
+    uint32_t tick;
+    qint64   timeUs;    // elapsed microseconds at tick
+    qint64   usPerBeat; // microseconds per quarter note from tick
+} TempoSegment;
+
+typedef QVector<TempoSegment> TempoMap;
+
+// bpm speeds with a cached tempo map, -256 to 255
+#define TEMPO_MAP_SPEEDS 512
 
 class MidiFile
 {
@@ -25,6 +39,7 @@ public:
     void clear();
     bool read(const QString &file, bool seekFileChunkID = false);
     bool read(QFile *in, bool seekFileChunkID = false);
+    bool read(const QByteArray &data, bool seekFileChunkID = false);
 
     int formatType() { return fFormatType; }
     int numberOfTracks() { return fNumOfTracks; }
@@ -34,38 +49,46 @@ public:
     QString lyrics() { return fLyrics; }
     QVector<long> lyricsCursor() { return fLyricscursor; }
 
-    QVector<MidiEvent*> events() { return fEvents; }
-    QVector<MidiEvent*> tempoEvents() { return fTempoEvents; }
-    QVector<MidiEvent*> lyricsEvents() { return fLyricsEvents; }
-    QVector<MidiEvent*> controllerEvents() { return fControllerEvents; }
-    QVector<MidiEvent*> programChangeEvents() { return fProgramChangeEvents; }
-    QVector<MidiEvent*> timeSignatureEvents() { return fTimeSignatureEvents; }
-    QVector<MidiEvent*> controllerAndProgramEvents();
+    const MidiEventStore *eventStore() const { return &fStore; }
+
+    MidiEventList events() const { return MidiEventList(&fStore); }
+    MidiEventList tempoEvents() const { return MidiEventList(&fStore, fTempoIndexes); }
+    MidiEventList lyricsEvents() const { return MidiEventList(&fStore, fLyricsIndexes); }
+    MidiEventList controllerEvents() const { return MidiEventList(&fStore, fControllerIndexes); }
+    MidiEventList programChangeEvents() const { return MidiEventList(&fStore, fProgramChangeIndexes); }
+    MidiEventList timeSignatureEvents() const { return MidiEventList(&fStore, fTimeSignatureIndexes); }
+    MidiEventList controllerAndProgramEvents() const;
 
-    MidiEvent* createMidiEvent(int track, uint32_t tick, uint32_t delta, MidiEventType evType, int ch, int data1, int data2);
-    MidiEvent* createMetaEvent(int track, uint32_t tick, uint32_t delta, int number, QByteArray data);
-    MidiEvent* createSysExEvent(int track, uint32_t tick, uint32_t delta, QByteArray data);
+    int createMidiEvent(int track, uint32_t tick, MidiEventType evType, int ch, int data1, int data2);
+    int createMetaEvent(int track, uint32_t tick, int number, const QByteArray &data);
+    int createSysExEvent(int track, uint32_t tick, const QByteArray &data);
 
     float    beatFromTick(uint32_t tick);
-    float    timeFromTick(uint32_t tick, int bpmSpeed = 0);
-    uint32_t tickFromTime(float time, int bpmSpeed = 0);
-    uint32_t tickFromTimeMs(long msTime, int bpmSpeed = 0);
+    // singleTempo : the first tempo for the whole song, medley
+    float    timeFromTick(uint32_t tick, int bpmSpeed = 0, bool singleTempo = false);
+    qint64   timeUsFromTick(uint32_t tick, int bpmSpeed = 0, bool singleTempo = false);
+    uint32_t tickFromTime(float time, int bpmSpeed = 0, bool singleTempo = false);
+    uint32_t tickFromTimeMs(long msTime, int bpmSpeed = 0, bool singleTempo = false);
+    uint32_t tickFromTimeUs(qint64 usTime, int bpmSpeed = 0, bool singleTempo = false);
     uint32_t tickFromBeat(float beat);
     uint32_t tickFromBar(int barNumber);
     int      barFromTick(uint32_t tick);
 
     int barCount();
 
-    bool isSingleTempo();
-    void setSingleTempo(bool single);
-
-    void insertEvent(int index, MidiEvent *event);
-    MidiEvent *takeEvent(int index);
-    MidiEvent *takeEvent(MidiEvent *event);
+    // Built on the first call for a speed and kept until clear(), read
+    // without a lock. Call it for a new speed before playing at it.
+    const TempoMap &tempoMap(int bpmSpeed = 0, bool singleTempo = false);
 
     static int firstBpm(const QString &file);
     static int firstBpm(QFile *in);
 
+private:
+    void mergeTracks(const QVector<int> &trackStarts);
+    void appendToIndexes(const MidiEventRecord &r, int index);
+    TempoMap buildTempoMap(int bpmSpeed, bool singleTempo);
+    void clearTempoMaps();
+
 private:
     int fFormatType;
     int fNumOfTracks;
@@ -75,14 +98,21 @@ private:
     QString fLyrics;
     QVector<long> fLyricscursor;
 
-    QVector<MidiEvent*> fEvents;
-    QVector<MidiEvent*> fTempoEvents;
-    QVector<MidiEvent*> fLyricsEvents;
-    QVector<MidiEvent*> fControllerEvents;
-    QVector<MidiEvent*> fProgramChangeEvents;
-    QVector<MidiEvent*> fTimeSignatureEvents;
+    MidiEventStore fStore;
+
+    // indexes in fStore
+    QVector<int> fTempoIndexes;
+    QVector<int> fLyricsIndexes;
+    QVector<int> fControllerIndexes;
+    QVector<int> fProgramChangeIndexes;
+    QVector<int> fTimeSignatureIndexes;
+
+    // [single tempo][bpmSpeed + TEMPO_MAP_SPEEDS / 2], a slot is only
+    // set once, by the first thread that built the map
+    QAtomicPointer<TempoMap> fTempoMaps[2][TEMPO_MAP_SPEEDS];
+    TempoMap fSpeedTempoMap;    // a speed out of the cached range, not thread safe
 
-    bool _singleTempo = false;
+    Q_DISABLE_COPY(MidiFile)
 };
 
 #endif // MIDIFILE_H
@@ -51,17 +51,18 @@ int MidiHelper::getNumberBeatInBar(int numerator, int denominator)
 QList<SignatureBeat> MidiHelper::calculateBeats(MidiFile *midi)
 {
     QList<SignatureBeat> beats;
-    uint32_t t = midi->events().back()->tick();
+    uint32_t t = midi->events().back().tick();
     ushort bCount = midi->beatFromTick(t);
 
-    for (MidiEvent *evt : midi->timeSignatureEvents())
+    for (MidiEvent evt : midi->timeSignatureEvents())
     {
-        int nBeatInBar = getNumberBeatInBar(evt->data()[0], evt->data()[1]);
+        QByteArray data = evt.data();
+        int nBeatInBar = getNumberBeatInBar(data[0], data[1]);
         if (nBeatInBar <= 0)
             continue;
 
         SignatureBeat sb;
-        sb.nBeat = midi->beatFromTick(evt->tick());
+        sb.nBeat = midi->beatFromTick(evt.tick());
         sb.nBeatInBar = nBeatInBar;
         beats.append(sb);
     }
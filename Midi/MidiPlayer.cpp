@@ -1,6 +1,7 @@
 #include "MidiPlayer.h"
 
 #include <QtMath>
+#include <QVarLengthArray>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -14,6 +15,9 @@ MidiPlayer::MidiPlayer(QObject *parent) : QObject(parent)
 
     _midiSynth  = new MidiSynthesizer();
 
+    _dispatcher = new MidiDispatcher(this);
+    _dispatcher->start(QThread::TimeCriticalPriority);
+
     if (midiDevices().size() > 0)
     {
         setMidiOut(0);
@@ -22,10 +26,13 @@ MidiPlayer::MidiPlayer(QObject *parent) : QObject(parent)
 
 MidiPlayer::~MidiPlayer()
 {
+    // the queued songs reset the ramp and fade of _midiSeq
+    unloadNextMedley();
+
     delete _midiSeq;
 
-    if (_midiSeqTemp != nullptr)
-        delete _midiSeqTemp;
+    _dispatcher->stop();
+    delete _dispatcher;
 
     for (MidiOut *out : _midiOuts.values()) {
         if (out) {
@@ -106,10 +113,22 @@ MidiFile *MidiPlayer::midiFile()
 
 MidiFile *MidiPlayer::midiFileTemp()
 {
-    if (_midiSeqTemp == nullptr)
+    MidiSequencer *seq = midiSequencerTemp();
+    if (seq == nullptr)
         return nullptr;
     else
-        return _midiSeqTemp->midiFile();
+        return seq->midiFile();
+}
+
+MidiSequencer *MidiPlayer::midiSequencerTemp()
+{
+    _medleyMutex.lock();
+    MidiSequencer *seq = _crossfade.seq;
+    if (!seq && !_medleyQueue.isEmpty())
+        seq = _medleyQueue.first().seq;
+    _medleyMutex.unlock();
+
+    return seq;
 }
 
 bool MidiPlayer::isUsedMidiSynthesizer()
@@ -175,6 +194,11 @@ int MidiPlayer::positionTick()
     return _midiSeq->positionTick();
 }
 
+qint64 MidiPlayer::timeUsFromTick(int tick)
+{
+    return _midiSeq->midiFile()->timeUsFromTick(tick, _midiSeq->bpmSpeed());
+}
+
 int MidiPlayer::bpmSpeed()
 {
     return _midiSeq->bpmSpeed();
@@ -203,6 +227,9 @@ bool MidiPlayer::setMidiOut(int portNumber)
     if (!isPlayerStopped())
         stop(true);
 
+    // the outputs are changed here with the dispatcher idle
+    _dispatcher->waitForEmpty();
+
     int oldPort = _midiPortNum;
     bool result = false;
 
@@ -229,6 +256,7 @@ bool MidiPlayer::setMidiOut(int portNumber)
         _midiChannels[i].setPort(_midiPortNum);
     }
 
+    closeUnusedPorts();
     calculateUsedPort();
 
     return result;
@@ -265,27 +293,45 @@ bool MidiPlayer::setMidiIn(int portNumber)
 }
 
 bool MidiPlayer::load(const QString &file, bool seekFileChunkID)
+{
+    QSharedPointer<MidiFile> midi(new MidiFile());
+    if (!midi->read(file, seekFileChunkID)) {
+        if (!isPlayerStopped())
+            stop(true);
+        return false;
+    }
+
+    return load(midi);
+}
+
+bool MidiPlayer::load(const QByteArray &data, bool seekFileChunkID)
+{
+    QSharedPointer<MidiFile> midi(new MidiFile());
+    if (!midi->read(data, seekFileChunkID)) {
+        if (!isPlayerStopped())
+            stop(true);
+        return false;
+    }
+
+    return load(midi);
+}
+
+bool MidiPlayer::load(const QSharedPointer<MidiFile> &midi)
 {
     if (!isPlayerStopped())
         stop(true);
 
     _midiSeq->deleteLater();
     _midiSeq = new MidiSequencer();
+    connectSequencer();
+    connectSequencerEvents(_midiSeq, _seqRing.load());
 
-    connect(_midiSeq, SIGNAL(playingEvent(MidiEvent)),
-            this, SLOT(sendEvent(MidiEvent)), Qt::DirectConnection);
-    connect(_midiSeq, SIGNAL(bpmChanged(int)),
-            this, SLOT(onSeqBpmChanged(int)), Qt::DirectConnection);
-    connect(_midiSeq, SIGNAL(finished()),
-            this, SLOT(onSeqFinished()), Qt::DirectConnection);
-
-    if (!_midiSeq->load(file, seekFileChunkID))
+    if (!_midiSeq->load(midi))
         return false;
 
-    if (_useMedley)
-        _midiSeq->midiFile()->setSingleTempo(true);
+    _midiSeq->setSingleTempo(_useMedley);
 
-    _midiTranspose = 0;
+    _songTranspose[_seqRing.load()] = 0;
 
     for (int i=0; i<16; i++) {
         bool isLockVol = _midiChannels[i].isLockVol();
@@ -300,6 +346,7 @@ bool MidiPlayer::load(const QString &file, bool seekFileChunkID)
     _midiChannels[9].setInstrumentType(InstrumentType::PercussionEtc);
 
     _midiSynth->compactSoundfont();
+    sendCommand(DispatchCommand::ResetGain);
 
     emit loaded();
 
@@ -308,8 +355,13 @@ bool MidiPlayer::load(const QString &file, bool seekFileChunkID)
 
 void MidiPlayer::play()
 {
+    // MidiRenderer has the synthesizer
+    if (_midiSynth->isOfflineMode())
+        return;
+
     if (isPlayerStopped()) {
-        sendResetAllControllers();
+        for (int i=0; i<16; i++)
+            sendCommand(DispatchCommand::ResetAllControllers, i);
         MidiEvent ev;
         ev.setEventType(MidiEventType::ProgramChange);
         ev.setChannel(9);
@@ -319,8 +371,8 @@ void MidiPlayer::play()
             ev.setData1(0);
         }
         sendEvent(ev);
-        emit sendedEvent(ev);
     }
+    updateEventClock();
     _midiSeq->start();
 }
 
@@ -329,9 +381,16 @@ void MidiPlayer::stop(bool resetPos)
     if (isPlayerStopped())
         return;
 
+    cancelCrossfade();
+
     _midiSeq->stop(resetPos);
+    _dispatcher->waitForEmpty();
 
-    sendAllNotesOff();
+    if (_midiSynth->isEventClockStarted())
+        _midiSynth->stopEventClock();
+
+    for (int i=0; i<16; i++)
+        sendCommand(DispatchCommand::AllNotesOff, i);
 }
 
 void MidiPlayer::setVolume(int v)
@@ -341,10 +400,7 @@ void MidiPlayer::setVolume(int v)
     else _volume = v;
 
     _midiSynth->setVolume(_volume / 100.0f);
-    for (MidiOut *out : _midiOuts.values()) {
-        if (!out) continue;
-        out->setVolume(_volume / 100.0f);
-    }
+    sendCommand(DispatchCommand::OutputVolume, 0, _volume);
 }
 
 void MidiPlayer::setVolume(int ch, int v)
@@ -379,14 +435,7 @@ void MidiPlayer::setInstrument(int ch, int i)
     else if (i < 0) v = 0;
     else v = i;
 
-    _midiSynth->sendProgramChange(ch, v);
-    for (MidiOut *out : _midiOuts.values()) {
-        if (!out) continue;
-        out->sendProgramChange(ch, v);
-    }
-
-    _midiChannels[ch].setInstrument(v);
-    _midiChannels[ch].setInstrumentType(MidiHelper::getInstrumentType(v));
+    sendCommand(DispatchCommand::Instrument, ch, v);
 }
 
 void MidiPlayer::setMute(int ch, bool mute)
@@ -400,7 +449,7 @@ void MidiPlayer::setMute(int ch, bool mute)
     _midiChannels[ch].setMute(mute);
 
     if (mute)
-        sendAllNotesOff(ch);
+        sendCommand(DispatchCommand::AllNotesOff, ch);
 }
 
 void MidiPlayer::setSolo(int ch, bool solo)
@@ -418,7 +467,7 @@ void MidiPlayer::setSolo(int ch, bool solo)
         if (_midiChannels[i].isSolo()) {
             us = true;
         } else {
-            sendAllNotesOff(i);
+            sendCommand(DispatchCommand::AllNotesOff, i);
         }
     }
 
@@ -429,7 +478,7 @@ void MidiPlayer::setSolo(int ch, bool solo)
             if (_midiChannels[i].isSolo()) {
                 continue;
             }
-            sendAllNotesOff(i);
+            sendCommand(DispatchCommand::AllNotesOff, i);
         }
     }
 }
@@ -501,21 +550,36 @@ void MidiPlayer::setLockVolume(int ch, bool lock)
 
 void MidiPlayer::setPositionTick(int t)
 {
+    cancelCrossfade();
+
+    if (_midiSeq->lookahead() > 0 && isPlayerPlaying()) {
+        // queued events belong to the old position
+        _midiSeq->stop();
+        _dispatcher->waitForEmpty();
+        _midiSynth->stopEventClock();
+        for (int i=0; i<16; i++)
+            sendCommand(DispatchCommand::AllNotesOff, i);
+        _midiSeq->setPositionTick(t);
+        _midiSeq->start();
+        return;
+    }
+
     _midiSeq->setPositionTick(t);
 }
 
 void MidiPlayer::setTranspose(int t)
 {
-    if (_midiTranspose == -12 || _midiTranspose == 12)
+    int &transpose = _songTranspose[_seqRing.load()];
+    if (transpose == -12 || transpose == 12)
         return;
 
-    _midiTranspose = t;
+    transpose = t;
 
     if (isPlayerPlaying()) {
         for (int i=0; i<16; i++) {
             if (i == 9)
                 continue;
-            sendAllNotesOff(i);
+            sendCommand(DispatchCommand::AllNotesOff, i);
         }
     }
 }
@@ -536,7 +600,6 @@ void MidiPlayer::setLockDrum(bool lock, int number)
         ev.setChannel(9);
         ev.setData1(number);
         sendEvent(ev);
-        emit sendedEvent(ev);
     }
 }
 
@@ -549,7 +612,7 @@ void MidiPlayer::setLockSnare(bool lock, int number)
     _lockSnareNumber = number;
 
     if (isPlayerPlaying()) {
-        sendAllNotesOff(9);
+        sendCommand(DispatchCommand::AllNotesOff, 9);
     }
 }
 
@@ -573,7 +636,6 @@ void MidiPlayer::setLockBass(bool lock, int number)
             ev.setChannel(i);
             ev.setData1(number);
             sendEvent(ev);
-            emit sendedEvent(ev);
         }
     }
 }
@@ -586,50 +648,13 @@ void MidiPlayer::setMapChannelOutput(int ch, int port)
     if (port == _midiChannels[ch].port())
         return;
 
-    if (port == -1)
-    {
-        if (!_midiSynth->isOpened()) {
-            _midiSynth->open();
-            _midiSynth->setVolume(_volume / 100.0f);
-        }
-
-        if (!this->isPlayerStopped()) {
-            _midiSynth->sendProgramChange(ch, _midiChannels[ch].instrument());
-            _midiSynth->sendController(ch, 7, _midiChannels[ch].volume());
-            _midiSynth->sendController(ch, 10, _midiChannels[ch].pan());
-            _midiSynth->sendController(ch, 91, _midiChannels[ch].reverb());
-            _midiSynth->sendController(ch, 93, _midiChannels[ch].chorus());
-        }
-    }
-    else
-    {
-        MidiOut *out = _midiOuts[port];
-        if (!out) {
-            out = new MidiOut();
-            out->openPort(port);
-            out->setVolume(_volume / 100.0f);
-            _midiOuts[port] = out;
-        }
-
-        if (!this->isPlayerStopped()) {
-            out->sendProgramChange(ch, _midiChannels[ch].instrument());
-            out->sendController(ch, 7, _midiChannels[ch].volume());
-            out->sendController(ch, 10, _midiChannels[ch].pan());
-            out->sendController(ch, 91, _midiChannels[ch].reverb());
-            out->sendController(ch, 93, _midiChannels[ch].chorus());
-        }
-    }
-
-    if (isPlayerPlaying()) {
-        _midiChannels[ch].setChangingPort(true);
-        sendAllNotesOff(ch);
-        _midiChannels[ch].setPort(port);
-        _midiChannels[ch].setChangingPort(false);
-    } else {
-        _midiChannels[ch].setPort(port);
+    // the synth is opened here, the channel moves on the dispatcher thread
+    if (port == -1 && !_midiSynth->isOpened()) {
+        _midiSynth->open();
+        _midiSynth->setVolume(_volume / 100.0f);
     }
 
-    this->calculateUsedPort();
+    sendCommand(DispatchCommand::ChannelOutput, ch, port + 1);
 }
 
 void MidiPlayer::receiveMidiIn(std::vector<unsigned char> *message)
@@ -662,84 +687,439 @@ bool MidiPlayer::loadNextMedley(const QString &file, int cutStartBar, int cutEnd
     if (!_useMedley)
         return false;
 
-    if (_midiSeqTemp != nullptr)
-        delete _midiSeqTemp;
+    QSharedPointer<MidiFile> midi(new MidiFile());
+    if (!midi->read(file, true)) {
+        unloadNextMedley();
+        return false;
+    }
+
+    return loadNextMedley(midi, cutStartBar, cutEndBar, midiSpeed, transpose);
+}
+
+bool MidiPlayer::loadNextMedley(const QByteArray &data, int cutStartBar, int cutEndBar, int midiSpeed, int transpose)
+{
+    if (!_useMedley)
+        return false;
+
+    QSharedPointer<MidiFile> midi(new MidiFile());
+    if (!midi->read(data, true)) {
+        unloadNextMedley();
+        return false;
+    }
+
+    return loadNextMedley(midi, cutStartBar, cutEndBar, midiSpeed, transpose);
+}
+
+bool MidiPlayer::loadNextMedley(const QSharedPointer<MidiFile> &midi, int cutStartBar, int cutEndBar, int midiSpeed, int transpose)
+{
+    if (!_useMedley)
+        return false;
+
+    unloadNextMedley();
+
+    return queueMedley(midi, cutStartBar, cutEndBar, midiSpeed, transpose);
+}
+
+void MidiPlayer::unloadNextMedley()
+{
+    cancelCrossfade();
+
+    _medleyMutex.lock();
+
+    for (const MedleySegment &seg : _medleyQueue)
+        delete seg.seq;
+    _medleyQueue.clear();
+
+    // nothing to move to
+    _midiSeq->setTempoRamp(0, 0);
+    _midiSeq->setFadeOut(0);
+
+    _medleyMutex.unlock();
+}
 
-    _midiSeqTemp = new MidiSequencer();
-    if (!_midiSeqTemp->load(file, true))
+bool MidiPlayer::queueMedley(const QSharedPointer<MidiFile> &midi, int cutStartBar, int cutEndBar, int midiSpeed, int transpose)
+{
+    if (!_useMedley)
+        return false;
+
+    MidiSequencer *seq = new MidiSequencer();
+    if (!seq->load(midi)) {
+        delete seq;
         return false;
+    }
+
+    seq->setSingleTempo(true);
+    seq->setBpmSpeed(midiSpeed);
+    seq->setCutStartBar(cutStartBar);
+    seq->setCutEndBar(cutEndBar);
 
-    _midiSeqTemp->midiFile()->setSingleTempo(true);
+    // samples are loaded now, not at the song change, what only the
+    // songs before the current one used is dropped first
+    if (medleyQueueCount() == 0)
+        _midiSynth->compactSoundfont();
+    preloadSoundfont(seq->midiFile());
 
-    _midiSeqTemp->setBpmSpeed(midiSpeed);
-    _midiTransposeTemp = transpose;
+    MedleySegment seg;
+    seg.seq = seq;
+    seg.transpose = transpose;
 
-    _midiSeqTemp->setCutStartBar(cutStartBar);
-    _midiSeqTemp->setCutEndBar(cutEndBar);
+    _medleyMutex.lock();
+    MidiSequencer *prev = _medleyQueue.isEmpty() ? _midiSeq : _medleyQueue.last().seq;
+    _medleyQueue.append(seg);
+    updateMedleyTransition(prev, seq);
+    _medleyMutex.unlock();
 
     return true;
 }
 
-void MidiPlayer::unloadNextMedley()
+int MidiPlayer::medleyQueueCount()
 {
-    if (_midiSeqTemp != nullptr) {
-        delete _midiSeqTemp;
-        _midiSeqTemp = nullptr;
-        _midiTransposeTemp = 0;
+    _medleyMutex.lock();
+    int count = _medleyQueue.count();
+    _medleyMutex.unlock();
+
+    return count;
+}
+
+void MidiPlayer::updateMedleyTransitions()
+{
+    _medleyMutex.lock();
+
+    MidiSequencer *prev = _midiSeq;
+    for (const MedleySegment &seg : _medleyQueue) {
+        updateMedleyTransition(prev, seg.seq);
+        prev = seg.seq;
     }
+
+    _medleyMutex.unlock();
+}
+
+void MidiPlayer::updateMedleyTransition(MidiSequencer *from, MidiSequencer *to)
+{
+    MidiFile *fromMidi = from->midiFile();
+    MidiFile *toMidi = to->midiFile();
+
+    int end = from->endTick();
+    int endBar = fromMidi->barFromTick(end);
+
+    int fadeOut = 0, fadeIn = 0, ramp = 0;
+    if (_medleyCrossfadeBars > 0) {
+        fadeOut = end - fromMidi->tickFromBar(qMax(0, endBar - _medleyCrossfadeBars));
+        int startBar = toMidi->barFromTick(to->startTick());
+        fadeIn = toMidi->tickFromBar(startBar + _medleyCrossfadeBars) - to->startTick();
+    }
+    if (_medleyTempoRampBars > 0)
+        ramp = end - fromMidi->tickFromBar(qMax(0, endBar - _medleyTempoRampBars));
+
+    // the speed that plays the tempo of from at the bpm to starts with,
+    // the ramp sets it without the range check of setBpmSpeed()
+    int fromBpm = from->currentBpm() - from->bpmSpeed();
+    int targetSpeed = qBound(SEQ_MIN_BPM - fromBpm, to->currentBpm() - fromBpm, SEQ_MAX_BPM - fromBpm);
+
+    from->setFadeOut(fadeOut);
+    from->setTempoRamp(ramp, targetSpeed);
+    to->setFadeIn(fadeIn);
+}
+
+void MidiPlayer::preloadSoundfont(MidiFile *midi)
+{
+    QList<int> programs, drumKits;
+    programs.append(0);
+    drumKits.append(0);
+
+    for (MidiEvent e : midi->programChangeEvents()) {
+        QList<int> &list = (e.channel() == 9) ? drumKits : programs;
+        if (!list.contains(e.data1()))
+            list.append(e.data1());
+    }
+
+    _midiSynth->preloadPresets(programs, drumKits);
+}
+
+void MidiPlayer::connectSequencer()
+{
+    connect(_midiSeq, SIGNAL(clockStarted()),
+            this, SLOT(onSeqClockStarted()), Qt::DirectConnection);
+    connect(_midiSeq, SIGNAL(fadeOutStarted(qint64)),
+            this, SLOT(onSeqFadeOutStarted(qint64)), Qt::DirectConnection);
+    connect(_midiSeq, SIGNAL(bpmChanged(int)),
+            this, SLOT(onSeqBpmChanged(int)), Qt::DirectConnection);
+    connect(_midiSeq, SIGNAL(finished()),
+            this, SLOT(onSeqFinished()), Qt::DirectConnection);
+}
+
+void MidiPlayer::setUseEventClock(bool use)
+{
+    if (use == _useEventClock)
+        return;
+
+    _useEventClock = use;
+
+    updateEventClock();
+}
+
+bool MidiPlayer::takeSentNoteOn(MidiEvent *e)
+{
+    QueuedEvent q;
+    if (!_sentNoteOns.pop(&q))
+        return false;
+
+    *e = MidiDispatcher::unpack(q);
+
+    return true;
 }
 
 void MidiPlayer::sendEvent(MidiEvent e)
 {
-    _playingEventPtr = &e;
+    _dispatcher->send(MidiDispatcher::pack(e));
+}
 
-    if (e.eventType() == MidiEventType::Controller
-        || e.eventType() == MidiEventType::ProgramChange) {
-        sendEventToDevices(e);
-    } else {
-        if (_midiChannels[e.channel()].isMute() == false) {
-            if (_useSolo) {
-                if (_midiChannels[e.channel()].isSolo()) {
-                    sendEventToDevices(e);
-                }
-            } else {
-                sendEventToDevices(e);
-            }
+void MidiPlayer::sendCommand(DispatchCommand c, int ch, int data1)
+{
+    _dispatcher->send(MidiDispatcher::command(c, ch, data1));
+}
+
+void MidiPlayer::connectSequencerEvents(MidiSequencer *seq, int ring)
+{
+    // on the sequencer thread, each sequencer has its own ring
+    connect(seq, &MidiSequencer::playingEvent, this, [this, seq, ring](MidiEvent e) {
+        // Meta and SysEx never reach the devices
+        if (e.eventType() == MidiEventType::Meta || e.eventType() == MidiEventType::SysEx)
+            return;
+        _dispatcher->push(ring, MidiDispatcher::pack(e, seq->eventTimeUs(), seq->eventGain()));
+    }, Qt::DirectConnection);
+
+    connect(seq, &MidiSequencer::playingEvents, this,
+            [this, ring](const MidiEventStore *store, const SequencedEvent *events, int count) {
+        queueSeqEvents(ring, store, events, count);
+    }, Qt::DirectConnection);
+}
+
+void MidiPlayer::dispatchSent(const QueuedEvent &e)
+{
+    // dispatcher thread
+    int ch = e.channel;
+
+    switch (e.command) {
+    case DispatchCommand::Event:
+        dispatchEvent(MidiDispatcher::unpack(e), transpose(), -1);
+        break;
+    case DispatchCommand::AllNotesOff:
+        sendAllNotesOff(ch);
+        break;
+    case DispatchCommand::ResetAllControllers:
+        sendResetAllControllers(ch);
+        break;
+    case DispatchCommand::Instrument:
+        _midiSynth->sendProgramChange(ch, e.data1);
+        for (MidiOut *out : _midiOuts.values()) {
+            if (!out) continue;
+            out->sendProgramChange(ch, e.data1);
         }
+        _midiChannels[ch].setInstrument(e.data1);
+        _midiChannels[ch].setInstrumentType(MidiHelper::getInstrumentType(e.data1));
+        _detailChanges.fetchAndOrRelease(1 << ch);
+        break;
+    case DispatchCommand::ChannelOutput:
+        switchChannelOutput(ch, e.data1 - 1);
+        break;
+    case DispatchCommand::OutputVolume:
+        for (MidiOut *out : _midiOuts.values()) {
+            if (!out) continue;
+            out->setVolume(e.data1 / 100.0f);
+        }
+        break;
+    case DispatchCommand::ResetGain:
+        for (int i=0; i<16; i++) {
+            _sentGains[i] = 1.0f;
+            _channelRing[i] = _seqRing.load();
+        }
+        break;
     }
+}
 
-    emit sendedEvent(*_playingEventPtr);
+void MidiPlayer::switchChannelOutput(int ch, int port)
+{
+    // dispatcher thread, the state of the channel goes to the new output
+    // and the notes held on the old one are released
+    if (port == _midiChannels[ch].port())
+        return;
+
+    if (port == -1)
+    {
+        _midiSynth->sendProgramChange(ch, _midiChannels[ch].instrument());
+        _midiSynth->sendController(ch, 7, _midiChannels[ch].volume());
+        _midiSynth->sendController(ch, 10, _midiChannels[ch].pan());
+        _midiSynth->sendController(ch, 91, _midiChannels[ch].reverb());
+        _midiSynth->sendController(ch, 93, _midiChannels[ch].chorus());
+    }
+    else
+    {
+        MidiOut *out = _midiOuts.value(port, nullptr);
+        if (!out) {
+            out = new MidiOut();
+            out->openPort(port);
+            out->setVolume(_volume / 100.0f);
+            _midiOuts[port] = out;
+        }
+
+        out->sendProgramChange(ch, _midiChannels[ch].instrument());
+        out->sendController(ch, 7, _midiChannels[ch].volume());
+        out->sendController(ch, 10, _midiChannels[ch].pan());
+        out->sendController(ch, 91, _midiChannels[ch].reverb());
+        out->sendController(ch, 93, _midiChannels[ch].chorus());
+    }
+
+    sendAllNotesOff(ch);
+    _midiChannels[ch].setPort(port);
+
+    closeUnusedPorts();
+
+    // the synth and the event clock belong to the GUI thread
+    QMetaObject::invokeMethod(this, "calculateUsedPort", Qt::QueuedConnection);
+}
+
+void MidiPlayer::dispatchQueued(const QueuedEvent &e, int ring)
+{
+    // Dispatcher thread, medley fade, held notes follow the channel
+    // volumes. In a crossfade both songs play on the same channels, a
+    // channel follows the song that last played a note on it.
+    if (e.type == static_cast<quint8>(MidiEventType::NoteOn) && e.data2 > 0)
+        _channelRing[e.channel] = ring;
+
+    for (int ch=0; ch<16; ch++) {
+        if (_channelRing[ch] != ring)
+            continue;
+        float &sent = _sentGains[ch];
+        if (qAbs(e.gain - sent) >= 1.0f / 16 || (e.gain == 1.0f && sent != 1.0f)) {
+            sent = e.gain;
+            sendChannelVolume(ch, qRound(_midiChannels[ch].volume() * e.gain), e.timeUs);
+        }
+    }
+
+    dispatchEvent(MidiDispatcher::unpack(e), _songTranspose[ring], e.timeUs, e.gain);
+}
+
+void MidiPlayer::dispatchEvent(MidiEvent e, int transpose, qint64 timeUs, float gain)
+{
+    if (filterEvent(&e, transpose))
+        sendEventToDevices(&e, timeUs, gain);
+
+    // the peaks may be dropped, a state change may not
+    switch (e.eventType()) {
+    case MidiEventType::NoteOn:
+        if (e.data2() > 0)
+            _sentNoteOns.push(MidiDispatcher::pack(e));
+        break;
+    case MidiEventType::Controller:
+        if (e.data1() == 7)
+            _volumeChanges.fetchAndOrRelease(1 << e.channel());
+        else if (e.data1() == 10 || e.data1() == 91 || e.data1() == 93)
+            _detailChanges.fetchAndOrRelease(1 << e.channel());
+        break;
+    case MidiEventType::ProgramChange:
+        _detailChanges.fetchAndOrRelease(1 << e.channel());
+        break;
+    default:
+        break;
+    }
 }
 
 void MidiPlayer::onSeqFinished()
 {
-    if (_useMedley) {
-        if (_midiSeq->isSeqFinished() && (_midiSeqTemp != nullptr)) {
-            _midiSeq->deleteLater();
-            _midiSeq = _midiSeqTemp;
-            _midiSeqTemp = nullptr;
+    if (!_useMedley) {
+        emit finished();
+        return;
+    }
 
-            connect(_midiSeq, SIGNAL(playingEvent(MidiEvent)),
-                    this, SLOT(sendEvent(MidiEvent)), Qt::DirectConnection);
-            connect(_midiSeq, SIGNAL(bpmChanged(int)),
-                    this, SLOT(onSeqBpmChanged(int)), Qt::DirectConnection);
-            connect(_midiSeq, SIGNAL(finished()),
-                    this, SLOT(onSeqFinished()), Qt::DirectConnection);
+    if (!_midiSeq->isSeqFinished())
+        return;
 
-            _midiTranspose = _midiTransposeTemp;
-            _midiTransposeTemp = 0;
+    _medleyMutex.lock();
 
-            _midiSynth->compactSoundfont();
-            _midiSeq->start();
+    MedleySegment seg = _crossfade;
+    _crossfade.seq = nullptr;
 
-            emit nextMedleyStarted();
-            emit nextMedleyAfterStarted();
-        } else if (_midiSeq->isSeqFinished() && (_midiSeqTemp == nullptr)) {
+    if (!seg.seq) {
+        if (_medleyQueue.isEmpty()) {
+            _medleyMutex.unlock();
             emit finished();
+            return;
         }
-    } else {
-        emit finished();
+
+        // Without a crossfade the next song goes on the clock of this one
+        // from its end time. The events were sent ahead, the next song has
+        // the same lookahead to queue its first events, no silence and no
+        // soundfont work here.
+        seg = _medleyQueue.takeFirst();
+        int ring = 1 - _seqRing.load();
+        _songTranspose[ring] = seg.transpose;
+        connectSequencerEvents(seg.seq, ring);
+        seg.seq->setLookahead(_midiSeq->lookahead());
+        seg.seq->setChainStart(_midiSeq->clock(), _midiSeq->clockEndUs());
+        seg.seq->start();
     }
+
+    // the next song plays from here on, on its own ring
+    MidiSequencer *prev = _midiSeq;
+    _midiSeq = seg.seq;
+    _seqRing.storeRelease(1 - _seqRing.load());
+    prev->deleteLater();
+    connectSequencer();
+
+    _medleyMutex.unlock();
+
+    emit bpmChanged(_midiSeq->currentBpm());
+    emit nextMedleyStarted();
+    emit nextMedleyAfterStarted();
+}
+
+void MidiPlayer::onSeqFadeOutStarted(qint64 clockUs)
+{
+    // Sequencer thread of _midiSeq. The next song starts on its clock at
+    // the beginning of the fade out and fades in while this one fades
+    // out, it becomes _midiSeq when this one finishes.
+    _medleyMutex.lock();
+
+    if (_crossfade.seq || _medleyQueue.isEmpty()) {
+        _medleyMutex.unlock();
+        return;
+    }
+
+    _crossfade = _medleyQueue.takeFirst();
+
+    int ring = 1 - _seqRing.load();
+    _songTranspose[ring] = _crossfade.transpose;
+    connectSequencerEvents(_crossfade.seq, ring);
+    _crossfade.seq->setLookahead(_midiSeq->lookahead());
+    _crossfade.seq->setChainStart(_midiSeq->clock(), clockUs);
+    _crossfade.seq->start();
+
+    _medleyMutex.unlock();
+}
+
+void MidiPlayer::cancelCrossfade()
+{
+    // a stop or a seek of _midiSeq, the next song goes back to the queue
+    // and starts again at the next fade out
+    _medleyMutex.lock();
+    MedleySegment seg = _crossfade;
+    _crossfade.seq = nullptr;
+    _medleyMutex.unlock();
+
+    if (!seg.seq)
+        return;
+
+    seg.seq->stop(true);
+    disconnect(seg.seq, nullptr, this, nullptr);
+    _dispatcher->waitForEmpty();
+
+    for (int i=0; i<16; i++)
+        sendCommand(DispatchCommand::AllNotesOff, i);
+
+    _medleyMutex.lock();
+    _medleyQueue.prepend(seg);
+    _medleyMutex.unlock();
 }
 
 void MidiPlayer::onSeqBpmChanged(int bpm)
@@ -747,36 +1127,103 @@ void MidiPlayer::onSeqBpmChanged(int bpm)
     emit bpmChanged(bpm);
 }
 
-void MidiPlayer::sendEventToDevices(MidiEvent evt)
+void MidiPlayer::queueSeqEvents(int ring, const MidiEventStore *store, const SequencedEvent *events, int count)
+{
+    // called on the sequencer thread, packed from the records of the
+    // store and pushed as one batch
+    QVarLengthArray<QueuedEvent, 256> queued;
+
+    for (int i = 0; i < count; i++) {
+        const MidiEventRecord &r = store->record(events[i].index);
+        if (r.status == 0 || r.status == 0xF7 || r.status == 0xFF)
+            continue;
+        queued.append(MidiDispatcher::pack(r, events[i].timeUs, events[i].gain));
+    }
+
+    if (!queued.isEmpty())
+        _dispatcher->push(ring, queued.constData(), queued.count());
+}
+
+void MidiPlayer::onSeqClockStarted()
+{
+    if (_midiSeq->lookahead() > 0)
+        _midiSynth->startEventClock();
+}
+
+void MidiPlayer::sendChannelVolume(int ch, int value, qint64 timeUs)
+{
+    if (_midiChannels[ch].port() == -1) {
+        _midiSynth->sendController(ch, 7, value, timeUs);
+    } else {
+        _midiOuts[_midiChannels[ch].port()]->sendController(ch, 7, value);
+    }
+}
+
+bool MidiPlayer::filterEvent(MidiEvent *e, int transpose)
+{
+    int ch = e->channel();
+
+    switch (e->eventType()) {
+    case MidiEventType::Controller:
+        if (e->data1() == 7 && _midiChannels[ch].isLockVol())
+            e->setData2(_midiChannels[ch].volume());
+        return true;
+    case MidiEventType::ProgramChange: {
+        int programe = e->data1();
+        if (ch == 9 && _lockDrum) {
+            programe = _lockDrumNumber;
+        }
+        if (isBassInstrument(e->data1()) && _lockBass) {
+            programe = _lockBassBumber;
+        }
+        e->setData1(programe);
+        return true;
+    }
+    case MidiEventType::NoteOff:
+    case MidiEventType::NoteOn:
+    case MidiEventType::NoteAftertouch:
+        e->setData1(getNoteNumberToPlay(ch, e->data1(), transpose));
+        break;
+    default:
+        break;
+    }
+
+    if (_midiChannels[ch].isMute())
+        return false;
+
+    return !_useSolo || _midiChannels[ch].isSolo();
+}
+
+void MidiPlayer::sendEventToDevices(MidiEvent *e, qint64 timeUs, float gain)
 {
-    MidiEvent *e = &evt;
     int ch = e->channel();
 
     switch (e->eventType()) {
         case MidiEventType::NoteOff: {
-            int n = getNoteNumberToPlay(ch, e->data1());
+            int n = e->data1();
             if (_midiChannels[ch].port() == -1) {
-                _midiSynth->sendNoteOff(ch, n, e->data2());
+                _midiSynth->sendNoteOff(ch, n, e->data2(), timeUs);
             } else {
                 _midiOuts[_midiChannels[ch].port()]->sendNoteOff(ch, n, e->data2());
             }
             break;
         }
         case MidiEventType::NoteOn: {
-            if (_midiChannels[ch].isChangingPort())
-                break;
-            int n = getNoteNumberToPlay(ch, e->data1());
+            int n = e->data1();
+            int v = e->data2();
+            if (gain < 1.0f && v > 0)
+                v = qMax(1, qRound(v * gain));
             if (_midiChannels[ch].port() == -1) {
-                _midiSynth->sendNoteOn(ch, n, e->data2());
+                _midiSynth->sendNoteOn(ch, n, v, timeUs);
             } else {
-                _midiOuts[_midiChannels[ch].port()]->sendNoteOn(ch, n, e->data2());
+                _midiOuts[_midiChannels[ch].port()]->sendNoteOn(ch, n, v);
             }
             break;
         }
         case MidiEventType::NoteAftertouch: {
-            int n = getNoteNumberToPlay(ch, e->data1());
+            int n = e->data1();
             if (_midiChannels[ch].port() == -1) {
-                _midiSynth->sendNoteAftertouch(ch, n, e->data2());
+                _midiSynth->sendNoteAftertouch(ch, n, e->data2(), timeUs);
             } else {
                 _midiOuts[_midiChannels[ch].port()]->sendNoteAftertouch(ch, n, e->data2());
             }
@@ -784,44 +1231,26 @@ void MidiPlayer::sendEventToDevices(MidiEvent evt)
         }
         case MidiEventType::Controller: {
             switch (e->data1()) {
-            case 7: {
-                if (_midiChannels[ch].isLockVol()) {
-                    _tempEvent = *e;
-                    _tempEvent.setData2(_midiChannels[ch].volume());
-                    _playingEventPtr = &_tempEvent;
-                    e = &_tempEvent;
-                } else {
-                    _midiChannels[ch].setVolume(e->data2());
-                }
-                break;
-            }
+            case 7: _midiChannels[ch].setVolume(e->data2()); break;
             case 10: _midiChannels[ch].setPan(e->data2()); break;
             case 91: _midiChannels[ch].setReverb(e->data2()); break;
             case 93: _midiChannels[ch].setChorus(e->data2()); break;
             default: break;
             }
 
+            int value = e->data2();
+            if (e->data1() == 7 && gain < 1.0f)
+                value = qRound(value * gain);
+
             if (_midiChannels[ch].port() == -1) {
-                _midiSynth->sendController(ch, e->data1(), e->data2());
+                _midiSynth->sendController(ch, e->data1(), value, timeUs);
             } else {
-                _midiOuts[_midiChannels[ch].port()]->sendController(ch, e->data1(), e->data2());
+                _midiOuts[_midiChannels[ch].port()]->sendController(ch, e->data1(), value);
             }
             break;
         }
         case MidiEventType::ProgramChange: {
             int programe = e->data1();
-            if (ch == 9 && _lockDrum) {
-                programe = _lockDrumNumber;
-                _tempEvent = *e;
-                _tempEvent.setData1(programe);
-                _playingEventPtr = &_tempEvent;
-            }
-            if (isBassInstrument(e->data1()) && _lockBass) {
-                programe = _lockBassBumber;
-                _tempEvent = *e;
-                _tempEvent.setData1(programe);
-                _playingEventPtr = &_tempEvent;
-            }
 
             _midiChannels[ch].setInstrument(programe);
             if (ch != 9) {
@@ -829,7 +1258,7 @@ void MidiPlayer::sendEventToDevices(MidiEvent evt)
             }
 
             if (_midiChannels[ch].port() == -1) {
-                _midiSynth->sendProgramChange(ch, programe);
+                _midiSynth->sendProgramChange(ch, programe, timeUs);
             } else {
                 _midiOuts[_midiChannels[ch].port()]->sendProgramChange(ch, programe);
             }
@@ -837,7 +1266,7 @@ void MidiPlayer::sendEventToDevices(MidiEvent evt)
         }
         case MidiEventType::ChannelAftertouch: {
             if (_midiChannels[ch].port() == -1) {
-                _midiSynth->sendChannelAftertouch(ch, e->data1());
+                _midiSynth->sendChannelAftertouch(ch, e->data1(), timeUs);
             } else {
                 _midiOuts[_midiChannels[ch].port()]->sendChannelAftertouch(ch, e->data1());
             }
@@ -845,7 +1274,7 @@ void MidiPlayer::sendEventToDevices(MidiEvent evt)
         }
         case MidiEventType::PitchBend: {
             if (_midiChannels[ch].port() == -1) {
-                _midiSynth->sendPitchBend(ch, e->data1());
+                _midiSynth->sendPitchBend(ch, e->data1(), timeUs);
             } else {
                 _midiOuts[_midiChannels[ch].port()]->sendPitchBend(ch, e->data1());
             }
@@ -904,7 +1333,7 @@ void MidiPlayer::sendResetAllControllers()
     }
 }
 
-int MidiPlayer::getNoteNumberToPlay(int ch, int defaultNote)
+int MidiPlayer::getNoteNumberToPlay(int ch, int defaultNote, int transpose)
 {
     int n = 0;
     if (ch == 9) {
@@ -914,38 +1343,53 @@ int MidiPlayer::getNoteNumberToPlay(int ch, int defaultNote)
             n = defaultNote;
     }
     else {
-        n = defaultNote + _midiTranspose;
+        n = defaultNote + transpose;
     }
     return n;
 }
 
 void MidiPlayer::calculateUsedPort()
 {
-    // calculate used port
-    // list port all channel
-    bool usedSynth = false;
-    QList<int> usedPort;
-    for (int i=0; i<16; i++) {
-        int p = _midiChannels[i].port();
-        usedPort.append(p);
-        if (p == -1)
-            usedSynth = true;
-    }
-
-    // remove port not used
-    if (!usedSynth) {
+    // close the synth when no channel uses it
+    if (!isUsedMidiSynthesizer()) {
         _midiSynth->close();
     }
+
+    updateEventClock();
+}
+
+void MidiPlayer::closeUnusedPorts()
+{
+    // dispatcher thread or the dispatcher idle
+    QList<int> usedPort;
+    for (int i=0; i<16; i++)
+        usedPort.append(_midiChannels[i].port());
+
     for (int pNumber : _midiOuts.keys()) {
 
         if (usedPort.indexOf(pNumber) != -1)
             continue;
 
-        _midiOuts[pNumber]->closePort();;
+        _midiOuts[pNumber]->closePort();
         delete _midiOuts.take(pNumber);
     }
 }
 
+void MidiPlayer::updateEventClock()
+{
+    // sending ahead is only safe when every channel plays on the synth
+    bool synthOnly = true;
+    for (int i=0; i<16; i++) {
+        if (_midiChannels[i].port() != -1) {
+            synthOnly = false;
+            break;
+        }
+    }
+
+    bool use = _useEventClock && synthOnly && _midiSynth->canScheduleEvents();
+    _midiSeq->setLookahead(use ? _eventClockLookaheadMs * 1000 : 0);
+}
+
 void midiIncallback(double deltatime, std::vector<unsigned char> *message, void *userData)
 {
     if (message->size() < 2)
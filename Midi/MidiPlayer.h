@@ -5,8 +5,11 @@
 #include "Channel.h"
 #include "MidiSequencer.h"
 #include "MidiSynthesizer.h"
+#include "MidiDispatcher.h"
+#include "EventRing.h"
 
 #include <QObject>
+#include <QMutex>
 
 enum class PlayerState
 {
@@ -16,6 +19,13 @@ enum class PlayerState
     Finished
 };
 
+// A song queued in the medley, played on the clock of the one before it
+typedef struct
+{
+    MidiSequencer *seq;
+    int transpose;
+} MedleySegment;
+
 class MidiPlayer : public QObject
 {
     Q_OBJECT
@@ -29,13 +39,13 @@ public:
     static bool isBassInstrument(int ints);
 
     MidiSequencer *midiSequencer() { return _midiSeq; }
-    MidiSequencer *midiSequencerTemp() { return _midiSeqTemp; }
+    MidiSequencer *midiSequencerTemp();
     MidiSynthesizer *midiSynthesizer() { return _midiSynth; }
     Channel *midiChannel() { return _midiChannels; }
     int midiOutPortNumber() { return _midiPortNum; }
     int midiInPortNumber() { return _midiPortInNum; }
     int volume() { return _volume; }
-    int transpose() { return _midiTranspose; }
+    int transpose() { return _songTranspose[_seqRing.load()]; }
 
     int  lockDrumNumber()  { return _lockDrumNumber; }
     int  lockSnareNumber() { return _lockSnareNumber; }
@@ -59,6 +69,7 @@ public:
     long positionMs();
     int durationTick();
     int positionTick();
+    qint64 timeUsFromTick(int tick);  // through the tempo map, at the current speed
     int bpmSpeed();
     int currentBpm();
     int currentBeat();
@@ -67,6 +78,8 @@ public:
     bool setMidiOut(int portNumber);
     bool setMidiIn(int portNumber);
     bool load(const QString &file, bool seekFileChunkID = false);
+    bool load(const QByteArray &data, bool seekFileChunkID = false);
+    bool load(const QSharedPointer<MidiFile> &midi);
     void play();
     void stop(bool resetPos = false);
     void setVolume(int v);
@@ -96,16 +109,50 @@ public:
     int medleyBPM() { return _medleyBPM; }
     void setMedleyBPM(int bpm);
 
+    // bars at the end of a song that fade out and the next song fades in
+    int medleyCrossfadeBars() { return _medleyCrossfadeBars; }
+    void setMedleyCrossfadeBars(int bars) { _medleyCrossfadeBars = qMax(0, bars); }
+
+    // bars at the end of a song that move its tempo to the next song
+    int medleyTempoRampBars() { return _medleyTempoRampBars; }
+    void setMedleyTempoRampBars(int bars) { _medleyTempoRampBars = qMax(0, bars); }
+
     bool loadNextMedley(const QString &file, int cutStartBar, int cutEndBar, int midiSpeed, int transpose);
+    bool loadNextMedley(const QByteArray &data, int cutStartBar, int cutEndBar, int midiSpeed, int transpose);
+    bool loadNextMedley(const QSharedPointer<MidiFile> &midi, int cutStartBar, int cutEndBar, int midiSpeed, int transpose);
     void unloadNextMedley();
 
+    // add after the last queued song instead of replacing the next one
+    bool queueMedley(const QSharedPointer<MidiFile> &midi, int cutStartBar, int cutEndBar, int midiSpeed, int transpose);
+    int medleyQueueCount();
+
+    // after the cut of the playing or a queued song changed
+    void updateMedleyTransitions();
+
+    // Mute, solo, transpose and the volume, drum, bass and snare locks of
+    // the channels, e is changed to what is played. False when the channel
+    // doesn't play it. Also used by MidiRenderer.
+    bool filterEvent(MidiEvent *e, int transpose);
+
+    // Internal synth only: queue events ahead with their sample position
+    bool isUseEventClock() { return _useEventClock; }
+    void setUseEventClock(bool use);
+
+    // GUI thread, the note ons sent since the last call, oldest first.
+    // They are dropped when not taken in time, timing never waits.
+    bool takeSentNoteOn(MidiEvent *e);
+
+    // GUI thread, bit n set when channel n changed since the last call,
+    // read the values from midiChannel(). Never dropped.
+    int takeVolumeChanges() { return _volumeChanges.fetchAndStoreAcquire(0); }
+    int takeDetailChanges() { return _detailChanges.fetchAndStoreAcquire(0); }  // instrument, pan, effects
+
 public slots:
     void sendEvent(MidiEvent e);
 
 signals:
     void loaded();
     void finished();
-    void sendedEvent(MidiEvent e);
     void bpmChanged(int bpm);
     void nextMedleyStarted();
     void nextMedleyAfterStarted();
@@ -113,9 +160,24 @@ signals:
 private slots:
     void onSeqFinished();
     void onSeqBpmChanged(int bpm);
+    void onSeqClockStarted();
+    void onSeqFadeOutStarted(qint64 clockUs);
+    void calculateUsedPort();
 
 private:
-    void sendEventToDevices(MidiEvent evt);
+    friend class MidiDispatcher;
+    void dispatchQueued(const QueuedEvent &e, int ring);
+    void dispatchSent(const QueuedEvent &e);
+    void sendCommand(DispatchCommand c, int ch = 0, int data1 = 0);
+    void switchChannelOutput(int ch, int port);
+    void closeUnusedPorts();
+
+    // gain < 1 scales note on velocity, medley fades
+    void dispatchEvent(MidiEvent e, int transpose, qint64 timeUs, float gain = 1.0f);
+
+    // e as filtered by filterEvent
+    void sendEventToDevices(MidiEvent *e, qint64 timeUs = -1, float gain = 1.0f);
+    void sendChannelVolume(int ch, int value, qint64 timeUs);
     void sendAllNotesOff(int ch);
     void sendAllNotesOff();
     void sendAllSoundOff(int ch);
@@ -123,30 +185,50 @@ private:
     void sendResetAllControllers(int ch);
     void sendResetAllControllers();
 
-    int getNoteNumberToPlay(int ch, int defaultNote);
-    void calculateUsedPort();
+    int getNoteNumberToPlay(int ch, int defaultNote, int transpose);
+    void updateEventClock();
+    void connectSequencer();
+    // the events of seq go to ring, its song transposes by _songTranspose[ring]
+    void connectSequencerEvents(MidiSequencer *seq, int ring);
+    void queueSeqEvents(int ring, const MidiEventStore *store, const SequencedEvent *events, int count);
+    void cancelCrossfade();
+    void preloadSoundfont(MidiFile *midi);
+    void updateMedleyTransition(MidiSequencer *from, MidiSequencer *to);
 
 private:
     MidiSequencer *_midiSeq;
-    MidiSequencer *_midiSeqTemp = nullptr;
+    MedleySegment _crossfade = { nullptr, 0 };   // the next song while it fades in
+    QList<MedleySegment> _medleyQueue;
+    QMutex _medleyMutex;
     QMap<int, MidiOut*> _midiOuts;
     MidiSynthesizer     *_midiSynth;
+    MidiDispatcher      *_dispatcher;
+    EventRing<QueuedEvent, 1024> _sentNoteOns;    // dispatcher thread -> GUI
+    QAtomicInt          _volumeChanges;
+    QAtomicInt          _detailChanges;
     RtMidiIn            *_midiIn = nullptr;
     Channel             _midiChannels[16];
     int                 _midiPortNum = 0;
     int                 _midiPortInNum = -1;
     int                 _volume = 100;
-    int                 _midiTranspose = 0;
-    int                 _midiTransposeTemp = 0;
+    int                 _songTranspose[DISPATCH_RINGS] = {};
+    QAtomicInt          _seqRing;   // dispatcher ring of _midiSeq
     int                 _seqIndex = 0;
     int                 _medleyBPM = 120;
+    int                 _medleyCrossfadeBars = 0;
+    int                 _medleyTempoRampBars = 0;
+    // dispatcher thread, the ring of the song that last played a note
+    // on the channel and the gain its volume was sent with
+    quint8              _channelRing[16] = {};
+    float               _sentGains[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
     bool                _useMedley = false;
     bool                _useSolo = false;
+    bool                _useEventClock = false;
+    int                 _eventClockLookaheadMs = 20;
 
     QString _medleyId = "";
 
-    MidiEvent   _tempEvent, _midiInEvent;
-    MidiEvent*  _playingEventPtr = nullptr;
+    MidiEvent   _midiInEvent;
 
     bool    _lockDrum  = false;
     bool    _lockSnare = false;
@@ -0,0 +1,338 @@
+#include "MidiRenderer.h"
+#include "MidiPlayer.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <cstring>
+
+#define RENDER_SAMPLE_RATE  44100
+#define RENDER_CHANNELS     2
+#define RENDER_BLOCK_FRAMES 4096
+
+MidiRenderer::MidiRenderer(MidiPlayer *player, QObject *parent) : QThread(parent)
+{
+    _player = player;
+    _synth = player->midiSynthesizer();
+    resetStats();
+
+    connect(this, SIGNAL(finished()), this, SLOT(onJobsFinished()));
+}
+
+MidiRenderer::~MidiRenderer()
+{
+    wait();
+}
+
+void MidiRenderer::addJob(const QString &midiFile, const QString &wavFile)
+{
+    RenderJob job;
+    job.midiFile = midiFile;
+    job.wavFile = wavFile;
+
+    _mutex.lock();
+    _jobs.append(job);
+    _mutex.unlock();
+}
+
+void MidiRenderer::addJob(const QByteArray &midiData, const QString &wavFile)
+{
+    RenderJob job;
+    job.midiData = midiData;
+    job.wavFile = wavFile;
+
+    _mutex.lock();
+    _jobs.append(job);
+    _mutex.unlock();
+}
+
+void MidiRenderer::clearJobs()
+{
+    _mutex.lock();
+    _jobs.clear();
+    _mutex.unlock();
+}
+
+int MidiRenderer::jobCount()
+{
+    _mutex.lock();
+    int count = _jobs.count();
+    _mutex.unlock();
+
+    return count;
+}
+
+bool MidiRenderer::startJobs()
+{
+    if (isRunning() || _player->isPlayerPlaying())
+        return false;
+
+    // switched here and not on the render thread, the player checks
+    // it before it starts
+    _wasOffline = _synth->isOfflineMode();
+    _synth->setOfflineMode(true);
+    _jobsOffline = true;
+
+    start();
+
+    return true;
+}
+
+void MidiRenderer::waitForJobs()
+{
+    wait();
+    onJobsFinished();
+}
+
+bool MidiRenderer::render(const QString &midiFile, const QString &wavFile)
+{
+    if (isRunning() || _player->isPlayerPlaying())
+        return false;
+
+    RenderJob job;
+    job.midiFile = midiFile;
+    job.wavFile = wavFile;
+
+    bool wasOffline = _synth->isOfflineMode();
+    _synth->setOfflineMode(true);
+
+    bool result = renderSong(job);
+
+    _synth->setOfflineMode(wasOffline);
+
+    return result;
+}
+
+RenderStats MidiRenderer::stats()
+{
+    _mutex.lock();
+    RenderStats st = _stats;
+    _mutex.unlock();
+
+    return st;
+}
+
+void MidiRenderer::resetStats()
+{
+    _mutex.lock();
+    _stats.songs = 0;
+    _stats.failed = 0;
+    _stats.audioSeconds = 0;
+    _stats.renderSeconds = 0;
+    _mutex.unlock();
+}
+
+double MidiRenderer::realtimeFactor()
+{
+    RenderStats st = stats();
+    if (st.renderSeconds <= 0)
+        return 0;
+
+    return st.audioSeconds / st.renderSeconds;
+}
+
+void MidiRenderer::run()
+{
+    int done = 0;
+
+    while (true) {
+        _mutex.lock();
+        if (_jobs.isEmpty()) {
+            _mutex.unlock();
+            break;
+        }
+        RenderJob job = _jobs.takeFirst();
+        int total = done + _jobs.count() + 1;
+        _mutex.unlock();
+
+        bool result = renderSong(job);
+        done++;
+
+        emit songRendered(job.wavFile, result);
+        emit progress(done, total);
+    }
+}
+
+void MidiRenderer::onJobsFinished()
+{
+    // once, waitForJobs may have restored it before the queued finished()
+    if (!_jobsOffline)
+        return;
+
+    _jobsOffline = false;
+    _synth->setOfflineMode(_wasOffline);
+}
+
+bool MidiRenderer::renderSong(const RenderJob &job)
+{
+    MidiFile midi;
+    HSTREAM out = _synth->offlineHandle();
+
+    bool read = job.midiFile.isEmpty() ? midi.read(job.midiData, true) : midi.read(job.midiFile);
+
+    if (out == 0 || !read || midi.events().isEmpty()) {
+        _mutex.lock();
+        _stats.failed++;
+        _mutex.unlock();
+        return false;
+    }
+
+    QFile wav(job.wavFile);
+    if (!wav.open(QFile::WriteOnly)) {
+        _mutex.lock();
+        _stats.failed++;
+        _mutex.unlock();
+        return false;
+    }
+
+    writeWavHeader(&wav, 0);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // same starting state as MidiPlayer::play()
+    _synth->sendAllNotesOff();
+    _synth->sendResetAllControllers();
+    _synth->sendProgramChange(9, 0);
+
+    // Render up to each event and send it right there, the graph only
+    // decodes what is pulled so every event lands on its sample. The
+    // channels filter the events as they do when the player plays.
+    const MidiEventStore *store = midi.eventStore();
+    qint64 frames = 0;
+    bool ok = true;
+
+    for (int i=0; i<store->count() && ok; i++) {
+        int status = store->record(i).status;
+        if (status == 0xFF || status == 0xF7 || status == 0)
+            continue;
+
+        qint64 frame = midi.timeUsFromTick(store->tick(i), _bpmSpeed) * RENDER_SAMPLE_RATE / 1000000;
+        if (frame > frames) {
+            ok = renderFrames(out, &wav, frame - frames);
+            frames = frame;
+        }
+
+        MidiEvent e = store->event(i);
+        if (_player->filterEvent(&e, _transpose))
+            sendEvent(e);
+    }
+
+    // let releases and reverb ring out
+    _synth->sendAllNotesOff();
+    if (ok) {
+        qint64 tail = (qint64)(_tailMs) * RENDER_SAMPLE_RATE / 1000;
+        ok = renderFrames(out, &wav, tail);
+        frames += tail;
+    }
+
+    quint32 dataSize = wav.size() - 44;
+    wav.seek(0);
+    writeWavHeader(&wav, dataSize);
+    wav.close();
+
+    _mutex.lock();
+    if (ok) {
+        _stats.songs++;
+        _stats.audioSeconds += (double)(frames) / RENDER_SAMPLE_RATE;
+        _stats.renderSeconds += timer.nsecsElapsed() / 1000000000.0;
+    } else {
+        _stats.failed++;
+    }
+    _mutex.unlock();
+
+    return ok;
+}
+
+bool MidiRenderer::renderFrames(HSTREAM out, QFile *wav, qint64 frames)
+{
+    float buffer[RENDER_BLOCK_FRAMES * RENDER_CHANNELS];
+    QByteArray pcm;
+    pcm.resize(RENDER_BLOCK_FRAMES * RENDER_CHANNELS * 2);
+
+    while (frames > 0) {
+        int n = (frames > RENDER_BLOCK_FRAMES) ? RENDER_BLOCK_FRAMES : frames;
+        DWORD bytes = n * RENDER_CHANNELS * sizeof(float);
+
+        DWORD got = BASS_ChannelGetData(out, buffer, bytes | BASS_DATA_FLOAT);
+        if (got == (DWORD)-1)
+            return false;
+        if (got < bytes)
+            memset((char*)buffer + got, 0, bytes - got);
+
+        // float to 16 bit little endian
+        char *p = pcm.data();
+        for (int i=0; i<n * RENDER_CHANNELS; i++) {
+            int v = qRound(buffer[i] * 32767.0f);
+            if (v > 32767) v = 32767;
+            else if (v < -32768) v = -32768;
+            p[i*2] = v & 0xFF;
+            p[i*2 + 1] = (v >> 8) & 0xFF;
+        }
+
+        if (wav->write(pcm.constData(), n * RENDER_CHANNELS * 2) < 0)
+            return false;
+
+        frames -= n;
+    }
+
+    return true;
+}
+
+void MidiRenderer::sendEvent(const MidiEvent &e)
+{
+    int ch = e.channel();
+
+    switch (e.eventType()) {
+    case MidiEventType::NoteOff:
+        _synth->sendNoteOff(ch, e.data1(), e.data2());
+        break;
+    case MidiEventType::NoteOn:
+        _synth->sendNoteOn(ch, e.data1(), e.data2());
+        break;
+    case MidiEventType::NoteAftertouch:
+        _synth->sendNoteAftertouch(ch, e.data1(), e.data2());
+        break;
+    case MidiEventType::Controller:
+        _synth->sendController(ch, e.data1(), e.data2());
+        break;
+    case MidiEventType::ProgramChange:
+        _synth->sendProgramChange(ch, e.data1());
+        break;
+    case MidiEventType::ChannelAftertouch:
+        _synth->sendChannelAftertouch(ch, e.data1());
+        break;
+    case MidiEventType::PitchBend:
+        _synth->sendPitchBend(ch, e.data1());
+        break;
+    default:
+        break;
+    }
+}
+
+void MidiRenderer::writeWavHeader(QFile *wav, quint32 dataSize)
+{
+    const quint32 byteRate = RENDER_SAMPLE_RATE * RENDER_CHANNELS * 2;
+
+    QByteArray h;
+    h.reserve(44);
+
+    auto put16 = [&h](quint16 v) { h.append(v & 0xFF); h.append((v >> 8) & 0xFF); };
+    auto put32 = [&h](quint32 v) { for (int i=0; i<4; i++) h.append((v >> (i*8)) & 0xFF); };
+
+    h.append("RIFF");
+    put32(36 + dataSize);
+    h.append("WAVE");
+    h.append("fmt ");
+    put32(16);
+    put16(1);                       // PCM
+    put16(RENDER_CHANNELS);
+    put32(RENDER_SAMPLE_RATE);
+    put32(byteRate);
+    put16(RENDER_CHANNELS * 2);     // block align
+    put16(16);                      // bits per sample
+    h.append("data");
+    put32(dataSize);
+
+    wav->write(h);
+}
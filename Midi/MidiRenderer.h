@@ -0,0 +1,104 @@
+#ifndef MIDIRENDERER_H
+#define MIDIRENDERER_H
+
+#include <QThread>
+#include <QFile>
+#include <QStringList>
+#include <QMutex>
+
+#include "MidiFile.h"
+#include "MidiSynthesizer.h"
+
+class MidiPlayer;
+
+typedef struct
+{
+    int     songs;
+    int     failed;
+    double  audioSeconds;
+    double  renderSeconds;  // wall time spent rendering
+} RenderStats;
+
+typedef struct
+{
+    QString     midiFile;
+    QByteArray  midiData;   // decoded in memory (HNK) when midiFile is empty
+    QString     wavFile;
+} RenderJob;
+
+// Offline render of MIDI files to WAV through the synthesizer graph
+// (instrument map, bus groups, FX) and the channel filter of the player
+// (mute, solo, locks). The synthesizer is switched to offline mode while
+// rendering, nothing is rendered while the player plays and the player
+// doesn't start until it is done.
+class MidiRenderer : public QThread
+{
+    Q_OBJECT
+public:
+    explicit MidiRenderer(MidiPlayer *player, QObject *parent = nullptr);
+    ~MidiRenderer();
+
+    void addJob(const QString &midiFile, const QString &wavFile);
+    void addJob(const QByteArray &midiData, const QString &wavFile);
+    void clearJobs();
+    int jobCount();
+
+    // GUI thread, renders the jobs on this thread. False while the
+    // player plays or the jobs are already rendering.
+    bool startJobs();
+
+    // GUI thread, blocks until the jobs are done and gives the synthesizer
+    // back to the player now instead of in the queued finished()
+    void waitForJobs();
+
+    int bpmSpeed() { return _bpmSpeed; }
+    void setBpmSpeed(int sp) { _bpmSpeed = sp; }
+
+    int transpose() { return _transpose; }
+    void setTranspose(int t) { _transpose = t; }
+
+    int tailMs() { return _tailMs; }
+    void setTailMs(int ms) { _tailMs = ms; }
+
+    // blocking, render one file now, false while the player plays
+    bool render(const QString &midiFile, const QString &wavFile);
+
+    RenderStats stats();
+    void resetStats();
+
+    // seconds of audio per second of rendering
+    double realtimeFactor();
+
+signals:
+    void songRendered(const QString &wavFile, bool success);
+    void progress(int done, int total);
+
+protected:
+    void run();
+
+private slots:
+    void onJobsFinished();
+
+private:
+    bool renderSong(const RenderJob &job);
+    bool renderFrames(HSTREAM out, QFile *wav, qint64 frames);
+    void sendEvent(const MidiEvent &e);
+    void writeWavHeader(QFile *wav, quint32 dataSize);
+
+private:
+    MidiPlayer *_player;
+    MidiSynthesizer *_synth;
+    bool _wasOffline = false;
+    bool _jobsOffline = false;   // set by startJobs until the mode is restored
+
+    QList<RenderJob> _jobs;
+
+    int _bpmSpeed = 0;
+    int _transpose = 0;
+    int _tailMs = 2000;
+
+    RenderStats _stats;
+    QMutex _mutex;
+};
+
+#endif // MIDIRENDERER_H
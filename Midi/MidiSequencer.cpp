@@ -1,9 +1,12 @@
 #include "MidiSequencer.h"
 
+#include <cmath>
+
 MidiSequencer::MidiSequencer(QObject *parent) : QThread(parent)
 {
-    _midi = new MidiFile();
+    _midi = QSharedPointer<MidiFile>(new MidiFile());
     _eTimer = new QElapsedTimer();
+    _batch.reserve(256);
 }
 
 MidiSequencer::~MidiSequencer()
@@ -11,7 +14,6 @@ MidiSequencer::~MidiSequencer()
     stop();
 
     delete _eTimer;
-    delete _midi;
 }
 
 int MidiSequencer::beatCount()
@@ -31,7 +33,7 @@ int MidiSequencer::currentBeat()
 int MidiSequencer::positionTick()
 {
     if (_playing) {
-        return _midi->tickFromTimeMs(_eTimer->elapsed()  + _startPlayTime, _midiSpeed);
+        return _midi->tickFromTimeMs(_eTimer->elapsed()  + _startPlayTime, _midiSpeed, _singleTempo);
     } else {
         return _positionTick;
     }
@@ -39,17 +41,17 @@ int MidiSequencer::positionTick()
 
 int MidiSequencer::durationTick()
 {
-    return _midi->events().back()->tick();
+    return _midi->events().back().tick();
 }
 
 long MidiSequencer::positionMs()
 {
-    return _playing ? _midi->timeFromTick(positionTick()) * 1000 : _positionMs;
+    return _playing ? _midi->timeUsFromTick(positionTick(), 0, _singleTempo) / 1000 : _positionMs;
 }
 
 long MidiSequencer::durationMs()
 {
-    return _midi->timeFromTick(durationTick()) * 1000;
+    return _midi->timeUsFromTick(durationTick(), 0, _singleTempo) / 1000;
 }
 
 void MidiSequencer::setPositionTick(int t)
@@ -71,7 +73,7 @@ void MidiSequencer::setPositionTick(int t)
     _mutex.lock();
 
     _playedIndex = eventIndexFromTick(tick);
-    _startPlayTime = _midi->timeFromTick(tick, _midiSpeed) * 1000;
+    _startPlayTime = _midi->timeUsFromTick(tick, _midiSpeed, _singleTempo) / 1000;
     _positionMs = _startPlayTime;
     _positionTick = t;
 
@@ -86,9 +88,12 @@ void MidiSequencer::setBpmSpeed(int sp)
     if (sp == _midiSpeed)
         return;
 
-    if ((_midiBpm + sp) < 20 || (_midiBpm + sp) > 250)
+    if ((_midiBpm + sp) < SEQ_MIN_BPM || (_midiBpm + sp) > SEQ_MAX_BPM)
         return;
 
+    // built here, not on the playing thread
+    _midi->tempoMap(sp, _singleTempo);
+
     _mutex.lock();
 
     if (_playing) {
@@ -104,22 +109,55 @@ void MidiSequencer::setBpmSpeed(int sp)
 }
 
 bool MidiSequencer::load(const QString &file, bool seekFileChunkID)
+{
+    QSharedPointer<MidiFile> midi(new MidiFile());
+    if (!midi->read(file, seekFileChunkID)) {
+        if (!_stopped)
+            stop();
+        return false;
+    }
+
+    return load(midi);
+}
+
+bool MidiSequencer::load(const QByteArray &data, bool seekFileChunkID)
+{
+    QSharedPointer<MidiFile> midi(new MidiFile());
+    if (!midi->read(data, seekFileChunkID)) {
+        if (!_stopped)
+            stop();
+        return false;
+    }
+
+    return load(midi);
+}
+
+bool MidiSequencer::load(const QSharedPointer<MidiFile> &midi)
 {
     if (!_stopped)
         stop();
 
-    if (!_midi->read(file, seekFileChunkID))
+    if (midi.isNull() || midi->events().count() == 0)
         return false;
 
+    _midi = midi;
+
     _midiSpeed = 0;
     _midiSpeedTemp = 0;
     _midiChangeBpmSpeed = false;
-    _endTick = _midi->events().last()->tick();
+    _endTick = _midi->events().last().tick();
+    _endIndex = -1;
 
     _finished = false;
+    _chained = false;
+    _rampTicks = 0;
+    _fadeInTicks = 0;
+    _fadeOutTicks = 0;
+
+    resetTimingStats();
 
     if (_midi->tempoEvents().count() > 0) {
-        _midiBpm = _midi->tempoEvents()[0]->bpm();
+        _midiBpm = _midi->eventStore()->bpm(_midi->tempoEvents().index(0));
     } else {
         _midiBpm = 120;
     }
@@ -146,7 +184,7 @@ void MidiSequencer::stop(bool resetPos)
     if (resetPos) {
         _mutex.lock();
         _stopped = true;
-        _startPlayTime = _midi->timeFromTick(_startTick, _midiSpeed) * 1000;;
+        _startPlayTime = _midi->timeUsFromTick(_startTick, _midiSpeed, _singleTempo) / 1000;
         _startPlayIndex = eventIndexFromTick(_startTick);
         _playedIndex = _startPlayIndex;
         _positionMs = _startPlayTime;
@@ -161,7 +199,7 @@ void MidiSequencer::setStartTick(int tick)
 
     if (_stopped) {
         _mutex.lock();
-        _startPlayTime = _midi->timeFromTick(tick, _midiSpeed) * 1000;
+        _startPlayTime = _midi->timeUsFromTick(tick, _midiSpeed, _singleTempo) / 1000;
         _startPlayIndex = eventIndexFromTick(tick);
         _playedIndex = _startPlayIndex;
         _positionMs = _startPlayTime;
@@ -173,44 +211,15 @@ void MidiSequencer::setStartTick(int tick)
 void MidiSequencer::setEndTick(int tick)
 {
     if (tick == 0) {
+        _mutex.lock();
         _endTick = 0;
-        if (_endEvent != nullptr) {
-            _midi->takeEvent(_endEventIndex);
-            delete _endEvent;
-            _endEvent = nullptr;
-            _endEventIndex = 0;
-        }
+        _endIndex = -1;
+        _mutex.unlock();
     } else if (tick > _startTick) {
+        _mutex.lock();
         _endTick = tick;
-        if (_endEvent == nullptr) {
-            _endEvent = new MidiEvent();
-        } else {
-            _midi->takeEvent(_endEventIndex);
-        }
-        _endEvent->setTick(tick);
-
-        MidiEvent *halfEvent = _midi->events()[ _midi->events().size() / 2 ];
-
-        int index;
-
-        if (tick >= halfEvent->tick()) {
-            index = _midi->events().size() - 1;
-            for (int i = index; i >= 0; i--) {
-                index = i;
-                if (_midi->events()[i]->tick() < tick)
-                    break;
-            }
-        } else {
-            index = 0;
-            for (int i = index; i < _midi->events().size(); i++) {
-                index = i;
-                if (_midi->events()[i]->tick() >= tick)
-                    break;
-            }
-        }
-
-        _endEventIndex = index;
-        _midi->insertEvent(_endEventIndex, _endEvent);
+        _endIndex = eventIndexFromTick(tick);
+        _mutex.unlock();
     }
 }
 
@@ -233,6 +242,104 @@ int MidiSequencer::currentBar()
     return _midi->barFromTick(positionTick());
 }
 
+int MidiSequencer::endTick()
+{
+    if (_endIndex >= 0 && _endTick > 0)
+        return _endTick;
+
+    return _midi->events().last().tick();
+}
+
+void MidiSequencer::setSingleTempo(bool single)
+{
+    // built here, not on the playing thread
+    _midi->tempoMap(_midiSpeed, single);
+
+    _mutex.lock();
+    _singleTempo = single;
+    _mutex.unlock();
+}
+
+void MidiSequencer::setChainStart(const QElapsedTimer &clock, qint64 offsetUs)
+{
+    _mutex.lock();
+    _chained = true;
+    _chainClock = clock;
+    _chainOffsetUs = offsetUs;
+    _mutex.unlock();
+}
+
+void MidiSequencer::setTempoRamp(int ticks, int targetSpeed)
+{
+    if (ticks > 0) {
+        for (int sp=qMin(_midiSpeed, targetSpeed); sp<=qMax(_midiSpeed, targetSpeed); sp++)
+            _midi->tempoMap(sp, _singleTempo);
+    }
+
+    _mutex.lock();
+    _rampTicks = qMax(0, ticks);
+    _rampFromSpeed = _midiSpeed;
+    _rampToSpeed = targetSpeed;
+    _mutex.unlock();
+}
+
+void MidiSequencer::setFadeIn(int ticks)
+{
+    _mutex.lock();
+    _fadeInTicks = qMax(0, ticks);
+    _mutex.unlock();
+}
+
+void MidiSequencer::setFadeOut(int ticks)
+{
+    _mutex.lock();
+    _fadeOutTicks = qMax(0, ticks);
+    _mutex.unlock();
+}
+
+void MidiSequencer::checkFadeOut(uint32_t tick, qint64 startUs, qint64 eventUs)
+{
+    if (_fadeOutSignalled || _fadeOutTicks <= 0)
+        return;
+
+    int fadeTick = endTick() - _fadeOutTicks;
+    if ((int)tick < fadeTick)
+        return;
+
+    // after a seek into the fade the next song starts now, not in the past
+    _fadeOutSignalled = true;
+    qint64 fadeUs = _midi->timeUsFromTick(fadeTick, _midiSpeed, _singleTempo) - startUs;
+    emit fadeOutStarted(qMax(fadeUs, eventUs));
+}
+
+int MidiSequencer::rampSpeed(uint32_t tick)
+{
+    int end = endTick();
+    int from = end - _rampTicks;
+    if (_rampTicks <= 0 || (int)tick <= from)
+        return _midiSpeed;
+
+    if ((int)tick >= end)
+        return _rampToSpeed;
+
+    double r = (double)((int)tick - from) / _rampTicks;
+    return qRound(_rampFromSpeed + (_rampToSpeed - _rampFromSpeed) * r);
+}
+
+float MidiSequencer::gain(uint32_t tick)
+{
+    float g = 1.0f;
+
+    if (_fadeInTicks > 0 && (int)tick < _startTick + _fadeInTicks)
+        g = qMax(0, (int)tick - _startTick) / (float)_fadeInTicks;
+
+    int end = endTick();
+    if (_fadeOutTicks > 0 && (int)tick > end - _fadeOutTicks)
+        g = qMin(g, qMax(0, end - (int)tick) / (float)_fadeOutTicks);
+
+    return g;
+}
+
 void MidiSequencer::run()
 {
     if (_playing)
@@ -244,65 +351,100 @@ void MidiSequencer::run()
     _stopped = false;
     _finished = false;
 
+    bool chained = _chained;
+    _chained = false;
+
+    // the state before the cut start goes out at the chain point,
+    // not over the end of the previous song
+    _eventTimeUs = (chained && _lookaheadUs > 0) ? _chainOffsetUs : -1;
+    _eventGain = 1.0f;
+    _fadeOutSignalled = false;
+
     _mutex.unlock();
 
+    const MidiEventStore *store = _midi->eventStore();
+    int firstTempoIndex = _midi->tempoEvents().isEmpty() ? -1 : _midi->tempoEvents().index(0);
+
     if (_positionTick <= _startTick) {
-        for (MidiEvent *e : _midi->events()) {
-            if (e->tick() >= _startTick)
+        for (int i = 0; i < store->count(); i++) {
+            if (store->tick(i) >= _startTick)
                 break;
-            if (e->eventType() != MidiEventType::Meta)
-                switch (e->eventType()) {
-                case MidiEventType::NoteOff:
-                case MidiEventType::NoteOn:
+            if (!store->isMeta(i))
+                switch (store->record(i).status & 0xF0) {
+                case 0x80: // NoteOff
+                case 0x90: // NoteOn
                     break;
                 default:
-                    emit playingEvent(*e);
+                    emit playingEvent(store->event(i));
                 }
-            else if (e->metaEventType() == MidiMetaType::SetTempo) {
-                if (_midi->isSingleTempo() && (e != _midi->tempoEvents()[0]))
+            else if (store->isTempo(i)) {
+                if (_singleTempo && (i != firstTempoIndex))
                     continue;
-                _midiBpm = e->bpm();
+                _midiBpm = store->bpm(i);
                 emit bpmChanged(_midiBpm + _midiSpeed);
             }
         }
     }
 
-    bool seqEnded = false;
+    if (chained) {
+        // same clock as the previous song, the output keeps its mapping
+        *_eTimer = _chainClock;
+        _clockStartUs = _midi->timeUsFromTick(_positionTick, _midiSpeed, _singleTempo) - _chainOffsetUs;
+        _startPlayTime = _clockStartUs / 1000;
+    } else {
+        _eTimer->restart();
+        _clockStartUs = (qint64)(_startPlayTime) * 1000;
+        emit clockStarted();
+    }
 
-    _eTimer->restart();
+    bool seqEnded = _preciseTiming ? playEventsPrecise() : playEvents();
 
-    for (int i = _playedIndex; i < _midi->events().count(); i++) {
+    _eventTimeUs = -1;
+
+    if (seqEnded || (_playedIndex == store->count() -1)) {
+        _mutex.lock();
+        _finished = true;
+        _mutex.unlock();
+    }
+}
+
+bool MidiSequencer::playEvents()
+{
+    const MidiEventStore *store = _midi->eventStore();
+    int firstTempoIndex = _midi->tempoEvents().isEmpty() ? -1 : _midi->tempoEvents().index(0);
+
+    for (int i = _playedIndex; i < store->count(); i++) {
 
         if (!_playing)
             break;
 
-        if ((_endEvent != nullptr) && (_endTick > 0) && _midi->events()[i]->tick() >= _endEvent->tick()) {
-            MidiEvent evt;
-            evt.setEventType(MidiEventType::Controller);
-            evt.setData1(123);
-            evt.setData2(0);
-            for (int ch = 0; ch < 16; ch++) {
-                evt.setChannel(ch);
-                emit playingEvent(evt);
-            }
-            seqEnded = true;
-            break;
+        if (isCutEnd(i)) {
+            _clockEndUs = _midi->timeUsFromTick(_endTick, _midiSpeed, _singleTempo) - (qint64)(_startPlayTime) * 1000;
+            sendAllNotesOff();
+            return true;
         }
 
         _mutex.lock();
 
-        if (_midi->events()[i]->eventType() != MidiEventType::Meta) {
+        if (!store->isMeta(i)) {
+
+            uint32_t tick = store->tick(i);
 
-            uint32_t tick = _midi->events()[i]->tick();
+            int sp = rampSpeed(tick);
+            if (sp != _midiSpeed && !_midiChangeBpmSpeed) {
+                _midiSpeedTemp = sp;
+                _midiChangeBpmSpeed = true;
+                emit bpmChanged(_midiBpm + sp);
+            }
 
             if (_midiChangeBpmSpeed) {
                 _midiChangeBpmSpeed = false;
                 _midiSpeed = _midiSpeedTemp;
-                _startPlayTime = _midi->timeFromTick(_midi->events()[i-1]->tick(), _midiSpeed) * 1000;
+                _startPlayTime = _midi->timeUsFromTick(store->tick(i-1), _midiSpeed, _singleTempo) / 1000;
                 _eTimer->restart();
             }
 
-            long eventTime = (_midi->timeFromTick(tick, _midiSpeed)  * 1000);
+            long eventTime = _midi->timeUsFromTick(tick, _midiSpeed, _singleTempo) / 1000;
             long waitTime = eventTime - _startPlayTime  - _eTimer->elapsed();
 
             if (waitTime > 0) {
@@ -310,47 +452,277 @@ void MidiSequencer::run()
                 _waitCondition.wait(&_mutex, waitTime);
             }
 
+            recordTiming(_eTimer->nsecsElapsed() / 1000 - (eventTime - _startPlayTime) * 1000);
+
             _positionMs = eventTime;
+            _clockEndUs = (qint64)(eventTime - _startPlayTime) * 1000;
+            _eventGain = gain(tick);
+            checkFadeOut(tick, (qint64)(_startPlayTime) * 1000, _clockEndUs);
 
 
         } else { // Meta event
-            if (_midi->events()[i]->metaEventType() == MidiMetaType::SetTempo) {
-                if (_midi->isSingleTempo() && (_midi->events()[i] != _midi->tempoEvents()[0])) {
+            if (store->isTempo(i)) {
+                if (_singleTempo && (i != firstTempoIndex)) {
                     _playedIndex = i;
-                    _positionTick = _midi->events()[i]->tick();
+                    _positionTick = store->tick(i);
                     _mutex.unlock();
                     continue;
                 }
-                _midiBpm = _midi->events()[i]->bpm();
+                _midiBpm = store->bpm(i);
                 emit bpmChanged(_midiBpm + _midiSpeed);
             }
         }
 
-        emit playingEvent(*_midi->events()[i]);
+        emit playingEvent(store->event(i));
 
         _playedIndex = i;
-        _positionTick = _midi->events()[i]->tick();
+        _positionTick = store->tick(i);
 
         _mutex.unlock();
 
     } // End for loop
 
-    if (seqEnded || (_playedIndex == _midi->events().size() -1)) {
+    return false;
+}
+
+bool MidiSequencer::playEventsPrecise()
+{
+    const MidiEventStore *store = _midi->eventStore();
+    int firstTempoIndex = _midi->tempoEvents().isEmpty() ? -1 : _midi->tempoEvents().index(0);
+
+    // event times are relative to this point of the song,
+    // the same reference _eTimer was restarted at
+    qint64 startUs = _clockStartUs;
+
+    int i = _playedIndex;
+
+    // clock time of the last dispatched event, a tempo ramp continues from it
+    uint32_t lastTick = store->tick(i > 0 ? i-1 : 0);
+    qint64 lastUs = _midi->timeUsFromTick(lastTick, _midiSpeed, _singleTempo) - startUs;
+
+    while (i < store->count()) {
+
+        if (!_playing)
+            break;
+
+        if (isCutEnd(i)) {
+            _clockEndUs = _midi->timeUsFromTick(_endTick, _midiSpeed, _singleTempo) - startUs;
+            _eventTimeUs = (_lookaheadUs > 0) ? _clockEndUs : -1;
+            sendAllNotesOff();
+            return true;
+        }
+
         _mutex.lock();
-        _finished = true;
+
+        if (_midiChangeBpmSpeed) {
+            // Re-anchored at the clock time the last event was scheduled
+            // for, not at now: with lookahead it is queued ahead, and the
+            // next events must not be scheduled before it.
+            _midiChangeBpmSpeed = false;
+            _midiSpeed = _midiSpeedTemp;
+            startUs = _midi->timeUsFromTick(lastTick, _midiSpeed, _singleTempo) - lastUs;
+            _startPlayTime = startUs / 1000;
+        }
+
+        qint64 dueUs = _midi->timeUsFromTick(store->tick(i), _midiSpeed, _singleTempo) - startUs;
+        int lookaheadUs = _lookaheadUs;
+
+        _mutex.unlock();
+
+        waitUntil(dueUs - lookaheadUs);
+
+        if (!_playing)
+            break;
+
+        // one wake up dispatches every event due before the end of the window
+        qint64 nowUs = _eTimer->nsecsElapsed() / 1000;
+        qint64 windowEndUs = nowUs + _schedulerWindowUs + lookaheadUs;
+
+        _mutex.lock();
+
+        for (; i < store->count(); i++) {
+
+            if (isCutEnd(i))
+                break;
+
+            uint32_t tick = store->tick(i);
+
+            int sp = rampSpeed(tick);
+            if (sp != _midiSpeed) {
+                // re-anchor at the last event, the song time goes on from there
+                _midiSpeed = sp;
+                _midiSpeedTemp = sp;
+                startUs = _midi->timeUsFromTick(lastTick, _midiSpeed, _singleTempo) - lastUs;
+                _startPlayTime = startUs / 1000;
+                emit bpmChanged(_midiBpm + _midiSpeed);
+            }
+
+            qint64 eventUs = _midi->timeUsFromTick(tick, _midiSpeed, _singleTempo) - startUs;
+            if (eventUs > windowEndUs)
+                break;
+
+            lastTick = tick;
+            lastUs = eventUs;
+            _clockEndUs = eventUs;
+            checkFadeOut(tick, startUs, eventUs);
+
+            if (store->isTempo(i)) {
+                if (!_singleTempo || (i == firstTempoIndex)) {
+                    _midiBpm = store->bpm(i);
+                    emit bpmChanged(_midiBpm + _midiSpeed);
+                }
+            } else if (!store->isMeta(i)) {
+                SequencedEvent se;
+                se.index = i;
+                se.timeUs = (lookaheadUs > 0) ? eventUs : -1;
+                se.gain = gain(tick);
+                _batch.append(se);
+            }
+
+            if (!store->isMeta(i)) {
+                // events in the first lookahead can not be sent earlier than the start
+                qint64 sendUs = eventUs - lookaheadUs;
+                if (lookaheadUs > 0 && sendUs < 0)
+                    sendUs = 0;
+                recordTiming(nowUs - sendUs);
+                _positionMs = (eventUs + startUs) / 1000;
+            }
+
+            _playedIndex = i;
+            _positionTick = tick;
+        }
+
+        // the whole window in one call, the output takes it from the store
+        if (!_batch.isEmpty()) {
+            emit playingEvents(store, _batch.constData(), _batch.count());
+            _batch.clear();
+        }
+
         _mutex.unlock();
     }
+
+    return false;
 }
 
-int MidiSequencer::eventIndexFromTick(int tick)
+void MidiSequencer::waitUntil(qint64 elapsedUs)
 {
-    int index = 0;
-    for (MidiEvent *e :_midi->events()) {
-        if (e->tick() >= tick)
-            break;
+    // Sleep while the target is far away, the wait condition only has
+    // millisecond resolution and may oversleep, so the rest is spun.
+    qint64 remainUs = elapsedUs - _eTimer->nsecsElapsed() / 1000;
+
+    while (remainUs > _spinUs && _playing) {
+        _mutex.lock();
+        if (_playing)
+            _waitCondition.wait(&_mutex, (remainUs - _spinUs) / 1000 + 1);
+        _mutex.unlock();
 
-        index++;
+        remainUs = elapsedUs - _eTimer->nsecsElapsed() / 1000;
     }
 
-    return index;
+    while (_playing && _eTimer->nsecsElapsed() / 1000 < elapsedUs)
+        QThread::yieldCurrentThread();
+}
+
+bool MidiSequencer::isCutEnd(int index)
+{
+    return (_endIndex >= 0) && (_endTick > 0) && (index >= _endIndex);
+}
+
+void MidiSequencer::sendAllNotesOff()
+{
+    MidiEvent evt;
+    evt.setEventType(MidiEventType::Controller);
+    evt.setData1(123);
+    evt.setData2(0);
+    for (int ch = 0; ch < 16; ch++) {
+        evt.setChannel(ch);
+        emit playingEvent(evt);
+    }
+}
+
+void MidiSequencer::recordTiming(qint64 errorUs)
+{
+    _timingCount++;
+    _timingSumUs += errorUs;
+    _timingSumSqUs += (double)errorUs * errorUs;
+
+    if (errorUs > _timingMaxLateUs)
+        _timingMaxLateUs = errorUs;
+    if (-errorUs > _timingMaxEarlyUs)
+        _timingMaxEarlyUs = -errorUs;
+    if (qAbs(errorUs) > _jitterTargetUs)
+        _timingOverTarget++;
+}
+
+SchedulerStats MidiSequencer::timingStats()
+{
+    SchedulerStats st;
+
+    _mutex.lock();
+
+    st.events = _timingCount;
+    st.meanErrorUs = 0;
+    st.stdDevUs = 0;
+    st.maxLateUs = _timingMaxLateUs;
+    st.maxEarlyUs = _timingMaxEarlyUs;
+    st.overTargetEvents = _timingOverTarget;
+    st.targetUs = _jitterTargetUs;
+
+    if (_timingCount > 0) {
+        double mean = (double)_timingSumUs / _timingCount;
+        double variance = _timingSumSqUs / _timingCount - mean * mean;
+        st.meanErrorUs = qRound64(mean);
+        st.stdDevUs = qRound64(std::sqrt(qMax(0.0, variance)));
+    }
+
+    _mutex.unlock();
+
+    return st;
+}
+
+void MidiSequencer::resetTimingStats()
+{
+    _mutex.lock();
+
+    _timingCount = 0;
+    _timingSumUs = 0;
+    _timingSumSqUs = 0;
+    _timingMaxLateUs = 0;
+    _timingMaxEarlyUs = 0;
+    _timingOverTarget = 0;
+
+    _mutex.unlock();
+}
+
+void MidiSequencer::setPreciseTiming(bool precise)
+{
+    _mutex.lock();
+    _preciseTiming = precise;
+    _mutex.unlock();
+}
+
+void MidiSequencer::setSchedulerWindow(int us)
+{
+    _mutex.lock();
+    _schedulerWindowUs = qMax(0, us);
+    _mutex.unlock();
+}
+
+void MidiSequencer::setLookahead(int us)
+{
+    _mutex.lock();
+    _lookaheadUs = qMax(0, us);
+    _mutex.unlock();
+}
+
+void MidiSequencer::setJitterTarget(int us)
+{
+    _mutex.lock();
+    _jitterTargetUs = qMax(0, us);
+    _mutex.unlock();
+}
+
+int MidiSequencer::eventIndexFromTick(int tick)
+{
+    return _midi->eventStore()->lowerBound(tick);
 }
@@ -5,9 +5,35 @@
 #include <QElapsedTimer>
 #include <QWaitCondition>
 #include <QMutex>
+#include <QSharedPointer>
 
 #include "MidiFile.h"
 
+// the bpm setBpmSpeed() accepts, tempo + speed
+#define SEQ_MIN_BPM     20
+#define SEQ_MAX_BPM     250
+
+// Timing error of dispatched events against their song time,
+// positive = late, negative = early
+typedef struct
+{
+    int     events;
+    qint64  meanErrorUs;
+    qint64  stdDevUs;
+    qint64  maxLateUs;
+    qint64  maxEarlyUs;
+    int     overTargetEvents;  // |error| above targetUs
+    int     targetUs;
+} SchedulerStats;
+
+// An event of the store dispatched in a window of the precise mode
+typedef struct
+{
+    int     index;      // in the event store
+    qint64  timeUs;     // clock time, -1 = send now
+    float   gain;       // medley fade
+} SequencedEvent;
+
 class MidiSequencer : public QThread
 {
     Q_OBJECT
@@ -15,7 +41,7 @@ public:
     explicit MidiSequencer(QObject *parent = nullptr);
     ~MidiSequencer();
 
-    MidiFile* midiFile() { return _midi; }
+    MidiFile* midiFile() { return _midi.data(); }
 
     bool isSeqFinished() { return _finished; }
     bool isSeqPlaying() { return _playing; }
@@ -35,8 +61,18 @@ public:
     void setPositionTick(int t);
     void setBpmSpeed(int sp);
 
+    // Medley: the first tempo for the whole song. Kept here, the
+    // MidiFile may be shared with the song cache.
+    bool isSingleTempo() { return _singleTempo; }
+    void setSingleTempo(bool single);
+
 
     bool load(const QString &file, bool seekFileChunkID = false);
+    bool load(const QByteArray &data, bool seekFileChunkID = false);
+
+    // already parsed, may be shared with the song cache
+    bool load(const QSharedPointer<MidiFile> &midi);
+
     void stop(bool resetPos = false);
 
     void setStartTick(int tick);
@@ -45,13 +81,64 @@ public:
     void setCutStartBar(int bar);
     void setCutEndBar(int bar);
 
+    int startTick() { return _startTick; }
+    // the cut end or the last event
+    int endTick();
+
     int currentBar();
 
+    // precise: wake once per window, dispatch a batch, sleep then spin
+    bool isPreciseTiming() { return _preciseTiming; }
+    void setPreciseTiming(bool precise);
+    int schedulerWindow() { return _schedulerWindowUs; }
+    void setSchedulerWindow(int us);
+    void setJitterTarget(int us);
+
+    // precise only: events are dispatched this much ahead of time
+    // together with eventTimeUs(), for an output that queues them
+    int lookahead() { return _lookaheadUs; }
+    void setLookahead(int us);
+
+    // time of the dispatching event on the clock started with clockStarted(),
+    // valid inside playingEvent(), -1 = send now
+    qint64 eventTimeUs() { return _eventTimeUs; }
+
+    // Medley: start on the clock of the previous song at offsetUs of
+    // that clock, the first events follow its last ones without a gap
+    void setChainStart(const QElapsedTimer &clock, qint64 offsetUs);
+    QElapsedTimer clock() { return *_eTimer; }
+
+    // clock time of the end of the song, valid after finished
+    qint64 clockEndUs() { return _clockEndUs; }
+
+    // bpm speed moves to targetSpeed over the last ticks before endTick()
+    void setTempoRamp(int ticks, int targetSpeed);
+
+    // gain from 0 over the first ticks after startTick(),
+    // to 0 over the last ticks before endTick()
+    void setFadeIn(int ticks);
+    void setFadeOut(int ticks);
+    int fadeOutTicks() { return _fadeOutTicks; }
+
+    // gain of the dispatching event, valid inside playingEvent()
+    float eventGain() { return _eventGain; }
+
+    // reset on load
+    SchedulerStats timingStats();
+    void resetTimingStats();
+
 public slots:
 
 signals:
     void bpmChanged(int bpm);
     void playingEvent(MidiEvent e);
+    // precise mode, the channel events of one window of store,
+    // valid only inside a direct connection
+    void playingEvents(const MidiEventStore *store, const SequencedEvent *events, int count);
+    void clockStarted();
+    // once per play from the playing thread, the fade out begins at
+    // clockUs, the next song of a medley fades in from there
+    void fadeOutStarted(qint64 clockUs);
 
 protected:
     void run();
@@ -59,8 +146,18 @@ protected:
 private:
     int eventIndexFromTick(int tick);
 
+    bool playEvents();
+    bool playEventsPrecise();
+    void waitUntil(qint64 elapsedUs);
+    bool isCutEnd(int index);
+    void sendAllNotesOff();
+    void recordTiming(qint64 errorUs);
+    int rampSpeed(uint32_t tick);
+    float gain(uint32_t tick);
+    void checkFadeOut(uint32_t tick, qint64 startUs, qint64 eventUs);
+
 private:
-    MidiFile *_midi;
+    QSharedPointer<MidiFile> _midi;
     QElapsedTimer *_eTimer;
 
     int     _midiBpm = 120;
@@ -80,8 +177,37 @@ private:
 
     int _startTick = 0;
     int _endTick = 0;
-    int _endEventIndex = 0;
-    MidiEvent *_endEvent = nullptr;
+    int _endIndex = -1; // first event index after the cut, -1 = no cut
+
+    bool    _preciseTiming = true;
+    int     _schedulerWindowUs = 1000;
+    int     _spinUs = 2000;
+    int     _jitterTargetUs = 1000;
+    int     _lookaheadUs = 0;
+    qint64  _eventTimeUs = -1;
+    float   _eventGain = 1.0f;
+    QVector<SequencedEvent> _batch;
+
+    bool    _chained = false;
+    QElapsedTimer _chainClock;
+    qint64  _chainOffsetUs = 0;
+    qint64  _clockStartUs = 0;  // song time at clock 0
+    qint64  _clockEndUs = 0;
+
+    int     _rampTicks = 0;
+    int     _rampFromSpeed = 0;
+    int     _rampToSpeed = 0;
+    int     _fadeInTicks = 0;
+    int     _fadeOutTicks = 0;
+    bool    _fadeOutSignalled = false;
+    bool    _singleTempo = false;
+
+    int     _timingCount = 0;
+    qint64  _timingSumUs = 0;
+    double  _timingSumSqUs = 0;
+    qint64  _timingMaxLateUs = 0;
+    qint64  _timingMaxEarlyUs = 0;
+    int     _timingOverTarget = 0;
 
     QWaitCondition _waitCondition;
     QMutex _mutex;
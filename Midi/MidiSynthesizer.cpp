@@ -9,6 +9,8 @@
 #include "BASSFX/ReverbFX.h"
 #include "BASSFX/VSTFX.h"
 
+#include <QThread>
+
 #include <cstring>
 
 QMap<int, QString> MidiSynthesizer::outDevices;
@@ -29,6 +31,7 @@ MidiSynthesizer::MidiSynthesizer(QObject *parent) : QObject(parent)
         mixer.eq = new Equalizer31BandFX(0, 1);
         mixer.chorus = new Chorus2FX(0, 2);
         mixer.reverb = new Reverb2FX(0, 3);
+        mixer.meter = new LevelMeter();
 
         mixers.append(mixer);
     }
@@ -78,6 +81,7 @@ MidiSynthesizer::MidiSynthesizer(QObject *parent) : QObject(parent)
         instMap[t] = im;
 
         handles[t] = 0;
+        meters[t] = new LevelMeter();
     }
 
     for (int i=0; i<16; i++)
@@ -85,6 +89,19 @@ MidiSynthesizer::MidiSynthesizer(QObject *parent) : QObject(parent)
         chInstType[i] = InstrumentType::Piano;
     }
     chInstType[9] = InstrumentType::PercussionEtc;
+
+    for (int note=0; note<128; note++)
+        drumInstType[note] = MidiHelper::getInstrumentDrumType(note);
+
+    for (RouteTable &table : routeTables) {
+        table.eventClock = false;
+        for (NoteRoute &r : table.streams) {
+            r.handle = 0;
+            r.clockPos = 0;
+        }
+    }
+
+    updateRoutes();
 }
 
 MidiSynthesizer::~MidiSynthesizer()
@@ -108,6 +125,10 @@ MidiSynthesizer::~MidiSynthesizer()
             delete fx;
     }
 
+    for (LevelMeter *m : meters.values())
+        delete m;
+    meters.clear();
+
 
     // free mixer fx
     for (MixerHandle mixer : mixers)
@@ -115,6 +136,7 @@ MidiSynthesizer::~MidiSynthesizer()
         delete mixer.eq;
         delete mixer.reverb;
         delete mixer.chorus;
+        delete mixer.meter;
     }
     mixers.clear();
 
@@ -136,18 +158,27 @@ bool MidiSynthesizer::open()
 
     DWORD f = useFloat ? BASS_SAMPLE_FLOAT : 0;
 
+    // offline, all device mixers are summed to one stereo decode stream
+    if (offline)
+        offlineMixer = BASS_Mixer_StreamCreate(44100, 2, BASS_SAMPLE_FLOAT|BASS_STREAM_DECODE|BASS_MIXER_NONSTOP);
+
     // create mixer, bus
     for (int i=0; i<mixers.count(); i++)
     {
         MixerHandle mixer = mixers[i];
-        mixer.handle = BASS_Mixer_StreamCreate(44100, 8, f);
+        mixer.handle = BASS_Mixer_StreamCreate(44100, 8, offline ? f|BASS_STREAM_DECODE : f);
         mixer.eq->setStreamHandle(mixer.handle);
         mixer.reverb->setStreamHandle(mixer.handle);
         mixer.chorus->setStreamHandle(mixer.handle);
-
-        DWORD device = (i == 0) ? defaultDev : outDevices.keys()[i];
-        BASS_ChannelSetDevice(mixer.handle, device);
-        BASS_ChannelPlay(mixer.handle, false);
+        mixer.meter->setStreamHandle(mixer.handle);
+
+        if (offline) {
+            BASS_Mixer_StreamAddChannel(offlineMixer, mixer.handle, BASS_MIXER_DOWNMIX);
+        } else {
+            DWORD device = (i == 0) ? defaultDev : outDevices.keys()[i];
+            BASS_ChannelSetDevice(mixer.handle, device);
+            BASS_ChannelPlay(mixer.handle, false);
+        }
 
         mixers[i] = mixer;
     }
@@ -172,11 +203,14 @@ bool MidiSynthesizer::open()
         // Set fx to stream handle
         for (FX *fx : instMap[t].FXs)
             fx->setStreamHandle(handles[t]);
+
+        meters[t]->setStreamHandle(handles[t]);
     }
 
     setSfToStream();
     setSoundfontPresets(sfPreset);
     setVolume(synth_volume);
+    updateRoutes();
 
     return true;
 }
@@ -197,6 +231,9 @@ void MidiSynthesizer::close()
         }
     }
 
+    for (LevelMeter *m : meters.values())
+        m->setStreamHandle(0);
+
     // clear handles
     for (InstrumentType t: handles.keys())
     {
@@ -233,6 +270,7 @@ void MidiSynthesizer::close()
         mixer.eq->setStreamHandle(0);
         mixer.reverb->setStreamHandle(0);
         mixer.chorus->setStreamHandle(0);
+        mixer.meter->setStreamHandle(0);
 
         BASS_ChannelStop(mixer.handle);
         BASS_StreamFree(mixer.handle);
@@ -241,10 +279,33 @@ void MidiSynthesizer::close()
         mixers[i] = mixer;
     }
 
+    if (offlineMixer != 0) {
+        BASS_StreamFree(offlineMixer);
+        offlineMixer = 0;
+    }
+
     // compact soundfont
     BASS_MIDI_FontCompact(0);
 
     openned = false;
+    updateRoutes();
+}
+
+void MidiSynthesizer::setOfflineMode(bool use)
+{
+    if (use == offline)
+        return;
+
+    // same as changing sample format, the graph is rebuilt from the settings
+    if (use)
+        openedBeforeOffline = openned;
+
+    close();
+
+    offline = use;
+
+    if (offline || openedBeforeOffline)
+        open();
 }
 
 int MidiSynthesizer::defaultDevice()
@@ -504,116 +565,64 @@ void MidiSynthesizer::setSoundfontPresets(int presetIndex)
     }
 }
 
-void MidiSynthesizer::sendNoteOff(int ch, int note, int velocity)
+void MidiSynthesizer::sendNoteOff(int ch, int note, int velocity, qint64 timeUs)
 {
     if (note < 0 || note > 127)
         return;
 
-    if (ch == 9)
-    {
-        int vstiIndex = instMap[MidiHelper::getInstrumentDrumType(note)].vsti;
-        if (vstiIndex == -1)
-            BASS_MIDI_StreamEvent(getDrumHandleFromNote(note), 9, MIDI_EVENT_NOTE, MAKEWORD(note, 0));
-        else
-        {
-            #ifndef __linux__
-            InstrumentType t = static_cast<InstrumentType>(vstiIndex + HANDLE_VSTI_START);
-            BASS_VST_ProcessEvent(handles[t], 9, MIDI_EVENT_NOTE, MAKEWORD(note, 0));
-            #endif
-        }
-    }
+    bool clock;
+    NoteRoute r = noteRoute(ch, note, &clock);
+    if (r.vsti == -1)
+        streamEvent(r, clock, ch, MIDI_EVENT_NOTE, MAKEWORD(note, 0), timeUs);
     else
     {
-        int vstiIndex = instMap[chInstType[ch]].vsti;
-        if (vstiIndex == -1)
-            BASS_MIDI_StreamEvent(handles[chInstType[ch]], ch, MIDI_EVENT_NOTE, MAKEWORD(note, 0));
-        else
-        {
-            #ifndef __linux__
-            InstrumentType t = static_cast<InstrumentType>(vstiIndex + HANDLE_VSTI_START);
-            BASS_VST_ProcessEvent(handles[t], ch, MIDI_EVENT_NOTE, MAKEWORD(note, 0));
-            #endif
-        }
+        #ifndef __linux__
+        BASS_VST_ProcessEvent(r.handle, ch, MIDI_EVENT_NOTE, MAKEWORD(note, 0));
+        #endif
     }
 }
 
-void MidiSynthesizer::sendNoteOn(int ch, int note, int velocity)
+void MidiSynthesizer::sendNoteOn(int ch, int note, int velocity, qint64 timeUs)
 {
     if (note < 0 || note > 127)
         return;
 
-    if (ch == 9)
+    // no new notes on a muted instrument, note off still goes out
+    bool clock;
+    NoteRoute r = noteRoute(ch, note, &clock);
+    if (!r.enabled)
+        return;
+
+    if (r.vsti == -1)
     {
-        int vstiIndex = instMap[MidiHelper::getInstrumentDrumType(note)].vsti;
-        if (vstiIndex == -1)
-        {
-            InstrumentType t = MidiHelper::getInstrumentDrumType(note);
-            BASS_MIDI_StreamEvent(handles[t], 9, MIDI_EVENT_NOTE, MAKEWORD(note, velocity));
-            emit noteOnSended(t, instMap[t].bus, 9, note, velocity);
-        }
-        else
-        {
-            #ifndef __linux__
-            InstrumentType t = static_cast<InstrumentType>(vstiIndex + HANDLE_VSTI_START);
-            BASS_VST_ProcessEvent(handles[t], 9, MIDI_EVENT_NOTE, MAKEWORD(note, velocity));
-            emit noteOnSended(t, instMap[t].bus, 9, note, velocity);
-            #endif
-        }
+        streamEvent(r, clock, ch, MIDI_EVENT_NOTE, MAKEWORD(note, velocity), timeUs);
     }
     else
     {
-        int vstiIndex = instMap[chInstType[ch]].vsti;
-        if (vstiIndex == -1)
-        {
-            InstrumentType t = chInstType[ch];
-            BASS_MIDI_StreamEvent(handles[t], ch, MIDI_EVENT_NOTE, MAKEWORD(note, velocity));
-            emit noteOnSended(t, instMap[t].bus, ch, note, velocity);
-        }
-        else
-        {
-            #ifndef __linux__
-            InstrumentType t = static_cast<InstrumentType>(vstiIndex + HANDLE_VSTI_START);
-            BASS_VST_ProcessEvent(handles[t], ch, MIDI_EVENT_NOTE, MAKEWORD(note, velocity));
-            emit noteOnSended(t, instMap[t].bus, ch, note, velocity);
-            #endif
-        }
+        #ifndef __linux__
+        BASS_VST_ProcessEvent(r.handle, ch, MIDI_EVENT_NOTE, MAKEWORD(note, velocity));
+        #endif
     }
 }
 
-void MidiSynthesizer::sendNoteAftertouch(int ch, int note, int value)
+void MidiSynthesizer::sendNoteAftertouch(int ch, int note, int value, qint64 timeUs)
 {
     if (note < 0 || note > 127)
         return;
 
-    if (ch == 9)
-    {
-        int vstiIndex = instMap[MidiHelper::getInstrumentDrumType(note)].vsti;
-        if (vstiIndex == -1)
-            BASS_MIDI_StreamEvent(getDrumHandleFromNote(note), 9, MIDI_EVENT_KEYPRES, MAKEWORD(note, value));
-        else
-        {
-            #ifndef __linux__
-            InstrumentType t = static_cast<InstrumentType>(vstiIndex + HANDLE_VSTI_START);
-            BASS_VST_ProcessEvent(handles[t], 9, MIDI_EVENT_KEYPRES, MAKEWORD(note, value));
-            #endif
-        }
-    }
+    bool clock;
+    NoteRoute r = noteRoute(ch, note, &clock);
+    if (r.vsti == -1)
+        streamEvent(r, clock, ch, MIDI_EVENT_KEYPRES, MAKEWORD(note, value), timeUs);
     else
     {
-        int vstiIndex = instMap[chInstType[ch]].vsti;
-        if (vstiIndex == -1)
-            BASS_MIDI_StreamEvent(handles[chInstType[ch]], ch, MIDI_EVENT_KEYPRES, MAKEWORD(note, value));
-        else
-        {
-            #ifndef __linux__
-            InstrumentType t = static_cast<InstrumentType>(vstiIndex + HANDLE_VSTI_START);
-            BASS_VST_ProcessEvent(handles[t], ch, MIDI_EVENT_KEYPRES, MAKEWORD(note, value));
-            #endif
-        }
+        #ifndef __linux__
+        BASS_VST_ProcessEvent(r.handle, ch, MIDI_EVENT_KEYPRES, MAKEWORD(note, value));
+        #endif
     }
 }
 
-void MidiSynthesizer::sendController(int ch, int number, int value)
+void MidiSynthesizer::sendController(int ch, int number, int value, qint64 timeUs)
 {
     DWORD et;
 
@@ -697,50 +706,53 @@ void MidiSynthesizer::sendController(int ch, int number, int value)
             return;
         BYTE data[3] = { (0xB0 | ch), (number & 0x7F), (value & 0x7F) };
         //qDebug() << (data[0] & 0xF0) << "  " << (data[0] & 0x0F) << "  " << data[1] << "  " << data[2];
+        int index = beginRouteRead();
+        const RouteTable &table = routeTables[index];
         for (int i=0; i<HANDLE_MIDI_COUNT; i++) {
-            HSTREAM h = handles[static_cast<InstrumentType>(i)];
-            if (i < HANDLE_VSTI_START)
-                BASS_MIDI_StreamEvents(h, BASS_MIDI_EVENTS_RAW, (void*)data, 3);
+            const NoteRoute &r = table.streams[i];
+            if (r.vsti == -1 && timeUs >= 0 && table.eventClock)
+                streamEvent(r, true, ch, MIDI_EVENT_CONTROL, MAKEWORD(number & 0x7F, value & 0x7F), timeUs);
+            else if (r.vsti == -1)
+                BASS_MIDI_StreamEvents(r.handle, BASS_MIDI_EVENTS_RAW, (void*)data, 3);
             #ifndef __linux__
             else
-                BASS_VST_ProcessEventRaw(h, (void*)data, 3);
+                BASS_VST_ProcessEventRaw(r.handle, (void*)data, 3);
             #endif
         }
+        endRouteRead(index);
         return;
     }
 
-    sendToAllMidiStream(ch, et, value);
+    sendToAllMidiStream(ch, et, value, timeUs);
 }
 
-void MidiSynthesizer::sendProgramChange(int ch, int number)
+void MidiSynthesizer::sendProgramChange(int ch, int number, qint64 timeUs)
 {
-    sendToAllMidiStream(ch, MIDI_EVENT_PROGRAM, number);
+    sendToAllMidiStream(ch, MIDI_EVENT_PROGRAM, number, timeUs);
 
-    if (ch != 9) {
-        InstrumentType t = MidiHelper::getInstrumentType(number);
-        chInstType[ch] = t;
-    }
+    if (ch != 9)
+        chInstType[ch] = MidiHelper::getInstrumentType(number);
 }
 
-void MidiSynthesizer::sendChannelAftertouch(int ch, int value)
+void MidiSynthesizer::sendChannelAftertouch(int ch, int value, qint64 timeUs)
 {
-    sendToAllMidiStream(ch, MIDI_EVENT_CHANPRES, value);
+    sendToAllMidiStream(ch, MIDI_EVENT_CHANPRES, value, timeUs);
 }
 
-void MidiSynthesizer::sendPitchBend(int ch, int value)
+void MidiSynthesizer::sendPitchBend(int ch, int value, qint64 timeUs)
 {
     if (ch == 9)
-        sendToAllMidiStream(ch, MIDI_EVENT_PITCH, value);
+        sendToAllMidiStream(ch, MIDI_EVENT_PITCH, value, timeUs);
     else
     {
-        int vstiIndex = instMap[chInstType[ch]].vsti;
-        if (vstiIndex == -1)
-            BASS_MIDI_StreamEvent(handles[chInstType[ch]], ch, MIDI_EVENT_PITCH, value);
+        bool clock;
+        NoteRoute r = noteRoute(ch, 0, &clock);
+        if (r.vsti == -1)
+            streamEvent(r, clock, ch, MIDI_EVENT_PITCH, value, timeUs);
         else
         {
             #ifndef __linux__
-            InstrumentType t = static_cast<InstrumentType>(vstiIndex + HANDLE_VSTI_START);
-            BASS_VST_ProcessEvent(handles[t], ch, MIDI_EVENT_PITCH, value);
+            BASS_VST_ProcessEvent(r.handle, ch, MIDI_EVENT_PITCH, value);
             #endif
         }
     }
@@ -771,6 +783,71 @@ void MidiSynthesizer::sendResetAllControllers()
     }
 }
 
+bool MidiSynthesizer::canScheduleEvents()
+{
+    if (!openned)
+        return false;
+
+    // BASS_VST has no timed events
+    bool vsti = false;
+
+    int index = beginRouteRead();
+    for (int i=0; i<HANDLE_VSTI_START; i++) {
+        if (routeTables[index].insts[i].vsti != -1)
+            vsti = true;
+    }
+    endRouteRead(index);
+
+    return !vsti;
+}
+
+bool MidiSynthesizer::isEventClockStarted()
+{
+    int index = beginRouteRead();
+    bool started = routeTables[index].eventClock;
+    endRouteRead(index);
+
+    return started;
+}
+
+void MidiSynthesizer::startEventClock()
+{
+    // Time 0 of the clock is mapped one update period after the current
+    // decode position, so an event sent on time is never behind the mixer.
+    RouteTable *table = beginRouteWrite();
+
+    eventClockLatency = BASS_GetConfig(BASS_CONFIG_UPDATEPERIOD) / 1000.0;
+    eventClockTimer.start();
+
+    for (int i=0; i<HANDLE_VSTI_START; i++) {
+        NoteRoute &r = table->streams[i];
+        r.clockPos = BASS_ChannelGetPosition(r.handle, BASS_POS_BYTE)
+                   + BASS_ChannelSeconds2Bytes(r.handle, eventClockLatency);
+    }
+
+    // an instrument not on a VSTi uses its own stream
+    for (int i=0; i<HANDLE_VSTI_START; i++) {
+        if (table->insts[i].vsti == -1)
+            table->insts[i].clockPos = table->streams[i].clockPos;
+    }
+
+    table->eventClock = true;
+
+    endRouteWrite();
+}
+
+void MidiSynthesizer::stopEventClock()
+{
+    RouteTable *table = beginRouteWrite();
+
+    table->eventClock = false;
+
+    for (int i=0; i<HANDLE_VSTI_START; i++)
+        BASS_MIDI_StreamEvents(table->streams[i].handle, BASS_MIDI_EVENTS_CANCEL, NULL, 0);
+
+    endRouteWrite();
+}
+
 int MidiSynthesizer::device(InstrumentType t)
 {
     return instMap[t].device;
@@ -833,6 +910,7 @@ void MidiSynthesizer::setBusGroup(InstrumentType t, int group)
         return;
 
     instMap[t].bus = group;
+    updateRoutes();
 
     if (!openned)
         return;
@@ -875,6 +953,7 @@ void MidiSynthesizer::setMute(InstrumentType t, bool m)
 {
     instMap[t].mute = m;
     calculateEnable();
+    updateRoutes();
 
     if (!openned)
         return;
@@ -900,6 +979,7 @@ void MidiSynthesizer::setSolo(InstrumentType t, bool s)
     useSolo = us;
 
     calculateEnable();
+    updateRoutes();
 
     if (!openned)
         return;
@@ -924,6 +1004,7 @@ void MidiSynthesizer::setUseVSTi(InstrumentType t, int vstiIndex)
     #ifndef __linux__
     int oldVstiIndex = instMap[t].vsti;
     instMap[t].vsti = vstiIndex;
+    updateRoutes();
 
     if (oldVstiIndex != -1 && vstiHandle(oldVstiIndex) != 0)
     {
@@ -951,6 +1032,7 @@ void MidiSynthesizer::setSpeaker(InstrumentType t, SpeakerType speaker)
     BASS_StreamFree(handles[t]);
 
     handles[t] = createStream(t);
+    updateRoutes();
 
     // Check device.. volume .. mute.. solo.. bus.. and VST
     setDevice(t, instMap[t].device);
@@ -1062,6 +1144,56 @@ HSTREAM MidiSynthesizer::getChannelHandle(InstrumentType type)
     return handles[type];
 }
 
+void MidiSynthesizer::setMetering(bool m)
+{
+    // counted, on from the first view that shows levels to the last
+    int before = metering;
+    metering = m ? metering + 1 : qMax(0, metering - 1);
+    if ((before > 0) == (metering > 0))
+        return;
+
+    for (LevelMeter *meter : meters.values()) {
+        if (metering > 0) meter->on();
+        else meter->off();
+    }
+
+    for (MixerHandle mix : mixers) {
+        if (metering > 0) mix.meter->on();
+        else mix.meter->off();
+    }
+}
+
+MeterLevel MidiSynthesizer::takeLevel(InstrumentType t, MeterReader reader)
+{
+    MeterLevel level = { 0.0f, 0.0f };
+    if (!meters.contains(t))
+        return level;
+
+    level = meters[t]->take(reader);
+
+    // the mixer applies the volume after the DSP
+    float vol = 1.0f;
+    if (handles[t] != 0)
+        BASS_ChannelGetAttribute(handles[t], BASS_ATTRIB_VOL, &vol);
+    level.peak *= vol;
+    level.rms *= vol;
+
+    return level;
+}
+
+MeterLevel MidiSynthesizer::takeMixerLevel(int mixerIndex, MeterReader reader)
+{
+    MeterLevel level = { 0.0f, 0.0f };
+    if (mixerIndex < 0 || mixerIndex >= mixers.count())
+        return level;
+
+    level = mixers[mixerIndex].meter->take(reader);
+    level.peak *= synth_volume;
+    level.rms *= synth_volume;
+
+    return level;
+}
+
 FX *MidiSynthesizer::addFX(InstrumentType type, DWORD uid)
 {
     FX *fx = nullptr;
@@ -1263,6 +1395,7 @@ DWORD MidiSynthesizer::setVSTiFile(int vstiIndex, const QString &file)
     if (!openned)
         return 0;
 
+    meters[t]->setStreamHandle(0);
     BASS_Mixer_ChannelRemove(vsti);
     BASS_VST_ChannelFree(vsti);
 
@@ -1277,6 +1410,7 @@ DWORD MidiSynthesizer::setVSTiFile(int vstiIndex, const QString &file)
         mVstiTempParams[vstiIndex].clear();
 
         handles[t] = vsti;
+        updateRoutes();
 
         setDevice(t, instMap[t].device);
         setVolume(t, instMap[t].volume);
@@ -1287,12 +1421,14 @@ DWORD MidiSynthesizer::setVSTiFile(int vstiIndex, const QString &file)
         // Set stream handle to FX
         for (FX *fx : instMap[t].FXs)
             fx->setStreamHandle(vsti);
+        meters[t]->setStreamHandle(vsti);
 
         return vsti;
     }
     else
     {
         handles[t] = 0;
+        updateRoutes();
         return 0;
     }
 }
@@ -1305,10 +1441,12 @@ void MidiSynthesizer::removeVSTiFile(int vstiIndex)
     InstrumentType t = static_cast<InstrumentType>(HANDLE_VSTI_START+vstiIndex);
     DWORD vsti = handles[t];
 
+    meters[t]->setStreamHandle(0);
     BASS_Mixer_ChannelRemove(vsti);
     BASS_VST_ChannelFree(vsti);
 
     handles[t] = 0;
+    updateRoutes();
     mVstiFiles[vstiIndex] = "";
     mVstiInfos[vstiIndex] = BASS_VST_INFO();
     mVstiTempProgram[vstiIndex] = 0;
@@ -1322,6 +1460,19 @@ void MidiSynthesizer::compactSoundfont()
     BASS_MIDI_FontCompact(0);
 }
 
+void MidiSynthesizer::preloadPresets(const QList<int> &programs, const QList<int> &drumKits)
+{
+    if (sfLoadAll)
+        return;
+
+    for (HSOUNDFONT sf : synth_HSOUNDFONT) {
+        for (int p : programs)
+            BASS_MIDI_FontLoad(sf, p, 0);
+        for (int p : drumKits)
+            BASS_MIDI_FontLoad(sf, p, 128);
+    }
+}
+
 DWORD MidiSynthesizer::createStream(InstrumentType t)
 {
     int index = static_cast<int>(t);
@@ -1377,17 +1528,45 @@ DWORD MidiSynthesizer::createStream(InstrumentType t)
     }
 }
 
-void MidiSynthesizer::sendToAllMidiStream(int ch, DWORD eventType, DWORD param)
+void MidiSynthesizer::streamEvent(const NoteRoute &r, bool clock, int ch, DWORD eventType, DWORD param, qint64 timeUs)
 {
+    HSTREAM h = r.handle;
+
+    if (timeUs < 0 || !clock) {
+        BASS_MIDI_StreamEvent(h, ch, eventType, param);
+        return;
+    }
+
+    // delay from the current decode position to the event position
+    qint64 target = r.clockPos + (qint64)BASS_ChannelSeconds2Bytes(h, timeUs / 1000000.0);
+    qint64 current = (qint64)BASS_ChannelGetPosition(h, BASS_POS_BYTE);
+
+    BASS_MIDI_EVENT ev;
+    ev.event = eventType;
+    ev.param = param;
+    ev.chan = ch;
+    ev.tick = 0;
+    ev.pos = (target > current) ? (DWORD)(target - current) : 0;
+
+    BASS_MIDI_StreamEvents(h, BASS_MIDI_EVENTS_STRUCT | BASS_MIDI_EVENTS_TIME, &ev, 1);
+}
+
+void MidiSynthesizer::sendToAllMidiStream(int ch, DWORD eventType, DWORD param, qint64 timeUs)
+{
+    int index = beginRouteRead();
+    const RouteTable &table = routeTables[index];
+
     for (int i=0; i<HANDLE_MIDI_COUNT; i++) {
-        HSTREAM stream = handles[static_cast<InstrumentType>(i)];
-        if (i < HANDLE_VSTI_START)
-            BASS_MIDI_StreamEvent(stream, ch, eventType, param);
+        const NoteRoute &r = table.streams[i];
+        if (r.vsti == -1)
+            streamEvent(r, table.eventClock, ch, eventType, param, timeUs);
         #ifndef __linux__
         else
-            BASS_VST_ProcessEvent(stream, ch, eventType, param);
+            BASS_VST_ProcessEvent(r.handle, ch, eventType, param);
         #endif
     }
+
+    endRouteRead(index);
 }
 
 void MidiSynthesizer::setSfToStream()
@@ -1439,88 +1618,91 @@ void MidiSynthesizer::calculateEnable()
     }
 }
 
-HSTREAM MidiSynthesizer::getDrumHandleFromNote(int drumNote)
+NoteRoute MidiSynthesizer::noteRoute(int ch, int note, bool *clock)
 {
-    switch (drumNote) {
+    InstrumentType t = (ch == 9) ? drumInstType[note] : chInstType[ch];
 
-    // Bass drum
-    case 35:
-    case 36:
-        return handles[InstrumentType::BassDrum];
+    int index = beginRouteRead();
+    NoteRoute r = routeTables[index].insts[static_cast<int>(t)];
+    *clock = routeTables[index].eventClock;
+    endRouteRead(index);
 
-    // snare
-    case 38:
-    case 40:
-        return handles[InstrumentType::Snare];
-
-    // Side Stick/Rimshot
-    case 37:
-        return handles[InstrumentType::SideStick];
-
-    // Low Tom
-    case 41:
-    case 43:
-        return handles[InstrumentType::LowTom];
-
-    // Mid Tom
-    case 45:
-    case 47:
-        return handles[InstrumentType::MidTom];
-
-    // High Tom
-    case 48:
-    case 50:
-        return handles[InstrumentType::HighTom];
-
-    // Hi-hat
-    case 42:
-    case 44:
-    case 46:
-        return handles[InstrumentType::Hihat];
-
-    // Cowbell
-    case 56:
-        return handles[InstrumentType::Cowbell];
-
-    // Crash Cymbal ( 55 = Splash Cymbal )
-    case 49:
-    case 52:
-    case 55:
-    case 57:
-        return handles[InstrumentType::CrashCymbal];
-
-    // Ride Cymbal
-    case 51:
-    case 59:
-        return handles[InstrumentType::RideCymbal];
-
-    // Bongo
-    case 60:
-    case 61:
-        return handles[InstrumentType::Bongo];
-
-    // Conga
-    case 62:
-    case 63:
-    case 64:
-        return handles[InstrumentType::Conga];
+    return r;
+}
 
-    // Timbale
-    case 65:
-    case 66:
-        return handles[InstrumentType::Timbale];
+int MidiSynthesizer::beginRouteRead()
+{
+    // retry when the table was swapped before the reader was counted,
+    // the writer may already be filling it
+    for (;;) {
+        int index = routeIndex.loadAcquire();
+        routeReaders[index].ref();
+        if (routeIndex.loadAcquire() == index)
+            return index;
+        routeReaders[index].deref();
+    }
+}
+
+void MidiSynthesizer::endRouteRead(int index)
+{
+    routeReaders[index].deref();
+}
 
-    // ฉิ่ง
-    case 80:
-    case 81:
-        return handles[InstrumentType::SmallCupShapedCymbals];
+RouteTable *MidiSynthesizer::beginRouteWrite()
+{
+    routeMutex.lock();
 
-    // ฉาบ
-    case 82:
-    case 83:
-        return handles[InstrumentType::ThaiChap];
+    // readers left on the other table loaded it before the last swap,
+    // they are out after one call
+    int next = 1 - routeIndex.load();
+    while (routeReaders[next].loadAcquire() > 0)
+        QThread::yieldCurrentThread();
 
-    default:
-        return handles[InstrumentType::PercussionEtc];
+    routeTables[next] = routeTables[1 - next];
+
+    return &routeTables[next];
+}
+
+void MidiSynthesizer::endRouteWrite()
+{
+    routeIndex.storeRelease(1 - routeIndex.load());
+
+    routeMutex.unlock();
+}
+
+void MidiSynthesizer::updateRoutes()
+{
+    RouteTable *table = beginRouteWrite();
+
+    for (int i=0; i<HANDLE_MIDI_COUNT; i++) {
+        InstrumentType t = static_cast<InstrumentType>(i);
+        NoteRoute &r = table->streams[i];
+
+        // A stream created while the clock runs starts at position 0,
+        // its clock 0 is where it was on the other streams.
+        HSTREAM h = handles.value(t, 0);
+        if (h != r.handle) {
+            r.clockPos = 0;
+            if (table->eventClock && h != 0) {
+                double elapsed = eventClockTimer.nsecsElapsed() / 1000000000.0;
+                r.clockPos = (qint64)BASS_ChannelGetPosition(h, BASS_POS_BYTE)
+                           + (qint64)BASS_ChannelSeconds2Bytes(h, eventClockLatency)
+                           - (qint64)BASS_ChannelSeconds2Bytes(h, elapsed);
+            }
+        }
+
+        r.handle = h;
+        r.vsti = (i < HANDLE_VSTI_START) ? -1 : i - HANDLE_VSTI_START;
+        r.enabled = (i < HANDLE_VSTI_START) ? instMap.value(t).enable : true;
     }
+
+    for (int i=0; i<HANDLE_VSTI_START; i++) {
+        const Instrument &im = instMap[static_cast<InstrumentType>(i)];
+        NoteRoute &r = table->insts[i];
+
+        r = (im.vsti == -1) ? table->streams[i] : table->streams[im.vsti + HANDLE_VSTI_START];
+        r.enabled = im.enable;
+    }
+
+    endRouteWrite();
 }
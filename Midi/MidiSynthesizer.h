@@ -3,7 +3,10 @@
 
 #include <QObject>
 #include <QMap>
+#include <QMutex>
 #include <QTimer>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 
 #include <bass.h>
 #include <bassmidi.h>
@@ -15,6 +18,7 @@
 #include "BASSFX/Equalizer31BandFX.h"
 #include "BASSFX/Chorus2FX.h"
 #include "BASSFX/Reverb2FX.h"
+#include "BASSFX/LevelMeter.h"
 
 #define SF_PRESET_COUNT 11
 
@@ -24,6 +28,7 @@ typedef struct
     Equalizer31BandFX *eq;
     Chorus2FX *chorus;
     Reverb2FX *reverb;
+    LevelMeter *meter;
 } MixerHandle;
 
 typedef struct
@@ -40,6 +45,22 @@ typedef struct
     QList<FX*> FXs;
 } Instrument;
 
+// Where the events of an instrument go, the VSTi when the instrument uses one
+typedef struct
+{
+    HSTREAM handle;
+    int vsti;       // -1 : BASSMIDI stream
+    bool enabled;   // not muted or silenced by a solo
+    qint64 clockPos; // byte position of event clock 0 in handle, can be before 0
+} NoteRoute;
+
+typedef struct
+{
+    bool eventClock;
+    NoteRoute streams[46];  // BASSMIDI and VSTi streams by InstrumentType
+    NoteRoute insts[42];    // instruments, the VSTi stream when they use one
+} RouteTable;
+
 typedef struct
 {
     unsigned int uniqueID;
@@ -61,6 +82,11 @@ public:
     bool open();
     void close();
 
+    // Offline: no audio device, the whole graph is pulled from offlineHandle()
+    bool isOfflineMode() { return offline; }
+    void setOfflineMode(bool use);
+    HSTREAM offlineHandle() { return offlineMixer; }
+
     int defaultDevice();
     bool setDefaultDevice(int dv);
     void setVolume(float vol);
@@ -85,18 +111,25 @@ public:
     QList<int> getDrumMapSfIndex(int presetIndex) { return drumSf[presetIndex]; }
 
 
-    void sendNoteOff(int ch, int note, int velocity);
-    void sendNoteOn(int ch, int note, int velocity);
-    void sendNoteAftertouch(int ch, int note, int value);
-    void sendController(int ch, int number, int value);
-    void sendProgramChange(int ch, int number);
-    void sendChannelAftertouch(int ch, int value);
-    void sendPitchBend(int ch, int value);
+    // timeUs >= 0 : microseconds on the event clock, sent ahead with sample position
+    void sendNoteOff(int ch, int note, int velocity, qint64 timeUs = -1);
+    void sendNoteOn(int ch, int note, int velocity, qint64 timeUs = -1);
+    void sendNoteAftertouch(int ch, int note, int value, qint64 timeUs = -1);
+    void sendController(int ch, int number, int value, qint64 timeUs = -1);
+    void sendProgramChange(int ch, int number, qint64 timeUs = -1);
+    void sendChannelAftertouch(int ch, int value, qint64 timeUs = -1);
+    void sendPitchBend(int ch, int value, qint64 timeUs = -1);
     void sendAllNotesOff(int ch);
     void sendAllNotesOff();
     void sendResetAllControllers(int ch);
     void sendResetAllControllers();
 
+    // Event clock, timed events are queued in the BASSMIDI streams
+    bool canScheduleEvents();
+    bool isEventClockStarted();
+    void startEventClock();
+    void stopEventClock();  // also drops the queued events
+
 
     // Instrument Maper
     QMap<InstrumentType, Instrument> instrumentMap() { return instMap; }
@@ -167,19 +200,41 @@ public:
     const int HANDLE_BUS_COUNT = 16;
     const int HANDLE_BUS_START = 46;
 
+    // load the samples of these presets now instead of at the first note
+    void preloadPresets(const QList<int> &programs, const QList<int> &drumKits);
+
+    // Levels of the instrument and bus streams and the device mixers,
+    // measured while at least one view has metering on. GUI thread, the
+    // highest levels since the last call of the reader.
+    bool isMetering() { return metering > 0; }
+    void setMetering(bool m);
+    MeterLevel takeLevel(InstrumentType t, MeterReader reader = MeterReader::SynthMixer);  // after the volume of the instrument
+    MeterLevel takeMixerLevel(int mixerIndex, MeterReader reader = MeterReader::SynthMixer);  // after the master volume
+    int mixerCount() { return mixers.count(); }
+
 public slots:
     void compactSoundfont();
 
-signals:
-    void noteOnSended(InstrumentType t, int bus, int ch, int note, int velocity);
-
 private:
     DWORD createStream(InstrumentType t);
 
-    void sendToAllMidiStream(int ch, DWORD eventType, DWORD param);
+    void sendToAllMidiStream(int ch, DWORD eventType, DWORD param, qint64 timeUs = -1);
+    void streamEvent(const NoteRoute &r, bool clock, int ch, DWORD eventType, DWORD param, qint64 timeUs);
     void setSfToStream();
     void calculateEnable();
-    HSTREAM getDrumHandleFromNote(int drumNote);
+
+    // rebuild after anything that moves an instrument to another stream
+    // or changes its mute or solo, GUI thread
+    void updateRoutes();
+    NoteRoute noteRoute(int ch, int note, bool *clock);
+
+    // The table the sending thread reads is published by swapping an
+    // index, the reader never locks. Writers hold routeMutex and fill
+    // the other table once no reader is left on it.
+    int beginRouteRead();
+    void endRouteRead(int index);
+    RouteTable *beginRouteWrite();
+    void endRouteWrite();
 
 private:
     QTimer timer;
@@ -194,7 +249,20 @@ private:
     QList<QList<int>> instmSf;
     QList<QList<int>> drumSf;
     QMap<InstrumentType, Instrument> instMap;
-    InstrumentType chInstType[16];
+    InstrumentType chInstType[16];      // thread that sends the events
+    InstrumentType drumInstType[128];   // channel 9 by note
+
+    // Copy of handles and instMap for the thread that sends the events,
+    // instMap and handles are only used by the GUI thread
+    QMutex routeMutex;
+    RouteTable routeTables[2];
+    QAtomicInt routeIndex;          // published table
+    QAtomicInt routeReaders[2];
+    QElapsedTimer eventClockTimer;  // since startEventClock()
+    double eventClockLatency = 0;
+
+    QMap<InstrumentType, LevelMeter*> meters;
+    int metering = 0;   // views with metering on
 
     #ifndef __linux__
     QString mVstiFiles[4];
@@ -211,6 +279,9 @@ private:
     float synth_volume = 1.0f;
     bool openned = false;
     bool useSolo = false;
+    bool offline = false;
+    bool openedBeforeOffline = false;
+    HSTREAM offlineMixer = 0;
 
     int defaultDev = 1;
     bool useFloat = true;
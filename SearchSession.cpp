@@ -0,0 +1,162 @@
+#include "SearchSession.h"
+
+#include "SongCatalog.h"
+
+#include <QSqlQuery>
+
+
+SearchSession::SearchSession(int windowSize)
+{
+    _windowSize = windowSize;
+}
+
+void SearchSession::start(QSqlDatabase *db, const QString &sql, const QVariantList &values)
+{
+    _mutex.lock();
+    _db = db;
+    _catalog = nullptr;
+    _indexes.clear();
+    _sql = sql;
+    _values = values;
+    _window.clear();
+    _windowStart = 0;
+    _loaded = false;
+    _total = -1;
+    _mutex.unlock();
+}
+
+void SearchSession::start(SongCatalog *catalog, const QVector<int> &indexes)
+{
+    _mutex.lock();
+    _db = nullptr;
+    _catalog = catalog;
+    _indexes = indexes;
+    _sql = "";
+    _values.clear();
+    _window.clear();
+    _windowStart = 0;
+    _loaded = true;
+    _total = indexes.count();
+    _mutex.unlock();
+}
+
+void SearchSession::clear()
+{
+    start(nullptr, "", QVariantList());
+}
+
+void SearchSession::invalidate()
+{
+    _mutex.lock();
+    if (_catalog != nullptr) {
+        _mutex.unlock();
+        return;
+    }
+
+    _window.clear();
+    _loaded = false;
+    _total = -1;
+    _mutex.unlock();
+}
+
+bool SearchSession::row(int index, Song *r)
+{
+    if (index < 0)
+        return false;
+
+    _mutex.lock();
+
+    bool result;
+    if (_catalog != nullptr) {
+        result = (index < _indexes.count());
+        if (result)
+            *r = _catalog->row(_indexes.at(index));
+    } else {
+        result = load(index);
+        if (result)
+            *r = _window.at(index - _windowStart);
+    }
+
+    _mutex.unlock();
+
+    return result;
+}
+
+QVector<Song> SearchSession::rows(int from, int count)
+{
+    QVector<Song> result;
+    if (from < 0 || count <= 0)
+        return result;
+
+    result.reserve(count);
+
+    _mutex.lock();
+    for (int i=from; i<from + count; i++) {
+        if (_catalog != nullptr) {
+            if (i >= _indexes.count())
+                break;
+            result.append(_catalog->row(_indexes.at(i)));
+        } else {
+            if (!load(i))
+                break;
+            result.append(_window.at(i - _windowStart));
+        }
+    }
+    _mutex.unlock();
+
+    return result;
+}
+
+bool SearchSession::load(int index)
+{
+    if (_total >= 0 && index >= _total)
+        return false;
+
+    if (_loaded && index >= _windowStart && index < _windowStart + _window.count())
+        return true;
+
+    if (_db == nullptr || _sql.isEmpty())
+        return false;
+
+    // keep a few rows behind the index for previous
+    int start = index - _windowSize / 4;
+    if (start < 0)
+        start = 0;
+
+    QSqlQuery q(*_db);
+    q.setForwardOnly(true);
+    q.prepare(_sql + " LIMIT ? OFFSET ?");
+
+    int p = 0;
+    for (const QVariant &v : _values)
+        q.bindValue(p++, v);
+    q.bindValue(p++, _windowSize);
+    q.bindValue(p++, start);
+
+    _window.clear();
+    _windowStart = start;
+    _loaded = true;
+
+    if (q.exec()) {
+        while (q.next()) {
+            Song r;
+            r.setId(q.value(0).toString());
+            r.setName(q.value(1).toString());
+            r.setArtist(q.value(2).toString());
+            r.setKey(q.value(3).toString());
+            r.setTempo(q.value(4).toInt());
+            r.setSongType(q.value(5).toString());
+            r.setLyrics(q.value(6).toString());
+            r.setPath(q.value(7).toString());
+            _window.append(r);
+        }
+    }
+    q.finish();
+    q.clear();
+
+    // a short window is the end of the results
+    if (_window.count() < _windowSize)
+        _total = start + _window.count();
+
+    return index < _windowStart + _window.count();
+}
@@ -0,0 +1,55 @@
+#ifndef SEARCHSESSION_H
+#define SEARCHSESSION_H
+
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QVariantList>
+#include <QVector>
+
+#include "Song.h"
+
+class SongCatalog;
+
+// Results of one search, kept as a window of rows around the current
+// index. Next/previous inside the window don't touch the database, the
+// query only runs again (LIMIT/OFFSET) when the index leaves it.
+// With a catalog the results are song indexes in the catalog instead.
+class SearchSession
+{
+public:
+    explicit SearchSession(int windowSize = 100);
+
+    void start(QSqlDatabase *db, const QString &sql, const QVariantList &values);
+    void start(SongCatalog *catalog, const QVector<int> &indexes);
+    void clear();
+
+    // drop the cached rows, the next access reads them again
+    void invalidate();
+
+    // false when index is out of the results
+    bool row(int index, Song *r);
+    QVector<Song> rows(int from, int count);
+
+    // -1 until the end of the results was read
+    int total() { return _total; }
+
+private:
+    bool load(int index);
+
+private:
+    QSqlDatabase *_db = nullptr;
+    SongCatalog *_catalog = nullptr;
+    QVector<int> _indexes;
+    QString _sql = "";
+    QVariantList _values;
+
+    int _windowSize;
+    int _windowStart = 0;
+    QVector<Song> _window;
+    bool _loaded = false;
+    int _total = -1;
+
+    QMutex _mutex;
+};
+
+#endif // SEARCHSESSION_H
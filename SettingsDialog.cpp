@@ -534,7 +534,7 @@ void SettingsDialog::on_btnUpdateSongs_clicked()
     ui->lbCountSongsText->setEnabled(false);
     ui->lbCountSongsValue->setEnabled(false);
 
-    db->setUpdateType(UpdateType::UpdateAll);
+    db->setUpdateType(UpdateType::UpdateChanged);
     db->start();
 }
 
@@ -1,92 +1,50 @@
 #include "Song.h"
 
-Song::Song(QObject *parent) : QObject(parent)
+Song::Song() : d(new SongData)
 {
-    sId         = "";
-    sName       = "";
-    sArtist     = "";
-    sKey        = "";
-    sTempo      = 0;
-    sBpmSpeed   = 0;
-    sTranspose  = 0;
-    sSongType   = "";
-    sLyrics     = "";
-    sPath       = "";
-
-    sCutStartBar = 0;
-    sCutEndBar   = 1;
 }
 
-Song::Song(const Song &s)
+void Song::setLyrics(const QString &lyr)
 {
-    sId         = s.sId;
-    sName       = s.sName;
-    sArtist     = s.sArtist;
-    sKey        = s.sKey;
-    sTempo      = s.sTempo;
-    sBpmSpeed   = s.sBpmSpeed;
-    sTranspose  = s.sTranspose;
-    sSongType   = s.sSongType;
-    sLyrics     = s.sLyrics;
-    sPath       = s.sPath;
-
-    sCutStartBar = s.sCutStartBar;
-    sCutEndBar   = s.sCutEndBar;
-}
-
-Song &Song::operator =(const Song &s)
-{
-    sId         = s.sId;
-    sName       = s.sName;
-    sArtist     = s.sArtist;
-    sKey        = s.sKey;
-    sTempo      = s.sTempo;
-    sBpmSpeed   = s.sBpmSpeed;
-    sTranspose  = s.sTranspose;
-    sSongType   = s.sSongType;
-    sLyrics     = s.sLyrics;
-    sPath       = s.sPath;
-
-    sCutStartBar = s.sCutStartBar;
-    sCutEndBar   = s.sCutEndBar;
-
-    return *this;
+    // kept on one line, lyrics() used to do this on every call
+    QString l = lyr;
+    d->sLyrics = l.replace("\n", " ");
 }
 
-QString Song::detail()
+QString Song::detail() const
 {
-    QString d = sId + "  " + sName + " - " + sArtist;
-    d += "  (" + QString::number(sTempo + sBpmSpeed);
-    d += sKey == "" ? ")" : "-" + sKey + ")";
-    if (sBpmSpeed != 0)
+    QString text = id() + "  " + name() + " - " + artist();
+    text += "  (" + QString::number(tempo() + bpmSpeed());
+    text += key() == "" ? ")" : "-" + key() + ")";
+    if (bpmSpeed() != 0)
     {
-        QString s = sBpmSpeed > 0 ? "+" + QString::number(sBpmSpeed) : QString::number(sBpmSpeed);
-        d += " (" + s + ")";
+        QString s = bpmSpeed() > 0 ? "+" + QString::number(bpmSpeed()) : QString::number(bpmSpeed());
+        text += " (" + s + ")";
     }
-    if (sTranspose != 0)
+    if (transpose() != 0)
     {
-        QString str = sTranspose > 0 ? "+" + QString::number(sTranspose) : QString::number(sTranspose);
-        d += " (Key " + str + ")";
+        QString str = transpose() > 0 ? "+" + QString::number(transpose()) : QString::number(transpose());
+        text += " (Key " + str + ")";
     }
-    d += "  [" + sSongType + "]";
-    return d;
+    text += "  [" + songType() + "]";
+    return text;
 }
 
-QString Song::detailWithoutIDType()
+QString Song::detailWithoutIDType() const
 {
-    QString d = sName + " - " + sArtist;
-    d += "  (" + QString::number(sTempo + sBpmSpeed);
-    d += sKey == "" ? ")" : "-" + sKey + ")";
-    if (sBpmSpeed != 0)
+    QString text = name() + " - " + artist();
+    text += "  (" + QString::number(tempo() + bpmSpeed());
+    text += key() == "" ? ")" : "-" + key() + ")";
+    if (bpmSpeed() != 0)
     {
-        QString s = sBpmSpeed > 0 ? "+" + QString::number(sBpmSpeed) : QString::number(sBpmSpeed);
-        d += " (" + s + ")";
+        QString s = bpmSpeed() > 0 ? "+" + QString::number(bpmSpeed()) : QString::number(bpmSpeed());
+        text += " (" + s + ")";
     }
-    if (sTranspose != 0)
+    if (transpose() != 0)
     {
-        QString str = sTranspose > 0 ? "+" + QString::number(sTranspose) : QString::number(sTranspose);
-        d += " (Key " + str + ")";
+        QString str = transpose() > 0 ? "+" + QString::number(transpose()) : QString::number(transpose());
+        text += " (Key " + str + ")";
     }
 
-    return d;
+    return text;
 }
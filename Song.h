@@ -1,65 +1,69 @@
 #ifndef SONG_H
 #define SONG_H
 
-#include <QObject>
+#include <QSharedData>
+#include <QString>
 
-class Song : public QObject
+class SongData : public QSharedData
 {
-    Q_OBJECT
 public:
-    explicit Song(QObject *parent = 0);
-    Song(const Song &s);
-    Song& operator = (const Song &s);
+    QString sId         = "";
+    QString sName       = "";
+    QString sArtist     = "";
+    QString sKey        = "";
+    int     sTempo      = 0;
+    int     sBpmSpeed   = 0;
+    int     sTranspose  = 0;
+    QString sSongType   = "";
+    QString sLyrics     = "";
+    QString sPath       = "";
 
-    QString id()        { return sId; }
-    QString name()      { return sName; }
-    QString artist()    { return sArtist; }
-    QString key()       { return sKey; }
-    int     tempo()     { return sTempo; }
-    int     bpmSpeed()  { return sBpmSpeed; }
-    int     transpose() { return sTranspose;  }
-    QString songType()  { return sSongType; }
-    QString lyrics()    { return sLyrics.replace("\n", " "); }
-    QString path()      { return sPath; }
+    int     sCutStartBar = 0;
+    int     sCutEndBar   = 1;
+};
 
-    int     cutStartBar()   { return sCutStartBar; }
-    int     cutEndBar()     { return sCutEndBar; }
+// Implicitly shared value, copies only share the data until one of
+// them is changed. Keep it by value in lists.
+class Song
+{
+public:
+    Song();
 
-    void setId          (const QString &id)     { sId = id; }
-    void setName        (const QString &name)   { sName = name; }
-    void setArtist      (const QString &artist) { sArtist = artist; }
-    void setKey         (const QString &key)    { sKey = key; }
-    void setTempo       (int tempo)             { sTempo = tempo; }
-    void setBpmSpeed    (int bpm)               { sBpmSpeed = bpm; }
-    void setTranspose   (int t)                 { sTranspose = t; }
-    void setSongType    (const QString &type)   { sSongType = type; }
-    void setLyrics      (const QString &lyr)    { sLyrics = lyr; }
-    void setPath        (const QString &path)   { sPath = path; }
+    QString id()        const { return d->sId; }
+    QString name()      const { return d->sName; }
+    QString artist()    const { return d->sArtist; }
+    QString key()       const { return d->sKey; }
+    int     tempo()     const { return d->sTempo; }
+    int     bpmSpeed()  const { return d->sBpmSpeed; }
+    int     transpose() const { return d->sTranspose;  }
+    QString songType()  const { return d->sSongType; }
+    QString lyrics()    const { return d->sLyrics; }
+    QString path()      const { return d->sPath; }
 
-    void setCutStartBar (int bar)               { sCutStartBar = bar; }
-    void setCutEndBar   (int bar)               { sCutEndBar = bar; }
+    int     cutStartBar()   const { return d->sCutStartBar; }
+    int     cutEndBar()     const { return d->sCutEndBar; }
 
-    QString detail();
-    QString detailWithoutIDType();
+    void setId          (const QString &id)     { d->sId = id; }
+    void setName        (const QString &name)   { d->sName = name; }
+    void setArtist      (const QString &artist) { d->sArtist = artist; }
+    void setKey         (const QString &key)    { d->sKey = key; }
+    void setTempo       (int tempo)             { d->sTempo = tempo; }
+    void setBpmSpeed    (int bpm)               { d->sBpmSpeed = bpm; }
+    void setTranspose   (int t)                 { d->sTranspose = t; }
+    void setSongType    (const QString &type)   { d->sSongType = type; }
+    void setLyrics      (const QString &lyr);
+    void setPath        (const QString &path)   { d->sPath = path; }
 
-signals:
+    void setCutStartBar (int bar)               { d->sCutStartBar = bar; }
+    void setCutEndBar   (int bar)               { d->sCutEndBar = bar; }
 
-public slots:
+    QString detail() const;
+    QString detailWithoutIDType() const;
 
 private:
-    QString sId;
-    QString sName;
-    QString sArtist;
-    QString sKey;
-    int     sTempo;
-    int     sBpmSpeed;
-    int     sTranspose;
-    QString sSongType;
-    QString sLyrics;
-    QString sPath;
-
-    int     sCutStartBar;
-    int     sCutEndBar;
+    QSharedDataPointer<SongData> d;
 };
 
+Q_DECLARE_TYPEINFO(Song, Q_MOVABLE_TYPE);
+
 #endif // SONG_H
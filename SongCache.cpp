@@ -0,0 +1,206 @@
+#include "SongCache.h"
+
+#include "Utils.h"
+#include "SongDatabase.h"
+#include "SongScanner.h"
+
+
+SongCache::SongCache(SongDatabase *db, qint64 budgetBytes, QObject *parent) : QThread(parent)
+{
+    _db = db;
+    _budget = budgetBytes;
+}
+
+SongCache::~SongCache()
+{
+    stop();
+}
+
+void SongCache::setBudget(qint64 bytes)
+{
+    _mutex.lock();
+    _budget = bytes;
+    evict();
+    _mutex.unlock();
+}
+
+void SongCache::preload(const QList<Song> &songs)
+{
+    _mutex.lock();
+    _pending = songs;
+    _wanted.clear();
+    for (const Song &s : songs)
+        _wanted.append(songKey(s));
+    _wake.wakeAll();
+    _mutex.unlock();
+}
+
+bool SongCache::find(const Song &song, CachedSong *cs)
+{
+    QString key = songKey(song);
+
+    _mutex.lock();
+
+    auto it = _songs.constFind(key);
+    bool result = (it != _songs.constEnd());
+    if (result) {
+        *cs = it.value();
+        _lru.removeOne(key);
+        _lru.prepend(key);
+    }
+
+    _mutex.unlock();
+
+    return result;
+}
+
+void SongCache::clear()
+{
+    _mutex.lock();
+    _songs.clear();
+    _lru.clear();
+    _wanted.clear();
+    _pending.clear();
+    _size = 0;
+    _mutex.unlock();
+}
+
+void SongCache::stop()
+{
+    _mutex.lock();
+    _quit = true;
+    _wake.wakeAll();
+    _mutex.unlock();
+
+    wait();
+}
+
+qint64 SongCache::sizeInBytes()
+{
+    _mutex.lock();
+    qint64 size = _size;
+    _mutex.unlock();
+
+    return size;
+}
+
+bool SongCache::readSong(SongDatabase *db, const Song &song, CachedSong *cs)
+{
+    QSharedPointer<MidiFile> midi(new MidiFile());
+
+    if (song.songType() == "NCN")
+    {
+        QString p = db->ncnPath() + song.path();
+        QString curPath = db->getCurFilePath(p);
+        QString lyrPath = db->getLyrFilePath(p);
+        if (curPath == "" || lyrPath == "")
+            return false;
+
+        if (!midi->read(p, true))
+            return false;
+
+        cs->lyrics = Utils::readLyrics(lyrPath);
+        cs->cursor = Utils::readCurFile(curPath, midi->resorution());
+    }
+    else if (song.songType() == "HNK")
+    {
+        QString p = db->hnkPath() + song.path();
+        if (!QFile::exists(p))
+            return false;
+
+        HNKSong hnk;
+        if (!Utils::readHNK(p, &hnk) || !midi->read(hnk.midData, true))
+            return false;
+
+        cs->lyrics = Utils::readLyrics(hnk.lyrData);
+        cs->cursor = Utils::readCurFile(hnk.curData, midi->resorution());
+    }
+    else if (song.songType() == "KAR")
+    {
+        QString p = db->karPath() + song.path();
+        if (!midi->read(p, false))
+            return false;
+
+        cs->lyrics = midi->lyrics();
+        cs->cursor = midi->lyricsCursor();
+    }
+    else
+    {
+        return false;
+    }
+
+    cs->midi = midi;
+    cs->beats = MidiHelper::calculateBeats(midi.data());
+
+    cs->bytes = midi->eventStore()->count() * sizeof(MidiEventRecord)
+            + midi->eventStore()->payloadBytes()
+            + cs->lyrics.size() * sizeof(QChar)
+            + cs->cursor.size() * sizeof(long)
+            + cs->beats.size() * sizeof(SignatureBeat);
+
+    return true;
+}
+
+void SongCache::run()
+{
+    _mutex.lock();
+
+    while (!_quit) {
+        bool found = false;
+        Song song;
+        while (!_pending.isEmpty()) {
+            song = _pending.takeFirst();
+            if (!_songs.contains(songKey(song))) {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
+            _wake.wait(&_mutex);
+            continue;
+        }
+
+        _mutex.unlock();
+
+        CachedSong cs;
+        bool result = readSong(_db, song, &cs);
+
+        _mutex.lock();
+
+        if (result && !_quit)
+            insert(songKey(song), cs);
+    }
+
+    _mutex.unlock();
+}
+
+QString SongCache::songKey(const Song &song)
+{
+    return SongDirWalker::songKey(song.songType(), song.path());
+}
+
+void SongCache::insert(const QString &key, const CachedSong &cs)
+{
+    if (_songs.contains(key))
+        return;
+
+    _songs.insert(key, cs);
+    _lru.prepend(key);
+    _size += cs.bytes;
+
+    evict();
+}
+
+void SongCache::evict()
+{
+    for (int i=_lru.count()-1; i>=0 && _size > _budget; i--) {
+        QString key = _lru.at(i);
+        if (_wanted.contains(key))
+            continue;
+
+        _size -= _songs.value(key).bytes;
+        _songs.remove(key);
+        _lru.removeAt(i);
+    }
+}
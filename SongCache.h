@@ -0,0 +1,82 @@
+#ifndef SONGCACHE_H
+#define SONGCACHE_H
+
+#include <QThread>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QWaitCondition>
+
+#include "Song.h"
+#include "Midi/MidiFile.h"
+#include "Midi/MidiHelper.h"
+
+class SongDatabase;
+
+// A song ready to play, everything play() reads from disk
+typedef struct
+{
+    QSharedPointer<MidiFile> midi;
+    QString lyrics;
+    QVector<long> cursor;
+    QList<SignatureBeat> beats;
+    qint64 bytes;
+} CachedSong;
+
+// Reads the next songs of the playlist on its own thread while the
+// current one plays, and keeps recently played songs for next/replay.
+// Songs are dropped least recently used first when the cache is over
+// budget, the songs asked for by the last preload() are kept.
+class SongCache : public QThread
+{
+    Q_OBJECT
+public:
+    explicit SongCache(SongDatabase *db, qint64 budgetBytes = 256 * 1024 * 1024, QObject *parent = nullptr);
+    ~SongCache();
+
+    int aheadCount() { return _ahead; }
+    void setAheadCount(int count) { _ahead = count; }
+
+    qint64 budget() { return _budget; }
+    void setBudget(qint64 bytes);
+
+    // read these songs in the background, replaces the last request
+    void preload(const QList<Song> &songs);
+
+    // false when the song isn't read yet
+    bool find(const Song &song, CachedSong *cs);
+
+    void clear();
+    void stop();
+
+    qint64 sizeInBytes();
+
+    // blocking, also used by the worker
+    static bool readSong(SongDatabase *db, const Song &song, CachedSong *cs);
+
+protected:
+    void run();
+
+private:
+    static QString songKey(const Song &song);
+    void insert(const QString &key, const CachedSong &cs);
+    void evict();
+
+private:
+    SongDatabase *_db;
+    int _ahead = 3;
+    qint64 _budget;
+    qint64 _size = 0;
+
+    QHash<QString, CachedSong> _songs;
+    QStringList _lru;           // most recently used first
+    QStringList _wanted;        // keys of the last preload
+    QList<Song> _pending;
+    bool _quit = false;
+
+    QMutex _mutex;
+    QWaitCondition _wake;
+};
+
+#endif // SONGCACHE_H
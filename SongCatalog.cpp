@@ -0,0 +1,419 @@
+#include "SongCatalog.h"
+
+#include <QHash>
+#include <QSqlQuery>
+
+#include <algorithm>
+#include <cstring>
+
+#define CATALOG_VERSION     1
+#define CATALOG_FLAG_KAR    0x1
+
+// CatalogSong::text
+#define TEXT_ID         0
+#define TEXT_NAME       1
+#define TEXT_ARTIST     2
+#define TEXT_KEY        3
+#define TEXT_TYPE       4
+#define TEXT_LYRICS     5
+#define TEXT_PATH       6
+
+typedef struct
+{
+    qint64 songs;
+    qint64 orders;
+    qint64 grams;
+    qint64 postings;
+    qint64 text;
+    qint64 size;
+} CatalogLayout;
+
+static qint64 alignUp(qint64 v, qint64 a)
+{
+    return (v + a - 1) / a * a;
+}
+
+static CatalogLayout layoutFor(const CatalogHeader *h)
+{
+    CatalogLayout l;
+    l.songs = alignUp(sizeof(CatalogHeader), 8);
+    l.orders = l.songs + (qint64)(h->songCount) * sizeof(CatalogSong);
+    l.grams = alignUp(l.orders + (qint64)(h->songCount) * 3 * sizeof(quint32), 8);
+    l.postings = l.grams + (qint64)(h->gramCount) * sizeof(CatalogGram);
+    l.text = l.postings + (qint64)(h->postingCount) * sizeof(quint32);
+    l.size = l.text + (qint64)(h->textLength) * sizeof(ushort);
+    return l;
+}
+
+static int textField(CatalogField field)
+{
+    switch (field) {
+    case CatalogField::Id:      return TEXT_ID;
+    case CatalogField::Name:    return TEXT_NAME;
+    case CatalogField::Artist:  return TEXT_ARTIST;
+    case CatalogField::Lyrics:  return TEXT_LYRICS;
+    }
+    return TEXT_NAME;
+}
+
+
+SongCatalog::SongCatalog()
+{
+}
+
+SongCatalog::~SongCatalog()
+{
+    clear();
+}
+
+bool SongCatalog::build(QSqlDatabase *db, qint64 stamp)
+{
+    clear();
+
+    QVector<CatalogSong> songs;
+    QString pool;
+    QHash<QString, quint32> interned;
+
+    QSqlQuery q(*db);
+    q.setForwardOnly(true);
+    if (!q.exec("SELECT id, name, artist, keyname, songtype, lyrics, path, tempo FROM songs"))
+        return false;
+
+    while (q.next()) {
+        CatalogSong s;
+        for (int f=0; f<7; f++) {
+            QString v = q.value(f).toString();
+            quint32 offset;
+            auto it = interned.constFind(v);
+            if (it != interned.constEnd()) {
+                offset = it.value();
+            } else {
+                offset = pool.length();
+                pool.append(v);
+                interned.insert(v, offset);
+            }
+            s.text[f][0] = offset;
+            s.text[f][1] = v.length();
+        }
+        s.tempo = q.value(7).toInt();
+        s.flags = (q.value(4).toString() == "KAR") ? CATALOG_FLAG_KAR : 0;
+        songs.append(s);
+    }
+    q.finish();
+    q.clear();
+    interned.clear();
+
+    // first pass without orders and grams, enough to read the strings
+    CatalogHeader h;
+    memcpy(h.magic, "HKCT", 4);
+    h.version = CATALOG_VERSION;
+    h.stamp = stamp;
+    h.songCount = songs.count();
+    h.gramCount = 0;
+    h.postingCount = 0;
+    h.textLength = pool.length();
+
+    CatalogLayout l = layoutFor(&h);
+    _image = QByteArray(l.size, 0);
+    memcpy(_image.data(), &h, sizeof(h));
+    memcpy(_image.data() + l.songs, songs.constData(), songs.count() * sizeof(CatalogSong));
+    memcpy(_image.data() + l.text, pool.constData(), pool.length() * sizeof(ushort));
+    pool.clear();
+
+    if (!attach((const uchar*)_image.constData(), _image.size()))
+        return false;
+
+    // sorted like ORDER BY id, name, artist / name, artist, id / artist, name, id
+    QVector<quint32> orders[3];
+    CatalogField orderFields[3] = { CatalogField::Id, CatalogField::Name, CatalogField::Artist };
+    for (int o=0; o<3; o++) {
+        orders[o].resize(h.songCount);
+        for (quint32 i=0; i<h.songCount; i++)
+            orders[o][i] = i;
+        CatalogField f = orderFields[o];
+        std::sort(orders[o].begin(), orders[o].end(),
+                  [this, f](quint32 a, quint32 b) { return lessBy(f, a, b); });
+    }
+
+    // trigrams of name and lyrics, postings in song order
+    QHash<quint64, QVector<quint32>> postings;
+    for (quint32 i=0; i<h.songCount; i++) {
+        QSet<quint64> grams;
+        for (int f : { TEXT_NAME, TEXT_LYRICS }) {
+            QString folded = text(i, f).toCaseFolded();
+            for (int p=0; p+2<folded.length(); p++)
+                grams.insert(gramAt(folded, p));
+        }
+        for (quint64 g : grams)
+            postings[g].append(i);
+    }
+
+    QVector<quint64> keys = postings.keys().toVector();
+    std::sort(keys.begin(), keys.end());
+
+    QVector<CatalogGram> gramTable;
+    QVector<quint32> postingTable;
+    gramTable.reserve(keys.count());
+    for (quint64 k : keys) {
+        const QVector<quint32> &list = postings[k];
+        CatalogGram g;
+        g.gram = k;
+        g.offset = postingTable.count();
+        g.count = list.count();
+        gramTable.append(g);
+        postingTable += list;
+    }
+    postings.clear();
+
+    // final image
+    QByteArray first = _image;
+    CatalogLayout firstLayout = l;
+    _header = nullptr;
+
+    h.gramCount = gramTable.count();
+    h.postingCount = postingTable.count();
+    l = layoutFor(&h);
+
+    _image = QByteArray(l.size, 0);
+    char *d = _image.data();
+    memcpy(d, &h, sizeof(h));
+    memcpy(d + l.songs, first.constData() + firstLayout.songs, h.songCount * sizeof(CatalogSong));
+    for (int o=0; o<3; o++)
+        memcpy(d + l.orders + o * h.songCount * sizeof(quint32), orders[o].constData(), h.songCount * sizeof(quint32));
+    memcpy(d + l.grams, gramTable.constData(), gramTable.count() * sizeof(CatalogGram));
+    memcpy(d + l.postings, postingTable.constData(), postingTable.count() * sizeof(quint32));
+    memcpy(d + l.text, first.constData() + firstLayout.text, h.textLength * sizeof(ushort));
+
+    return attach((const uchar*)_image.constData(), _image.size());
+}
+
+bool SongCatalog::save(const QString &path)
+{
+    if (_image.isEmpty())
+        return false;
+
+    QFile f(path);
+    if (!f.open(QFile::WriteOnly))
+        return false;
+
+    bool result = (f.write(_image) == _image.size());
+    f.close();
+
+    if (!result)
+        f.remove();
+
+    return result;
+}
+
+bool SongCatalog::load(const QString &path, qint64 stamp)
+{
+    clear();
+
+    _file.setFileName(path);
+    if (!_file.open(QFile::ReadOnly))
+        return false;
+
+    _mapped = _file.map(0, _file.size());
+    if (_mapped == nullptr) {
+        _file.close();
+        return false;
+    }
+
+    if (!attach(_mapped, _file.size()) || _header->stamp != stamp) {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+void SongCatalog::clear()
+{
+    _header = nullptr;
+    _songs = nullptr;
+    _grams = nullptr;
+    _postings = nullptr;
+    _text = nullptr;
+    for (int o=0; o<3; o++)
+        _orders[o] = nullptr;
+    _size = 0;
+
+    if (_mapped != nullptr) {
+        _file.unmap(_mapped);
+        _mapped = nullptr;
+    }
+    if (_file.isOpen())
+        _file.close();
+
+    _image.clear();
+    _removed.clear();
+}
+
+bool SongCatalog::attach(const uchar *data, qint64 size)
+{
+    if (size < (qint64)sizeof(CatalogHeader))
+        return false;
+
+    const CatalogHeader *h = (const CatalogHeader*)data;
+    if (memcmp(h->magic, "HKCT", 4) != 0 || h->version != CATALOG_VERSION)
+        return false;
+
+    CatalogLayout l = layoutFor(h);
+    if (l.size != size)
+        return false;
+
+    _header = h;
+    _songs = (const CatalogSong*)(data + l.songs);
+    for (int o=0; o<3; o++)
+        _orders[o] = (const quint32*)(data + l.orders) + o * h->songCount;
+    _grams = (const CatalogGram*)(data + l.grams);
+    _postings = (const quint32*)(data + l.postings);
+    _text = (const ushort*)(data + l.text);
+    _size = size;
+
+    return true;
+}
+
+QString SongCatalog::text(int index, int field)
+{
+    const quint32 *t = _songs[index].text[field];
+    return QString::fromRawData((const QChar*)(_text + t[0]), t[1]);
+}
+
+Song SongCatalog::row(int index)
+{
+    Song r;
+    if (!isLoaded() || index < 0 || index >= count())
+        return r;
+
+    // deep copies, the rows may outlive the mapping
+    const CatalogSong &s = _songs[index];
+    r.setId(QString((const QChar*)(_text + s.text[TEXT_ID][0]), s.text[TEXT_ID][1]));
+    r.setName(QString((const QChar*)(_text + s.text[TEXT_NAME][0]), s.text[TEXT_NAME][1]));
+    r.setArtist(QString((const QChar*)(_text + s.text[TEXT_ARTIST][0]), s.text[TEXT_ARTIST][1]));
+    r.setKey(QString((const QChar*)(_text + s.text[TEXT_KEY][0]), s.text[TEXT_KEY][1]));
+    r.setTempo(s.tempo);
+    r.setSongType(QString((const QChar*)(_text + s.text[TEXT_TYPE][0]), s.text[TEXT_TYPE][1]));
+    r.setLyrics(QString((const QChar*)(_text + s.text[TEXT_LYRICS][0]), s.text[TEXT_LYRICS][1]));
+    r.setPath(QString((const QChar*)(_text + s.text[TEXT_PATH][0]), s.text[TEXT_PATH][1]));
+
+    return r;
+}
+
+bool SongCatalog::isKar(int index)
+{
+    return (_songs[index].flags & CATALOG_FLAG_KAR) != 0;
+}
+
+void SongCatalog::remove(const QString &id, const QString &name, const QString &songType, const QString &path)
+{
+    for (int i=0; i<count(); i++) {
+        if (text(i, TEXT_PATH) == path && text(i, TEXT_ID) == id
+                && text(i, TEXT_NAME) == name && text(i, TEXT_TYPE) == songType)
+            _removed.insert(i);
+    }
+}
+
+QVector<int> SongCatalog::prefix(CatalogField field, const QString &text)
+{
+    QVector<int> result;
+    if (!isLoaded() || field == CatalogField::Lyrics)
+        return result;
+
+    int o = (field == CatalogField::Id) ? 0 : (field == CatalogField::Name) ? 1 : 2;
+    int f = textField(field);
+    const quint32 *begin = _orders[o];
+    const quint32 *end = begin + count();
+    int n = text.length();
+
+    // sorted by the whole string, so the songs starting with text are one range
+    const quint32 *lo = std::lower_bound(begin, end, text,
+        [this, f, n](quint32 i, const QString &t) {
+            return this->text(i, f).leftRef(n).compare(t, Qt::CaseInsensitive) < 0;
+        });
+    const quint32 *hi = std::upper_bound(lo, end, text,
+        [this, f, n](const QString &t, quint32 i) {
+            return this->text(i, f).leftRef(n).compare(t, Qt::CaseInsensitive) > 0;
+        });
+
+    result.reserve(hi - lo);
+    for (const quint32 *it=lo; it<hi; it++) {
+        if (!_removed.contains(*it))
+            result.append(*it);
+    }
+
+    return result;
+}
+
+QVector<int> SongCatalog::contains(CatalogField field, const QString &text)
+{
+    QVector<int> result;
+    if (!isLoaded())
+        return result;
+
+    int f = textField(field);
+    QString folded = text.toCaseFolded();
+
+    if (folded.length() < 3) {
+        // no trigram to look up
+        for (int i=0; i<count(); i++) {
+            if (!_removed.contains(i) && this->text(i, f).contains(text, Qt::CaseInsensitive))
+                result.append(i);
+        }
+    } else {
+        // candidates from the rarest trigram of the text, then check them
+        const CatalogGram *gEnd = _grams + _header->gramCount;
+        const CatalogGram *best = nullptr;
+        for (int p=0; p+2<folded.length(); p++) {
+            quint64 g = gramAt(folded, p);
+            const CatalogGram *it = std::lower_bound(_grams, gEnd, g,
+                [](const CatalogGram &a, quint64 v) { return a.gram < v; });
+            if (it == gEnd || it->gram != g)
+                return result;
+            if (best == nullptr || it->count < best->count)
+                best = it;
+        }
+
+        for (quint32 k=0; k<best->count; k++) {
+            int i = _postings[best->offset + k];
+            if (!_removed.contains(i) && this->text(i, f).contains(text, Qt::CaseInsensitive))
+                result.append(i);
+        }
+    }
+
+    std::sort(result.begin(), result.end(),
+              [this](int a, int b) { return lessBy(CatalogField::Name, a, b); });
+
+    return result;
+}
+
+bool SongCatalog::lessBy(CatalogField field, int a, int b)
+{
+    int keys[3];
+    switch (field) {
+    case CatalogField::Id:
+        keys[0] = TEXT_ID; keys[1] = TEXT_NAME; keys[2] = TEXT_ARTIST;
+        break;
+    case CatalogField::Artist:
+        keys[0] = TEXT_ARTIST; keys[1] = TEXT_NAME; keys[2] = TEXT_ID;
+        break;
+    default:
+        keys[0] = TEXT_NAME; keys[1] = TEXT_ARTIST; keys[2] = TEXT_ID;
+        break;
+    }
+
+    for (int k=0; k<3; k++) {
+        int c = text(a, keys[k]).compare(text(b, keys[k]), Qt::CaseInsensitive);
+        if (c != 0)
+            return c < 0;
+    }
+
+    return a < b;
+}
+
+quint64 SongCatalog::gramAt(const QString &folded, int pos)
+{
+    return ((quint64)(folded.at(pos).unicode()) << 32)
+            | ((quint64)(folded.at(pos + 1).unicode()) << 16)
+            | (quint64)(folded.at(pos + 2).unicode());
+}
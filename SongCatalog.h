@@ -0,0 +1,106 @@
+#ifndef SONGCATALOG_H
+#define SONGCATALOG_H
+
+#include "SearchSession.h"
+
+#include <QFile>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QVector>
+
+
+enum class CatalogField {
+    Id,
+    Name,
+    Artist,
+    Lyrics
+};
+
+// 64 bytes, every string is an offset and length (UTF-16 units) in
+// the shared text block, equal strings are stored once
+typedef struct
+{
+    quint32 text[7][2];     // id, name, artist, key, songtype, lyrics, path
+    qint32  tempo;
+    quint32 flags;
+} CatalogSong;
+
+typedef struct
+{
+    quint64 gram;           // 3 case folded UTF-16 units
+    quint32 offset;         // in postings
+    quint32 count;
+} CatalogGram;
+
+typedef struct
+{
+    char    magic[4];
+    quint32 version;
+    qint64  stamp;
+    quint32 songCount;
+    quint32 gramCount;
+    quint32 postingCount;
+    quint32 textLength;
+} CatalogHeader;
+
+
+// Read-only copy of the songs table for search without SQLite.
+//
+// The snapshot file is the same image that is searched: header, songs,
+// the song indexes sorted like the SQL ORDER BY of id, name and artist
+// (a binary search over them gives the prefix range, a flattened trie),
+// a trigram index over name and lyrics with its posting lists, and the
+// text block. load() maps the file and strings are read in place.
+class SongCatalog
+{
+public:
+    SongCatalog();
+    ~SongCatalog();
+
+    bool build(QSqlDatabase *db, qint64 stamp);
+    bool save(const QString &path);
+    bool load(const QString &path, qint64 stamp);
+    void clear();
+
+    bool isLoaded() { return _header != nullptr; }
+    int count() { return isLoaded() ? _header->songCount : 0; }
+    qint64 stamp() { return isLoaded() ? _header->stamp : 0; }
+
+    // size of the image, mapped or in memory
+    qint64 sizeInBytes() { return _size; }
+
+    Song row(int index);
+    bool isKar(int index);
+
+    // hide a deleted song until the next snapshot
+    void remove(const QString &id, const QString &name, const QString &songType, const QString &path);
+
+    // Id, Name, Artist, in the SQL order of that column
+    QVector<int> prefix(CatalogField field, const QString &text);
+
+    // Name, Lyrics, ordered by name, artist, id
+    QVector<int> contains(CatalogField field, const QString &text);
+
+private:
+    bool attach(const uchar *data, qint64 size);
+    QString text(int index, int field);
+    bool lessBy(CatalogField field, int a, int b);
+    static quint64 gramAt(const QString &folded, int pos);
+
+private:
+    QByteArray _image;      // built in memory
+    QFile _file;            // or mapped
+    uchar *_mapped = nullptr;
+    qint64 _size = 0;
+
+    const CatalogHeader *_header = nullptr;
+    const CatalogSong *_songs = nullptr;
+    const quint32 *_orders[3] = { nullptr, nullptr, nullptr };
+    const CatalogGram *_grams = nullptr;
+    const quint32 *_postings = nullptr;
+    const ushort *_text = nullptr;
+
+    QSet<int> _removed;
+};
+
+#endif // SONGCATALOG_H
@@ -1,21 +1,32 @@
 #include "SongDatabase.h"
 
 #include "Midi/MidiFile.h"
-#include "Midi/HNKFile.h"
 #include "Config.h"
+#include "Utils.h"
 
+#include <QDateTime>
+#include <QDebug>
 #include <QDir>
-#include <QDirIterator>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
 #include <QSqlQuery>
 #include <QTextStream>
 
+#define SCAN_INSERT_ROWS            90
+#define SCAN_COMMIT_ROWS            2000
+#define SCAN_PROGRESS_INTERVAL_MS   100
+#define SCAN_CONNECTION_NAME        "SongDatabaseScan"
+
 
 SongDatabase::SongDatabase()
 {
-    song = new Song();
     searchType = SearchType::ByAll;
 
+    connect(this, SIGNAL(songsChanged()),
+            this, SLOT(onSongsChanged()), Qt::QueuedConnection);
+
     bool hasDb = false;
 
     if (QFile::exists(Config::DATABASE_FILE_PATH)) {
@@ -41,7 +52,9 @@ SongDatabase::SongDatabase()
                         "tempo    INTEGER,"
                         "songtype TEXT,"
                         "lyrics   TEXT,"
-                        "path     TEXT"
+                        "path     TEXT,"
+                        "filesize INTEGER,"
+                        "mtime    INTEGER"
                     ")";
 
             QSqlQuery query(db);
@@ -59,20 +72,24 @@ SongDatabase::SongDatabase()
             query.finish();
             query.clear();
 
-            createIndex();
+            createIndex(db);
         }
         db.close();
     }
 
-    db.open();
+    if (db.open())
+        updateSchema();
 }
 
 SongDatabase::~SongDatabase()
 {
+    session.clear();
+    if (catalog != nullptr)
+        delete catalog;
+
     if (db.isOpen()) {
         db.close();
     }
-    delete song;
 }
 
 bool SongDatabase::isNewVersion()
@@ -108,6 +125,9 @@ void SongDatabase::updateToNewVersion()
     q.exec("vacuum");
     q.finish();
     q.clear();
+
+    // after vacuum, it may renumber the rowids songs_fts points at
+    updateSchema();
 }
 
 int SongDatabase::count()
@@ -200,32 +220,88 @@ void SongDatabase::setUpdateType(UpdateType type)
 
 bool SongDatabase::insertNCN(const QString &ncnPath, const QString &songId, const QString &midFilePath)
 {
-    QString id = songId;
+    ScanResult r = readNCN(ncnPath, songId, midFilePath);
+    if (!r.valid)
+        return false;
 
-    QString curFilePath = getCurFilePath(midFilePath);
-    QString lyrFilePath = getLyrFilePath(midFilePath);
+    return insertSongs(db, QVector<ScanResult>() << r);
+}
 
-    if (curFilePath == "" || lyrFilePath == "")
+bool SongDatabase::insertHNK(const QString &hnkPath, const QString &songId, const QString &hnkFilePath)
+{
+    ScanResult r = readHNK(hnkPath, songId, hnkFilePath);
+    if (!r.valid)
         return false;
 
+    return insertSongs(db, QVector<ScanResult>() << r);
+}
+
+bool SongDatabase::insertKAR(const QString &karPath, const QString &songId, const QString &karFilePath, const QString &fileName)
+{
+    ScanResult r = readKAR(karPath, songId, karFilePath, fileName);
+    if (!r.valid)
+        return false;
+
+    return insertSongs(db, QVector<ScanResult>() << r);
+}
+
+ScanResult SongDatabase::readSong(const ScanJob &job)
+{
+    ScanResult r;
+    if (job.songType == "NCN")
+        r = readNCN(job.rootPath, job.fileName.section(".", 0, 0), job.filePath, job.curPath, job.lyrPath);
+    else if (job.songType == "HNK")
+        r = readHNK(job.rootPath, job.fileName.section(".", 0, 0), job.filePath);
+    else
+        r = readKAR(job.rootPath, "-------", job.filePath, job.fileName);
+
+    // keep the row key even when the file can't be read, a changed
+    // file that broke still has to lose its old row
+    r.songType = job.songType;
+    r.path = job.path;
+    r.replace = job.replace;
+
+    return r;
+}
+
+ScanResult SongDatabase::readNCN(const QString &ncnPath, const QString &songId, const QString &midFilePath)
+{
+    return readNCN(ncnPath, songId, midFilePath, getCurFilePath(midFilePath), getLyrFilePath(midFilePath));
+}
+
+ScanResult SongDatabase::readNCN(const QString &ncnPath, const QString &songId, const QString &midFilePath,
+                                 const QString &curFilePath, const QString &lyrFilePath)
+{
+    ScanResult r;
+    r.valid = false;
+    r.tempo = 0;
+    r.replace = false;
+
+    QFileInfo info(midFilePath);
+    r.fileName = info.fileName();
+    r.size = info.size();
+    r.mtime = info.lastModified().toMSecsSinceEpoch();
+
+    if (curFilePath == "" || lyrFilePath == "")
+        return r;
+
     // Check mid file
     int bpm = MidiFile::firstBpm(midFilePath);
     if (bpm == 0)
-        return false;
+        return r;
 
 
     // Read .LYR file
     QFile file(lyrFilePath);
     if (!file.open(QFile::ReadOnly))
-        return false;
+        return r;
 
     QTextStream textStream(&file);
     textStream.setCodec("TIS-620");
 
-    QString name = textStream.readLine();
-    QString artist = textStream.readLine();
-    QString key = textStream.readLine();
-    QString type = "NCN";
+    r.name = textStream.readLine();
+    r.artist = textStream.readLine();
+    r.key = textStream.readLine();
 
     textStream.readLine();
 
@@ -239,44 +315,40 @@ bool SongDatabase::insertNCN(const QString &ncnPath, const QString &songId, cons
     QString path = midFilePath;
     path = path.replace(ncnPath, "");
 
-    // Insert to database
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO songs VALUES "
-                  "(?, ?, ?, ?, ?, ?, ?, ?);");
-    query.bindValue(0, id);
-    query.bindValue(1, name);
-    query.bindValue(2, artist);
-    query.bindValue(3, key);
-    query.bindValue(4, bpm);
-    query.bindValue(5, type);
-    query.bindValue(6, lyr);
-    query.bindValue(7, path);
-
-    query.exec();
-    query.finish();
-    query.clear();
+    r.id = songId;
+    r.tempo = bpm;
+    r.songType = "NCN";
+    r.lyrics = lyr;
+    r.path = path;
+    r.valid = true;
 
-    return true;
+    return r;
 }
 
-bool SongDatabase::insertHNK(const QString &hnkPath, const QString &songId, const QString &hnkFilePath)
+ScanResult SongDatabase::readHNK(const QString &hnkPath, const QString &songId, const QString &hnkFilePath)
 {
-    QString id = songId;
+    ScanResult r;
+    r.valid = false;
+    r.tempo = 0;
+    r.replace = false;
 
-    int bpm = HNKFile::bpm(hnkFilePath);
-    if (bpm == 0)
-        return false;
+    QFileInfo info(hnkFilePath);
+    r.fileName = info.fileName();
+    r.size = info.size();
+    r.mtime = info.lastModified().toMSecsSinceEpoch();
+
+    HNKSong hnk;
+    if (!Utils::readHNK(hnkFilePath, &hnk, HNKBpm | HNKLyrics))
+        return r;
 
     // Read Lyrics
-    QByteArray lyrData = HNKFile::lyrData(hnkFilePath);
 
-    QTextStream textStream(&lyrData);
+    QTextStream textStream(&hnk.lyrData);
     textStream.setCodec("TIS-620");
 
-    QString name = textStream.readLine();
-    QString artist = textStream.readLine();
-    QString key = textStream.readLine();
-    QString type = "HNK";
+    r.name = textStream.readLine();
+    r.artist = textStream.readLine();
+    r.key = textStream.readLine();
 
     textStream.readLine();
 
@@ -288,40 +360,35 @@ bool SongDatabase::insertHNK(const QString &hnkPath, const QString &songId, cons
     QString path = hnkFilePath;
     path = path.replace(hnkPath, "");
 
-    // Insert to database
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO songs VALUES "
-                  "(?, ?, ?, ?, ?, ?, ?, ?);");
-    query.bindValue(0, id);
-    query.bindValue(1, name);
-    query.bindValue(2, artist);
-    query.bindValue(3, key);
-    query.bindValue(4, bpm);
-    query.bindValue(5, type);
-    query.bindValue(6, lyr);
-    query.bindValue(7, path);
-
-    query.exec();
-    query.finish();
-    query.clear();
+    r.id = songId;
+    r.tempo = hnk.bpm;
+    r.songType = "HNK";
+    r.lyrics = lyr;
+    r.path = path;
+    r.valid = true;
 
-    return true;
+    return r;
 }
 
-bool SongDatabase::insertKAR(const QString &karPath, const QString &songId, const QString &karFilePath, const QString &fileName)
+ScanResult SongDatabase::readKAR(const QString &karPath, const QString &songId, const QString &karFilePath, const QString &fileName)
 {
-    QString id = songId;
+    ScanResult r;
+    r.valid = false;
+    r.tempo = 0;
+    r.replace = false;
+
+    QFileInfo info(karFilePath);
+    r.fileName = fileName;
+    r.size = info.size();
+    r.mtime = info.lastModified().toMSecsSinceEpoch();
 
     MidiFile mid;
     if (!mid.read(karFilePath))
-        return false;
+        return r;
 
     int bpm = 120;
     if (mid.tempoEvents().size() > 0)
-        bpm = mid.tempoEvents()[0]->bpm();
-
-    QString name = fileName.section(".", 0, 0);
-    QString type = "KAR";
+        bpm = mid.tempoEvents()[0].bpm();
 
     QString path = karFilePath;
     path = path.replace(karPath, "");
@@ -337,28 +404,72 @@ bool SongDatabase::insertKAR(const QString &karPath, const QString &songId, cons
     if (lyrics.size() > 3)
         lyr += lyrics[3];
 
-    QSqlQuery query(db);
-    query.prepare("INSERT INTO songs VALUES "
-                  "(?, ?, ?, ?, ?, ?, ?, ?);");
-    query.bindValue(0, id);
-    query.bindValue(1, name);
-    query.bindValue(2, "");
-    query.bindValue(3, "");
-    query.bindValue(4, bpm);
-    query.bindValue(5, type);
-    query.bindValue(6, lyr);
-    query.bindValue(7, path);
-
-    query.exec();
+    r.id = songId;
+    r.name = fileName.section(".", 0, 0);
+    r.artist = "";
+    r.key = "";
+    r.tempo = bpm;
+    r.songType = "KAR";
+    r.lyrics = lyr;
+    r.path = path;
+    r.valid = true;
+
+    return r;
+}
+
+bool SongDatabase::insertSongs(QSqlDatabase &con, const QVector<ScanResult> &songs)
+{
+    // multi-row INSERT, 10 columns x SCAN_INSERT_ROWS stays under the
+    // SQLite host parameter limit (999)
+    QSqlQuery query(con);
+    int preparedRows = 0;
+    bool result = true;
+
+    for (int start=0; start<songs.count(); start += SCAN_INSERT_ROWS) {
+        int rows = qMin(SCAN_INSERT_ROWS, songs.count() - start);
+
+        if (rows != preparedRows) {
+            QString sql = "INSERT INTO songs "
+                          "(id, name, artist, keyname, tempo, songtype, lyrics, path, filesize, mtime) "
+                          "VALUES ";
+            for (int i=0; i<rows; i++) {
+                if (i > 0)
+                    sql += ", ";
+                sql += "(?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+            }
+            if (!query.prepare(sql))
+                return false;
+            preparedRows = rows;
+        }
+
+        for (int i=0; i<rows; i++) {
+            const ScanResult &r = songs.at(start + i);
+            int c = i * 10;
+            query.bindValue(c + 0, r.id);
+            query.bindValue(c + 1, r.name);
+            query.bindValue(c + 2, r.artist);
+            query.bindValue(c + 3, r.key);
+            query.bindValue(c + 4, r.tempo);
+            query.bindValue(c + 5, r.songType);
+            query.bindValue(c + 6, r.lyrics);
+            query.bindValue(c + 7, r.path);
+            query.bindValue(c + 8, r.size);
+            query.bindValue(c + 9, r.mtime);
+        }
+
+        if (!query.exec())
+            result = false;
+    }
+
     query.finish();
     query.clear();
 
-    return true;
+    return result;
 }
 
 Song* SongDatabase::nextType(const QString &s)
 {
-    Song *sg = song;
+    Song *sg = &song;
     switch (searchType) {
     case SearchType::ByAll:
         searchType = SearchType::ById;
@@ -373,6 +484,7 @@ Song* SongDatabase::nextType(const QString &s)
         sg = search(_searchText);
         break;
     case SearchType::ByArtist:
+    case SearchType::ByLyrics:
         searchType = SearchType::ByAll;
         sg = search(_searchText);
         break;
@@ -380,174 +492,227 @@ Song* SongDatabase::nextType(const QString &s)
     return sg;
 }
 
-void setSong(Song *s, QSqlQuery *qry) {
-    s->setId(qry->value(0).toString());
-    s->setName(qry->value(1).toString());
-    s->setArtist(qry->value(2).toString());
-    s->setKey(qry->value(3).toString());
-    s->setTempo(qry->value(4).toInt());
-    s->setSongType(qry->value(5).toString());
-    s->setLyrics(qry->value(6).toString());
-    s->setPath(qry->value(7).toString());
-
-    s->setBpmSpeed(0);
-    s->setTranspose(0);
-}
-
-Song *SongDatabase::search(const QString &s)
+QString SongDatabase::searchSql()
 {
+    // KAR names and lyrics are substring matches, the trigram index in
+    // songs_fts answers those instead of a LIKE '%..%' scan of songs
+    bool fts = ftsEnabled.load();
+    QString karName = fts
+            ? "rowid IN (SELECT rowid FROM songs_fts WHERE name LIKE ?)"
+            : "name LIKE ?";
+
     QString sql = "";
-    _searchText = s;
-    currentResultIndex = 0;
 
     switch (searchType) {
     case SearchType::ByAll:
-        sql = "SELECT * FROM (SELECT * FROM songs WHERE id LIKE ? AND songtype != 'KAR' ORDER BY id LIMIT 1) "
+        sql = "SELECT * FROM (SELECT * FROM songs WHERE id LIKE ? AND songtype != 'KAR' ORDER BY id, name, artist) "
               "UNION ALL "
-              "SELECT * FROM (SELECT * FROM songs WHERE name LIKE ? AND songtype != 'KAR' ORDER BY name LIMIT 1) "
+              "SELECT * FROM (SELECT * FROM songs WHERE name LIKE ? AND songtype != 'KAR' ORDER BY name, artist, id) "
               "UNION ALL "
-              "SELECT * FROM (SELECT * FROM songs WHERE artist LIKE ? AND songtype != 'KAR' ORDER BY artist LIMIT 1) "
+              "SELECT * FROM (SELECT * FROM songs WHERE artist LIKE ? AND songtype != 'KAR' ORDER BY artist, name, id) "
               "UNION ALL "
-              "SELECT * FROM (SELECT * FROM songs WHERE name LIKE ? AND songtype = 'KAR' ORDER BY name LIMIT 1) "
-              "LIMIT 1";
+              "SELECT * FROM (SELECT * FROM songs WHERE " + karName + " AND songtype = 'KAR' ORDER BY name, artist, id) ";
         break;
     case SearchType::ById:
         sql = "SELECT * FROM songs WHERE id LIKE ? "
-              "ORDER BY id, name, artist LIMIT 1";
+              "ORDER BY id, name, artist";
         break;
     case SearchType::ByName:
         sql = "SELECT * FROM songs WHERE name LIKE ? "
-              "ORDER BY name, artist, id LIMIT 1";
+              "ORDER BY name, artist, id";
         break;
     case SearchType::ByArtist:
         sql = "SELECT * FROM songs WHERE artist LIKE ? "
-              "ORDER BY artist, name, id LIMIT 1";
+              "ORDER BY artist, name, id";
+        break;
+    case SearchType::ByLyrics:
+        // ranked (bm25), trigram MATCH needs at least 3 characters
+        if (fts && _searchText.length() >= 3)
+            sql = "SELECT songs.* FROM songs_fts JOIN songs ON songs.rowid = songs_fts.rowid "
+                  "WHERE songs_fts MATCH ? "
+                  "ORDER BY songs_fts.rank, songs.name, songs.id";
+        else
+            sql = "SELECT * FROM songs WHERE lyrics LIKE ? "
+                  "ORDER BY name, artist, id";
         break;
     }
 
-    QSqlQuery query(db);
-    if (searchType == SearchType::ByAll) {
-        query.prepare(sql);
-        query.bindValue(0, s + "%");
-        query.bindValue(1, s + "%");
-        query.bindValue(2, s + "%");
-        query.bindValue(3, "%" + s + "%");
-    } else {
-        query.prepare(sql);
-        query.bindValue(0, s + "%");
-    }
-
-    if (query.exec()) {
-        if (query.next()) {
-            setSong(song, &query);
-        }
-    }
-    query.finish();
-    query.clear();
-
-    return song;
+    return sql;
 }
 
-Song *SongDatabase::searchNext()
+QVariantList SongDatabase::searchValues()
 {
-    QString sql = "";
+    QVariantList values;
 
     switch (searchType) {
     case SearchType::ByAll:
-        sql = "SELECT * FROM (SELECT * FROM songs WHERE id LIKE ? AND songtype != 'KAR' ORDER BY id, name, artist) "
-              "UNION ALL "
-              "SELECT * FROM (SELECT * FROM songs WHERE name LIKE ? AND songtype != 'KAR' ORDER BY name, artist, id) "
-              "UNION ALL "
-              "SELECT * FROM (SELECT * FROM songs WHERE artist LIKE ? AND songtype != 'KAR' ORDER BY artist, name, id) "
-              "UNION ALL "
-              "SELECT * FROM (SELECT * FROM songs WHERE name LIKE ? AND songtype = 'KAR' ORDER BY name, artist, id) ";
-        break;
-    case SearchType::ById:
-        sql = "SELECT * FROM songs WHERE id LIKE ? "
-              "ORDER BY id, name, artist";
+        values << _searchText + "%"
+               << _searchText + "%"
+               << _searchText + "%"
+               << "%" + _searchText + "%";
         break;
-    case SearchType::ByName:
-        sql = "SELECT * FROM songs WHERE name LIKE ? "
-              "ORDER BY name, artist, id";
+    case SearchType::ByLyrics:
+        if (ftsEnabled.load() && _searchText.length() >= 3) {
+            QString phrase = _searchText;
+            values << "lyrics : \"" + phrase.replace("\"", "\"\"") + "\"";
+        } else {
+            values << "%" + _searchText + "%";
+        }
         break;
-    case SearchType::ByArtist:
-        sql = "SELECT * FROM songs WHERE artist LIKE ? "
-              "ORDER BY artist, name, id";
+    default:
+        values << _searchText + "%";
         break;
     }
 
-    QSqlQuery q(db);
-    q.prepare(sql);
+    return values;
+}
 
-    if (searchType == SearchType::ByAll) {
-        q.bindValue(0, _searchText + "%");
-        q.bindValue(1, _searchText + "%");
-        q.bindValue(2, _searchText + "%");
-        q.bindValue(3, "%" + _searchText + "%");
-    } else {
-        q.bindValue(0, _searchText + "%");
-    }
+Song *SongDatabase::search(const QString &s)
+{
+    _searchText = s;
+    currentResultIndex = 0;
+
+    if (catalog != nullptr)
+        reloadCatalog();
+
+    if (catalog != nullptr && catalog->isLoaded())
+        session.start(catalog, catalogSearch());
+    else
+        session.start(&db, searchSql(), searchValues());
 
-    if (q.exec() && q.seek(currentResultIndex + 1)) {
+    Song r;
+    if (session.row(0, &r))
+        song = r;
+
+    return &song;
+}
+
+Song *SongDatabase::searchNext()
+{
+    Song r;
+    if (session.row(currentResultIndex + 1, &r)) {
         currentResultIndex++;
-        setSong(song, &q);
+        song = r;
     }
 
-    q.finish();
-    q.clear();
-
-    return song;
+    return &song;
 }
 
 Song *SongDatabase::searchPrevious()
 {
-    QString sql = "";
+    Song r;
+    if (session.row(currentResultIndex - 1, &r)) {
+        currentResultIndex--;
+        song = r;
+    }
+
+    return &song;
+}
+
+QVector<Song> SongDatabase::searchResults(int from, int count)
+{
+    return session.rows(from, count);
+}
+
+QVector<int> SongDatabase::catalogSearch()
+{
+    QVector<int> result;
 
     switch (searchType) {
     case SearchType::ByAll:
-        sql = "SELECT * FROM (SELECT * FROM songs WHERE id LIKE ? AND songtype != 'KAR' ORDER BY id, name, artist) "
-              "UNION ALL "
-              "SELECT * FROM (SELECT * FROM songs WHERE name LIKE ? AND songtype != 'KAR' ORDER BY name, artist, id) "
-              "UNION ALL "
-              "SELECT * FROM (SELECT * FROM songs WHERE artist LIKE ? AND songtype != 'KAR' ORDER BY artist, name, id) "
-              "UNION ALL "
-              "SELECT * FROM (SELECT * FROM songs WHERE name LIKE ? AND songtype = 'KAR' ORDER BY name, artist, id) ";
+        // same parts and order as the UNION in searchSql()
+        for (CatalogField f : { CatalogField::Id, CatalogField::Name, CatalogField::Artist }) {
+            for (int i : catalog->prefix(f, _searchText)) {
+                if (!catalog->isKar(i))
+                    result.append(i);
+            }
+        }
+        for (int i : catalog->contains(CatalogField::Name, _searchText)) {
+            if (catalog->isKar(i))
+                result.append(i);
+        }
         break;
     case SearchType::ById:
-        sql = "SELECT * FROM songs WHERE id LIKE ? "
-              "ORDER BY id, name, artist";
+        result = catalog->prefix(CatalogField::Id, _searchText);
         break;
     case SearchType::ByName:
-        sql = "SELECT * FROM songs WHERE name LIKE ? "
-              "ORDER BY name, artist, id";
+        result = catalog->prefix(CatalogField::Name, _searchText);
         break;
     case SearchType::ByArtist:
-        sql = "SELECT * FROM songs WHERE artist LIKE ? "
-              "ORDER BY artist, name, id";
+        result = catalog->prefix(CatalogField::Artist, _searchText);
+        break;
+    case SearchType::ByLyrics:
+        result = catalog->contains(CatalogField::Lyrics, _searchText);
         break;
     }
 
-    QSqlQuery q(db);
-    q.prepare(sql);
+    return result;
+}
+
+void SongDatabase::setUseCatalog(bool use)
+{
+    if (use == (catalog != nullptr))
+        return;
+
+    session.clear();
 
-    if (searchType == SearchType::ByAll) {
-        q.bindValue(0, _searchText + "%");
-        q.bindValue(1, _searchText + "%");
-        q.bindValue(2, _searchText + "%");
-        q.bindValue(3, "%" + _searchText + "%");
+    if (use) {
+        catalog = new SongCatalog();
+        loadCatalog();
     } else {
-        q.bindValue(0, _searchText + "%");
+        delete catalog;
+        catalog = nullptr;
     }
+}
 
-    if (q.exec() && q.seek(currentResultIndex - 1)) {
-        currentResultIndex--;
-        setSong(song, &q);
+QString SongDatabase::catalogFilePath(qint64 stamp)
+{
+    return Config::DATABASE_DIR_PATH + "/Catalog-" + QString::number(stamp) + ".bin";
+}
+
+bool SongDatabase::loadCatalog()
+{
+    // snapshot of the last scan, or build it once from the table
+    qint64 stamp = miscValue(db, "catalog_stamp").toLongLong();
+    if (stamp > 0 && catalog->load(catalogFilePath(stamp), stamp)) {
+        snapshotStamp.store(stamp);
+        return true;
     }
 
-    q.finish();
-    q.clear();
+    stamp = QDateTime::currentMSecsSinceEpoch();
+    if (!catalog->build(&db, stamp))
+        return false;
+
+    if (catalog->save(catalogFilePath(stamp))) {
+        setMiscValue(db, "catalog_stamp", QString::number(stamp));
+        catalog->load(catalogFilePath(stamp), stamp);
+        removeOldCatalogs(stamp);
+    }
+    snapshotStamp.store(stamp);
+
+    return catalog->isLoaded();
+}
 
-    return song;
+void SongDatabase::reloadCatalog()
+{
+    qint64 stamp = snapshotStamp.load();
+    if (stamp == 0 || stamp == catalog->stamp())
+        return;
+
+    session.clear();
+    catalog->load(catalogFilePath(stamp), stamp);
+    removeOldCatalogs(stamp);
+}
+
+void SongDatabase::removeOldCatalogs(qint64 keepStamp)
+{
+    QDir dir(Config::DATABASE_DIR_PATH);
+    QString keep = QFileInfo(catalogFilePath(keepStamp)).fileName();
+
+    for (const QString &name : dir.entryList(QStringList() << "Catalog-*.bin", QDir::Files)) {
+        if (name != keep)
+            dir.remove(name);
+    }
 }
 
 bool SongDatabase::removeCurrentSong(bool removeFromStorage)
@@ -556,10 +721,10 @@ bool SongDatabase::removeCurrentSong(bool removeFromStorage)
 
    QSqlQuery q(db);
    q.prepare(sql);
-   q.bindValue(0, song->id());
-   q.bindValue(1, song->name());
-   q.bindValue(2, song->songType());
-   q.bindValue(3, song->path());
+   q.bindValue(0, song.id());
+   q.bindValue(1, song.name());
+   q.bindValue(2, song.songType());
+   q.bindValue(3, song.path());
 
    if (!q.exec())
        return false;
@@ -569,11 +734,20 @@ bool SongDatabase::removeCurrentSong(bool removeFromStorage)
 
    currentResultIndex--;
 
+   if (catalog != nullptr && catalog->isLoaded()) {
+       // the snapshot is out of date, build it again on next start
+       catalog->remove(song.id(), song.name(), song.songType(), song.path());
+       setMiscValue(db, "catalog_stamp", "0");
+       session.start(catalog, catalogSearch());
+   } else {
+       session.invalidate();
+   }
+
    if (removeFromStorage)
    {
-       if (song->songType() == "NCN")
+       if (song.songType() == "NCN")
        {
-           QString midFilePath = _ncnPath + song->path();
+           QString midFilePath = _ncnPath + song.path();
            QString curFilePath = getCurFilePath(midFilePath);
            QString lyrFilePath = getLyrFilePath(midFilePath);
 
@@ -586,15 +760,15 @@ bool SongDatabase::removeCurrentSong(bool removeFromStorage)
            f.setFileName(lyrFilePath);
            f.remove();
        }
-       else if (song->songType() == "HNK")
+       else if (song.songType() == "HNK")
        {
-           QString path = _hnkPath + song->path();
+           QString path = _hnkPath + song.path();
            QFile f(path);
            f.remove();
        }
-       else if (song->songType() == "KAR")
+       else if (song.songType() == "KAR")
        {
-           QString path = _karPath + song->path();
+           QString path = _karPath + song.path();
            QFile f(path);
            f.remove();
        }
@@ -613,121 +787,192 @@ void SongDatabase::run()
         return;
     }
 
-    int count = 0;
-
-    // Count mid file in NCN
-    QDir dir(_ncnPath + "/Song");
-    QDir hnkDir(_hnkPath);
-    QDir karDir(_karPath);
-
-    QDirIterator iter1(dir.path() ,QStringList() << "*.mid" << "*.MID",
-                    QDir::Files, QDirIterator::Subdirectories);
-    while (iter1.hasNext()) {
-        iter1.next();
-        count++;
+    // db belongs to the GUI thread, a connection can't be shared
+    // between threads
+    {
+        QSqlDatabase con = QSqlDatabase::addDatabase("QSQLITE", SCAN_CONNECTION_NAME);
+        con.setDatabaseName(Config::DATABASE_FILE_PATH);
+        if (con.open()) {
+            scan(con);
+            con.close();
+        }
     }
+    QSqlDatabase::removeDatabase(SCAN_CONNECTION_NAME);
+}
 
-    QDirIterator iter2(hnkDir.path() ,QStringList() << "*.hnk" << "*.HNK",
-                    QDir::Files, QDirIterator::Subdirectories);
-    while (iter2.hasNext()) {
-        iter2.next();
-        count++;
-    }
+void SongDatabase::scan(QSqlDatabase &con)
+{
+    // Incremental only when the table was built from the same folders,
+    // it keeps the rows and indexes so search works during the update.
+    bool incremental = (upType == UpdateType::UpdateChanged)
+            && miscValue(con, "ncn_path") == _ncnPath
+            && miscValue(con, "hnk_path") == _hnkPath
+            && miscValue(con, "kar_path") == _karPath;
 
-    QDirIterator iter3(karDir.path() ,QStringList() << "*.kar" << "*.KAR" << "*.mid" << "*.MID",
-                    QDir::Files, QDirIterator::Subdirectories);
-    while (iter3.hasNext()) {
-        iter3.next();
-        count++;
-    }
+    QHash<QString, SongFingerprint> known;
+    if (incremental)
+        known = fingerprints(con);
 
-    upCount = count;
-    emit updateCountChanged(count);
+    upCount = 0;
+    emit updateCountChanged(0);
 
     upTing = true;
 
-    QSqlQuery q(db);
-    q.exec("DELETE FROM songs");
-    q.exec("vacuum");
-    q.finish();
-    q.clear();
-
-    db.transaction();
-
-    dropIndex();
+    // full rebuild, indexes and songs_fts go first so the delete
+    // doesn't go through the fts triggers row by row
+    if (!incremental) {
+        dropIndex(con);
+        emit songsChanged();
 
+        QSqlQuery q(con);
+        q.exec("DELETE FROM songs");
+        q.exec("vacuum");
+        q.finish();
+        q.clear();
+    }
 
-    // Update NCN
-    int i = 0;
-    int erCount = 0;
-    QDirIterator it(dir.path() ,QStringList() << "*.mid" << "*.MID",
-                     QDir::Files, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-
-        it.next();
-
-        i++;
-        emit updatePositionChanged(i);
-        emit updateSongNameChanged(it.fileName());
-
-        QString id = it.fileName().section(".", 0, 0);
+    // commits in batches, a search on the GUI thread waits for the
+    // write lock at most one batch long
+    con.transaction();
+    int uncommitted = 0;
 
-        bool result = insertNCN(_ncnPath, id, it.filePath());
+    // walker -> workers (parse metadata) -> this thread (batched INSERT)
+    ScanQueue<ScanJob> jobs;
+    ScanQueue<ScanResult> results;
+    QAtomicInt found(0);
 
-        if (!result)
-            erCount ++;
-    }
+    int workerCount = qBound(2, QThread::idealThreadCount(), 8);
+    QAtomicInt running(workerCount);
 
+    SongDirWalker walker(_ncnPath, _hnkPath, _karPath, &jobs, &found,
+                         incremental ? &known : nullptr);
+    QList<SongScanWorker*> workers;
+    for (int w=0; w<workerCount; w++)
+        workers.append(new SongScanWorker(&jobs, &results, &running));
 
-    // Update HNK
-    QDirIterator it2(hnkDir.path() ,QStringList() << "*.hnk" << "*.HNK",
-                     QDir::Files, QDirIterator::Subdirectories);
-    while (it2.hasNext()) {
+    walker.start();
+    for (SongScanWorker *worker : workers)
+        worker->start();
 
-        it2.next();
+    int i = 0;
+    int erCount = 0;
+    QString lastName = "";
+
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+
+    QSqlQuery del(con);
+    del.prepare("DELETE FROM songs WHERE songtype = ? AND path = ?");
+
+    QVector<ScanResult> batch;
+    QVector<ScanResult> valid;
+    batch.reserve(SCAN_INSERT_ROWS * 4);
+    valid.reserve(SCAN_INSERT_ROWS * 4);
+
+    bool open = true;
+    while (open || !batch.isEmpty()) {
+
+        open = results.popMany(&batch, SCAN_INSERT_ROWS * 4, SCAN_PROGRESS_INTERVAL_MS);
+
+        for (const ScanResult &r : batch) {
+            i++;
+            lastName = r.fileName;
+            if (r.replace) {
+                del.bindValue(0, r.songType);
+                del.bindValue(1, r.path);
+                del.exec();
+            }
+            if (r.valid)
+                valid.append(r);
+            else
+                erCount++;
+        }
+        batch.clear();
 
-        i++;
-        emit updatePositionChanged(i);
-        emit updateSongNameChanged(it2.fileName());
+        if (valid.count() >= SCAN_INSERT_ROWS || (!open && !valid.isEmpty())) {
+            uncommitted += valid.count();
+            insertSongs(con, valid);
+            valid.clear();
+        }
 
-        QString hnkId = it2.fileName().section(".", 0, 0);
+        if (uncommitted >= SCAN_COMMIT_ROWS) {
+            con.commit();
+            con.transaction();
+            uncommitted = 0;
+            emit songsChanged();
+        }
 
-        bool result = insertHNK(_hnkPath, hnkId, it2.filePath());
+        // throttled progress, the last update always goes out
+        if (progressTimer.elapsed() >= SCAN_PROGRESS_INTERVAL_MS || !open) {
+            progressTimer.restart();
+
+            int c = found.load();
+            if (c != upCount) {
+                upCount = c;
+                emit updateCountChanged(c);
+            }
+            if (i > 0) {
+                emit updatePositionChanged(i);
+                emit updateSongNameChanged(lastName);
+            }
+        }
+    }
 
-        if (!result)
-            erCount ++;
+    walker.wait();
+    for (SongScanWorker *worker : workers) {
+        worker->wait();
+        delete worker;
     }
 
-    // Update KAR
-    QDirIterator it3(karDir.path() ,QStringList() << "*.kar" << "*.KAR" << "*.mid" << "*.MID",
-                     QDir::Files, QDirIterator::Subdirectories);
-    while (it3.hasNext()) {
+    // rows of files that are gone
+    if (incremental) {
+        QSet<QString> seen = walker.seen();
+        for (auto it = known.constBegin(); it != known.constEnd(); ++it) {
+            if (seen.contains(it.key()))
+                continue;
+            int sep = it.key().indexOf('|');
+            del.bindValue(0, it.key().left(sep));
+            del.bindValue(1, it.key().mid(sep + 1));
+            del.exec();
+        }
+    }
+    del.finish();
+    del.clear();
 
-        it3.next();
 
-        i++;
-        emit updatePositionChanged(i);
-        emit updateSongNameChanged(it3.fileName());
+    con.commit();
 
-        QString karId = "-------";
+    if (!incremental)
+        createIndex(con);
 
-        bool result = insertKAR(_karPath, karId, it3.filePath(), it3.fileName());
+    setMiscValue(con, "ncn_path", _ncnPath);
+    setMiscValue(con, "hnk_path", _hnkPath);
+    setMiscValue(con, "kar_path", _karPath);
 
-        if (!result)
-            erCount ++;
+    // new snapshot for the in-memory catalog, the next search maps it
+    if (catalog != nullptr) {
+        qint64 stamp = QDateTime::currentMSecsSinceEpoch();
+        SongCatalog fresh;
+        if (fresh.build(&con, stamp) && fresh.save(catalogFilePath(stamp))) {
+            setMiscValue(con, "catalog_stamp", QString::number(stamp));
+            snapshotStamp.store(stamp);
+        }
     }
 
+    upTing = false;
 
-    db.commit();
-
-    createIndex();
+    emit songsChanged();
+}
 
-    upTing = false;
+void SongDatabase::onSongsChanged()
+{
+    // the search runs on the GUI thread, the rows it has are stale
+    session.invalidate();
 }
 
-void SongDatabase::createIndex()
+void SongDatabase::createIndex(QSqlDatabase &con)
 {
-    QSqlQuery query(db);
+    QSqlQuery query(con);
     QString sql;
 
     sql = "CREATE INDEX id_idx ON songs(id); ";
@@ -749,11 +994,18 @@ void SongDatabase::createIndex()
     query.exec(sql);
     query.finish();
     query.clear();
+
+    sql = "CREATE INDEX path_idx ON songs(songtype,path); ";
+    query.exec(sql);
+    query.finish();
+    query.clear();
+
+    createFullTextIndex(con);
 }
 
-void SongDatabase::dropIndex()
+void SongDatabase::dropIndex(QSqlDatabase &con)
 {
-    QSqlQuery q(db);
+    QSqlQuery q(con);
     QString sql;
 
     sql = "DROP INDEX id_idx; ";
@@ -775,4 +1027,187 @@ void SongDatabase::dropIndex()
     q.exec(sql);
     q.finish();
     q.clear();
+
+    sql = "DROP INDEX path_idx; ";
+    q.exec(sql);
+    q.finish();
+    q.clear();
+
+    dropFullTextIndex(con);
+}
+
+void SongDatabase::createFullTextIndex(QSqlDatabase &con)
+{
+    QSqlQuery q(con);
+
+    bool exists = false;
+    q.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND name = 'songs_fts'");
+    if (q.next())
+        exists = true;
+    q.finish();
+    q.clear();
+
+    if (exists) {
+        ftsEnabled.store(1);
+        return;
+    }
+
+    // External content table over songs. The trigram tokenizer indexes
+    // every 3 characters, so Thai text without spaces and transliterated
+    // names match anywhere in the word. Needs SQLite 3.34 with FTS5,
+    // without it search stays on LIKE.
+    QString sql = "CREATE VIRTUAL TABLE songs_fts USING fts5("
+                      "id, name, artist, lyrics, "
+                      "content='songs', content_rowid='rowid', "
+                      "tokenize='trigram'"
+                  ")";
+    if (!q.exec(sql)) {
+        QString error = q.lastError().text();
+        q.finish();
+        q.clear();
+
+        QString version;
+        if (q.exec("SELECT sqlite_version()") && q.next())
+            version = q.value(0).toString();
+        q.finish();
+        q.clear();
+
+        qWarning() << "SongDatabase: full text search disabled, lyrics and name search use LIKE."
+                   << "SQLite" << version << "needs 3.34 with FTS5 for the trigram tokenizer:" << error;
+
+        ftsEnabled.store(0);
+        return;
+    }
+    q.finish();
+    q.clear();
+
+    // every insert path (batched scan, insertNCN/HNK/KAR) and delete
+    // path keeps the index in sync through these
+    sql = "CREATE TRIGGER songs_fts_ai AFTER INSERT ON songs BEGIN "
+            "INSERT INTO songs_fts(rowid, id, name, artist, lyrics) "
+            "VALUES (new.rowid, new.id, new.name, new.artist, new.lyrics); "
+          "END";
+    q.exec(sql);
+    q.finish();
+    q.clear();
+
+    sql = "CREATE TRIGGER songs_fts_ad AFTER DELETE ON songs BEGIN "
+            "INSERT INTO songs_fts(songs_fts, rowid, id, name, artist, lyrics) "
+            "VALUES ('delete', old.rowid, old.id, old.name, old.artist, old.lyrics); "
+          "END";
+    q.exec(sql);
+    q.finish();
+    q.clear();
+
+    sql = "CREATE TRIGGER songs_fts_au AFTER UPDATE ON songs BEGIN "
+            "INSERT INTO songs_fts(songs_fts, rowid, id, name, artist, lyrics) "
+            "VALUES ('delete', old.rowid, old.id, old.name, old.artist, old.lyrics); "
+            "INSERT INTO songs_fts(rowid, id, name, artist, lyrics) "
+            "VALUES (new.rowid, new.id, new.name, new.artist, new.lyrics); "
+          "END";
+    q.exec(sql);
+    q.finish();
+    q.clear();
+
+    q.exec("INSERT INTO songs_fts(songs_fts) VALUES ('rebuild')");
+    q.finish();
+    q.clear();
+
+    ftsEnabled.store(1);
+}
+
+void SongDatabase::dropFullTextIndex(QSqlDatabase &con)
+{
+    QSqlQuery q(con);
+
+    q.exec("DROP TRIGGER IF EXISTS songs_fts_ai");
+    q.exec("DROP TRIGGER IF EXISTS songs_fts_ad");
+    q.exec("DROP TRIGGER IF EXISTS songs_fts_au");
+    q.exec("DROP TABLE IF EXISTS songs_fts");
+    q.finish();
+    q.clear();
+
+    ftsEnabled.store(0);
+}
+
+void SongDatabase::updateSchema()
+{
+    QSqlQuery q(db);
+    bool hasFingerprint = false;
+
+    q.exec("PRAGMA table_info(songs)");
+    while (q.next()) {
+        if (q.value(1).toString() == "filesize")
+            hasFingerprint = true;
+    }
+    q.finish();
+    q.clear();
+
+    if (!hasFingerprint) {
+        q.exec("ALTER TABLE songs ADD COLUMN filesize INTEGER");
+        q.finish();
+        q.clear();
+
+        q.exec("ALTER TABLE songs ADD COLUMN mtime INTEGER");
+        q.finish();
+        q.clear();
+    }
+
+    q.exec("CREATE INDEX IF NOT EXISTS path_idx ON songs(songtype,path)");
+    q.finish();
+    q.clear();
+
+    createFullTextIndex(db);
+}
+
+QHash<QString, SongFingerprint> SongDatabase::fingerprints(QSqlDatabase &con)
+{
+    QHash<QString, SongFingerprint> result;
+
+    QSqlQuery q(con);
+    q.setForwardOnly(true);
+    q.exec("SELECT songtype, path, filesize, mtime FROM songs "
+           "WHERE filesize IS NOT NULL AND mtime IS NOT NULL");
+    while (q.next()) {
+        SongFingerprint fp;
+        fp.size = q.value(2).toLongLong();
+        fp.mtime = q.value(3).toLongLong();
+        result.insert(SongDirWalker::songKey(q.value(0).toString(), q.value(1).toString()), fp);
+    }
+    q.finish();
+    q.clear();
+
+    return result;
+}
+
+QString SongDatabase::miscValue(QSqlDatabase &con, const QString &name)
+{
+    QString value = "";
+
+    QSqlQuery q(con);
+    q.prepare("SELECT value_str FROM miscellaneous WHERE name = ?");
+    q.bindValue(0, name);
+    if (q.exec() && q.next())
+        value = q.value(0).toString();
+    q.finish();
+    q.clear();
+
+    return value;
+}
+
+void SongDatabase::setMiscValue(QSqlDatabase &con, const QString &name, const QString &value)
+{
+    QSqlQuery q(con);
+    q.prepare("DELETE FROM miscellaneous WHERE name = ?");
+    q.bindValue(0, name);
+    q.exec();
+    q.finish();
+    q.clear();
+
+    q.prepare("INSERT INTO miscellaneous (name, value_str) VALUES (?, ?)");
+    q.bindValue(0, name);
+    q.bindValue(1, value);
+    q.exec();
+    q.finish();
+    q.clear();
 }
@@ -2,9 +2,14 @@
 #define SONGDATABASE_H
 
 #include "Song.h"
+#include "SearchSession.h"
+#include "SongCatalog.h"
+#include "SongScanner.h"
 
+#include <QAtomicInteger>
 #include <QObject>
 #include <QSqlDatabase>
+#include <QSqlQuery>
 #include <QThread>
 
 
@@ -12,12 +17,14 @@ enum class SearchType {
     ByAll,
     ById,
     ByName,
-    ByArtist
+    ByArtist,
+    ByLyrics    // setSearchType only, not in the nextType() cycle
 };
 
 enum class UpdateType {
     UpdateAll,
-    ImportNCN
+    ImportNCN,
+    UpdateChanged   // only new, changed and removed files
 };
 
 class SongDatabase : public QThread
@@ -31,7 +38,7 @@ public:
     void updateToNewVersion();
 
     int count();
-    Song* currentSong() { return song; }
+    Song* currentSong() { return &song; }
     QString searchText() { return _searchText; }
 
     QSqlDatabase* database() { return &db; }
@@ -53,9 +60,23 @@ public:
     QString karPath() { return _karPath; }
     void setKarPath(const QString &p) { _karPath = p; }
 
+    // kiosk mode, search from a memory-mapped snapshot instead of SQLite
+    bool useCatalog() { return catalog != nullptr; }
+    void setUseCatalog(bool use);
+    SongCatalog* songCatalog() { return catalog; }
+
     UpdateType updateType() { return upType; }
     void setUpdateType(UpdateType type);
 
+    // thread safe, no database access
+    static ScanResult readSong(const ScanJob &job);
+    static ScanResult readNCN(const QString &ncnPath, const QString &songId, const QString &midFilePath);
+    // cursor and lyrics paths already known, "" when missing
+    static ScanResult readNCN(const QString &ncnPath, const QString &songId, const QString &midFilePath,
+                              const QString &curFilePath, const QString &lyrFilePath);
+    static ScanResult readHNK(const QString &hnkPath, const QString &songId, const QString &hnkFilePath);
+    static ScanResult readKAR(const QString &karPath, const QString &songId, const QString &karFilePath, const QString &fileName);
+
 public slots:
     bool insertNCN(const QString &ncnPath, const QString &songId, const QString &midFilePath);
     bool insertHNK(const QString &hnkPath, const QString &songId, const QString &hnkFilePath);
@@ -67,6 +88,11 @@ public slots:
     Song* searchNext();
     Song* searchPrevious();
 
+    // rows of the current search for a result list, index of
+    // currentSong() is searchIndex()
+    QVector<Song> searchResults(int from, int count);
+    int searchIndex() { return currentResultIndex; }
+
     bool removeCurrentSong(bool removeFromStorage = false);
 
 signals:
@@ -74,19 +100,45 @@ signals:
     void updatePositionChanged(int p);
     void updateSongNameChanged(QString n);
 
+    // from run(), queued to the GUI thread
+    void songsChanged();
+
 protected:
     void run();
 
+private slots:
+    void onSongsChanged();
+
 private:
-    void createIndex();
-    void dropIndex();
+    void scan(QSqlDatabase &con);
+
+    void createIndex(QSqlDatabase &con);
+    void dropIndex(QSqlDatabase &con);
+    bool insertSongs(QSqlDatabase &con, const QVector<ScanResult> &songs);
+
+    void updateSchema();
+    void createFullTextIndex(QSqlDatabase &con);
+    void dropFullTextIndex(QSqlDatabase &con);
+
+    QString searchSql();
+    QVariantList searchValues();
+    QVector<int> catalogSearch();
+
+    QString catalogFilePath(qint64 stamp);
+    bool loadCatalog();
+    void reloadCatalog();
+    void removeOldCatalogs(qint64 keepStamp);
+    QHash<QString, SongFingerprint> fingerprints(QSqlDatabase &con);
+    QString miscValue(QSqlDatabase &con, const QString &name);
+    void setMiscValue(QSqlDatabase &con, const QString &name, const QString &value);
 
 private:
     QSqlDatabase db;
-    Song *song;
+    Song song;
     SearchType searchType;
 
     QString _searchText = "";
+    QAtomicInt ftsEnabled;  // songs_fts exists, run() drops and creates it
 
     UpdateType upType = UpdateType::UpdateAll;
     QString _ncnPath = "";
@@ -98,6 +150,10 @@ private:
     bool upTing = false;
 
     int currentResultIndex = -1;
+    SearchSession session;
+
+    SongCatalog *catalog = nullptr;
+    QAtomicInteger<qint64> snapshotStamp;  // newest snapshot, written by run()
 };
 
 #endif // SONGDATABASE_H
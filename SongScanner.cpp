@@ -0,0 +1,142 @@
+#include "SongScanner.h"
+
+#include "SongDatabase.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+
+
+SongDirWalker::SongDirWalker(const QString &ncnPath, const QString &hnkPath, const QString &karPath,
+                             ScanQueue<ScanJob> *jobs, QAtomicInt *found,
+                             const QHash<QString, SongFingerprint> *known)
+{
+    _ncnPath = ncnPath;
+    _hnkPath = hnkPath;
+    _karPath = karPath;
+    _jobs = jobs;
+    _found = found;
+    _known = known;
+}
+
+QString SongDirWalker::songKey(const QString &songType, const QString &path)
+{
+    return songType + "|" + path;
+}
+
+void SongDirWalker::run()
+{
+    walk(_ncnPath + "/Song", QStringList() << "*.mid" << "*.MID", "NCN", _ncnPath);
+    walk(_hnkPath, QStringList() << "*.hnk" << "*.HNK", "HNK", _hnkPath);
+    walk(_karPath, QStringList() << "*.kar" << "*.KAR" << "*.mid" << "*.MID", "KAR", _karPath);
+
+    _jobs->close();
+}
+
+void SongDirWalker::walk(const QString &dir, const QStringList &filters,
+                         const QString &songType, const QString &rootPath)
+{
+    if (dir.isEmpty() || !QDir(dir).exists())
+        return;
+
+    QDirIterator it(dir, filters, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+
+        ScanJob job;
+        job.songType = songType;
+        job.rootPath = rootPath;
+        job.filePath = it.filePath();
+        job.fileName = it.fileName();
+        job.path = job.filePath;
+        job.path = job.path.replace(rootPath, "");
+        job.replace = false;
+
+        if (_known != nullptr) {
+            QString key = songKey(songType, job.path);
+            _seen.insert(key);
+
+            auto fp = _known->constFind(key);
+            if (fp != _known->constEnd()) {
+                QFileInfo info = it.fileInfo();
+                if (fp->size == info.size()
+                        && fp->mtime == info.lastModified().toMSecsSinceEpoch())
+                    continue;
+                job.replace = true;
+            }
+        }
+
+        if (songType == "NCN") {
+            if (!_ncnListed) {
+                _curFiles = listParts(rootPath + "/Cursor", QStringList() << "*.CUR" << "*.cur" << "*.Cur");
+                _lyrFiles = listParts(rootPath + "/Lyrics", QStringList() << "*.LYR" << "*.lyr" << "*.Lyr");
+                _ncnListed = true;
+            }
+            QString key = partKey(dir, job.filePath);
+            job.curPath = _curFiles.value(key);
+            job.lyrPath = _lyrFiles.value(key);
+        }
+
+        _found->ref();
+        _jobs->push(job);
+    }
+}
+
+QHash<QString, QString> SongDirWalker::listParts(const QString &dir, const QStringList &filters)
+{
+    QHash<QString, QString> files;
+    if (!QDir(dir).exists())
+        return files;
+
+    QDirIterator it(dir, filters, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+
+        QString key = partKey(dir, it.filePath());
+        auto other = files.constFind(key);
+
+        // same order as SongDatabase::getCurFilePath and getLyrFilePath
+        if (other == files.constEnd()
+                || extRank(filters, it.filePath()) < extRank(filters, other.value()))
+            files.insert(key, it.filePath());
+    }
+
+    return files;
+}
+
+int SongDirWalker::extRank(const QStringList &filters, const QString &filePath)
+{
+    int i = filters.indexOf("*." + QFileInfo(filePath).suffix());
+    return (i == -1) ? filters.count() : i;
+}
+
+QString SongDirWalker::partKey(const QString &dir, const QString &filePath)
+{
+    QString key = filePath.mid(dir.length());
+    int dot = key.lastIndexOf('.');
+    if (dot > key.lastIndexOf('/'))
+        key.truncate(dot);
+
+    return key.toLower();
+}
+
+// ========================================================
+
+SongScanWorker::SongScanWorker(ScanQueue<ScanJob> *jobs, ScanQueue<ScanResult> *results, QAtomicInt *running)
+{
+    _jobs = jobs;
+    _results = results;
+    _running = running;
+}
+
+void SongScanWorker::run()
+{
+    ScanJob job;
+    while (_jobs->pop(&job)) {
+        _results->push(SongDatabase::readSong(job));
+    }
+
+    if (!_running->deref())
+        _results->close();
+}
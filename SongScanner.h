@@ -0,0 +1,182 @@
+#ifndef SONGSCANNER_H
+#define SONGSCANNER_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+
+typedef struct
+{
+    qint64  size;
+    qint64  mtime;      // ms since epoch
+} SongFingerprint;
+
+typedef struct
+{
+    QString songType;   // NCN, HNK, KAR
+    QString rootPath;
+    QString filePath;
+    QString fileName;
+    QString path;       // filePath relative to rootPath, as stored in songs
+    QString curPath;    // NCN : from the walker's listing, empty if none
+    QString lyrPath;    // NCN : from the walker's listing, empty if none
+    bool    replace;    // a row for this file is already in songs
+} ScanJob;
+
+typedef struct
+{
+    bool    valid;
+    QString id;
+    QString name;
+    QString artist;
+    QString key;
+    int     tempo;
+    QString songType;
+    QString lyrics;
+    QString path;
+    QString fileName;
+    qint64  size;
+    qint64  mtime;
+    bool    replace;
+} ScanResult;
+
+
+// Bounded blocking queue between the scan stages
+template <typename T>
+class ScanQueue
+{
+public:
+    explicit ScanQueue(int capacity = 1024) : _capacity(capacity) {}
+
+    void push(const T &value)
+    {
+        _mutex.lock();
+        while (_queue.count() >= _capacity && !_closed)
+            _notFull.wait(&_mutex);
+        if (!_closed) {
+            _queue.enqueue(value);
+            _notEmpty.wakeOne();
+        }
+        _mutex.unlock();
+    }
+
+    // false when closed and empty
+    bool pop(T *value)
+    {
+        _mutex.lock();
+        while (_queue.isEmpty() && !_closed)
+            _notEmpty.wait(&_mutex);
+        bool result = !_queue.isEmpty();
+        if (result) {
+            *value = _queue.dequeue();
+            _notFull.wakeOne();
+        }
+        _mutex.unlock();
+        return result;
+    }
+
+    // take up to max values, wait at most timeoutMs for the first one
+    // false when closed and empty
+    bool popMany(QVector<T> *values, int max, unsigned long timeoutMs)
+    {
+        _mutex.lock();
+        if (_queue.isEmpty() && !_closed)
+            _notEmpty.wait(&_mutex, timeoutMs);
+        bool result = !(_queue.isEmpty() && _closed);
+        while (!_queue.isEmpty() && values->count() < max)
+            values->append(_queue.dequeue());
+        _notFull.wakeAll();
+        _mutex.unlock();
+        return result;
+    }
+
+    void close()
+    {
+        _mutex.lock();
+        _closed = true;
+        _notEmpty.wakeAll();
+        _notFull.wakeAll();
+        _mutex.unlock();
+    }
+
+private:
+    QQueue<T> _queue;
+    QMutex _mutex;
+    QWaitCondition _notEmpty;
+    QWaitCondition _notFull;
+    int _capacity;
+    bool _closed = false;
+};
+
+
+// Walks the NCN, HNK and KAR trees once and feeds the workers.
+// With known fingerprints only new or changed files are queued and
+// every file seen goes to seen(), so vanished rows can be found after.
+// The NCN Cursor and Lyrics trees are listed once, the jobs carry the
+// paths, the workers don't look for them file by file.
+class SongDirWalker : public QThread
+{
+    Q_OBJECT
+public:
+    SongDirWalker(const QString &ncnPath, const QString &hnkPath, const QString &karPath,
+                  ScanQueue<ScanJob> *jobs, QAtomicInt *found,
+                  const QHash<QString, SongFingerprint> *known = nullptr);
+
+    static QString songKey(const QString &songType, const QString &path);
+
+    // keys of every file walked, only filled with known fingerprints.
+    // Written by the walker thread, read it after wait().
+    QSet<QString> seen() { return _seen; }
+
+protected:
+    void run();
+
+private:
+    void walk(const QString &dir, const QStringList &filters,
+              const QString &songType, const QString &rootPath);
+
+    // path of every file under dir by its lowercase relative path
+    // without extension, the first extension in filters wins
+    static QHash<QString, QString> listParts(const QString &dir, const QStringList &filters);
+    static QString partKey(const QString &dir, const QString &filePath);
+    static int extRank(const QStringList &filters, const QString &filePath);
+
+private:
+    QString _ncnPath;
+    QString _hnkPath;
+    QString _karPath;
+    ScanQueue<ScanJob> *_jobs;
+    QAtomicInt *_found;
+    const QHash<QString, SongFingerprint> *_known;
+    QSet<QString> _seen;
+
+    // NCN, listed at the first queued song
+    bool _ncnListed = false;
+    QHash<QString, QString> _curFiles;
+    QHash<QString, QString> _lyrFiles;
+};
+
+
+// Reads song metadata, the last running worker closes the result queue
+class SongScanWorker : public QThread
+{
+    Q_OBJECT
+public:
+    SongScanWorker(ScanQueue<ScanJob> *jobs, ScanQueue<ScanResult> *results, QAtomicInt *running);
+
+protected:
+    void run();
+
+private:
+    ScanQueue<ScanJob> *_jobs;
+    ScanQueue<ScanResult> *_results;
+    QAtomicInt *_running;
+};
+
+#endif // SONGSCANNER_H
@@ -9,6 +9,7 @@
 
 #include "Config.h"
 #include "Midi/MidiHelper.h"
+#include "Midi/HNKFile.h"
 
 Utils::Utils()
 {
@@ -117,7 +118,7 @@ bool Utils::vstInfo(const QString &vstPath, VSTNamePath *info)
     return true;
 }
 
-bool Utils::savePlaylist(const QString &filePath, const QList<Song *> &songs)
+bool Utils::savePlaylist(const QString &filePath, const QList<Song> &songs)
 {
     QFile file(filePath);
 
@@ -138,20 +139,20 @@ bool Utils::savePlaylist(const QString &filePath, const QList<Song *> &songs)
 
     for (int i=0; i<songs.count(); i++)
     {
-        Song *s = songs[i];
+        const Song &s = songs[i];
         out << HANDY_PLAYLIST_SONG + QString::number(i+1) << endl;
-        out << s->id() << endl;
-        out << s->name() << endl;
-        out << s->artist() << endl;
-        out << s->key() << endl;
-        out << s->tempo() << endl;
-        out << s->bpmSpeed() << endl;
-        out << s->transpose() << endl;
-        out << s->songType() << endl;
-        out << s->lyrics() << endl;
-        out << s->path() << endl;
-        out << s->cutStartBar() << endl;
-        out << s->cutEndBar() << endl;
+        out << s.id() << endl;
+        out << s.name() << endl;
+        out << s.artist() << endl;
+        out << s.key() << endl;
+        out << s.tempo() << endl;
+        out << s.bpmSpeed() << endl;
+        out << s.transpose() << endl;
+        out << s.songType() << endl;
+        out << s.lyrics() << endl;
+        out << s.path() << endl;
+        out << s.cutStartBar() << endl;
+        out << s.cutEndBar() << endl;
         out << endl;
     }
 
@@ -162,7 +163,7 @@ bool Utils::savePlaylist(const QString &filePath, const QList<Song *> &songs)
     return true;
 }
 
-bool Utils::loadPlaylist(const QString &filePath, QList<Song *> &songs)
+bool Utils::loadPlaylist(const QString &filePath, QList<Song> &songs)
 {
     int version = 0;
 
@@ -215,7 +216,7 @@ bool Utils::loadPlaylist(const QString &filePath, QList<Song *> &songs)
     }
 
     bool valid = true;
-    QList<Song*> songList;
+    QList<Song> songList;
 
     for (int i=0; i<count; i++)
     {
@@ -231,22 +232,22 @@ bool Utils::loadPlaylist(const QString &filePath, QList<Song *> &songs)
             break;
         }
 
-        Song *s = new Song();
-        s->setId(in.readLine());
-        s->setName(in.readLine());
-        s->setArtist(in.readLine());
-        s->setKey(in.readLine());
-        s->setTempo(in.readLine().toInt());
-        s->setBpmSpeed(in.readLine().toInt());
-        s->setTranspose(in.readLine().toInt());
-        s->setSongType(in.readLine());
-        s->setLyrics(in.readLine());
-        s->setPath(in.readLine());
+        Song s;
+        s.setId(in.readLine());
+        s.setName(in.readLine());
+        s.setArtist(in.readLine());
+        s.setKey(in.readLine());
+        s.setTempo(in.readLine().toInt());
+        s.setBpmSpeed(in.readLine().toInt());
+        s.setTranspose(in.readLine().toInt());
+        s.setSongType(in.readLine());
+        s.setLyrics(in.readLine());
+        s.setPath(in.readLine());
 
         if (version >= 2)
         {
-            s->setCutStartBar(in.readLine().toInt());
-            s->setCutEndBar(in.readLine().toInt());
+            s.setCutStartBar(in.readLine().toInt());
+            s.setCutEndBar(in.readLine().toInt());
         }
 
         in.readLine();
@@ -261,19 +262,42 @@ bool Utils::loadPlaylist(const QString &filePath, QList<Song *> &songs)
 
     if (valid)
     {
-        for (Song *s : songs)
-            delete s;
-        songs.clear();
         songs = songList;
         return true;
     }
     else
     {
-        for (Song *s : songList)
-            delete s;
-        songList.clear();
         return false;
     }
 }
 
+bool Utils::readHNK(const QString &path, HNKSong *song, int parts)
+{
+    song->bpm = 0;
+    song->midData.clear();
+    song->lyrData.clear();
+    song->curData.clear();
+
+    HNK_MUTEX.lock();
+
+    bool ok = true;
+    if (parts & HNKBpm) {
+        song->bpm = HNKFile::bpm(path);
+        ok = song->bpm != 0;
+    }
+    if (ok && (parts & HNKMidi)) {
+        song->midData = HNKFile::midData(path);
+        ok = !song->midData.isEmpty();
+    }
+    if (ok && (parts & HNKLyrics))
+        song->lyrData = HNKFile::lyrData(path);
+    if (ok && (parts & HNKCursor))
+        song->curData = HNKFile::curData(path);
+
+    HNK_MUTEX.unlock();
+
+    return ok;
+}
+
 QString Utils::LAST_OPEN_DIR = QDir::homePath();
+QMutex Utils::HNK_MUTEX;
@@ -3,6 +3,7 @@
 
 #include <QFile>
 #include <QMenu>
+#include <QMutex>
 #include <QSignalMapper>
 
 #include "Song.h"
@@ -13,6 +14,24 @@ typedef __int32 int32_t;
 typedef unsigned __int32 uint32_t;
 #endif
 
+// parts of an HNK song, see Utils::readHNK
+enum HNKPart
+{
+    HNKBpm      = 0x1,
+    HNKMidi     = 0x2,
+    HNKLyrics   = 0x4,
+    HNKCursor   = 0x8,
+    HNKPlayback = HNKMidi | HNKLyrics | HNKCursor
+};
+
+typedef struct
+{
+    int bpm;
+    QByteArray midData;
+    QByteArray lyrData;
+    QByteArray curData;
+} HNKSong;
+
 class Utils
 {
 public:
@@ -28,10 +47,19 @@ public:
 
     static bool vstInfo(const QString &vstPath, VSTNamePath *info);
 
-    static bool savePlaylist(const QString &filePath, const QList<Song*> &songs);
-    static bool loadPlaylist(const QString &filePath, QList<Song*> &songs);
+    // every requested part of the song in one call under one lock,
+    // false if the requested bpm is 0 or the requested midi is empty
+    static bool readHNK(const QString &path, HNKSong *song, int parts = HNKPlayback);
+
+    static bool savePlaylist(const QString &filePath, const QList<Song> &songs);
+    static bool loadPlaylist(const QString &filePath, QList<Song> &songs);
 
     static QString LAST_OPEN_DIR;
+
+private:
+    // held around HNKFile calls, HNKFile is not known to be reentrant and
+    // readHNK is used by the scanner workers, SongCache, MedleyLoader and the GUI
+    static QMutex HNK_MUTEX;
 };
 
 #endif // UTILS_H
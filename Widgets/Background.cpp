@@ -1,17 +1,41 @@
 #include "Background.h"
+#include "SlideshowLoader.h"
 
 #include <QPainter>
+#include <QResizeEvent>
 
 Background::Background(QWidget *parent) :
     QWidget(parent),
     _color(81, 81, 81)
 {
+    _slideTimer = new QTimer(this);
+    _slideTimer->setSingleShot(true);
 
+    _fade = new QVariantAnimation(this);
+    _fade->setStartValue(0.0);
+    _fade->setEndValue(1.0);
+    _fade->setDuration(1000);
+
+    connect(_slideTimer, SIGNAL(timeout()), this, SLOT(nextSlide()));
+    connect(_fade, SIGNAL(valueChanged(QVariant)), this, SLOT(onFadeValueChanged(QVariant)));
+    connect(_fade, SIGNAL(finished()), this, SLOT(onFadeFinished()));
+}
+
+Background::~Background()
+{
+    _slideTimer->stop();
+    _fade->stop();
+
+    if (_loader != nullptr) {
+        _loader->stop();
+        delete _loader;
+    }
 }
 
 void Background::setBackgroundType(Background::BackgroundType t)
 {
     _bgType = t;
+    updateSlideshow();
     update();
 }
 
@@ -37,9 +61,48 @@ void Background::setBackgroundImage(const QString &imgFile)
 
     _image = img;
     _imageName = imgFile;
+    _scaled = QPixmap();
     update();
 }
 
+void Background::setSlideshowDir(const QString &dir)
+{
+    if (dir == _slideDir)
+        return;
+
+    _slideDir = dir;
+    _fade->stop();
+    _slideImage = QImage();
+    _nextImage = QImage();
+    _slide = QPixmap();
+    _nextSlide = QPixmap();
+
+    if (_loader != nullptr)
+        _loader->setFiles(SlideshowLoader::imageFiles(_slideDir));
+
+    updateSlideshow();
+    update();
+}
+
+void Background::setSlideshowInterval(int ms)
+{
+    _slideInterval = qMax(1000, ms);
+}
+
+void Background::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+
+    // scaled again on the next paint, the slides ahead are decoded
+    // again for the new size
+    _scaled = QPixmap();
+    _slide = QPixmap();
+    _nextSlide = QPixmap();
+
+    if (_loader != nullptr)
+        _loader->setSize(deviceSize());
+}
+
 void Background::paintEvent(QPaintEvent *event)
 {
     QWidget::paintEvent(event);
@@ -51,9 +114,119 @@ void Background::paintEvent(QPaintEvent *event)
         painter.fillRect(rect(), _color);
         break;
     case Image:
-        painter.drawImage(rect(), _image);
+        // scaled once per size, a repaint is a plain copy
+        if (_scaled.isNull())
+            updateScaled();
+        painter.drawPixmap(0, 0, _scaled);
+        break;
+    case Slideshow:
+        if (_slideImage.isNull()) {
+            painter.fillRect(rect(), _color);
+            break;
+        }
+        if (_slide.isNull())
+            _slide = fitted(_slideImage);
+        painter.drawPixmap(0, 0, _slide);
+
+        if (!_nextImage.isNull()) {
+            if (_nextSlide.isNull())
+                _nextSlide = fitted(_nextImage);
+            painter.setOpacity(_fadeOpacity);
+            painter.drawPixmap(0, 0, _nextSlide);
+        }
         break;
     default:
         break;
     }
 }
+
+void Background::nextSlide()
+{
+    if (_bgType != Slideshow || _loader == nullptr || _fade->state() == QAbstractAnimation::Running)
+        return;
+
+    QImage img;
+    if (!_loader->takeNext(&img)) {
+        // still decoding
+        _slideTimer->start(200);
+        return;
+    }
+
+    if (_slideImage.isNull() || _fade->duration() == 0) {
+        _slideImage = img;
+        _slide = QPixmap();
+        _slideTimer->start(_slideInterval);
+        update();
+        return;
+    }
+
+    _nextImage = img;
+    _nextSlide = QPixmap();
+    _fadeOpacity = 0.0;
+    _fade->start();
+}
+
+void Background::onFadeValueChanged(const QVariant &v)
+{
+    _fadeOpacity = v.toReal();
+    update();
+}
+
+void Background::onFadeFinished()
+{
+    _slideImage = _nextImage;
+    _slide = _nextSlide;
+    _nextImage = QImage();
+    _nextSlide = QPixmap();
+    update();
+
+    if (_bgType == Slideshow)
+        _slideTimer->start(_slideInterval);
+}
+
+QSize Background::deviceSize()
+{
+    return size() * devicePixelRatioF();
+}
+
+QPixmap Background::fitted(const QImage &img)
+{
+    // the loader scaled it already, unless the size changed since
+    QPixmap pm;
+    if (img.size() == deviceSize() || deviceSize().isEmpty())
+        pm = QPixmap::fromImage(img);
+    else
+        pm = QPixmap::fromImage(img.scaled(deviceSize(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    pm.setDevicePixelRatio(devicePixelRatioF());
+
+    return pm;
+}
+
+void Background::updateScaled()
+{
+    if (_image.isNull() || deviceSize().isEmpty()) {
+        _scaled = QPixmap();
+        return;
+    }
+
+    _scaled = QPixmap::fromImage(_image.scaled(deviceSize(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    _scaled.setDevicePixelRatio(devicePixelRatioF());
+}
+
+void Background::updateSlideshow()
+{
+    if (_bgType != Slideshow || _slideDir.isEmpty()) {
+        _slideTimer->stop();
+        return;
+    }
+
+    if (_loader == nullptr) {
+        _loader = new SlideshowLoader();
+        _loader->setFiles(SlideshowLoader::imageFiles(_slideDir));
+        _loader->setSize(deviceSize());
+        _loader->start(QThread::LowPriority);
+    }
+
+    if (_slideImage.isNull() || !_slideTimer->isActive())
+        _slideTimer->start(0);
+}
@@ -2,6 +2,11 @@
 #define BACKGROUND_H
 
 #include <QWidget>
+#include <QPixmap>
+#include <QTimer>
+#include <QVariantAnimation>
+
+class SlideshowLoader;
 
 class Background : public QWidget
 {
@@ -10,10 +15,12 @@ public:
     enum BackgroundType {
         Color = 0,
         Image,
-        Video
+        Video,
+        Slideshow
     };
 
     explicit Background(QWidget *parent = nullptr);
+    ~Background();
 
     BackgroundType backgroundType() { return _bgType; }
     void setBackgroundType(BackgroundType t);
@@ -25,14 +32,43 @@ public:
     QString backgroundImage() { return _imageName; }
     void setBackgroundImage(const QString &imgFile);
 
+    // images of a folder, changed every interval with a crossfade
+    QString slideshowDir() { return _slideDir; }
+    void setSlideshowDir(const QString &dir);
+    int  slideshowInterval() { return _slideInterval; }
+    void setSlideshowInterval(int ms);
+    int  slideshowFadeTime() { return _fade->duration(); }
+    void setSlideshowFadeTime(int ms) { _fade->setDuration(qMax(0, ms)); }
+
 protected:
+    void resizeEvent(QResizeEvent *event);
     void paintEvent(QPaintEvent *event);
 
+private slots:
+    void nextSlide();
+    void onFadeValueChanged(const QVariant &v);
+    void onFadeFinished();
+
 private:
     BackgroundType _bgType = Color;
     QColor _color;
     QImage _image;
     QString _imageName;
+    QPixmap _scaled;    // _image at the widget size, in device pixels
+
+    QString _slideDir;
+    SlideshowLoader *_loader = nullptr;
+    QTimer *_slideTimer;
+    int _slideInterval = 10000;
+    QVariantAnimation *_fade;
+    QImage _slideImage, _nextImage;
+    QPixmap _slide, _nextSlide;     // the images at the widget size
+    qreal _fadeOpacity = 0.0;
+
+    QSize deviceSize();
+    QPixmap fitted(const QImage &img);
+    void updateScaled();
+    void updateSlideshow();
 };
 
 #endif // BACKGROUND_H
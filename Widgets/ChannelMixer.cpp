@@ -29,6 +29,11 @@ ChannelMixer::ChannelMixer(QWidget *parent) :
 
     player = nullptr;
 
+    // poll the stream levels of the synth and the changes the player
+    // dropped into its rings at VU rate
+    eventTimer.setInterval(30);
+    connect(&eventTimer, SIGNAL(timeout()), this, SLOT(readPlayerEvents()));
+
     setAutoFillBackground(true);
 
     chs.append(ui->ch1);
@@ -139,15 +144,92 @@ void ChannelMixer::setPlayer(MidiPlayer *p)
 {
     if (player != nullptr) {
         disconnect(player, SIGNAL(loaded()), this, SLOT(onPlayerLoaded()));
-        disconnect(player, SIGNAL(sendedEvent(MidiEvent)),
-                   this, SLOT(onPlayerPlayingEvent(MidiEvent)));
     }
 
     player = p;
 
     connect(player, SIGNAL(loaded()), this, SLOT(onPlayerLoaded()));
-    connect(player, SIGNAL(sendedEvent(MidiEvent)),
-            this, SLOT(onPlayerPlayingEvent(MidiEvent)));
+
+    setMetering(isVisible());
+    eventTimer.start();
+}
+
+void ChannelMixer::readPlayerEvents()
+{
+    // A channel on the synth shows the level of the stream it plays on,
+    // a MIDI out has no audio here and shows its note velocities.
+    MidiEvent e;
+    while (player->takeSentNoteOn(&e)) {
+        if (player->midiChannel()[e.channel()].port() != -1)
+            chs[e.channel()]->peak(e.data2());
+    }
+
+    if (metering) {
+        QMap<InstrumentType, int> levels;
+        for (int ch=0; ch<16; ch++) {
+            if (player->midiChannel()[ch].port() != -1)
+                continue;
+            int leds = channelLevel(ch, &levels);
+            if (leds > 0)
+                chs[ch]->peak(leds);
+        }
+    }
+
+    int volumes = player->takeVolumeChanges();
+    for (int ch=0; ch<16; ch++) {
+        if (volumes & (1 << ch))
+            chs[ch]->setSliderValue(player->midiChannel()[ch].volume());
+    }
+
+    int cur = ui->cbCh->currentIndex();
+    if (player->takeDetailChanges() & (1 << cur))
+        showDeTail(cur);
+}
+
+int ChannelMixer::channelLevel(int ch, QMap<InstrumentType, int> *levels)
+{
+    // a stream is taken once a poll, channels may share it
+    MidiSynthesizer *synth = player->midiSynthesizer();
+    auto streamLevel = [synth, levels](InstrumentType t) {
+        int vsti = synth->useVSTi(t);
+        if (vsti != -1)
+            t = static_cast<InstrumentType>(static_cast<int>(InstrumentType::VSTi1) + vsti);
+        if (!levels->contains(t))
+            levels->insert(t, LevelMeter::dbSteps(synth->takeLevel(t, MeterReader::ChannelMixer).peak, 127));
+        return levels->value(t);
+    };
+
+    if (ch != 9)
+        return streamLevel(player->midiChannel()[ch].instrumentType());
+
+    // the drum notes play on their own streams
+    int leds = 0;
+    for (int t = static_cast<int>(InstrumentType::BassDrum); t <= static_cast<int>(InstrumentType::PercussionEtc); t++)
+        leds = qMax(leds, streamLevel(static_cast<InstrumentType>(t)));
+
+    return leds;
+}
+
+void ChannelMixer::setMetering(bool m)
+{
+    if (player == nullptr || m == metering)
+        return;
+
+    metering = m;
+    player->midiSynthesizer()->setMetering(m);
+}
+
+void ChannelMixer::showEvent(QShowEvent *event)
+{
+    // the streams are measured only while the meters are seen
+    QWidget::showEvent(event);
+    setMetering(true);
+}
+
+void ChannelMixer::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    setMetering(false);
 }
 
 void ChannelMixer::peak(int ch, int value)
@@ -214,37 +296,6 @@ void ChannelMixer::onPlayerLoaded()
     showDeTail(ui->cbCh->currentIndex());
 }
 
-void ChannelMixer::onPlayerPlayingEvent(MidiEvent e)
-{
-    switch (e.eventType()) {
-    case MidiEventType::NoteOn:
-        chs[e.channel()]->peak(e.data2());
-        break;
-    case MidiEventType::Controller:
-        if (e.data1() == 7) {
-            chs[e.channel()]->setSliderValue(e.data2());
-        }
-        if (e.channel() == ui->cbCh->currentIndex()) {
-            switch (e.data1()) {
-            case 10:
-            case 91:
-            case 93:
-                showDeTail(ui->cbCh->currentIndex());
-                break;
-            default:
-                break;
-            }
-        }
-        break;
-    case MidiEventType::ProgramChange:
-        if (e.channel() == ui->cbCh->currentIndex())
-            showDeTail(ui->cbCh->currentIndex());
-        break;
-    default:
-        break;
-    }
-}
-
 void ChannelMixer::leaveEvent(QEvent *event)
 {
     if (ui->cbCh->isPopupVisible() || ui->cbInts->isPopupVisible())
@@ -2,6 +2,7 @@
 #define CHANNELMIXER_H
 
 #include <QWidget>
+#include <QTimer>
 
 #include "Midi/MidiPlayer.h"
 #include "ChMx.h"
@@ -41,7 +42,6 @@ public:
 public slots:
     void showDeTail(int ch);
     void onPlayerLoaded();
-    void onPlayerPlayingEvent(MidiEvent e);
 
 signals:
     void lockChanged(bool lock);
@@ -49,6 +49,8 @@ signals:
 
 protected:
     void leaveEvent(QEvent *event);
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
 
 private slots:
     void onChSliderValueChanged(int ch, int v);
@@ -67,13 +69,20 @@ private slots:
 
     void onBtnSettingVuClicked();
 
+    void readPlayerEvents();
+
 private:
     Ui::ChannelMixer *ui;
 
     MidiPlayer *player;
     QList<ChMx*> chs;
+    QTimer eventTimer;
 
     bool lock = false;
+    bool metering = false;
+
+    void setMetering(bool m);
+    int channelLevel(int ch, QMap<InstrumentType, int> *levels);
 };
 
 #endif // CHANNELMIXER_H
@@ -0,0 +1,305 @@
+#include "LyricsLayout.h"
+
+#include <QFontMetrics>
+#include <QPainter>
+#include <QPainterPath>
+#include <QSet>
+#include <QTextLayout>
+
+
+LyricsLayout::LyricsLayout(qint64 budgetBytes, QObject *parent) : QThread(parent)
+{
+    _budget = budgetBytes;
+}
+
+LyricsLayout::~LyricsLayout()
+{
+    stop();
+}
+
+void LyricsLayout::setStyle(const LyricsStyle &style)
+{
+    _mutex.lock();
+    // without autoFontSize the width is only the size of the view
+    bool sameLines = (_generation > 0) && sameLook(style, _style)
+            && (!style.autoFontSize || style.maxWidth == _style.maxWidth);
+    _style = style;
+    if (!sameLines) {
+        _generation++;
+        _cache.clear();
+        _size = 0;
+        _wake.wakeAll();
+    }
+    _mutex.unlock();
+
+    emit styleChanged();
+}
+
+int LyricsLayout::styleWidth()
+{
+    _mutex.lock();
+    int w = _style.maxWidth;
+    _mutex.unlock();
+
+    return w;
+}
+
+void LyricsLayout::setLines(const QStringList &lines)
+{
+    _mutex.lock();
+    _lines = lines;
+    _current = 0;
+    evict();
+    _wake.wakeAll();
+    _mutex.unlock();
+}
+
+void LyricsLayout::setCurrentLine(int index)
+{
+    _mutex.lock();
+    if (index != _current) {
+        _current = index;
+        evict();
+        _wake.wakeAll();
+    }
+    _mutex.unlock();
+}
+
+QSharedPointer<const LyricsLine> LyricsLayout::line(const QString &text)
+{
+    _mutex.lock();
+    QSharedPointer<LyricsLine> l = _cache.value(text);
+    LyricsStyle style = _style;
+    int generation = _generation;
+    _mutex.unlock();
+
+    if (!l.isNull())
+        return l;
+
+    l = build(style, text);
+
+    _mutex.lock();
+    if (generation == _generation)
+        insert(text, l);
+    _mutex.unlock();
+
+    return l;
+}
+
+void LyricsLayout::stop()
+{
+    _mutex.lock();
+    _quit = true;
+    _wake.wakeAll();
+    _mutex.unlock();
+
+    wait();
+}
+
+QSharedPointer<LyricsLine> LyricsLayout::build(const LyricsStyle &style, const QString &text)
+{
+    QSharedPointer<LyricsLine> l(new LyricsLine());
+    int border = borderSize(style);
+
+    l->font = style.autoFontSize ? fitFont(style.font, text, style.maxWidth - border * 2) : style.font;
+    QFontMetrics m(l->font);
+
+    // one layout of the whole line, clusters (Thai marks) end on their last char
+    if (!text.isEmpty()) {
+        QTextLayout layout(text, l->font);
+        layout.beginLayout();
+        QTextLine tl = layout.createLine();
+        layout.endLayout();
+
+        l->charsWidth.reserve(text.length());
+        for (int i=0; i<text.length(); i++) {
+            int pos = i + 1;
+            while (pos < text.length() && !layout.isValidCursorPosition(pos))
+                pos++;
+            l->charsWidth.append(qRound(tl.cursorToX(pos)) + border);
+        }
+        l->charsWidth.last() += border;
+    }
+
+    QSize size(m.width(text) + border * 2, l->font.pointSize() * 2.5);
+
+    QPainterPath path;
+    path.addText(border, l->font.pointSize() * 2, l->font, text);
+
+    l->text = drawLine(path, size, style.tColor, style.tBorderColor, style.tBorderOutColor,
+                       style.tBorderWidth, style.tBorderOutWidth);
+    l->cursor = drawLine(path, size, style.cColor, style.cBorderColor, style.cBorderOutColor,
+                         style.cBorderWidth, style.cBorderOutWidth);
+
+    l->bytes = l->text.byteCount() + l->cursor.byteCount()
+            + l->charsWidth.size() * sizeof(int);
+
+    return l;
+}
+
+QSharedPointer<LyricsLine> LyricsLayout::scaled(const LyricsLine &line, qreal scale)
+{
+    QSharedPointer<LyricsLine> l(new LyricsLine());
+
+    l->font = line.font;
+    if (line.font.pointSize() > 0)
+        l->font.setPointSize(qMax(2, qRound(line.font.pointSize() * scale)));
+
+    l->charsWidth.reserve(line.charsWidth.size());
+    for (int w : line.charsWidth)
+        l->charsWidth.append(qRound(w * scale));
+
+    QSize size(qMax(1, qRound(line.text.width() * scale)), qMax(1, qRound(line.text.height() * scale)));
+    l->text = line.text.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    l->cursor = line.cursor.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    l->bytes = l->text.byteCount() + l->cursor.byteCount()
+            + l->charsWidth.size() * sizeof(int);
+
+    return l;
+}
+
+void LyricsLayout::run()
+{
+    _mutex.lock();
+
+    while (!_quit) {
+        // next line not built yet, while the lines ahead fit the budget
+        QString text;
+        bool found = false;
+        qint64 ahead = 0;
+        for (int i=qMax(0, _current - 1); i<_lines.count() && ahead < _budget; i++) {
+            QSharedPointer<LyricsLine> l = _cache.value(_lines.at(i));
+            if (l.isNull()) {
+                text = _lines.at(i);
+                found = true;
+                break;
+            }
+            ahead += l->bytes;
+        }
+
+        if (!found) {
+            _wake.wait(&_mutex);
+            continue;
+        }
+
+        LyricsStyle style = _style;
+        int generation = _generation;
+
+        _mutex.unlock();
+
+        QSharedPointer<LyricsLine> l = build(style, text);
+
+        _mutex.lock();
+
+        if (generation == _generation)
+            insert(text, l);
+    }
+
+    _mutex.unlock();
+}
+
+bool LyricsLayout::sameLook(const LyricsStyle &a, const LyricsStyle &b)
+{
+    return a.font == b.font && a.autoFontSize == b.autoFontSize
+            && a.tColor == b.tColor && a.tBorderColor == b.tBorderColor && a.tBorderOutColor == b.tBorderOutColor
+            && a.cColor == b.cColor && a.cBorderColor == b.cBorderColor && a.cBorderOutColor == b.cBorderOutColor
+            && a.tBorderWidth == b.tBorderWidth && a.tBorderOutWidth == b.tBorderOutWidth
+            && a.cBorderWidth == b.cBorderWidth && a.cBorderOutWidth == b.cBorderOutWidth;
+}
+
+int LyricsLayout::borderSize(const LyricsStyle &style)
+{
+    return qMax(style.tBorderWidth + style.tBorderOutWidth,
+                style.cBorderWidth + style.cBorderOutWidth);
+}
+
+QFont LyricsLayout::fitFont(const QFont &font, const QString &text, int maxWidth)
+{
+    QFont f = font;
+    int w = QFontMetrics(f).width(text);
+    if (w <= maxWidth || w == 0)
+        return f;
+
+    // jump near the size that fits, then the same 2pt steps as before
+    int size = f.pointSize();
+    int steps = qMax(0, (int)((size - size * (qreal)maxWidth / w) / 2));
+    f.setPointSize(qMax(2, size - steps * 2));
+
+    while (QFontMetrics(f).width(text) > maxWidth && f.pointSize() > 2)
+        f.setPointSize(f.pointSize() - 2);
+
+    while (f.pointSize() + 2 <= size) {
+        QFont bigger = f;
+        bigger.setPointSize(f.pointSize() + 2);
+        if (QFontMetrics(bigger).width(text) > maxWidth)
+            break;
+        f = bigger;
+    }
+
+    return f;
+}
+
+QImage LyricsLayout::drawLine(const QPainterPath &path, const QSize &size,
+                              const QColor &color, const QColor &borderColor, const QColor &borderOutColor,
+                              int borderWidth, int borderOutWidth)
+{
+    QImage img(size, QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::transparent);
+
+    QPainter p(&img);
+    p.setRenderHints(QPainter::Antialiasing);
+
+    if (borderOutWidth > 0) {
+        int w = borderOutWidth + borderWidth;
+        QPen pen(borderOutColor, w, Qt::SolidLine, Qt::SquareCap, Qt::RoundJoin);
+        p.setPen(pen);
+        p.setBrush(borderOutColor);
+        p.drawPath(path);
+    }
+
+    if (borderWidth > 0) {
+        QPen pen(borderColor, borderWidth, Qt::SolidLine, Qt::SquareCap, Qt::RoundJoin);
+        p.setPen(pen);
+        p.setBrush(borderColor);
+        p.drawPath(path);
+    }
+
+    p.setPen(Qt::NoPen);
+    p.fillPath(path, color);
+
+    p.end();
+
+    return img;
+}
+
+void LyricsLayout::insert(const QString &text, const QSharedPointer<LyricsLine> &l)
+{
+    if (_cache.contains(text))
+        return;
+
+    _cache.insert(text, l);
+    _size += l->bytes;
+
+    evict();
+}
+
+void LyricsLayout::evict()
+{
+    if (_size <= _budget)
+        return;
+
+    // keep the lines from just before the current one on
+    QSet<QString> keep;
+    for (int i=qMax(0, _current - 2); i<_lines.count(); i++)
+        keep.insert(_lines.at(i));
+
+    for (auto it = _cache.begin(); it != _cache.end() && _size > _budget; ) {
+        if (keep.contains(it.key())) {
+            ++it;
+        } else {
+            _size -= it.value()->bytes;
+            it = _cache.erase(it);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef LYRICSLAYOUT_H
+#define LYRICSLAYOUT_H
+
+#include <QThread>
+#include <QFont>
+#include <QColor>
+#include <QImage>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+
+class QPainterPath;
+
+// Everything of LyricsWidget that changes how a line looks
+typedef struct
+{
+    QFont   font;
+    bool    autoFontSize;
+    int     maxWidth;       // widget width, for autoFontSize
+    QColor  tColor, tBorderColor, tBorderOutColor;
+    QColor  cColor, cBorderColor, cBorderOutColor;
+    int     tBorderWidth, tBorderOutWidth;
+    int     cBorderWidth, cBorderOutWidth;
+} LyricsStyle;
+
+// A lyric line ready to draw
+typedef struct
+{
+    QFont   font;               // fitted to the width with autoFontSize
+    QVector<int> charsWidth;    // right edge of each char, borders included
+    QImage  text;
+    QImage  cursor;             // highlighted colors, same size as text
+    qint64  bytes;
+} LyricsLine;
+
+// Lays out and draws the lines of a song on its own thread, from the
+// current line on, as far as the memory budget allows. A line not
+// built yet is built on the asking thread. Views of the same lyrics
+// may share one, see LyricsWidget::shareLayouts().
+class LyricsLayout : public QThread
+{
+    Q_OBJECT
+public:
+    explicit LyricsLayout(qint64 budgetBytes = 32 * 1024 * 1024, QObject *parent = nullptr);
+    ~LyricsLayout();
+
+    // drops the lines built with the old style
+    void setStyle(const LyricsStyle &style);
+    int styleWidth();   // the width the lines are built for
+
+    void setLines(const QStringList &lines);
+    void setCurrentLine(int index);
+
+    QSharedPointer<const LyricsLine> line(const QString &text);
+
+    void stop();
+
+    static QSharedPointer<LyricsLine> build(const LyricsStyle &style, const QString &text);
+
+    // for a view of another size
+    static QSharedPointer<LyricsLine> scaled(const LyricsLine &line, qreal scale);
+
+signals:
+    void styleChanged();
+
+protected:
+    void run();
+
+private:
+    static bool sameLook(const LyricsStyle &a, const LyricsStyle &b);   // all but maxWidth
+    static int borderSize(const LyricsStyle &style);
+    static QFont fitFont(const QFont &font, const QString &text, int maxWidth);
+    static QImage drawLine(const QPainterPath &path, const QSize &size,
+                           const QColor &color, const QColor &borderColor, const QColor &borderOutColor,
+                           int borderWidth, int borderOutWidth);
+
+    void insert(const QString &text, const QSharedPointer<LyricsLine> &l);
+    void evict();
+
+private:
+    LyricsStyle _style;
+    int _generation = 0;    // lines built with an older style are dropped
+
+    QStringList _lines;
+    int _current = 0;
+
+    QHash<QString, QSharedPointer<LyricsLine>> _cache;
+    qint64 _budget;
+    qint64 _size = 0;
+    bool _quit = false;
+
+    QMutex _mutex;
+    QWaitCondition _wake;
+};
+
+#endif // LYRICSLAYOUT_H
@@ -0,0 +1,119 @@
+#include "LyricsTimeline.h"
+
+#include <algorithm>
+
+
+QVector<LyricsStep> LyricsTimeline::build(const QStringList &lyrics, int cursorCount)
+{
+    // Runs the cursor steps of the song once on the line lengths only,
+    // the state after every cursor is kept for playback and seek.
+    QVector<LyricsStep> timeline;
+    timeline.reserve(cursorCount);
+
+    LyricsStep st;
+    st.line1 = lyrics.count() > 0 ? 0 : -1;
+    st.line2 = lyrics.count() > 1 ? 1 : -1;
+    st.linesIndex = lyrics.count() > 0 ? 1 : 0;
+    st.charIndex = -1;
+    st.wipe = 0;
+    st.isLine1 = true;
+    st.endLine = false;
+
+    auto length = [&lyrics](int line) { return line < 0 ? 0 : lyrics.at(line).length(); };
+
+    // chars of the line the widths were last taken from, as reset() and
+    // the steps below did with chars_width
+    int len = length(st.line1);
+
+    for (int i=0; i<cursorCount; i++) {
+
+        if (st.endLine) {
+            st.endLine = false;
+            st.charIndex = 0;
+            st.wipe = 0;
+            st.isLine1 = !st.isLine1;
+        }
+
+        if (len == 0 && st.linesIndex < lyrics.count()) {
+            // empty line, go straight to the next one
+            if (st.isLine1)
+                st.line2 = st.linesIndex;
+            else
+                st.line1 = st.linesIndex;
+            st.linesIndex++;
+            st.isLine1 = !st.isLine1;
+            len = length(st.isLine1 ? st.line1 : st.line2);
+            timeline.append(st);
+            continue;
+        }
+
+        if (st.charIndex == len) {
+            st.wipe = len;
+            st.endLine = true;
+            timeline.append(st);
+            continue;
+        }
+
+        if (st.charIndex == 0) {
+            int next = -1;
+            if (st.linesIndex < lyrics.count())
+                next = st.linesIndex++;
+            if (st.isLine1)
+                st.line2 = next;
+            else
+                st.line1 = next;
+            len = length(st.isLine1 ? st.line1 : st.line2);
+        }
+
+        if (st.charIndex >= 0 && len > 0)
+            st.wipe = st.charIndex + 1;
+
+        st.charIndex++;
+
+        if (i == cursorCount - 1)
+            st.wipe = len;
+
+        timeline.append(st);
+    }
+
+    return timeline;
+}
+
+int LyricsTimeline::seekStep(const QVector<long> &cursors, int tick)
+{
+    return std::lower_bound(cursors.constBegin(), cursors.constEnd(), tick) - cursors.constBegin() - 1;
+}
+
+int LyricsTimeline::playStep(const QVector<long> &cursors, int next, int tick)
+{
+    // a frame passes a few cursors at most, no search
+    int last = next - 1;
+    while (last + 1 < cursors.count() && cursors[last + 1] <= tick)
+        last++;
+
+    return last;
+}
+
+void LyricsTimeline::wipeChars(const QVector<LyricsStep> &timeline, int index, int *fromChars, int *toChars)
+{
+    const LyricsStep &st = timeline.at(index);
+
+    *toChars = st.wipe;
+
+    // an end of line stays wiped, otherwise the chars the previous cursor
+    // left wiped on this line
+    if (st.endLine)
+        *fromChars = st.wipe;
+    else if (index > 0 && timeline.at(index - 1).isLine1 == st.isLine1 && !timeline.at(index - 1).endLine)
+        *fromChars = qMin(timeline.at(index - 1).wipe, st.wipe);
+    else
+        *fromChars = 0;
+}
+
+int LyricsTimeline::wipeX(int fromX, int toX, qint64 startUs, qint64 endUs, qint64 nowUs)
+{
+    if (nowUs >= endUs || endUs <= startUs)
+        return toX;
+
+    return fromX + (toX - fromX) * qMax(Q_INT64_C(0), nowUs - startUs) / (endUs - startUs);
+}
@@ -0,0 +1,41 @@
+#ifndef LYRICSTIMELINE_H
+#define LYRICSTIMELINE_H
+
+#include <QStringList>
+#include <QVector>
+
+// Lyrics state after a cursor, line1 and line2 index lyrics, -1 is empty
+typedef struct
+{
+    int  line1;
+    int  line2;
+    int  linesIndex;    // next line to show
+    int  charIndex;
+    int  wipe;          // chars of the sung line under the cursor
+    bool isLine1;       // line 1 is sung
+    bool endLine;
+} LyricsStep;
+
+// The cursor steps of LyricsWidget on the line lengths only, no widget
+class LyricsTimeline
+{
+public:
+    // state after every cursor, by cursor index
+    static QVector<LyricsStep> build(const QStringList &lyrics, int cursorCount);
+
+    // seek, the cursors before tick are passed. Index of the last one,
+    // -1 if none.
+    static int seekStep(const QVector<long> &cursors, int tick);
+
+    // playback, next is the first cursor not applied yet. Index of the
+    // last cursor at or before tick, next - 1 if none was passed.
+    static int playStep(const QVector<long> &cursors, int next, int tick);
+
+    // chars wiped on the sung line when the step starts and ends
+    static void wipeChars(const QVector<LyricsStep> &timeline, int index, int *fromChars, int *toChars);
+
+    // x of a syllable sung from startUs to endUs, moved from fromX to toX
+    static int wipeX(int fromX, int toX, qint64 startUs, qint64 endUs, qint64 nowUs);
+};
+
+#endif // LYRICSTIMELINE_H
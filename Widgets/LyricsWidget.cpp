@@ -1,6 +1,7 @@
 #include "LyricsWidget.h"
 
 #include <QPainter>
+#include <QResizeEvent>
 
 
 LyricsWidget::LyricsWidget(QWidget *parent) : QWidget(parent)
@@ -8,6 +9,8 @@ LyricsWidget::LyricsWidget(QWidget *parent) : QWidget(parent)
     animation = new QVariantAnimation(this);
     animation->setDuration(300);
 
+    layouts.reset(new LyricsLayout());
+
     QFont f = font();
     f.setBold(true);
     f.setPointSize(40);
@@ -30,6 +33,8 @@ LyricsWidget::LyricsWidget(QWidget *parent) : QWidget(parent)
 
     connect(animation, SIGNAL(valueChanged(QVariant)),
             this, SLOT(onAnimationValueChanged(QVariant)));
+
+    layouts->start(QThread::LowPriority);
 }
 
 LyricsWidget::~LyricsWidget()
@@ -38,6 +43,8 @@ LyricsWidget::~LyricsWidget()
     cursors.clear();
     lyrics.clear();
 
+    layouts.clear();
+
     delete animation;
 }
 
@@ -62,11 +69,14 @@ void LyricsWidget::reset()
     cursor_index = 0;
     char_index = -1;
     at_end_line = false;
+    wipe_index = -1;
 
     chars_width.clear();
-    chars_width = getCharsWidth(tLine1);
+    chars_width = getCharsWidth();
 
     updateArea = calculateUpdateArea();
+    if (!layoutsShared)
+        layouts->setCurrentLine(linesIndex);
 
     update();
 }
@@ -104,6 +114,10 @@ void LyricsWidget::setLyrics(const QString &lyr, const QVector<long> &curs)
         index++;
     }
 
+    if (!layoutsShared)
+        layouts->setLines(lyrics);
+    timeline = LyricsTimeline::build(lyrics, cursors.count());
+
     reset();
 }
 
@@ -141,81 +155,15 @@ void LyricsWidget::setLyricsTemp(const QString &lyr, const QVector<long> &curs)
 
 void LyricsWidget::setPositionCursor(int tick)
 {
-    if (cursor_index >= cursors.count())
-        return;
-
-    if (tick < cursors[cursor_index])
-        return;
-
-    if (at_end_line) {
-        at_end_line = false;
-        char_index = 0;
-        cursor_width = 0;
-        cursor_toEnd = 0;
-        isLine1 = !isLine1;
+    // all cursors passed since the last call, the state of the last one
+    int last = LyricsTimeline::playStep(cursors, cursor_index, tick);
+    if (last >= cursor_index) {
+        applyStep(last, true);
+        cursor_index = last + 1;
     }
 
-    if (chars_width.count() == 0 && linesIndex < lyrics.count()) {
-        if (isLine1)
-            setTextLine2(lyrics.at(linesIndex));
-        else
-            setTextLine1(lyrics.at(linesIndex));
-        linesIndex++;
-        isLine1 = !isLine1;
-        cursor_index++;
-
-        chars_width.clear();
-        chars_width = getCharsWidth();
-
-        return;
-    }
-
-    if (char_index == chars_width.count()) {
-        animation->stop();
-        cursor_width = chars_width.last();
-        at_end_line = true;
-        cursor_index++;
-        update();
-
-        return;
-    }
-
-    if (char_index == 0) {
-        if (linesIndex < lyrics.count()) {
-            if (isLine1)
-                setTextLine2(lyrics.at(linesIndex));
-            else
-                setTextLine1(lyrics.at(linesIndex));
-            linesIndex++;
-        } else {
-            if (isLine1) setTextLine2("");
-            else setTextLine1("");
-        }
-
-        //update();
-
-        chars_width.clear();
-        chars_width = getCharsWidth();
-        updateArea = calculateUpdateArea();
-    }
-
-    if (char_index >= 0 && chars_width.count() != 0) {
-        cursor_toEnd = chars_width.at(char_index);
-    }
-
-    char_index++;
-
-    if (cursor_index == cursors.count() - 1) {
-        cursor_toEnd = chars_width.count() == 0 ? 0 : chars_width.last();
-    }
-
-    cursor_index++;
-
-    animation->stop();
-    animation->setStartValue(cursor_width);
-    animation->setEndValue(cursor_toEnd);
-    animation->start();
-
+    if (frameWipe)
+        updateWipe(tick);
 }
 
 void LyricsWidget::setSeekPositionCursor(int tick)
@@ -231,99 +179,19 @@ void LyricsWidget::setSeekPositionCursor(int tick)
         return;
     }
 
-    reset();
+    // cursors before tick are passed
+    int last = LyricsTimeline::seekStep(cursors, tick);
 
-    int round = 0;
-    while (cursors[round] < tick) {
-        round++;
-        if (round == cursors.count())
-            break;
+    if (last < 0) {
+        reset();
+        return;
     }
 
-    for (int i=0; i<round; i++) {
-
-        if (at_end_line) {
-            at_end_line = false;
-            char_index = 0;
-            cursor_width = 0;
-            cursor_toEnd = 0;
-            isLine1 = !isLine1;
-            //updateArea = calculateUpdateArea();
-        }
-
-        if (chars_width.count() == 0 && linesIndex < lyrics.count()) {
-            if (isLine1)
-                tLine2 = lyrics.at(linesIndex);
-            else
-                tLine1 = lyrics.at(linesIndex);
-            linesIndex++;
-            isLine1 = !isLine1;
-            cursor_index++;
-
-            chars_width.clear();
-            chars_width = getCharsWidth();
-            continue;
-        }
-
-        if (char_index == chars_width.count()) {
-            cursor_width = chars_width.last();
-            at_end_line = true;
-            cursor_index++;
-
-            /*if (linesIndex < lyrics.count()) {
-                if (isLine1)
-                    tLine1 = lyrics.at(linesIndex);
-                else
-                    tLine2 = lyrics.at(linesIndex);
-                linesIndex++;
-            } else {
-                if (isLine1) tLine1 = "";
-                else tLine2 = "";
-            }*/
-
-            continue;
-        }
-
-        if (char_index == 0) {
-            if (linesIndex < lyrics.count()) {
-                if (isLine1)
-                    tLine2 = lyrics.at(linesIndex);
-                else
-                    tLine1 = lyrics.at(linesIndex);
-                linesIndex++;
-            } else {
-                if (isLine1) tLine2 = "";
-                else tLine1 = "";
-            }
-            chars_width.clear();
-            chars_width = getCharsWidth();
-        }
-
-        if (char_index >= 0 && chars_width.count() != 0) {
-            cursor_toEnd = chars_width.at(char_index);
-        }
-
-        char_index++;
-
-        if (cursor_index == cursors.count() - 1) {
-            cursor_toEnd = chars_width.count() == 0 ? 0 : chars_width.last();
-        }
-
-        cursor_index++;
-
-    } // end for loop
-
-    at_end_line = (char_index == chars_width.count()) ? true : false;
-    chars_width.clear();
-    chars_width = getCharsWidth();
-
-    setTextLine1(tLine1);
-    setTextLine2(tLine2);
-
-    updateArea = calculateUpdateArea();
-    cursor_width = cursor_toEnd;
+    applyStep(last, false);
+    cursor_index = last + 1;
 
-    update();
+    if (frameWipe)
+        updateWipe(tick);
 }
 
 void LyricsWidget::switchToLyricsTemp()
@@ -336,12 +204,17 @@ void LyricsWidget::switchToLyricsTemp()
     lyricsTemp.clear();
     cursorsTemp.clear();
 
+    if (!layoutsShared)
+        layouts->setLines(lyrics);
+    timeline = LyricsTimeline::build(lyrics, cursors.count());
+
     reset();
 }
 
 void LyricsWidget::setTextFont(const QFont &f)
 {
     setFont(f);
+    updateLayoutStyle();
 
     setTextLine1(tLine1);
     setTextLine2(tLine2);
@@ -352,6 +225,7 @@ void LyricsWidget::setTextFont(const QFont &f)
 void LyricsWidget::setTextColor(const QColor &c)
 {
     tColor = c;
+    updateLayoutStyle();
     setTextLine1(tLine1);
     setTextLine2(tLine2);
 }
@@ -359,6 +233,7 @@ void LyricsWidget::setTextColor(const QColor &c)
 void LyricsWidget::setTextBorderColor(const QColor &c)
 {
     tBorderColor = c;
+    updateLayoutStyle();
     setTextLine1(tLine1);
     setTextLine2(tLine2);
 }
@@ -366,6 +241,7 @@ void LyricsWidget::setTextBorderColor(const QColor &c)
 void LyricsWidget::setTextBorderOutColor(const QColor &c)
 {
     tBorderOutColor = c;
+    updateLayoutStyle();
     setTextLine1(tLine1);
     setTextLine2(tLine2);
 }
@@ -373,6 +249,7 @@ void LyricsWidget::setTextBorderOutColor(const QColor &c)
 void LyricsWidget::setTextBorderWidth(int w)
 {
     tBorderWidth = w;
+    updateLayoutStyle();
     setTextLine1(tLine1);
     setTextLine2(tLine2);
     updateArea = calculateUpdateArea();
@@ -381,6 +258,7 @@ void LyricsWidget::setTextBorderWidth(int w)
 void LyricsWidget::setTextBorderOutWidth(int w)
 {
     tBorderOutWidth = w;
+    updateLayoutStyle();
     setTextLine1(tLine1);
     setTextLine2(tLine2);
     updateArea = calculateUpdateArea();
@@ -389,6 +267,7 @@ void LyricsWidget::setTextBorderOutWidth(int w)
 void LyricsWidget::setCurColor(const QColor &c)
 {
     cColor = c;
+    updateLayoutStyle();
     setTextLine1(tLine1);
     setTextLine2(tLine2);
 }
@@ -396,6 +275,7 @@ void LyricsWidget::setCurColor(const QColor &c)
 void LyricsWidget::setCurBorderColor(const QColor &c)
 {
     cBorderColor = c;
+    updateLayoutStyle();
     setTextLine1(tLine1);
     setTextLine2(tLine2);
 }
@@ -403,6 +283,7 @@ void LyricsWidget::setCurBorderColor(const QColor &c)
 void LyricsWidget::setCurBorderOutColor(const QColor &c)
 {
     cBorderOutColor = c;
+    updateLayoutStyle();
     setTextLine1(tLine1);
     setTextLine2(tLine2);
 }
@@ -410,6 +291,7 @@ void LyricsWidget::setCurBorderOutColor(const QColor &c)
 void LyricsWidget::setCurBorderWidth(int w)
 {
     cBorderWidth = w;
+    updateLayoutStyle();
     setTextLine1(tLine1);
     setTextLine2(tLine2);
     updateArea = calculateUpdateArea();
@@ -418,6 +300,7 @@ void LyricsWidget::setCurBorderWidth(int w)
 void LyricsWidget::setCurBorderOutWidth(int w)
 {
     cBorderOutWidth = w;
+    updateLayoutStyle();
     setTextLine1(tLine1);
     setTextLine2(tLine2);
     updateArea = calculateUpdateArea();
@@ -433,6 +316,31 @@ void LyricsWidget::setAnimationTime(int t)
         animation->setDuration(t);
 }
 
+void LyricsWidget::setFrameWipe(bool f)
+{
+    if (f == frameWipe)
+        return;
+
+    animation->stop();
+    frameWipe = f;
+    cursor_width = cursor_toEnd;
+    update(updateArea);
+}
+
+void LyricsWidget::shareLayouts(LyricsWidget *source)
+{
+    if (layoutsShared || source == this)
+        return;
+
+    // the own thread stops with the last reference
+    layouts = source->layouts;
+    layoutsShared = true;
+
+    connect(layouts.data(), SIGNAL(styleChanged()), this, SLOT(onLayoutStyleChanged()));
+
+    onLayoutStyleChanged();
+}
+
 void LyricsWidget::setLine1Position(LinePosition p)
 {
     if (line1_p == p)
@@ -470,12 +378,7 @@ void LyricsWidget::setLine2Y(int y)
 void LyricsWidget::setTextLine1(const QString &text, bool andUpdate)
 {
     tLine1 = text;
-
-    pixLine1 = QPixmap(calculateLineSize(text));
-    drawTextToPixmap(&pixLine1, text);
-
-    pixCurLine1 = QPixmap(pixLine1.size());
-    drawCursorTextToPixmap(&pixCurLine1, text);
+    line1 = viewLine(text);
 
     if (andUpdate)
         update();
@@ -484,12 +387,7 @@ void LyricsWidget::setTextLine1(const QString &text, bool andUpdate)
 void LyricsWidget::setTextLine2(const QString &text, bool andUpdate)
 {
     tLine2 = text;
-
-    pixLine2 = QPixmap(calculateLineSize(text));
-    drawTextToPixmap(&pixLine2, text);
-
-    pixCurLine2 = QPixmap(pixLine2.size());
-    drawCursorTextToPixmap(&pixCurLine2, text);
+    line2 = viewLine(text);
 
     if (andUpdate)
         update();
@@ -497,6 +395,15 @@ void LyricsWidget::setTextLine2(const QString &text, bool andUpdate)
 
 void LyricsWidget::resizeEvent(QResizeEvent *event)
 {
+    // the fitted font sizes depend on the width only, the shared lines
+    // are scaled to it
+    if (event->size().width() != event->oldSize().width()) {
+        if (layoutsShared)
+            onLayoutStyleChanged();
+        else
+            updateLayoutStyle();
+    }
+
     update();
     updateArea = calculateUpdateArea();
 }
@@ -508,32 +415,32 @@ void LyricsWidget::paintEvent(QPaintEvent *event)
     QPoint p1 = getLine1Point();
     QPoint p2 = getLine2Point();
 
-    p.drawPixmap( p1, pixLine1 );
-    p.drawPixmap( p2, pixLine2 );
+    p.drawImage( p1, line1->text );
+    p.drawImage( p2, line2->text );
 
     if (isLine1) {
         int x = p1.x();
         int y = p1.y();
-        QRect rect(x, y, pixLine1.width(), pixLine1.height());
+        QRect rect(x, y, line1->text.width(), line1->text.height());
         QRect inRect(rect.x(), rect.y(), cursor_width, rect.height());
         //QRegion r(rect);
         //r = r.intersected(inRect);
 
         //p.setClipRegion(r);
         p.setClipRect(inRect);
-        p.drawPixmap(x, y, pixCurLine1);
+        p.drawImage(x, y, line1->cursor);
     }
     else {
         int x = p2.x();
         int y = p2.y();
-        QRect rect(x, y, pixLine2.width(), pixLine2.height());
+        QRect rect(x, y, line2->text.width(), line2->text.height());
         QRect inRect(rect.x(), rect.y(), cursor_width, rect.height());
         //QRegion r(rect);
         //r = r.intersected(inRect);
 
         //p.setClipRegion(r);
         p.setClipRect(inRect);
-        p.drawPixmap(x, y, pixCurLine2);
+        p.drawImage(x, y, line2->cursor);
     }
 
     p.end();
@@ -545,29 +452,42 @@ void LyricsWidget::onAnimationValueChanged(const QVariant &v)
     update(updateArea);
 }
 
+void LyricsWidget::onLayoutStyleChanged()
+{
+    setTextLine1(tLine1, false);
+    setTextLine2(tLine2, false);
+
+    // the cursor positions in the new sizes
+    if (wipe_index >= 0 && wipe_index < timeline.count()) {
+        applyStep(wipe_index, false);
+        return;
+    }
+
+    chars_width = getCharsWidth();
+    updateArea = calculateUpdateArea();
+    update();
+}
+
 QVector<int> LyricsWidget::getCharsWidth()
 {
     if (isLine1)
-        return getCharsWidth(tLine1);
+        return line1->charsWidth;
     else
-        return getCharsWidth(tLine2);
+        return line2->charsWidth;
 }
 
-QVector<int> LyricsWidget::getCharsWidth(const QString &text)
+QSharedPointer<const LyricsLine> LyricsWidget::viewLine(const QString &text)
 {
-    QVector<int> cl;
-    QFont f = autoFontSize ? getPerfectFont(text) : font();
-    QFontMetrics m(f);
-
-    for (int i=0; i<text.length(); i++) {
-        int w = m.width(text.left(i+1)) + getAllBorderSize();
-        cl.append(w);
-    }
+    QSharedPointer<const LyricsLine> l = layouts->line(text);
+    if (!layoutsShared)
+        return l;
 
-    if (cl.count() > 0)
-        cl.last() += getAllBorderSize();
+    // shared lines are built for the width of the source view
+    int w = layouts->styleWidth();
+    if (w <= 0 || w == width())
+        return l;
 
-    return cl;
+    return LyricsLayout::scaled(*l, width() / (qreal)w);
 }
 
 QRect LyricsWidget::calculateUpdateArea()
@@ -577,59 +497,36 @@ QRect LyricsWidget::calculateUpdateArea()
         QPoint p = getLine1Point();
         r.setX(p.x());
         r.setY(p.y());
-        r.setWidth(pixLine1.width());
-        r.setHeight(pixLine1.height());
+        r.setWidth(line1->text.width());
+        r.setHeight(line1->text.height());
     }
     else {
         QPoint p = getLine2Point();
         r.setX(p.x());
         r.setY(p.y());
-        r.setWidth(pixLine2.width());
-        r.setHeight(pixLine2.height());
+        r.setWidth(line2->text.width());
+        r.setHeight(line2->text.height());
     }
     return r;
 }
 
-QSize LyricsWidget::calculateLineSize(const QString &text)
+int LyricsWidget::lineY(int y)
 {
-    QSize s;
-    if (autoFontSize) {
-        QFont f = getPerfectFont(text);
-        QFontMetrics m(f);
-        s.setWidth(m.width(text) + getAllBorderSize() * 2);
-        s.setHeight(f.pointSize() * 2.5);
-    } else {
-        s.setWidth( fontMetrics().width(text)
-                    + getAllBorderSize() *2 );
-        s.setHeight( font().pointSize() * 2.5 );
-    }
-    return s;
-}
+    // scaled with the shared lines
+    int w = layoutsShared ? layouts->styleWidth() : 0;
+    if (w <= 0 || w == width())
+        return y;
 
-int LyricsWidget::getAllBorderSize()
-{
-    return qMax(tBorderWidth + tBorderOutWidth,
-                cBorderWidth + cBorderOutWidth);
-}
-
-QFont LyricsWidget::getPerfectFont(const QString &text)
-{
-    QFont f = font();
-    QFontMetrics m(f);
-    while (m.width(text) > this->width() - (getAllBorderSize() * 2)) {
-        f.setPointSize(f.pointSize() - 2);
-        m = QFontMetrics(f);
-    }
-    return f;
+    return qRound(y * width() / (qreal)w);
 }
 
 QPoint LyricsWidget::getLine1Point()
 {
     QPoint p;
-    p.setY(this->height() - line1_y);
+    p.setY(this->height() - lineY(line1_y));
     switch (line1_p) {
     case LinePosition::Center: {
-        int x = (this->width() - pixLine1.width()) / 2;
+        int x = (this->width() - line1->text.width()) / 2;
         p.setX(x);
         break;
     }
@@ -638,7 +535,7 @@ QPoint LyricsWidget::getLine1Point()
         break;
     }
     case LinePosition::Right: {
-        p.setX( this->width() - (pixLine1.width() + 5) );
+        p.setX( this->width() - (line1->text.width() + 5) );
         break;
     }
     }
@@ -649,10 +546,10 @@ QPoint LyricsWidget::getLine1Point()
 QPoint LyricsWidget::getLine2Point()
 {
     QPoint p;
-    p.setY(this->height() - line2_y);
+    p.setY(this->height() - lineY(line2_y));
     switch (line2_p) {
     case LinePosition::Center: {
-        int x = (this->width() - pixLine2.width()) / 2;
+        int x = (this->width() - line2->text.width()) / 2;
         p.setX(x);
         break;
     }
@@ -661,7 +558,7 @@ QPoint LyricsWidget::getLine2Point()
         break;
     }
     case LinePosition::Right: {
-        p.setX( this->width() - (pixLine2.width() + 5) );
+        p.setX( this->width() - (line2->text.width() + 5) );
         break;
     }
     }
@@ -669,102 +566,99 @@ QPoint LyricsWidget::getLine2Point()
     return p;
 }
 
-void LyricsWidget::drawTextToPixmap(QPixmap *pix, const QString &text)
+void LyricsWidget::updateLayoutStyle()
 {
-    pix->fill(Qt::transparent);
-    QPainter p(pix);
-    p.setRenderHints(QPainter::Antialiasing);
+    if (layoutsShared)
+        return;
 
-    QFont f = autoFontSize ? getPerfectFont(text) : font();
-    QPainterPath path;
-    path.addText(getAllBorderSize(), f.pointSize() * 2, f, text);
+    LyricsStyle style;
+    style.font = font();
+    style.autoFontSize = autoFontSize;
+    style.maxWidth = width();
+    style.tColor = tColor;
+    style.tBorderColor = tBorderColor;
+    style.tBorderOutColor = tBorderOutColor;
+    style.cColor = cColor;
+    style.cBorderColor = cBorderColor;
+    style.cBorderOutColor = cBorderOutColor;
+    style.tBorderWidth = tBorderWidth;
+    style.tBorderOutWidth = tBorderOutWidth;
+    style.cBorderWidth = cBorderWidth;
+    style.cBorderOutWidth = cBorderOutWidth;
 
-    if (tBorderOutWidth > 0) {
-        int w = tBorderOutWidth + tBorderWidth;
-        QPen pen(tBorderOutColor, w, Qt::SolidLine, Qt::SquareCap, Qt::RoundJoin);
-        p.setPen(pen);
-        p.setBrush(tBorderOutColor);
-        p.drawPath(path);
-    }
+    layouts->setStyle(style);
+}
 
-    if (tBorderWidth > 0) {
-        int w = tBorderWidth;
-        QPen pen(tBorderColor, w, Qt::SolidLine, Qt::SquareCap, Qt::RoundJoin);
-        p.setPen(pen);
-        p.setBrush(tBorderColor);
-        p.drawPath(path);
-    }
+void LyricsWidget::applyStep(int index, bool animate)
+{
+    const LyricsStep &st = timeline.at(index);
 
-    //p.setBrush(tColor);
-    p.setPen(Qt::NoPen);
+    QString text1 = (st.line1 < 0) ? "" : lyrics.at(st.line1);
+    QString text2 = (st.line2 < 0) ? "" : lyrics.at(st.line2);
 
-    //p.drawPath(path);
-    p.fillPath(path, tColor);
+    if (text1 != tLine1)
+        setTextLine1(text1, false);
+    if (text2 != tLine2)
+        setTextLine2(text2, false);
 
-    /*if (tBorderWidth > 0) {
+    bool newLine = (st.isLine1 != isLine1);
 
-        QPen pen(Qt::red, tBorderWidth * 2, Qt::SolidLine, Qt::SquareCap, Qt::RoundJoin);
-        QPainterPathStroker stroker(pen);
-        QPainterPath strokedPath = stroker.createStroke(path);
+    isLine1 = st.isLine1;
+    linesIndex = st.linesIndex;
+    char_index = st.charIndex;
+    at_end_line = st.endLine;
+    if (!layoutsShared)
+        layouts->setCurrentLine(linesIndex);
 
-        if (tBorderOutWidth > 0)
-            p.setPen(QPen(tBorderOutColor, tBorderOutWidth));
-        p.setBrush(tBorderColor);
-        p.drawPath(strokedPath.subtracted(path));
+    chars_width = getCharsWidth();
+    updateArea = calculateUpdateArea();
 
-        //QPen pen(tBorderColor, tBorderWidth * 2, Qt::SolidLine, Qt::SquareCap, Qt::RoundJoin);
-        //p.strokePath(path, pen);
-    }*/
+    int fromChars, toChars;
+    LyricsTimeline::wipeChars(timeline, index, &fromChars, &toChars);
 
-    p.end();
-}
+    int wipe = qMin(toChars, chars_width.count());
+    cursor_toEnd = (wipe == 0) ? 0 : chars_width.at(wipe - 1);
 
-void LyricsWidget::drawCursorTextToPixmap(QPixmap *pix, const QString &text)
-{
-    pix->fill(Qt::transparent);
-    QPainter p(pix);
-    p.setRenderHints(QPainter::Antialiasing);
+    fromChars = qMin(fromChars, wipe);
+    wipe_index = index;
+    wipe_from = (fromChars == 0) ? 0 : chars_width.at(fromChars - 1);
 
-    QFont f = autoFontSize ? getPerfectFont(text) : font();
-    QPainterPath path;
-    path.addText(getAllBorderSize(), f.pointSize() * 2, f, text);
+    animation->stop();
 
-    if (cBorderOutWidth > 0) {
-        int w = cBorderOutWidth + cBorderWidth;
-        QPen pen(cBorderOutColor, w, Qt::SolidLine, Qt::SquareCap, Qt::RoundJoin);
-        p.setPen(pen);
-        p.setBrush(cBorderOutColor);
-        p.drawPath(path);
-    }
+    if (newLine)
+        cursor_width = 0;
 
-    if (cBorderWidth > 0) {
-        int w = cBorderWidth;
-        QPen pen(cBorderColor, w, Qt::SolidLine, Qt::SquareCap, Qt::RoundJoin);
-        p.setPen(pen);
-        p.setBrush(cBorderColor);
-        p.drawPath(path);
+    if (frameWipe && _player != nullptr) {
+        // updateWipe() moves it from here
+        cursor_width = animate ? wipe_from : cursor_toEnd;
+    }
+    else if (animate && !st.endLine) {
+        animation->setStartValue(cursor_width);
+        animation->setEndValue(cursor_toEnd);
+        animation->start();
+    } else {
+        cursor_width = cursor_toEnd;
     }
 
-    p.setBrush(cColor);
-    p.setPen(Qt::NoPen);
-
-    //p.drawPath(path);
-    p.fillPath(path, cColor);
+    update();
+}
 
-    /*if (cBorderWidth > 0) {
+void LyricsWidget::updateWipe(int tick)
+{
+    if (_player == nullptr || wipe_index < 0 || wipe_index >= cursors.count())
+        return;
 
-        QPen pen(Qt::red, cBorderWidth * 2, Qt::SolidLine, Qt::SquareCap, Qt::RoundJoin);
-        QPainterPathStroker stroker(pen);
-        QPainterPath strokedPath = stroker.createStroke(path);
+    // a syllable is sung from its cursor to the next one, compared in
+    // time so a tempo change inside it is followed
+    qint64 startUs = _player->timeUsFromTick(cursors[wipe_index]);
+    qint64 endUs = (wipe_index + 1 < cursors.count()) ? _player->timeUsFromTick(cursors[wipe_index + 1]) : startUs;
+    qint64 nowUs = _player->timeUsFromTick(qMax(0, tick));
 
-        if (cBorderOutWidth > 0)
-            p.setPen(QPen(cBorderOutColor, cBorderOutWidth));
-        p.setBrush(cBorderColor);
-        p.drawPath(strokedPath.subtracted(path));
+    int x = LyricsTimeline::wipeX(wipe_from, cursor_toEnd, startUs, endUs, nowUs);
 
-        //QPen pen(cBorderColor, cBorderWidth);
-        //p.strokePath(path.simplified(), pen);
-    }*/
+    if (x == cursor_width)
+        return;
 
-    p.end();
+    cursor_width = x;
+    update(updateArea);
 }
@@ -4,6 +4,10 @@
 #include <QWidget>
 #include <QVariantAnimation>
 
+#include "LyricsLayout.h"
+#include "LyricsTimeline.h"
+#include "Midi/MidiPlayer.h"
+
 enum class LinePosition {
     Center,
     Left,
@@ -58,8 +62,21 @@ public:
 
     void setAnimationTime(int t);
 
+    // the wipe follows the playback time between the syllable cursors,
+    // stepped by setPositionCursor() on every frame, instead of an
+    // animation started at each cursor
+    bool isFrameWipe() { return frameWipe; }
+    void setFrameWipe(bool f);
+
+    MidiPlayer *player() { return _player; }
+    void setPlayer(MidiPlayer *p) { _player = p; }
+
+    // draw the lines laid out by source, scaled when the widths differ,
+    // the style of source is used from then on
+    void shareLayouts(LyricsWidget *source);
+
     bool isAutoFontSize() { return autoFontSize; }
-    void setAutoFontSize(bool a) { autoFontSize = a; }
+    void setAutoFontSize(bool a) { autoFontSize = a; updateLayoutStyle(); }
 
     LinePosition line1Position() { return line1_p; }
     LinePosition line2Position() { return line2_p; }
@@ -89,13 +106,16 @@ protected:
 
 private slots:
     void onAnimationValueChanged(const QVariant &v);
+    void onLayoutStyleChanged();
 
 private:
     QVariantAnimation *animation;
+    QSharedPointer<LyricsLayout> layouts;
+    bool layoutsShared = false;
+    MidiPlayer *_player = nullptr;
 
     QString tLine1, tLine2;
-    QPixmap pixLine1, pixLine2;
-    QPixmap pixCurLine1, pixCurLine2;
+    QSharedPointer<const LyricsLine> line1, line2;
 
     LinePosition line1_p = LinePosition::Center;
     LinePosition line2_p = LinePosition::Center;
@@ -105,6 +125,7 @@ private:
 
     QStringList lyrics, lyricsTemp;
     QVector<long> cursors, cursorsTemp;
+    QVector<LyricsStep> timeline;   // by cursor index
     bool isLine1 = true;
     bool autoFontSize = true;
     int linesIndex = 0;
@@ -116,6 +137,10 @@ private:
     int cursor_toEnd = 0;
     bool at_end_line = false;
 
+    bool frameWipe = false;
+    int wipe_index = -1;    // cursor of the syllable being wiped
+    int wipe_from = 0;      // cursor position before that syllable
+
     int tBorderWidth = 2, tBorderOutWidth = 1;
     int cBorderWidth = 3, cBorderOutWidth = 1;
 
@@ -125,17 +150,17 @@ private:
     QRect updateArea;
 
     QVector<int> getCharsWidth();
-    QVector<int> getCharsWidth(const QString &text);
+    QSharedPointer<const LyricsLine> viewLine(const QString &text);
     QRect calculateUpdateArea();
-    QSize calculateLineSize(const QString &text);
 
-    int getAllBorderSize();
-    QFont getPerfectFont(const QString &text);
+    int lineY(int y);
     QPoint getLine1Point();
     QPoint getLine2Point();
 
-    void drawTextToPixmap(QPixmap *pix, const QString &text);
-    void drawCursorTextToPixmap(QPixmap *pix, const QString &text);
+    void updateLayoutStyle();
+
+    void applyStep(int index, bool animate);
+    void updateWipe(int tick);
 };
 
 #endif // LYRICSWIDGET_H
@@ -35,33 +35,33 @@ PlaylistWidget::~PlaylistWidget()
     delete ui;
 }
 
-void PlaylistWidget::setPlaylist(const QList<Song *> &songlist)
+void PlaylistWidget::setPlaylist(const QList<Song> &songlist)
 {
     for (int row=ui->tableWidget->rowCount()-1; row>=0; row--)
         ui->tableWidget->removeRow(row);
 
-    for (Song* s : songlist)
+    for (const Song &s : songlist)
         addSong(s);
 
     setCurrentRow(0);
 }
 
-void PlaylistWidget::addSong(Song *song)
+void PlaylistWidget::addSong(const Song &song)
 {
     int rowCount = ui->tableWidget->rowCount();
 
     ui->tableWidget->insertRow(rowCount);
     ui->tableWidget->setItem(rowCount, 0, new QTableWidgetItem(QString::number(rowCount+1)));
-    ui->tableWidget->setItem(rowCount, 1, new QTableWidgetItem(song->id()));
-    ui->tableWidget->setItem(rowCount, 2, new QTableWidgetItem(song->detailWithoutIDType()));
-    ui->tableWidget->setItem(rowCount, 3, new QTableWidgetItem(song->songType()));
+    ui->tableWidget->setItem(rowCount, 1, new QTableWidgetItem(song.id()));
+    ui->tableWidget->setItem(rowCount, 2, new QTableWidgetItem(song.detailWithoutIDType()));
+    ui->tableWidget->setItem(rowCount, 3, new QTableWidgetItem(song.songType()));
 
     ui->tableWidget->item(rowCount, 0)->setTextAlignment(Qt::AlignHCenter|Qt::AlignVCenter);
 }
 
-void PlaylistWidget::updateDetail(int row, Song *song)
+void PlaylistWidget::updateDetail(int row, const Song &song)
 {
-    ui->tableWidget->item(row, 2)->setText(song->detailWithoutIDType());
+    ui->tableWidget->item(row, 2)->setText(song.detailWithoutIDType());
 }
 
 int PlaylistWidget::rowCount()
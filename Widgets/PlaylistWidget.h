@@ -17,9 +17,9 @@ public:
     explicit PlaylistWidget(QWidget *parent = 0);
     ~PlaylistWidget();
 
-    void setPlaylist(const QList<Song*> &songlist);
-    void addSong(Song *song);
-    void updateDetail(int row, Song *song);
+    void setPlaylist(const QList<Song> &songlist);
+    void addSong(const Song &song);
+    void updateDetail(int row, const Song &song);
 
     int rowCount();
     int currentRow();
@@ -0,0 +1,142 @@
+#include "SlideshowLoader.h"
+
+#include <QDir>
+#include <QImageReader>
+
+
+SlideshowLoader::SlideshowLoader(int ahead, QObject *parent) : QThread(parent)
+{
+    _ahead = qMax(1, ahead);
+}
+
+SlideshowLoader::~SlideshowLoader()
+{
+    stop();
+}
+
+void SlideshowLoader::setFiles(const QStringList &files)
+{
+    _mutex.lock();
+    _files = files;
+    _next = 0;
+    _ready.clear();
+    _generation++;
+    _wake.wakeAll();
+    _mutex.unlock();
+}
+
+void SlideshowLoader::setSize(const QSize &size)
+{
+    _mutex.lock();
+    if (size != _size) {
+        // the dropped ones and the one being decoded are decoded again
+        if (!_files.isEmpty()) {
+            int back = _ready.count() + (_loading ? 1 : 0);
+            _next = ((_next - back) % _files.count() + _files.count()) % _files.count();
+        }
+        _size = size;
+        _ready.clear();
+        _generation++;
+        _wake.wakeAll();
+    }
+    _mutex.unlock();
+}
+
+bool SlideshowLoader::takeNext(QImage *image)
+{
+    _mutex.lock();
+    bool result = !_ready.isEmpty();
+    if (result) {
+        *image = _ready.takeFirst();
+        _wake.wakeAll();
+    }
+    _mutex.unlock();
+
+    return result;
+}
+
+void SlideshowLoader::stop()
+{
+    _mutex.lock();
+    _quit = true;
+    _wake.wakeAll();
+    _mutex.unlock();
+
+    wait();
+}
+
+QStringList SlideshowLoader::imageFiles(const QString &dir)
+{
+    QStringList filters;
+    filters << "*.png" << "*.jpg" << "*.jpeg" << "*.bmp";
+
+    QStringList files;
+    QDir d(dir);
+    for (const QString &name : d.entryList(filters, QDir::Files, QDir::Name | QDir::IgnoreCase))
+        files.append(d.absoluteFilePath(name));
+
+    return files;
+}
+
+QImage SlideshowLoader::load(const QString &file, const QSize &size)
+{
+    QImageReader reader(file);
+    reader.setAutoTransform(true);
+
+    QImage img = reader.read();
+    if (img.isNull() || size.isEmpty())
+        return QImage();
+
+    img = img.scaled(size, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    img = img.copy((img.width() - size.width()) / 2, (img.height() - size.height()) / 2,
+                   size.width(), size.height());
+
+    // the format the painter blits without converting
+    return img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+void SlideshowLoader::run()
+{
+    _mutex.lock();
+
+    int failed = 0;
+
+    while (!_quit) {
+        // nothing to do, or every file failed since the list or size changed
+        if (_files.isEmpty() || _size.isEmpty() || _ready.count() >= _ahead
+                || failed >= _files.count()) {
+            _wake.wait(&_mutex);
+            failed = 0;
+            continue;
+        }
+
+        QString file = _files.at(_next);
+        _next = (_next + 1) % _files.count();
+
+        QSize size = _size;
+        int generation = _generation;
+        _loading = true;
+
+        _mutex.unlock();
+
+        QImage img = load(file, size);
+
+        _mutex.lock();
+
+        _loading = false;
+
+        if (generation != _generation) {
+            failed = 0;
+            continue;
+        }
+
+        if (img.isNull()) {
+            failed++;
+        } else {
+            failed = 0;
+            _ready.append(img);
+        }
+    }
+
+    _mutex.unlock();
+}
@@ -0,0 +1,53 @@
+#ifndef SLIDESHOWLOADER_H
+#define SLIDESHOWLOADER_H
+
+#include <QThread>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QSize>
+#include <QStringList>
+#include <QWaitCondition>
+
+// Decodes the next images of a slideshow on its own thread and scales
+// them to the view, a few ahead of the one shown.
+class SlideshowLoader : public QThread
+{
+    Q_OBJECT
+public:
+    explicit SlideshowLoader(int ahead = 2, QObject *parent = nullptr);
+    ~SlideshowLoader();
+
+    void setFiles(const QStringList &files);
+
+    // device pixels, drops the images scaled for the old size
+    void setSize(const QSize &size);
+
+    // false when the next one is not ready yet
+    bool takeNext(QImage *image);
+
+    void stop();
+
+    static QStringList imageFiles(const QString &dir);
+
+    // fills size, cropped to keep the aspect ratio
+    static QImage load(const QString &file, const QSize &size);
+
+protected:
+    void run();
+
+private:
+    QStringList _files;
+    int _next = 0;          // next file to decode
+    QList<QImage> _ready;
+    QSize _size;
+    int _ahead;
+    int _generation = 0;    // images of an older size or list are dropped
+    bool _loading = false;
+    bool _quit = false;
+
+    QMutex _mutex;
+    QWaitCondition _wake;
+};
+
+#endif // SLIDESHOWLOADER_H
@@ -3,10 +3,13 @@
 #include <QApplication>
 #include <QSplashScreen>
 #include <QDirIterator>
+#include <QEventLoop>
 #include <QMetaType>
 #include <QStyleFactory>
+#include <QTextStream>
 
 #include "BASSFX/VSTFX.h"
+#include "Midi/MidiRenderer.h"
 #include "version.h"
 #include "Config.h"
 #include "Utils.h"
@@ -19,6 +22,7 @@ void registerMetaType();
 
 void checkDatabase(QSplashScreen *splash, SongDatabase *db);
 void loadSoundfonts(QSplashScreen *splash, MidiSynthesizer *synth);
+int renderBench(MidiPlayer *player, const QStringList &args);
 
 #ifndef __linux__
 void loadVSTi(QSplashScreen *splash, MidiSynthesizer *synth);
@@ -95,6 +99,15 @@ int main(int argc, char *argv[])
     #endif
     w.synthMixerDialog()->setFXToSynth();
 
+    // HandyKaraoke --render-bench <folder> [<count>]
+    int bench = a.arguments().indexOf("--render-bench");
+    if (bench != -1 && bench + 1 < a.arguments().count()) {
+        delete splash;
+        delete pixmap;
+
+        return renderBench(w.midiPlayer(), a.arguments().mid(bench + 1));
+    }
+
     w.show();
 
     splash->finish(&w);
@@ -182,6 +195,39 @@ void loadSoundfonts(QSplashScreen *splash, MidiSynthesizer *synth)
     }
 }
 
+int renderBench(MidiPlayer *player, const QStringList &args)
+{
+    // render the songs of a folder with the soundfonts and FX of the
+    // settings, seconds of audio per second of rendering
+    int count = (args.count() > 1) ? args.at(1).toInt() : 100;
+    QString wav = QString(TEMP_DIR_PATH) + "/render-bench.wav";
+
+    MidiRenderer renderer(player);
+
+    QDirIterator it(args.at(0), QStringList() << "*.mid" << "*.MID" << "*.kar" << "*.KAR",
+                    QDir::Files|QDir::NoSymLinks, QDirIterator::Subdirectories);
+    while (it.hasNext() && renderer.jobCount() < count)
+        renderer.addJob(it.next(), wav);
+
+    QEventLoop loop;
+    QObject::connect(&renderer, SIGNAL(finished()), &loop, SLOT(quit()));
+
+    if (!renderer.startJobs())
+        return 1;
+    loop.exec();
+
+    QFile::remove(wav);
+
+    RenderStats st = renderer.stats();
+
+    QTextStream out(stdout);
+    out << "songs: " << st.songs << ", failed: " << st.failed << "\n";
+    out << "audio: " << st.audioSeconds << " s, render: " << st.renderSeconds << " s\n";
+    out << "realtime factor: " << renderer.realtimeFactor() << "\n";
+
+    return (st.failed > 0) ? 1 : 0;
+}
+
 #ifndef __linux__
 
 void loadVSTi(QSplashScreen *splash, MidiSynthesizer *synth)
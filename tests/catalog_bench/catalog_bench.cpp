@@ -0,0 +1,228 @@
+#include "SongCatalog.h"
+#include "ResidentMemory.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+// Song catalog benchmark: builds a songs table of <count> synthetic songs
+// (default 100000), writes the snapshot, maps it back and reports queries
+// per second of each search and the resident memory.
+//
+// catalog_bench [<count>] [<seconds per query type>]
+
+#define BENCH_CONNECTION "CatalogBench"
+
+static quint32 lcg = 12345;
+
+static int nextInt(int n)
+{
+    lcg = lcg * 1664525u + 1013904223u;
+    return int((lcg >> 8) % n);
+}
+
+static QString words(const QStringList &list, int count)
+{
+    QStringList w;
+    for (int i=0; i<count; i++)
+        w.append(list.at(nextInt(list.count())));
+    return w.join(' ');
+}
+
+static bool createSongs(const QString &path, int count, QStringList *names, QStringList *artists, QStringList *lyrics)
+{
+    const QStringList nameWords = QString::fromUtf8(
+        "love night dream heart rain moon star fire river road "
+        "รัก คืน ฝัน ใจ ฝน ดาว ทะเล ทาง เธอ ฉัน").split(' ');
+    const QStringList artistWords = QString::fromUtf8(
+        "band boys girls brothers sisters project "
+        "คาราบาว พงษ์สิทธิ์ ปาน เบิร์ด ศิริพร").split(' ');
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", BENCH_CONNECTION);
+    db.setDatabaseName(path);
+    if (!db.open())
+        return false;
+
+    QSqlQuery q(db);
+    q.exec("CREATE TABLE songs ("
+               "id       TEXT    COLLATE NOCASE,"
+               "name     TEXT    COLLATE NOCASE,"
+               "artist   TEXT    COLLATE NOCASE,"
+               "keyname  TEXT,"
+               "tempo    INTEGER,"
+               "songtype TEXT,"
+               "lyrics   TEXT,"
+               "path     TEXT,"
+               "filesize INTEGER,"
+               "mtime    INTEGER"
+           ")");
+
+    db.transaction();
+    q.prepare("INSERT INTO songs VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+
+    for (int i=0; i<count; i++) {
+        QString id = QString("%1").arg(nextInt(1000000), 6, 10, QChar('0'));
+        QString name = words(nameWords, 2 + nextInt(3));
+        QString artist = words(artistWords, 1 + nextInt(2));
+        QString lyr = words(nameWords, 30 + nextInt(30));
+        bool kar = nextInt(2) == 0;
+
+        q.addBindValue(id);
+        q.addBindValue(name);
+        q.addBindValue(artist);
+        q.addBindValue("C");
+        q.addBindValue(80 + nextInt(80));
+        q.addBindValue(kar ? "KAR" : "MID");
+        q.addBindValue(lyr);
+        q.addBindValue(QString("Songs/%1/%2.%3").arg(i / 1000).arg(id).arg(kar ? "kar" : "mid"));
+        q.addBindValue(20000 + nextInt(100000));
+        q.addBindValue(1500000000 + nextInt(100000000));
+        if (!q.exec()) {
+            QTextStream(stderr) << q.lastError().text() << "\n";
+            return false;
+        }
+
+        if (i % 100 == 0) {
+            names->append(name);
+            artists->append(artist);
+            lyrics->append(lyr);
+        }
+    }
+
+    q.finish();
+    db.commit();
+
+    return true;
+}
+
+// query strings taken from the inserted songs
+static QStringList pieces(const QStringList &from, int length, bool prefix)
+{
+    QStringList result;
+    for (const QString &s : from) {
+        if (s.length() < length)
+            continue;
+        int pos = prefix ? 0 : nextInt(s.length() - length + 1);
+        result.append(s.mid(pos, length));
+    }
+    return result;
+}
+
+static double queriesPerSecond(SongCatalog *catalog, bool prefix, CatalogField field,
+                               const QStringList &queries, int seconds, qint64 *hits)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    qint64 n = 0;
+    *hits = 0;
+    while (timer.elapsed() < seconds * 1000) {
+        for (int i=0; i<100; i++, n++) {
+            const QString &text = queries.at(n % queries.count());
+            *hits += prefix ? catalog->prefix(field, text).count()
+                            : catalog->contains(field, text).count();
+        }
+    }
+
+    return n * 1000.0 / qMax<qint64>(1, timer.elapsed());
+}
+
+static QString mb(qint64 bytes)
+{
+    return (bytes < 0) ? QString("n/a") : QString::number(bytes / 1048576.0, 'f', 1) + " MB";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QStringList args = a.arguments();
+    int count = (args.count() > 1) ? args.at(1).toInt() : 100000;
+    int seconds = (args.count() > 2) ? args.at(2).toInt() : 2;
+
+    QTextStream out(stdout);
+
+    QTemporaryDir dir;
+    if (!dir.isValid())
+        return 1;
+
+    QString dbPath = dir.filePath("songs.db");
+    QString snapshotPath = dir.filePath("songs.catalog");
+
+    QStringList names, artists, lyrics;
+    QElapsedTimer timer;
+
+    timer.start();
+    if (!createSongs(dbPath, count, &names, &artists, &lyrics))
+        return 1;
+    out << "songs: " << count << ", database: " << timer.elapsed() << " ms\n";
+
+    {
+        QSqlDatabase db = QSqlDatabase::database(BENCH_CONNECTION);
+        SongCatalog catalog;
+
+        timer.restart();
+        if (!catalog.build(&db, 1) || !catalog.save(snapshotPath))
+            return 1;
+        out << "build + save: " << timer.elapsed() << " ms, snapshot: " << mb(catalog.sizeInBytes()) << "\n";
+
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(BENCH_CONNECTION);
+
+    // query strings before measuring memory
+    QStringList idQueries;
+    for (int i=0; i<1000; i++)
+        idQueries.append(QString::number(nextInt(1000)).rightJustified(3, '0'));
+    QStringList nameQueries = pieces(names, 2, true);
+    QStringList artistQueries = pieces(artists, 3, true);
+    QStringList nameContains = pieces(names, 4, false);
+    QStringList lyricsContains = pieces(lyrics, 6, false);
+
+    qint64 rssBefore = residentMemory();
+
+    SongCatalog catalog;
+    timer.restart();
+    if (!catalog.load(snapshotPath, 1))
+        return 1;
+    out << "load: " << timer.nsecsElapsed() / 1000 << " us\n";
+
+    qint64 rssLoaded = residentMemory();
+
+    typedef struct {
+        const char *name;
+        bool prefix;
+        CatalogField field;
+        const QStringList *queries;
+    } BenchQuery;
+
+    const BenchQuery benchQueries[] = {
+        { "prefix id",       true,  CatalogField::Id,     &idQueries },
+        { "prefix name",     true,  CatalogField::Name,   &nameQueries },
+        { "prefix artist",   true,  CatalogField::Artist, &artistQueries },
+        { "contains name",   false, CatalogField::Name,   &nameContains },
+        { "contains lyrics", false, CatalogField::Lyrics, &lyricsContains },
+    };
+
+    for (const BenchQuery &b : benchQueries) {
+        if (b.queries->isEmpty())
+            continue;
+        qint64 hits;
+        double qps = queriesPerSecond(&catalog, b.prefix, b.field, *b.queries, seconds, &hits);
+        out << b.name << ": " << qRound64(qps) << " queries/s, " << hits << " hits\n";
+    }
+
+    qint64 rssQueried = residentMemory();
+
+    out << "resident: " << mb(rssBefore) << " before load, "
+        << mb(rssLoaded) << " after load, "
+        << mb(rssQueried) << " after queries\n";
+    if (rssBefore >= 0 && rssQueried >= 0)
+        out << "catalog resident: " << mb(rssQueried - rssBefore) << "\n";
+
+    return 0;
+}
@@ -0,0 +1,20 @@
+include(../tests.pri)
+
+# benchmark, not run by make check
+QT += sql
+QT -= testlib
+CONFIG -= testcase
+
+TARGET = catalog_bench
+
+SOURCES += catalog_bench.cpp \
+    $$SRC_ROOT/Song.cpp \
+    $$SRC_ROOT/SongCatalog.cpp
+
+HEADERS += $$SRC_ROOT/Song.h \
+    $$SRC_ROOT/SongCatalog.h \
+    ../common/ResidentMemory.h
+
+win32 {
+    LIBS += -lpsapi
+}
@@ -0,0 +1,190 @@
+#ifndef REFERENCESMFREADER_H
+#define REFERENCESMFREADER_H
+
+#include "MidiEvent.h"
+
+#include <QBuffer>
+#include <QVector>
+
+#include <algorithm>
+#include <cstring>
+
+// Byte by byte SMF reader of the original MidiFile::read (QFile getChar,
+// running status, stable sort by tick), kept as reference for the tests.
+
+namespace ReferenceSmf {
+
+inline quint16 readUInt16(QIODevice *in)
+{
+    unsigned char buffer[2];
+    in->read((char*)&buffer, 2);
+    return ((uint16_t)(buffer[0]) << 8) | (uint16_t)(buffer[1]);
+}
+
+inline quint32 readUInt32(QIODevice *in)
+{
+    unsigned char buffer[4];
+    in->read((char*)&buffer, 4);
+    return ((uint32_t)(buffer[0]) << 24) | ((uint32_t)(buffer[1]) << 16) |
+           ((uint32_t)(buffer[2]) << 8) | (uint32_t)(buffer[3]);
+}
+
+inline quint32 readVariableLengthQuantity(QIODevice *in)
+{
+    unsigned char b;
+    uint32_t value = 0;
+    do {
+        in->getChar((char*)&b);
+        value = (value << 7) | (b & 0x7F);
+    } while ((b & 0x80) == 0x80 && !in->atEnd());
+
+    return value;
+}
+
+inline MidiEvent channelEvent(int track, uint32_t tick, MidiEventType evType, int ch, int data1, int data2)
+{
+    MidiEvent e;
+    e.setTrack(track);
+    e.setTick(tick);
+    e.setEventType(evType);
+    e.setChannel(ch);
+    e.setData1(data1);
+    e.setData2(data2);
+    return e;
+}
+
+// events sorted by tick, lyrics as MidiFile::lyrics()
+inline bool read(const QByteArray &smf, QVector<MidiEvent> *events, QString *lyrics = nullptr)
+{
+    QBuffer buf;
+    buf.setData(smf);
+    QIODevice *in = &buf;
+
+    if (!in->open(QIODevice::ReadOnly))
+        return false;
+
+    events->clear();
+
+    char chunkID[4];
+    qint64 chunkSize = 0, chunkStart = 0;
+
+    in->read((char*)chunkID, 4);
+    if (memcmp(chunkID, "MThd", 4) != 0)
+        return false;
+
+    chunkSize = readUInt32(in);
+    if (chunkSize != 6)
+        return false;
+
+    readUInt16(in); // format
+    int numOfTracks = readUInt16(in);
+    readUInt16(in); // division
+
+    for (int t=0; t<numOfTracks; t++) {
+
+        in->read((char*)chunkID, 4);
+        chunkSize = readUInt32(in);
+        chunkStart = in->pos();
+
+        if (memcmp(chunkID, "MTrk", 4) != 0) {
+            events->clear();
+            return false;
+        }
+
+        uint32_t tick = 0;
+        unsigned char status, runningStatus = 0;
+        bool endOfTrack = false;
+
+        while (in->pos() < (chunkStart + chunkSize) && !endOfTrack && !in->atEnd()) {
+
+            tick += readVariableLengthQuantity(in);
+            in->getChar((char*)&status);
+
+            if ((status & 0x80) == 0) {
+                status = runningStatus;
+                in->seek(in->pos() - 1);
+            } else {
+                runningStatus = status;
+            }
+
+            int ch = status & 0x0F;
+            char d1 = 0, d2 = 0;
+
+            switch (status & 0xF0) {
+            case 0x80:
+            case 0xA0:
+            case 0xB0:
+                in->getChar(&d1);
+                in->getChar(&d2);
+                events->append(channelEvent(t, tick, static_cast<MidiEventType>(status & 0xF0), ch, d1, d2));
+                break;
+            case 0x90:
+                in->getChar(&d1);
+                in->getChar(&d2);
+                if (d2 != 0)
+                    events->append(channelEvent(t, tick, MidiEventType::NoteOn, ch, d1, d2));
+                else
+                    events->append(channelEvent(t, tick, MidiEventType::NoteOff, ch, d1, 0));
+                break;
+            case 0xC0:
+            case 0xD0:
+                in->getChar(&d1);
+                events->append(channelEvent(t, tick, static_cast<MidiEventType>(status & 0xF0), ch, d1, 0));
+                break;
+            case 0xE0:
+                in->getChar(&d1);
+                in->getChar(&d2);
+                events->append(channelEvent(t, tick, MidiEventType::PitchBend, ch,
+                                            ((d2 & 0x7F) << 7) | (d1 & 0x7F), 0));
+                break;
+            case 0xF0: {
+                MidiEvent e;
+                e.setTrack(t);
+                e.setTick(tick);
+
+                if (status == 0xF0 || status == 0xF7) {
+                    int lenght = readVariableLengthQuantity(in);
+                    QByteArray data;
+                    data[0] = status;
+                    data += in->read(lenght);
+                    e.setEventType(MidiEventType::SysEx);
+                    e.setData(data);
+                    events->append(e);
+                }
+                else if (status == 0xFF) {
+                    char number;
+                    in->getChar(&number);
+                    int lenght = readVariableLengthQuantity(in);
+                    e.setEventType(MidiEventType::Meta);
+                    e.setMetaType((unsigned char)number);
+                    e.setData(in->read(lenght));
+                    events->append(e);
+                    if (number == 0x2F)
+                        endOfTrack = true;
+                }
+                break;
+            }
+            }
+        }
+
+        // skip extra data at the end of tracks
+        in->seek(chunkStart + chunkSize);
+    }
+
+    std::stable_sort(events->begin(), events->end(),
+                     [](const MidiEvent &e1, const MidiEvent &e2) { return e1.tick() < e2.tick(); });
+
+    if (lyrics) {
+        lyrics->clear();
+        for (const MidiEvent &e : *events) {
+            if (e.eventType() == MidiEventType::Meta && e.metaEventType() == MidiMetaType::Lyrics)
+                *lyrics += QString(e.data());
+        }
+    }
+
+    return true;
+}
+
+} // namespace ReferenceSmf
+
+#endif // REFERENCESMFREADER_H
@@ -0,0 +1,41 @@
+#ifndef RESIDENTMEMORY_H
+#define RESIDENTMEMORY_H
+
+#include <QtGlobal>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_MACOS)
+#include <mach/mach.h>
+#else
+#include <QFile>
+#endif
+
+// resident set size of this process in bytes, -1 if unknown
+inline qint64 residentMemory()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return -1;
+    return pmc.WorkingSetSize;
+#elif defined(Q_OS_MACOS)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+        return -1;
+    return info.resident_size;
+#else
+    QFile f("/proc/self/status");
+    if (!f.open(QFile::ReadOnly))
+        return -1;
+    for (QByteArray line = f.readLine(); !line.isEmpty(); line = f.readLine()) {
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+    }
+    return -1;
+#endif
+}
+
+#endif // RESIDENTMEMORY_H
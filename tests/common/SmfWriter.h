@@ -0,0 +1,129 @@
+#ifndef SMFWRITER_H
+#define SMFWRITER_H
+
+#include <QByteArray>
+#include <QList>
+
+// Track data of a standard MIDI file built in memory, delta times in ticks
+class SmfTrack
+{
+public:
+    SmfTrack &event(quint32 delta, int status, int data1, int data2 = -1)
+    {
+        fData += vlq(delta);
+        fData.append((char)status);
+        return appendData(data1, data2);
+    }
+
+    // running status, no status byte
+    SmfTrack &running(quint32 delta, int data1, int data2 = -1)
+    {
+        fData += vlq(delta);
+        return appendData(data1, data2);
+    }
+
+    SmfTrack &meta(quint32 delta, int number, const QByteArray &data)
+    {
+        fData += vlq(delta);
+        fData.append((char)0xFF);
+        fData.append((char)number);
+        fData += vlq(data.size());
+        fData += data;
+        return *this;
+    }
+
+    SmfTrack &tempo(quint32 delta, int bpm)
+    {
+        quint32 us = 60000000 / bpm;
+        QByteArray d;
+        d.append((char)((us >> 16) & 0xFF));
+        d.append((char)((us >> 8) & 0xFF));
+        d.append((char)(us & 0xFF));
+        return meta(delta, 0x51, d);
+    }
+
+    // status 0xF0 or 0xF7, data without the status byte
+    SmfTrack &sysEx(quint32 delta, int status, const QByteArray &data)
+    {
+        fData += vlq(delta);
+        fData.append((char)status);
+        fData += vlq(data.size());
+        fData += data;
+        return *this;
+    }
+
+    SmfTrack &endOfTrack(quint32 delta = 0) { return meta(delta, 0x2F, QByteArray()); }
+
+    // bytes after the end of track, still inside the chunk
+    SmfTrack &raw(const QByteArray &bytes) { fData += bytes; return *this; }
+
+    QByteArray data() const { return fData; }
+
+    static QByteArray vlq(quint32 value)
+    {
+        QByteArray v;
+        v.prepend((char)(value & 0x7F));
+        while ((value >>= 7) > 0)
+            v.prepend((char)((value & 0x7F) | 0x80));
+        return v;
+    }
+
+private:
+    SmfTrack &appendData(int data1, int data2)
+    {
+        fData.append((char)data1);
+        if (data2 >= 0)
+            fData.append((char)data2);
+        return *this;
+    }
+
+private:
+    QByteArray fData;
+};
+
+class SmfWriter
+{
+public:
+    explicit SmfWriter(int format = 1, int resolution = 480)
+        : fFormat(format), fResolution(resolution) {}
+
+    void addTrack(const SmfTrack &track) { fTracks.append(track.data()); }
+
+    QByteArray data() const
+    {
+        QByteArray smf("MThd");
+        smf += uint32(6);
+        smf += uint16(fFormat);
+        smf += uint16(fTracks.count());
+        smf += uint16(fResolution);
+
+        for (const QByteArray &t : fTracks) {
+            smf += "MTrk";
+            smf += uint32(t.size());
+            smf += t;
+        }
+
+        return smf;
+    }
+
+private:
+    static QByteArray uint16(quint16 v)
+    {
+        QByteArray b;
+        b.append((char)(v >> 8));
+        b.append((char)(v & 0xFF));
+        return b;
+    }
+
+    static QByteArray uint32(quint32 v)
+    {
+        return uint16(v >> 16) + uint16(v & 0xFFFF);
+    }
+
+private:
+    int fFormat;
+    int fResolution;
+    QList<QByteArray> fTracks;
+};
+
+#endif // SMFWRITER_H
@@ -0,0 +1,12 @@
+include(../tests.pri)
+
+TARGET = tst_lyrics_timeline
+
+SOURCES += tst_lyrics_timeline.cpp \
+    $$SRC_ROOT/Widgets/LyricsTimeline.cpp \
+    $$SRC_ROOT/Midi/MidiEvent.cpp \
+    $$SRC_ROOT/Midi/MidiEventStore.cpp \
+    $$SRC_ROOT/Midi/MidiFile.cpp \
+    $$SRC_ROOT/Midi/MidiHelper.cpp
+
+HEADERS += ../common/SmfWriter.h
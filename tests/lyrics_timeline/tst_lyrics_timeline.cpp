@@ -0,0 +1,430 @@
+#include "Widgets/LyricsTimeline.h"
+#include "MidiFile.h"
+#include "SmfWriter.h"
+
+#include <QtTest>
+#include <algorithm>
+
+// State of the original LyricsWidget after its cursor by cursor steps,
+// wipe is the cursor width in chars of the sung line
+typedef struct
+{
+    QString line1;
+    QString line2;
+    int     linesIndex;
+    int     charIndex;
+    int     wipe;
+    bool    isLine1;
+    bool    endLine;
+} ReferenceState;
+
+// The steps LyricsWidget::setPositionCursor did before the timeline, on
+// the line lengths instead of the char widths
+class ReferenceLyrics
+{
+public:
+    ReferenceLyrics(const QStringList &lyrics, int cursorCount)
+        : fLyrics(lyrics), fCount(cursorCount)
+    {
+        s.line1 = lyrics.count() > 0 ? lyrics.at(0) : QString();
+        s.line2 = lyrics.count() > 1 ? lyrics.at(1) : QString();
+        s.linesIndex = lyrics.count() > 0 ? 1 : 0;
+        s.charIndex = -1;
+        s.wipe = 0;
+        s.isLine1 = true;
+        s.endLine = false;
+        fChars = s.line1.length();
+    }
+
+    const ReferenceState &state() const { return s; }
+
+    // cursor width in chars when the last step started
+    int fromWipe() const { return fFrom; }
+
+    void step()
+    {
+        if (s.endLine) {
+            s.endLine = false;
+            s.charIndex = 0;
+            s.wipe = 0;
+            fToEnd = 0;
+            s.isLine1 = !s.isLine1;
+        }
+
+        fFrom = s.wipe;
+
+        if (fChars == 0 && s.linesIndex < fLyrics.count()) {
+            if (s.isLine1)
+                s.line2 = fLyrics.at(s.linesIndex);
+            else
+                s.line1 = fLyrics.at(s.linesIndex);
+            s.linesIndex++;
+            s.isLine1 = !s.isLine1;
+            fCursor++;
+            fChars = sungLine().length();
+            return;
+        }
+
+        if (s.charIndex == fChars) {
+            // no animation, the line is wiped at once
+            s.wipe = fChars;
+            fFrom = fChars;
+            s.endLine = true;
+            fCursor++;
+            return;
+        }
+
+        if (s.charIndex == 0) {
+            QString next = (s.linesIndex < fLyrics.count()) ? fLyrics.at(s.linesIndex++) : QString();
+            if (s.isLine1)
+                s.line2 = next;
+            else
+                s.line1 = next;
+            fChars = sungLine().length();
+        }
+
+        if (s.charIndex >= 0 && fChars != 0)
+            fToEnd = s.charIndex + 1;
+
+        s.charIndex++;
+
+        if (fCursor == fCount - 1)
+            fToEnd = fChars;
+
+        fCursor++;
+        s.wipe = fToEnd;
+    }
+
+private:
+    QString sungLine() const { return s.isLine1 ? s.line1 : s.line2; }
+
+    QStringList fLyrics;
+    int fCount;
+    int fCursor = 0;
+    int fChars = 0;
+    int fToEnd = 0;
+    int fFrom = 0;
+    ReferenceState s;
+};
+
+class tst_LyricsTimeline : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void steps_data();
+    void steps();
+    void seekMatchesStepping();
+    void playbackFrames();
+    void wipeChars();
+    void wipeInterpolation();
+    void wipeSeekMatchesFrames();
+
+private:
+    static QStringList randomLyrics(quint32 *seed, int lines);
+    static QVector<long> randomCursors(quint32 *seed, int count);
+    static quint32 next(quint32 *seed, quint32 max);
+    static void compare(const QStringList &lyrics, const LyricsStep &st, const ReferenceState &ref);
+};
+
+quint32 tst_LyricsTimeline::next(quint32 *seed, quint32 max)
+{
+    // fixed sequence on every platform
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 16) % max;
+}
+
+QStringList tst_LyricsTimeline::randomLyrics(quint32 *seed, int lines)
+{
+    // LyricsWidget::setLyrics turns empty lines into " " while there are
+    // cursors for them, the empty ones left are at the end
+    QStringList lyrics;
+    for (int i=0; i<lines; i++)
+        lyrics.append(QString(next(seed, 12) == 0 ? 1 : next(seed, 20) + 1, QChar('a' + i % 26)));
+    if (next(seed, 2) == 0)
+        lyrics.append("");
+    return lyrics;
+}
+
+QVector<long> tst_LyricsTimeline::randomCursors(quint32 *seed, int count)
+{
+    // rising, equal ticks where a line was inserted for an empty one
+    QVector<long> cursors;
+    long tick = next(seed, 100);
+    for (int i=0; i<count; i++) {
+        cursors.append(tick);
+        tick += (next(seed, 6) == 0) ? 0 : next(seed, 240) + 1;
+    }
+    return cursors;
+}
+
+void tst_LyricsTimeline::compare(const QStringList &lyrics, const LyricsStep &st, const ReferenceState &ref)
+{
+    QCOMPARE(st.line1 < 0 ? QString() : lyrics.at(st.line1), ref.line1);
+    QCOMPARE(st.line2 < 0 ? QString() : lyrics.at(st.line2), ref.line2);
+    QCOMPARE(st.linesIndex, ref.linesIndex);
+    QCOMPARE(st.charIndex, ref.charIndex);
+    QCOMPARE(st.wipe, ref.wipe);
+    QCOMPARE(st.isLine1, ref.isLine1);
+    QCOMPARE(st.endLine, ref.endLine);
+}
+
+void tst_LyricsTimeline::steps_data()
+{
+    QTest::addColumn<QStringList>("lyrics");
+    QTest::addColumn<int>("cursors");
+
+    QStringList song = QStringList() << "abc" << "de" << " " << "fghij" << "k";
+    int chars = 0;
+    for (const QString &l : song)
+        chars += l.length() + 1;
+
+    QTest::newRow("song") << song << chars;
+    QTest::newRow("fewer cursors") << song << chars - 4;
+    QTest::newRow("more cursors") << song << chars + 5;
+    QTest::newRow("empty last line") << (QStringList() << "ab" << "cd" << "") << 10;
+    QTest::newRow("one line") << (QStringList() << "abcd") << 5;
+    QTest::newRow("no lyrics") << (QStringList() << "" << "") << 3;
+    QTest::newRow("no cursors") << song << 0;
+
+    quint32 seed = 21;
+    for (int i=0; i<20; i++) {
+        QStringList lyrics = randomLyrics(&seed, next(&seed, 30) + 1);
+        int count = 0;
+        for (const QString &l : lyrics)
+            count += l.length() + 1;
+        count += int(next(&seed, 11)) - 5;
+        QTest::newRow(qPrintable(QString("random %1").arg(i))) << lyrics << qMax(0, count);
+    }
+}
+
+void tst_LyricsTimeline::steps()
+{
+    QFETCH(QStringList, lyrics);
+    QFETCH(int, cursors);
+
+    QVector<LyricsStep> timeline = LyricsTimeline::build(lyrics, cursors);
+    QCOMPARE(timeline.count(), cursors);
+
+    ReferenceLyrics ref(lyrics, cursors);
+    for (int i=0; i<cursors; i++) {
+        ref.step();
+        compare(lyrics, timeline.at(i), ref.state());
+        if (QTest::currentTestFailed()) {
+            qWarning() << "cursor" << i;
+            return;
+        }
+    }
+}
+
+void tst_LyricsTimeline::seekMatchesStepping()
+{
+    quint32 seed = 7;
+    for (int song=0; song<10; song++) {
+        QStringList lyrics = randomLyrics(&seed, next(&seed, 25) + 2);
+        int count = 0;
+        for (const QString &l : lyrics)
+            count += l.length() + 1;
+        QVector<long> cursors = randomCursors(&seed, count);
+        QVector<LyricsStep> timeline = LyricsTimeline::build(lyrics, count);
+
+        for (int n=0; n<200; n++) {
+            int tick = next(&seed, cursors.last() + 100);
+
+            // the original seek, cursors before tick are passed
+            int round = 0;
+            while (round < cursors.count() && cursors[round] < tick)
+                round++;
+
+            int last = LyricsTimeline::seekStep(cursors, tick);
+            QCOMPARE(last, round - 1);
+
+            ReferenceLyrics ref(lyrics, count);
+            for (int i=0; i<round; i++)
+                ref.step();
+            if (last >= 0)
+                compare(lyrics, timeline.at(last), ref.state());
+            else
+                QCOMPARE(ref.state().charIndex, -1);
+            if (QTest::currentTestFailed()) {
+                qWarning() << "song" << song << "tick" << tick;
+                return;
+            }
+        }
+
+        // on a cursor and right after it
+        for (int i=0; i<cursors.count(); i++) {
+            QVERIFY(LyricsTimeline::seekStep(cursors, cursors[i]) < i);
+            QVERIFY(LyricsTimeline::seekStep(cursors, cursors[i] + 1) >= i);
+        }
+    }
+}
+
+void tst_LyricsTimeline::playbackFrames()
+{
+    // frames at any tick step, the state must be the one a seek right
+    // after the frame tick gives
+    quint32 seed = 3;
+    for (int song=0; song<10; song++) {
+        QStringList lyrics = randomLyrics(&seed, next(&seed, 25) + 2);
+        int count = 0;
+        for (const QString &l : lyrics)
+            count += l.length() + 1;
+        QVector<long> cursors = randomCursors(&seed, count);
+
+        int nextCursor = 0;
+        int tick = 0;
+        while (true) {
+            int last = LyricsTimeline::playStep(cursors, nextCursor, tick);
+            QVERIFY(last >= nextCursor - 1);
+            nextCursor = last + 1;
+
+            QCOMPARE(last, LyricsTimeline::seekStep(cursors, tick + 1));
+
+            if (tick >= cursors.last())
+                break;
+            tick = qMin(tick + int(next(&seed, 300)), int(cursors.last()));
+        }
+        QCOMPARE(nextCursor, cursors.count());
+    }
+}
+
+void tst_LyricsTimeline::wipeChars()
+{
+    // start and end of every step, the original animated from the cursor
+    // width before the step to the width after it
+    quint32 seed = 11;
+    for (int song=0; song<20; song++) {
+        QStringList lyrics = randomLyrics(&seed, next(&seed, 25) + 1);
+        int count = 0;
+        for (const QString &l : lyrics)
+            count += l.length() + 1;
+        count = qMax(0, count + int(next(&seed, 11)) - 5);
+        QVector<LyricsStep> timeline = LyricsTimeline::build(lyrics, count);
+
+        ReferenceLyrics ref(lyrics, count);
+        for (int i=0; i<count; i++) {
+            ref.step();
+
+            int from, to;
+            LyricsTimeline::wipeChars(timeline, i, &from, &to);
+            QCOMPARE(to, ref.state().wipe);
+            QCOMPARE(from, ref.fromWipe());
+            if (QTest::currentTestFailed()) {
+                qWarning() << "song" << song << "cursor" << i;
+                return;
+            }
+        }
+    }
+}
+
+void tst_LyricsTimeline::wipeInterpolation()
+{
+    // 120 bpm then 60 bpm from tick 960, 480 ticks a beat
+    SmfTrack track;
+    track.tempo(0, 120)
+         .tempo(960, 60)
+         .endOfTrack(960);
+
+    SmfWriter smf(0, 480);
+    smf.addTrack(track);
+
+    MidiFile midi;
+    QVERIFY(midi.read(smf.data()));
+
+    // a syllable from tick 480 to 1440 crosses the tempo change,
+    // 0.5 s at 120 bpm and 1 s at 60 bpm
+    qint64 startUs = midi.timeUsFromTick(480);
+    qint64 endUs = midi.timeUsFromTick(1440);
+    QCOMPARE(startUs, Q_INT64_C(500000));
+    QCOMPARE(endUs, Q_INT64_C(2000000));
+
+    // a third of the time is at the tempo change, not half of the ticks
+    QCOMPARE(LyricsTimeline::wipeX(100, 400, startUs, endUs, midi.timeUsFromTick(960)), 200);
+    QCOMPARE(LyricsTimeline::wipeX(100, 400, startUs, endUs, midi.timeUsFromTick(1200)), 300);
+
+    QCOMPARE(LyricsTimeline::wipeX(100, 400, startUs, endUs, 0), 100);
+    QCOMPARE(LyricsTimeline::wipeX(100, 400, startUs, endUs, startUs), 100);
+    QCOMPARE(LyricsTimeline::wipeX(100, 400, startUs, endUs, endUs), 400);
+    QCOMPARE(LyricsTimeline::wipeX(100, 400, startUs, endUs, endUs + 1), 400);
+
+    // the last cursor has no end, it is wiped at once
+    QCOMPARE(LyricsTimeline::wipeX(100, 400, startUs, startUs, startUs), 400);
+
+    int last = 100;
+    for (int tick=480; tick<=1440; tick++) {
+        int x = LyricsTimeline::wipeX(100, 400, startUs, endUs, midi.timeUsFromTick(tick));
+        QVERIFY(x >= last && x <= 400);
+        last = x;
+    }
+    QCOMPARE(last, 400);
+}
+
+void tst_LyricsTimeline::wipeSeekMatchesFrames()
+{
+    // the wipe x after stepping frame by frame from the start and after
+    // a seek to the same tick, 10 pixels a char. Tempo changes at ticks
+    // 2000 and 5000.
+    SmfTrack track;
+    track.tempo(0, 100)
+         .tempo(2000, 140)
+         .tempo(3000, 70)
+         .endOfTrack(20000);
+
+    SmfWriter smf(0, 480);
+    smf.addTrack(track);
+
+    MidiFile midi;
+    QVERIFY(midi.read(smf.data()));
+
+    quint32 seed = 5;
+    for (int song=0; song<10; song++) {
+        QStringList lyrics = randomLyrics(&seed, next(&seed, 20) + 2);
+        int count = 0;
+        for (const QString &l : lyrics)
+            count += l.length() + 1;
+        QVector<long> cursors = randomCursors(&seed, count);
+        QVector<LyricsStep> timeline = LyricsTimeline::build(lyrics, count);
+
+        auto endUs = [&](int index) {
+            return midi.timeUsFromTick(index + 1 < cursors.count() ? cursors[index + 1] : cursors[index]);
+        };
+
+        ReferenceLyrics ref(lyrics, count);
+        int nextCursor = 0;
+        int tick = 0;
+        while (tick < cursors.last() + 200) {
+            while (nextCursor < cursors.count() && cursors[nextCursor] <= tick) {
+                ref.step();
+                nextCursor++;
+            }
+
+            int last = nextCursor - 1;
+            bool onCursor = std::binary_search(cursors.constBegin(), cursors.constEnd(), tick);
+            if (last >= 0 && !onCursor) {
+                qint64 nowUs = midi.timeUsFromTick(tick);
+                int frameX = LyricsTimeline::wipeX(ref.fromWipe() * 10, ref.state().wipe * 10,
+                                                   midi.timeUsFromTick(cursors[last]), endUs(last), nowUs);
+
+                int seek = LyricsTimeline::seekStep(cursors, tick);
+                QCOMPARE(seek, last);
+
+                int from, to;
+                LyricsTimeline::wipeChars(timeline, seek, &from, &to);
+                int seekX = LyricsTimeline::wipeX(from * 10, to * 10,
+                                                  midi.timeUsFromTick(cursors[seek]), endUs(seek), nowUs);
+                QCOMPARE(seekX, frameX);
+                if (QTest::currentTestFailed()) {
+                    qWarning() << "song" << song << "tick" << tick;
+                    return;
+                }
+            }
+
+            tick += next(&seed, 40) + 1;
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_LyricsTimeline)
+
+#include "tst_lyrics_timeline.moc"
@@ -0,0 +1,245 @@
+#include "MidiFile.h"
+#include "SmfWriter.h"
+#include "ReferenceSmfReader.h"
+
+#include <QtTest>
+#include <QDirIterator>
+
+// The k-way track merge of MidiFile::read must give the order of the old
+// stable sort by tick: equal ticks keep the track order, then the file order.
+class tst_MidiFileMerge : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void equalTicks();
+    void emptyTracks();
+    void randomTracks_data();
+    void randomTracks();
+    void corpus();
+
+private:
+    static QByteArray randomSmf(quint32 seed, int tracks, int eventsPerTrack);
+    static void compare(const QByteArray &smf);
+    static void compareList(const MidiEventList &list, const QVector<MidiEvent> &ref);
+    static bool sameEvent(const MidiEvent &e, const MidiEvent &r);
+};
+
+bool tst_MidiFileMerge::sameEvent(const MidiEvent &e, const MidiEvent &r)
+{
+    if (e.tick() != r.tick() || e.track() != r.track() || e.eventType() != r.eventType())
+        return false;
+
+    switch (r.eventType()) {
+    case MidiEventType::Meta:
+        return e.metaEventType() == r.metaEventType() && e.data() == r.data();
+    case MidiEventType::SysEx:
+        return e.data() == r.data();
+    default:
+        return e.channel() == r.channel() && e.data1() == r.data1() && e.data2() == r.data2();
+    }
+}
+
+void tst_MidiFileMerge::compareList(const MidiEventList &list, const QVector<MidiEvent> &ref)
+{
+    QCOMPARE(list.count(), ref.count());
+    for (int i=0; i<ref.count(); i++)
+        QVERIFY2(sameEvent(list.at(i), ref.at(i)), qPrintable(QString("event %1").arg(i)));
+}
+
+void tst_MidiFileMerge::compare(const QByteArray &smf)
+{
+    // reference events are concatenated by track then stable sorted by tick
+    QVector<MidiEvent> ref;
+    QVERIFY(ReferenceSmf::read(smf, &ref));
+
+    MidiFile midi;
+    QVERIFY(midi.read(smf));
+
+    QVector<MidiEvent> tempo, lyrics, timeSig, controllers, programs;
+    for (const MidiEvent &e : ref) {
+        if (e.eventType() == MidiEventType::Meta) {
+            if (e.metaEventType() == MidiMetaType::SetTempo)
+                tempo.append(e);
+            else if (e.metaEventType() == MidiMetaType::Lyrics)
+                lyrics.append(e);
+            else if (e.metaEventType() == MidiMetaType::TimeSignature)
+                timeSig.append(e);
+        }
+        else if (e.eventType() == MidiEventType::Controller) {
+            controllers.append(e);
+        }
+        else if (e.eventType() == MidiEventType::ProgramChange) {
+            programs.append(e);
+        }
+    }
+
+    // old controllerAndProgramEvents, controllers first then a stable sort
+    QVector<MidiEvent> ctrlAndProg = controllers + programs;
+    std::stable_sort(ctrlAndProg.begin(), ctrlAndProg.end(),
+                     [](const MidiEvent &e1, const MidiEvent &e2) { return e1.tick() < e2.tick(); });
+
+    compareList(midi.events(), ref);
+    if (QTest::currentTestFailed())
+        return;
+    compareList(midi.tempoEvents(), tempo);
+    if (QTest::currentTestFailed())
+        return;
+    compareList(midi.lyricsEvents(), lyrics);
+    if (QTest::currentTestFailed())
+        return;
+    compareList(midi.timeSignatureEvents(), timeSig);
+    if (QTest::currentTestFailed())
+        return;
+    compareList(midi.controllerEvents(), controllers);
+    if (QTest::currentTestFailed())
+        return;
+    compareList(midi.programChangeEvents(), programs);
+    if (QTest::currentTestFailed())
+        return;
+    compareList(midi.controllerAndProgramEvents(), ctrlAndProg);
+}
+
+QByteArray tst_MidiFileMerge::randomSmf(quint32 seed, int tracks, int eventsPerTrack)
+{
+    // fixed LCG, the same seed gives the same file everywhere
+    quint32 r = seed;
+    auto next = [&r](int n) { r = r * 1664525u + 1013904223u; return int((r >> 8) % n); };
+
+    SmfWriter smf;
+    for (int t=0; t<tracks; t++) {
+        SmfTrack track;
+        int ch = t % 16;
+        for (int i=0; i<eventsPerTrack; i++) {
+            // mostly zero or small deltas, many events share a tick across tracks
+            int roll = next(10);
+            quint32 delta = roll < 5 ? 0 : (roll < 9 ? 120 * next(3) : next(2000));
+
+            switch (next(8)) {
+            case 0:
+                track.tempo(delta, 60 + next(120));
+                break;
+            case 1:
+                track.meta(delta, 0x05, QByteArray(1 + next(4), char('a' + next(26))));
+                break;
+            case 2:
+                track.meta(delta, 0x58, QByteArray::fromHex("04021808"));
+                break;
+            case 3:
+                track.event(delta, 0xB0 | ch, next(128), next(128));
+                break;
+            case 4:
+                track.event(delta, 0xC0 | ch, next(128));
+                break;
+            case 5:
+                track.sysEx(delta, 0xF0, QByteArray::fromHex("7E7F0901F7"));
+                break;
+            default:
+                track.event(delta, 0x90 | ch, next(128), next(128));
+                break;
+            }
+        }
+        track.endOfTrack();
+        smf.addTrack(track);
+    }
+
+    return smf.data();
+}
+
+void tst_MidiFileMerge::equalTicks()
+{
+    // every event on tick 0 and 480, reversed type order on each track
+    SmfWriter smf;
+    for (int t=0; t<8; t++) {
+        SmfTrack track;
+        track.event(0, 0xC0 | t, t)
+             .event(0, 0xB0 | t, 0, t)
+             .meta(0, 0x05, QByteArray(1, char('a' + t)))
+             .tempo(0, 100 + t)
+             .event(480, 0x90 | t, 60, 100)
+             .event(0, 0xC0 | t, 10 + t)
+             .event(0, 0xB0 | t, 7, 100)
+             .endOfTrack();
+        smf.addTrack(track);
+    }
+    compare(smf.data());
+}
+
+void tst_MidiFileMerge::emptyTracks()
+{
+    SmfWriter smf;
+
+    SmfTrack empty;
+    empty.endOfTrack();
+
+    SmfTrack notes;
+    notes.event(10, 0x90, 60, 100)
+         .event(10, 0x80, 60, 0)
+         .endOfTrack();
+
+    smf.addTrack(empty);
+    smf.addTrack(notes);
+    smf.addTrack(empty);
+    smf.addTrack(notes);
+    smf.addTrack(SmfTrack()); // no end of track
+    compare(smf.data());
+}
+
+void tst_MidiFileMerge::randomTracks_data()
+{
+    QTest::addColumn<quint32>("seed");
+    QTest::addColumn<int>("tracks");
+    QTest::addColumn<int>("events");
+
+    QTest::newRow("1 track") << 1u << 1 << 500;
+    QTest::newRow("2 tracks") << 2u << 2 << 500;
+    QTest::newRow("16 tracks") << 16u << 16 << 300;
+    QTest::newRow("64 tracks") << 64u << 64 << 100;
+    QTest::newRow("200 tracks") << 200u << 200 << 20;
+}
+
+void tst_MidiFileMerge::randomTracks()
+{
+    QFETCH(quint32, seed);
+    QFETCH(int, tracks);
+    QFETCH(int, events);
+
+    compare(randomSmf(seed, tracks, events));
+}
+
+// HK_MIDI_CORPUS=<folder> compares every .mid/.kar file under folder
+void tst_MidiFileMerge::corpus()
+{
+    QString dir = qEnvironmentVariable("HK_MIDI_CORPUS");
+    if (dir.isEmpty())
+        QSKIP("HK_MIDI_CORPUS is not set");
+
+    QDirIterator it(dir, QStringList() << "*.mid" << "*.MID" << "*.kar" << "*.KAR",
+                    QDir::Files, QDirIterator::Subdirectories);
+    int files = 0;
+    while (it.hasNext()) {
+        QString path = it.next();
+        QFile f(path);
+        if (!f.open(QFile::ReadOnly))
+            continue;
+        QByteArray data = f.readAll();
+        f.close();
+
+        QVector<MidiEvent> ref;
+        if (!ReferenceSmf::read(data, &ref))
+            continue;
+
+        compare(data);
+        if (QTest::currentTestFailed()) {
+            qWarning() << "mismatch:" << path;
+            return;
+        }
+        files++;
+    }
+
+    qDebug() << files << "files compared";
+}
+
+QTEST_APPLESS_MAIN(tst_MidiFileMerge)
+
+#include "tst_midifile_merge.moc"
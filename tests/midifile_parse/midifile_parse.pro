@@ -0,0 +1,12 @@
+include(../tests.pri)
+
+TARGET = tst_midifile_parse
+
+SOURCES += tst_midifile_parse.cpp \
+    $$SRC_ROOT/Midi/MidiEvent.cpp \
+    $$SRC_ROOT/Midi/MidiEventStore.cpp \
+    $$SRC_ROOT/Midi/MidiFile.cpp \
+    $$SRC_ROOT/Midi/MidiHelper.cpp
+
+HEADERS += ../common/SmfWriter.h \
+    ../common/ReferenceSmfReader.h
@@ -0,0 +1,308 @@
+#include "MidiFile.h"
+#include "SmfWriter.h"
+#include "ReferenceSmfReader.h"
+
+#include <QtTest>
+#include <QDirIterator>
+#include <QTemporaryFile>
+
+// MidiFile::read must give the same events as the original byte by byte reader
+class tst_MidiFileParse : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void channelEvents();
+    void runningStatus();
+    void metaAndSysEx();
+    void extraTrackData();
+    void multipleTracks();
+    void trackLimit();
+    void fileAndBuffer();
+    void corpus();
+
+private:
+    static QByteArray songSmf();
+    static void compare(const QByteArray &smf);
+    static void compareEvents(MidiFile &midi, const QVector<MidiEvent> &ref);
+};
+
+QByteArray tst_MidiFileParse::songSmf()
+{
+    SmfTrack conductor;
+    conductor.meta(0, 0x03, "Song")
+             .tempo(0, 120)
+             .meta(0, 0x58, QByteArray::fromHex("04021808"))
+             .tempo(1920, 96)
+             .endOfTrack(0);
+
+    SmfTrack melody;
+    melody.event(0, 0xC3, 52)
+          .event(0, 0xB3, 7, 100)
+          .running(0, 10, 64)
+          .meta(0, 0x05, "Ha")
+          .event(0, 0x93, 60, 90)
+          .meta(240, 0x05, "ndy")
+          .event(0, 0x93, 62, 80)
+          .running(240, 60, 0)
+          .event(0, 0x83, 62, 64)
+          .event(10, 0xE3, 0x00, 0x40)
+          .running(10, 0x7F, 0x7F)
+          .event(0, 0xA3, 60, 30)
+          .event(0, 0xD3, 40)
+          .running(5, 20)
+          .endOfTrack(480);
+
+    SmfWriter smf;
+    smf.addTrack(conductor);
+    smf.addTrack(melody);
+    return smf.data();
+}
+
+void tst_MidiFileParse::compare(const QByteArray &smf)
+{
+    QVector<MidiEvent> ref;
+    QString refLyrics;
+    QVERIFY(ReferenceSmf::read(smf, &ref, &refLyrics));
+
+    MidiFile midi;
+    QVERIFY(midi.read(smf));
+
+    compareEvents(midi, ref);
+    if (QTest::currentTestFailed())
+        return;
+    QCOMPARE(midi.lyrics(), refLyrics);
+}
+
+void tst_MidiFileParse::compareEvents(MidiFile &midi, const QVector<MidiEvent> &ref)
+{
+    const MidiEventStore *store = midi.eventStore();
+    QCOMPARE(store->count(), ref.count());
+
+    for (int i=0; i<ref.count(); i++) {
+        MidiEvent e = store->event(i);
+        const MidiEvent &r = ref.at(i);
+
+        QCOMPARE(e.tick(), r.tick());
+        QCOMPARE(e.track(), r.track());
+        QCOMPARE(int(e.eventType()), int(r.eventType()));
+
+        switch (r.eventType()) {
+        case MidiEventType::Meta:
+            QCOMPARE(int(e.metaEventType()), int(r.metaEventType()));
+            QCOMPARE(e.data(), r.data());
+            break;
+        case MidiEventType::SysEx:
+            QCOMPARE(e.data(), r.data());
+            break;
+        default:
+            QCOMPARE(e.channel(), r.channel());
+            QCOMPARE(e.data1(), r.data1());
+            QCOMPARE(e.data2(), r.data2());
+            break;
+        }
+    }
+
+    // tempo index must follow the store order
+    int tempos = 0;
+    for (const MidiEvent &r : ref) {
+        if (r.eventType() == MidiEventType::Meta && r.metaEventType() == MidiMetaType::SetTempo)
+            tempos++;
+    }
+    MidiEventList tempoEvents = midi.tempoEvents();
+    QCOMPARE(tempoEvents.count(), tempos);
+    for (int i=1; i<tempoEvents.count(); i++)
+        QVERIFY(tempoEvents.index(i - 1) < tempoEvents.index(i));
+}
+
+void tst_MidiFileParse::channelEvents()
+{
+    SmfTrack track;
+    for (int ch=0; ch<16; ch++) {
+        track.event(0, 0x80 | ch, 60, 64)
+             .event(1, 0x90 | ch, 61, 100)
+             .event(1, 0x90 | ch, 61, 0)
+             .event(1, 0xA0 | ch, 62, 10)
+             .event(1, 0xB0 | ch, 64, 127)
+             .event(1, 0xC0 | ch, ch)
+             .event(1, 0xD0 | ch, 33)
+             .event(1, 0xE0 | ch, 0x12, 0x34);
+    }
+    track.endOfTrack();
+
+    SmfWriter smf(0);
+    smf.addTrack(track);
+    compare(smf.data());
+}
+
+void tst_MidiFileParse::runningStatus()
+{
+    SmfTrack track;
+    track.event(0, 0x90, 60, 100);
+    for (int i=0; i<200; i++)
+        track.running(i % 3, 60 + (i % 12), (i % 5) ? 100 : 0);
+    track.event(0, 0xC1, 5)
+         .running(0, 6)
+         .event(0, 0xE1, 0, 0x40)
+         .running(300, 0x7F, 0x7F);
+    track.endOfTrack();
+
+    SmfWriter smf(0);
+    smf.addTrack(track);
+    compare(smf.data());
+}
+
+void tst_MidiFileParse::metaAndSysEx()
+{
+    SmfTrack track;
+    track.sysEx(0, 0xF0, QByteArray::fromHex("7E7F0901F7"))
+         .sysEx(0, 0xF7, QByteArray::fromHex("F0411042"))
+         .meta(0, 0x01, "text")
+         .meta(0, 0x05, QByteArray(300, 'x')) // two byte length
+         .meta(100000, 0x51, QByteArray::fromHex("07A120")) // four byte delta
+         .meta(0, 0x7F, QByteArray())
+         .event(0, 0x90, 60, 90)
+         .sysEx(0, 0xF0, QByteArray::fromHex("F7"))
+         .event(10, 0x90, 60, 0)
+         .endOfTrack();
+
+    SmfWriter smf(0);
+    smf.addTrack(track);
+    compare(smf.data());
+}
+
+void tst_MidiFileParse::extraTrackData()
+{
+    SmfTrack first;
+    first.event(0, 0x90, 60, 90)
+         .endOfTrack(10)
+         .raw(QByteArray::fromHex("0090403000FF2F00"));
+
+    SmfTrack second;
+    second.event(5, 0x91, 64, 90)
+          .event(5, 0x81, 64, 0)
+          .endOfTrack();
+
+    SmfWriter smf;
+    smf.addTrack(first);
+    smf.addTrack(second);
+    compare(smf.data());
+}
+
+void tst_MidiFileParse::multipleTracks()
+{
+    compare(songSmf());
+
+    // same ticks on every track, the sort must stay stable on track order
+    SmfWriter smf;
+    for (int t=0; t<24; t++) {
+        SmfTrack track;
+        for (int i=0; i<50; i++)
+            track.event(i ? 120 : 0, 0x90 | (t % 16), 40 + t, 100)
+                 .running(0, 40 + t, 0);
+        track.endOfTrack();
+        smf.addTrack(track);
+    }
+    compare(smf.data());
+}
+
+void tst_MidiFileParse::trackLimit()
+{
+    SmfWriter smf;
+    for (int t=0; t<MIDI_MAX_TRACKS; t++) {
+        SmfTrack track;
+        track.meta(t, 0x03, QByteArray::number(t))
+             .event(0, 0x90 | (t % 16), t % 128, 100)
+             .endOfTrack();
+        smf.addTrack(track);
+    }
+
+    // payloads must not depend on the source buffer
+    MidiFile midi;
+    {
+        QByteArray data = smf.data();
+        QVERIFY(midi.read(data));
+    }
+    QVector<MidiEvent> ref;
+    QVERIFY(ReferenceSmf::read(smf.data(), &ref));
+    compareEvents(midi, ref);
+
+    SmfTrack extra;
+    extra.endOfTrack();
+    smf.addTrack(extra);
+
+    MidiFile tooMany;
+    QVERIFY(!tooMany.read(smf.data()));
+    QVERIFY(tooMany.eventStore()->isEmpty());
+}
+
+void tst_MidiFileParse::fileAndBuffer()
+{
+    QByteArray data = songSmf();
+
+    QTemporaryFile tmp;
+    QVERIFY(tmp.open());
+    tmp.write(data);
+    tmp.close();
+
+    QVector<MidiEvent> ref;
+    QVERIFY(ReferenceSmf::read(data, &ref));
+
+    MidiFile fromPath;
+    QVERIFY(fromPath.read(tmp.fileName()));
+    compareEvents(fromPath, ref);
+
+    QFile f(tmp.fileName());
+    MidiFile fromFile;
+    QVERIFY(fromFile.read(&f));
+    compareEvents(fromFile, ref);
+    QVERIFY(!f.isOpen());
+
+    QCOMPARE(fromPath.resorution(), 480);
+    QCOMPARE(fromPath.numberOfTracks(), 2);
+    QCOMPARE(fromPath.formatType(), 1);
+}
+
+// HK_MIDI_CORPUS=<folder> compares every .mid/.kar file under folder
+void tst_MidiFileParse::corpus()
+{
+    QString dir = qEnvironmentVariable("HK_MIDI_CORPUS");
+    if (dir.isEmpty())
+        QSKIP("HK_MIDI_CORPUS is not set");
+
+    QDirIterator it(dir, QStringList() << "*.mid" << "*.MID" << "*.kar" << "*.KAR",
+                    QDir::Files, QDirIterator::Subdirectories);
+    int files = 0;
+    while (it.hasNext()) {
+        QString path = it.next();
+        QFile f(path);
+        if (!f.open(QFile::ReadOnly))
+            continue;
+        QByteArray data = f.readAll();
+        f.close();
+
+        QVector<MidiEvent> ref;
+        QString refLyrics;
+        bool refOk = ReferenceSmf::read(data, &ref, &refLyrics);
+
+        MidiFile midi;
+        bool ok = midi.read(data);
+        QVERIFY2(ok == refOk, qPrintable(path));
+        if (!ok)
+            continue;
+
+        compareEvents(midi, ref);
+        if (QTest::currentTestFailed()) {
+            qWarning() << "mismatch:" << path;
+            return;
+        }
+        QVERIFY2(midi.lyrics() == refLyrics, qPrintable(path));
+        files++;
+    }
+
+    qDebug() << files << "files compared";
+}
+
+QTEST_APPLESS_MAIN(tst_MidiFileParse)
+
+#include "tst_midifile_parse.moc"
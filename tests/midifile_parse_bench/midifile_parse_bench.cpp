@@ -0,0 +1,116 @@
+#include "MidiFile.h"
+#include "ReferenceSmfReader.h"
+
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+// SMF parser benchmark: reads every .mid/.kar file under <folder> into
+// memory, then parses them all with the original byte by byte reader and
+// with MidiFile::read(QByteArray) and reports files and MB per second.
+//
+// midifile_parse_bench <folder> [<rounds>]
+
+typedef struct
+{
+    qint64 ns;
+    int failed;
+} ParseTime;
+
+static ParseTime referenceTime(const QList<QByteArray> &files, int rounds)
+{
+    ParseTime t = { 0, 0 };
+    QVector<MidiEvent> events;
+    QString lyrics;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int r=0; r<rounds; r++) {
+        for (const QByteArray &data : files) {
+            if (!ReferenceSmf::read(data, &events, &lyrics))
+                t.failed++;
+        }
+    }
+    t.ns = timer.nsecsElapsed();
+
+    return t;
+}
+
+static ParseTime midiFileTime(const QList<QByteArray> &files, int rounds)
+{
+    ParseTime t = { 0, 0 };
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int r=0; r<rounds; r++) {
+        for (const QByteArray &data : files) {
+            MidiFile midi;
+            if (!midi.read(data))
+                t.failed++;
+        }
+    }
+    t.ns = timer.nsecsElapsed();
+
+    return t;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QStringList args = a.arguments();
+    QTextStream out(stdout);
+
+    if (args.count() < 2) {
+        out << "usage: midifile_parse_bench <folder> [<rounds>]\n";
+        return 1;
+    }
+    int rounds = (args.count() > 2) ? qMax(1, args.at(2).toInt()) : 5;
+
+    QList<QByteArray> files;
+    qint64 bytes = 0;
+
+    QDirIterator it(args.at(1), QStringList() << "*.mid" << "*.MID" << "*.kar" << "*.KAR",
+                    QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QFile f(it.next());
+        if (!f.open(QFile::ReadOnly))
+            continue;
+        files.append(f.readAll());
+        bytes += files.last().size();
+        f.close();
+    }
+
+    if (files.isEmpty()) {
+        out << "no .mid or .kar file in " << args.at(1) << "\n";
+        return 1;
+    }
+    out << "files: " << files.count() << ", " << QString::number(bytes / 1048576.0, 'f', 1)
+        << " MB, rounds: " << rounds << "\n";
+
+    // once each before timing, the files and the allocator are warm
+    referenceTime(files, 1);
+    midiFileTime(files, 1);
+
+    typedef struct {
+        const char *name;
+        ParseTime time;
+    } BenchParser;
+
+    const BenchParser parsers[] = {
+        { "byte by byte", referenceTime(files, rounds) },
+        { "MidiFile::read", midiFileTime(files, rounds) },
+    };
+
+    for (const BenchParser &p : parsers) {
+        double seconds = qMax<qint64>(1, p.time.ns) / 1000000000.0;
+        out << p.name << ": " << qRound64(files.count() * rounds / seconds) << " files/s, "
+            << QString::number(bytes * rounds / seconds / 1048576.0, 'f', 1) << " MB/s, "
+            << p.time.failed / rounds << " failed\n";
+    }
+
+    out << "speedup: " << QString::number((double)parsers[0].time.ns / qMax<qint64>(1, parsers[1].time.ns), 'f', 2) << "x\n";
+
+    return 0;
+}
@@ -0,0 +1,15 @@
+include(../tests.pri)
+
+# benchmark, not run by make check
+QT -= testlib
+CONFIG -= testcase
+
+TARGET = midifile_parse_bench
+
+SOURCES += midifile_parse_bench.cpp \
+    $$SRC_ROOT/Midi/MidiEvent.cpp \
+    $$SRC_ROOT/Midi/MidiEventStore.cpp \
+    $$SRC_ROOT/Midi/MidiFile.cpp \
+    $$SRC_ROOT/Midi/MidiHelper.cpp
+
+HEADERS += ../common/ReferenceSmfReader.h
@@ -0,0 +1,110 @@
+#include "Midi/MidiSynthesizer.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+// MidiSynthesizer routing benchmark: events per second through sendNoteOn
+// and sendNoteOff on every channel (drum notes on channel 9), with and
+// without the event clock, plus program changes that re-route a channel.
+// The synth is opened offline on the no sound device, no soundfont.
+//
+// synth_route_bench [<seconds per case>]
+
+static quint32 lcg = 12345;
+
+static int nextInt(int n)
+{
+    lcg = lcg * 1664525u + 1013904223u;
+    return int((lcg >> 8) % n);
+}
+
+static double notesPerSecond(MidiSynthesizer *synth, int seconds, bool timed)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    qint64 events = 0;
+    qint64 timeUs = 0;
+
+    if (timed)
+        synth->startEventClock();
+
+    while (timer.elapsed() < seconds * 1000) {
+        for (int i=0; i<1000; i++) {
+            int ch = nextInt(16);
+            int note = 27 + nextInt(60);
+            synth->sendNoteOn(ch, note, 100, timed ? timeUs : -1);
+            synth->sendNoteOff(ch, note, 0, timed ? timeUs + 100000 : -1);
+            timeUs += 1000;
+        }
+        events += 2000;
+
+        // drop the queued events, the streams are never decoded
+        if (timed && events % 100000 == 0) {
+            synth->stopEventClock();
+            synth->startEventClock();
+            timeUs = 0;
+        }
+    }
+
+    if (timed)
+        synth->stopEventClock();
+
+    return events * 1000.0 / qMax<qint64>(1, timer.elapsed());
+}
+
+static double programChangesPerSecond(MidiSynthesizer *synth, int seconds)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    qint64 events = 0;
+    while (timer.elapsed() < seconds * 1000) {
+        for (int i=0; i<100; i++, events++)
+            synth->sendProgramChange(nextInt(16), nextInt(128));
+    }
+
+    return events * 1000.0 / qMax<qint64>(1, timer.elapsed());
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QStringList args = a.arguments();
+    int seconds = (args.count() > 1) ? args.at(1).toInt() : 2;
+
+    QTextStream out(stdout);
+
+    // device 0, no sound
+    if (!BASS_Init(0, 44100, 0, NULL, NULL)) {
+        out << "BASS_Init failed: " << BASS_ErrorGetCode() << "\n";
+        return 1;
+    }
+
+    int result = 0;
+    {
+        MidiSynthesizer synth;
+        synth.setOfflineMode(true);
+
+        if (!synth.isOpened()) {
+            out << "synth open failed\n";
+            result = 1;
+        } else {
+            // a channel on each instrument group
+            for (int ch=0; ch<16; ch++) {
+                if (ch != 9)
+                    synth.sendProgramChange(ch, ch * 8);
+            }
+
+            out << "notes: " << qRound64(notesPerSecond(&synth, seconds, false)) << " events/s\n";
+            out << "notes, event clock: " << qRound64(notesPerSecond(&synth, seconds, true)) << " events/s\n";
+            out << "program changes: " << qRound64(programChangesPerSecond(&synth, seconds)) << " events/s\n";
+        }
+    }
+
+    BASS_Free();
+
+    return result;
+}
@@ -0,0 +1,62 @@
+include(../tests.pri)
+
+# benchmark, not run by make check
+QT -= testlib
+CONFIG -= testcase
+
+TARGET = synth_route_bench
+
+SOURCES += synth_route_bench.cpp \
+    $$SRC_ROOT/Midi/MidiEvent.cpp \
+    $$SRC_ROOT/Midi/MidiEventStore.cpp \
+    $$SRC_ROOT/Midi/MidiFile.cpp \
+    $$SRC_ROOT/Midi/MidiHelper.cpp \
+    $$SRC_ROOT/Midi/MidiSynthesizer.cpp \
+    $$SRC_ROOT/BASSFX/FX.cpp \
+    $$SRC_ROOT/BASSFX/AutoWahFX.cpp \
+    $$SRC_ROOT/BASSFX/ChorusFX.cpp \
+    $$SRC_ROOT/BASSFX/Chorus2FX.cpp \
+    $$SRC_ROOT/BASSFX/CompressorFX.cpp \
+    $$SRC_ROOT/BASSFX/DistortionFX.cpp \
+    $$SRC_ROOT/BASSFX/EchoFX.cpp \
+    $$SRC_ROOT/BASSFX/Equalizer15BandFX.cpp \
+    $$SRC_ROOT/BASSFX/Equalizer31BandFX.cpp \
+    $$SRC_ROOT/BASSFX/LevelMeter.cpp \
+    $$SRC_ROOT/BASSFX/ReverbFX.cpp \
+    $$SRC_ROOT/BASSFX/Reverb2FX.cpp
+
+HEADERS += $$SRC_ROOT/Midi/MidiSynthesizer.h
+
+win32 {
+    SOURCES += $$SRC_ROOT/BASSFX/VSTFX.cpp
+
+    contains(QT_ARCH, i386) {
+        LIBS += -L$$SRC_ROOT/BASS/bass24/ -lbass
+        LIBS += -L$$SRC_ROOT/BASS/bassmidi24/ -lbassmidi
+        LIBS += -L$$SRC_ROOT/BASS/bass_fx24/ -lbass_fx
+        LIBS += -L$$SRC_ROOT/BASS/bassmix24/ -lbassmix
+        LIBS += -L$$SRC_ROOT/BASS/bass_vst24/ -lbass_vst
+    } else {
+        LIBS += -L$$SRC_ROOT/BASS/bass24/x64/ -lbass
+        LIBS += -L$$SRC_ROOT/BASS/bassmidi24/x64/ -lbassmidi
+        LIBS += -L$$SRC_ROOT/BASS/bass_fx24/x64/ -lbass_fx
+        LIBS += -L$$SRC_ROOT/BASS/bassmix24/x64/ -lbassmix
+        LIBS += -L$$SRC_ROOT/BASS/bass_vst24/x64/ -lbass_vst
+    }
+}
+
+unix:!macx {
+    QMAKE_LFLAGS += -no-pie
+
+    contains(QT_ARCH, i386) {
+        LIBS += -L$$SRC_ROOT/BASS/bass24-linux/ -lbass
+        LIBS += -L$$SRC_ROOT/BASS/bassmidi24-linux/ -lbassmidi
+        LIBS += -L$$SRC_ROOT/BASS/bass_fx24-linux/ -lbass_fx
+        LIBS += -L$$SRC_ROOT/BASS/bassmix24-linux/ -lbassmix
+    } else {
+        LIBS += -L$$SRC_ROOT/BASS/bass24-linux/x64/ -lbass
+        LIBS += -L$$SRC_ROOT/BASS/bassmidi24-linux/x64/ -lbassmidi
+        LIBS += -L$$SRC_ROOT/BASS/bass_fx24-linux/x64/ -lbass_fx
+        LIBS += -L$$SRC_ROOT/BASS/bassmix24-linux/x64/ -lbassmix
+    }
+}
@@ -0,0 +1,38 @@
+# Shared by the test projects, the sources are built from the app tree
+
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+SRC_ROOT = $$PWD/..
+
+INCLUDEPATH += $$SRC_ROOT \
+    $$SRC_ROOT/Midi \
+    $$PWD/common
+
+win32 {
+    INCLUDEPATH += $$SRC_ROOT/BASS/bass24
+    INCLUDEPATH += $$SRC_ROOT/BASS/bassmidi24
+    INCLUDEPATH += $$SRC_ROOT/BASS/bass_fx24
+    INCLUDEPATH += $$SRC_ROOT/BASS/bassmix24
+    INCLUDEPATH += $$SRC_ROOT/BASS/bass_vst24
+}
+
+unix:!macx {
+    INCLUDEPATH += $$SRC_ROOT/BASS/bass24-linux
+    INCLUDEPATH += $$SRC_ROOT/BASS/bassmidi24-linux
+    INCLUDEPATH += $$SRC_ROOT/BASS/bass_fx24-linux
+    INCLUDEPATH += $$SRC_ROOT/BASS/bassmix24-linux
+}
+
+macx {
+    INCLUDEPATH += $$SRC_ROOT/BASS/bass24-osx
+    INCLUDEPATH += $$SRC_ROOT/BASS/bassmidi24-osx
+    INCLUDEPATH += $$SRC_ROOT/BASS/bass_fx24-osx
+    INCLUDEPATH += $$SRC_ROOT/BASS/bassmix24-osx
+    INCLUDEPATH += $$SRC_ROOT/BASS/bass_vst24-osx
+}
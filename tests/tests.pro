@@ -0,0 +1,15 @@
+#-------------------------------------------------
+#
+# Tests and benchmarks, build with: qmake tests.pro && make check
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    midifile_parse \
+    midifile_parse_bench \
+    midifile_merge \
+    lyrics_timeline \
+    catalog_bench \
+    synth_route_bench